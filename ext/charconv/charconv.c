@@ -474,6 +474,89 @@ ScmObj Scm_MakeOutputConversionPort(ScmPort *toPort,
     return Scm_MakeBufferedPort(SCM_CLASS_PORT, name, SCM_PORT_OUTPUT, TRUE, &bufrec);
 }
 
+/*------------------------------------------------------------
+ * Bulk conversion
+ *
+ *  Converts the whole input at once, without going through the
+ *  buffers of conversion ports.  Returns a newly allocated buffer
+ *  that holds the result, terminated by NUL.  The size of the result
+ *  (excluding the NUL) is stored in *outsize.
+ */
+
+static char *grow_buffer(char *buf, size_t *bufsiz, char **outptr,
+                         size_t *outroom)
+{
+    size_t used = *outptr - buf;
+    size_t newsiz = *bufsiz * 2;
+    char *newbuf = SCM_NEW_ATOMIC2(char *, newsiz + 1);
+    memcpy(newbuf, buf, used);
+    *bufsiz = newsiz;
+    *outptr = newbuf + used;
+    *outroom = newsiz - used;
+    return newbuf;
+}
+
+char *Scm_ConvertBuffer(const char *fromCode, const char *toCode,
+                        const char *data, size_t size, size_t *outsize)
+{
+    conv_guess *guess = findGuessingProc(fromCode);
+    if (guess) {
+        if (size == 0) {
+            *outsize = 0;
+            return SCM_NEW_ATOMIC2(char *, 1);
+        }
+        const char *guessed = guess->proc(data, (int)size, guess->data);
+        if (guessed == NULL)
+            Scm_Error("%s: failed to guess input encoding", fromCode);
+        fromCode = guessed;
+    }
+
+    ScmConvInfo *info = jconv_open(toCode, fromCode);
+    if (info == NULL) {
+        Scm_Error("conversion from code %s to code %s is not supported",
+                  fromCode, toCode);
+    }
+
+    /* Most conversions don't change the size much.  UTF-16 may double
+       it, and then we just grow the buffer. */
+    size_t bufsiz = size + size/4 + 16;
+    char *buf = SCM_NEW_ATOMIC2(char *, bufsiz + 1);
+    const char *inptr = data;
+    size_t inroom = size;
+    char *outptr = buf;
+    size_t outroom = bufsiz;
+
+    while (inroom > 0) {
+        size_t r = jconv(info, &inptr, &inroom, &outptr, &outroom);
+        if (r == ILLEGAL_SEQUENCE) {
+            int cnt = inroom >= 6 ? 6 : (int)inroom;
+            ScmObj s = Scm_MakeString(inptr, cnt, cnt,
+                                      SCM_STRING_COPYING|SCM_STRING_INCOMPLETE);
+            jconv_close(info);
+            Scm_Error("invalid character sequence in the input: %S ...", s);
+        }
+        /* An incomplete character at the end is dropped, as the input
+           conversion port does. */
+        if (r == INPUT_NOT_ENOUGH) break;
+        if (inroom > 0) {
+            buf = grow_buffer(buf, &bufsiz, &outptr, &outroom);
+        }
+    }
+    for (;;) {
+        size_t r = jconv_reset(info, outptr, outroom);
+        if (r == OUTPUT_NOT_ENOUGH) {
+            buf = grow_buffer(buf, &bufsiz, &outptr, &outroom);
+            continue;
+        }
+        outptr += r;
+        break;
+    }
+    jconv_close(info);
+    *outptr = '\0';
+    *outsize = outptr - buf;
+    return buf;
+}
+
 /*------------------------------------------------------------
  * Direct interface for code guessing
  */
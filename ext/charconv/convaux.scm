@@ -35,8 +35,6 @@
 (use srfi-1)
 (use srfi-13)
 (use gauche.sequence)
-(autoload gauche.vport
-          open-input-uvector open-output-uvector get-output-uvector)
 
 ;; Determine charset compatibility.  (ces-equivalent? a b) is true if CES a and
 ;; CES b refer to the same CES.
@@ -113,35 +111,11 @@
 
     (values ces-equivalent? ces-upper-compatible?)))
 
-;; returns appropriate input port and size
-(define (%ces-input input)
-  (cond [(string? input)
-         (values (open-input-string input :private? #t) (string-length input))]
-        ;; avoid using u8vector? so that we don't depend on gauche.uvector
-        [(is-a? input <u8vector>)
-         (values (open-input-uvector input) (uvector-length input))]
-        [else (error "string or u8vector required, but got:" input)]))
-
-;; returns appropriate output port and get-output-*
-(define (%ces-output class)
-  (cond
-   [(eq? class <string>)
-    (values (open-output-string :private? #t) get-output-string)]
-   [(eq? class <u8vector>)
-    (values (open-output-uvector) get-output-uvector)]
-   [else (error "Only <string> or <u8vector> is supported, but got:" class)]))
-
 ;; Convert string or uvector -> string or uvector
 (define (ces-convert-to class input fromcode :optional (tocode #f))
-  (receive (inp isize) (%ces-input input)
-    (receive (out get) (%ces-output class)
-      (let1 in ($ open-input-conversion-port inp fromcode
-                  :to-code tocode :buffer-size isize :owner? #t)
-        (copy-port in out :unit 'byte)
-        (close-input-port in)
-        (flush out)
-        (begin0 (get out)
-          (close-output-port out))))))
+  (unless (or (eq? class <string>) (eq? class <u8vector>))
+    (error "Only <string> or <u8vector> is supported, but got:" class))
+  (%ces-convert input fromcode tocode (eq? class <string>)))
 
 (define (ces-convert input fromcode :optional (tocode #f))
   (ces-convert-to <string> input fromcode tocode))
@@ -250,6 +224,27 @@
      (return (Scm_MakeOutputConversionPort sink tc fc buffer_size
                                            (not (SCM_FALSEP ownerP))))))
 
+ (define-cproc %ces-convert (input from-code to-code to-string::<boolean>)
+   (let* ([fc::(const char*) (Scm_GetCESName from_code "from-code")]
+          [tc::(const char*) (Scm_GetCESName to_code "to-code")]
+          [src::(const char*) NULL]
+          [size::size_t 0]
+          [outsize::size_t 0])
+     (cond [(SCM_STRINGP input)
+            (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY input)])
+              (set! src (SCM_STRING_BODY_START b)
+                    size (SCM_STRING_BODY_SIZE b)))]
+           [(SCM_U8VECTORP input)
+            (set! src (cast (const char*) (SCM_U8VECTOR_ELEMENTS input))
+                  size (SCM_U8VECTOR_SIZE input))]
+           [else (Scm_Error "string or u8vector required, but got: %S"
+                            input)])
+     (let* ([out::char* (Scm_ConvertBuffer fc tc src size (& outsize))])
+       (if to-string
+         (return (Scm_MakeString out outsize -1 0))
+         (return (Scm_MakeU8VectorFromArrayShared
+                  outsize (cast (unsigned char*) out)))))))
+
  (define-cproc ces-guess-from-string (string::<string> scheme::<string>)
    (let* ([size::u_int]
           [s::(const char*) (Scm_GetStringContent string (& size) NULL NULL)]
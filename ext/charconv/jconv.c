@@ -1093,6 +1093,161 @@ static size_t pivot(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
     return 0;
 }
 
+/*=================================================================
+ * Latin-1 and UTF-16
+ */
+
+/* These are converted directly from/to UTF-8, without going through
+ * the EUC_JP pivot, for they have characters that EUC_JP doesn't have.
+ * Conversion between one of them and other Japanese encodings is
+ * left to iconv.
+ *
+ * Unlike utf2eucj, UTF-8 input is strictly checked; overlong forms,
+ * surrogates and the code points beyond U+10FFFF are rejected.
+ * A character that can't be represented in Latin-1 is substituted
+ * by SUBST1_CHAR.
+ */
+
+static inline size_t utf8_decode(const char *inptr, size_t inroom,
+                                 unsigned int *ucs)
+{
+    unsigned char u0 = (unsigned char)inptr[0];
+    unsigned int c, min;
+    size_t n;
+
+    if (u0 < 0x80) { *ucs = u0; return 1; }
+    if (u0 < 0xc2) return ILLEGAL_SEQUENCE;
+    if (u0 < 0xe0)      { n = 2; c = u0 & 0x1f; min = 0x80; }
+    else if (u0 < 0xf0) { n = 3; c = u0 & 0x0f; min = 0x800; }
+    else if (u0 < 0xf5) { n = 4; c = u0 & 0x07; min = 0x10000; }
+    else return ILLEGAL_SEQUENCE;
+
+    for (size_t i = 1; i < n; i++) {
+        if (i >= inroom) return INPUT_NOT_ENOUGH;
+        unsigned char u = (unsigned char)inptr[i];
+        if ((u & 0xc0) != 0x80) return ILLEGAL_SEQUENCE;
+        c = (c << 6) | (u & 0x3f);
+    }
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c < 0xe000)) {
+        return ILLEGAL_SEQUENCE;
+    }
+    *ucs = c;
+    return n;
+}
+
+static size_t utf2latin1(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
+                         char *outptr, size_t outroom, size_t *outchars)
+{
+    unsigned int ucs;
+    size_t r = utf8_decode(inptr, inroom, &ucs);
+    if (ERRP(r)) return r;
+    outptr[0] = (ucs < 0x100)? (char)ucs : SUBST1_CHAR;
+    *outchars = 1;
+    return r;
+}
+
+static size_t latin12utf(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
+                         char *outptr, size_t outroom, size_t *outchars)
+{
+    unsigned char c = (unsigned char)inptr[0];
+    if (c < 0x80) {
+        outptr[0] = c;
+        *outchars = 1;
+    } else {
+        OUTCHK(2);
+        outptr[0] = 0xc0 | (c >> 6);
+        outptr[1] = 0x80 | (c & 0x3f);
+        *outchars = 2;
+    }
+    return 1;
+}
+
+static inline void utf16_put(char *outptr, unsigned int u, int le)
+{
+    if (le) {
+        outptr[0] = u & 0xff;
+        outptr[1] = u >> 8;
+    } else {
+        outptr[0] = u >> 8;
+        outptr[1] = u & 0xff;
+    }
+}
+
+static inline unsigned int utf16_get(const char *inptr, int le)
+{
+    unsigned char b0 = (unsigned char)inptr[0];
+    unsigned char b1 = (unsigned char)inptr[1];
+    return le? ((b1 << 8) | b0) : ((b0 << 8) | b1);
+}
+
+static inline size_t utf2utf16(const char *inptr, size_t inroom,
+                               char *outptr, size_t outroom,
+                               size_t *outchars, int le)
+{
+    unsigned int ucs;
+    size_t r = utf8_decode(inptr, inroom, &ucs);
+    if (ERRP(r)) return r;
+    if (ucs < 0x10000) {
+        OUTCHK(2);
+        utf16_put(outptr, ucs, le);
+        *outchars = 2;
+    } else {
+        OUTCHK(4);
+        ucs -= 0x10000;
+        utf16_put(outptr, 0xd800 | (ucs >> 10), le);
+        utf16_put(outptr+2, 0xdc00 | (ucs & 0x3ff), le);
+        *outchars = 4;
+    }
+    return r;
+}
+
+static inline size_t utf162utf(const char *inptr, size_t inroom,
+                               char *outptr, size_t outroom,
+                               size_t *outchars, int le)
+{
+    INCHK(2);
+    unsigned int ucs = utf16_get(inptr, le);
+    size_t inchars = 2;
+    if (ucs >= 0xd800 && ucs < 0xdc00) {
+        INCHK(4);
+        unsigned int lo = utf16_get(inptr+2, le);
+        if (lo < 0xdc00 || lo >= 0xe000) return ILLEGAL_SEQUENCE;
+        ucs = 0x10000 + ((ucs - 0xd800) << 10) + (lo - 0xdc00);
+        inchars = 4;
+    } else if (ucs >= 0xdc00 && ucs < 0xe000) {
+        return ILLEGAL_SEQUENCE;
+    }
+    int outreq = UCS2UTF_NBYTES(ucs);
+    OUTCHK(outreq);
+    jconv_ucs4_to_utf8(ucs, outptr);
+    *outchars = outreq;
+    return inchars;
+}
+
+static size_t utf2utf16le(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
+                          char *outptr, size_t outroom, size_t *outchars)
+{
+    return utf2utf16(inptr, inroom, outptr, outroom, outchars, TRUE);
+}
+
+static size_t utf2utf16be(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
+                          char *outptr, size_t outroom, size_t *outchars)
+{
+    return utf2utf16(inptr, inroom, outptr, outroom, outchars, FALSE);
+}
+
+static size_t utf16le2utf(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
+                          char *outptr, size_t outroom, size_t *outchars)
+{
+    return utf162utf(inptr, inroom, outptr, outroom, outchars, TRUE);
+}
+
+static size_t utf16be2utf(ScmConvInfo *cinfo, const char *inptr, size_t inroom,
+                          char *outptr, size_t outroom, size_t *outchars)
+{
+    return utf162utf(inptr, inroom, outptr, outroom, outchars, FALSE);
+}
+
 /*=================================================================
  * JCONV - the entry
  */
@@ -1104,6 +1259,10 @@ enum {
     JCODE_UTF8,
     JCODE_ISO2022JP,
     JCODE_NONE,    /* a special entry standing for byte stream */
+    /* The following ones are only converted from/to UTF8. */
+    JCODE_LATIN1,
+    JCODE_UTF16LE,
+    JCODE_UTF16BE,
 #if 0
     JCODE_ISO2022JP-2,
     JCODE_ISO2022JP-3
@@ -1122,6 +1281,9 @@ static struct conv_converter_rec {
     { utf2eucj,  eucj2utf,  NULL },      /* UTF8 */
     { jis2eucj,  eucj2jis,  jis_reset }, /* ISO2022JP */
     { pivot, pivot, NULL },              /* NONE */
+    { latin12utf, utf2latin1, NULL },    /* LATIN1 (from/to UTF8) */
+    { utf16le2utf, utf2utf16le, NULL },  /* UTF16LE (from/to UTF8) */
+    { utf16be2utf, utf2utf16be, NULL },  /* UTF16BE (from/to UTF8) */
 };
 
 /* map convesion name to the canonical code */
@@ -1149,6 +1311,15 @@ static struct conv_support_rec {
     { "iso2022jp-3",  JCODE_ISO2022JP },
     { "iso-2022jp-3", JCODE_ISO2022JP },
     { "none",         JCODE_NONE },
+    { "iso-8859-1",   JCODE_LATIN1 },
+    { "iso8859-1",    JCODE_LATIN1 },
+    { "iso88591",     JCODE_LATIN1 },
+    { "latin1",       JCODE_LATIN1 },
+    { "latin-1",      JCODE_LATIN1 },
+    { "utf-16le",     JCODE_UTF16LE },
+    { "utf16le",      JCODE_UTF16LE },
+    { "utf-16be",     JCODE_UTF16BE },
+    { "utf16be",      JCODE_UTF16BE },
     { NULL, 0 }
 };
 
@@ -1189,6 +1360,9 @@ static int conv_name_find(const char *name)
      supported.  we use two conversion subroutine cascaded.
    (5) other cases;
      we delegate the job to iconv.
+   Latin-1 and UTF-16 don't use the pivot; the conversion between one
+   of them and UTF-8 is handled like (2) or (3), and the conversion
+   between one of them and other encodings is (5).
 */
 
 /* case (1) */
@@ -1216,6 +1390,30 @@ static size_t jconv_ident(ScmConvInfo *info, const char **iptr,
     }
 }
 
+/* Returns the length of the run of ASCII bytes, excluding DEL, at the
+   beginning of P.  Such bytes are passed through as they are when
+   info->asciiPass is set.  (We stop at DEL since sjis2eucj maps it to
+   the substitution character.)  We check a word at a time; a word
+   containing a byte >= 0x7f always has one of its high bits set after
+   adding 0x01 to each byte.  It may report a false positive when a byte
+   is >= 0x80 and carries over, which only makes us fall back to the
+   bytewise check. */
+#define ASCII_ONES  (~(u_long)0/0xff)
+#define ASCII_HIGHS (ASCII_ONES*0x80)
+
+static inline size_t ascii_run(const char *p, size_t n)
+{
+    size_t i = 0;
+    while (i + sizeof(u_long) <= n) {
+        u_long w;
+        memcpy(&w, p+i, sizeof(u_long));
+        if ((w | (w + ASCII_ONES)) & ASCII_HIGHS) break;
+        i += sizeof(u_long);
+    }
+    while (i < n && (unsigned char)p[i] < 0x7f) i++;
+    return i;
+}
+
 /* case (2) or (3) */
 static size_t jconv_1tier(ScmConvInfo *info, const char **iptr,
                           size_t *iroom, char **optr, size_t *oroom)
@@ -1231,6 +1429,18 @@ static size_t jconv_1tier(ScmConvInfo *info, const char **iptr,
 #endif
     SCM_ASSERT(cvt != NULL);
     while (inr > 0 && outr > 0) {
+        if (info->asciiPass) {
+            int n = (int)ascii_run(inp, (inr < outr)? inr : outr);
+            if (n > 0) {
+                memcpy(outp, inp, n);
+                converted += n;
+                inp += n;
+                inr -= n;
+                outp += n;
+                outr -= n;
+                continue;
+            }
+        }
         size_t outchars;
         size_t inchars = cvt(info, inp, inr, outp, outr, &outchars);
         if (ERRP(inchars)) {
@@ -1268,6 +1478,18 @@ static size_t jconv_2tier(ScmConvInfo *info, const char **iptr, size_t *iroom,
     fprintf(stderr, "jconv_2tier %s->%s\n", info->fromCode, info->toCode);
 #endif
     while (inr > 0 && outr > 0) {
+        if (info->asciiPass) {
+            int n = (int)ascii_run(inp, (inr < outr)? inr : outr);
+            if (n > 0) {
+                memcpy(outp, inp, n);
+                converted += n;
+                inp += n;
+                inr -= n;
+                outp += n;
+                outr -= n;
+                continue;
+            }
+        }
         size_t outchars, bufchars;
         size_t inchars = icvt(info, inp, inr, buf, INTBUFSIZ, &bufchars);
         if (ERRP(inchars)) {
@@ -1336,6 +1558,14 @@ static size_t jconv_iconv_reset(ScmConvInfo *info, char *optr, size_t oroom)
 }
 #endif /*HAVE_ICONV_H*/
 
+/* Whether the encoding maps ASCII bytes other than DEL to themselves,
+   regardless of the state. */
+static int ascii_transparent(int code)
+{
+    return (code == JCODE_EUCJ || code == JCODE_SJIS
+            || code == JCODE_UTF8 || code == JCODE_LATIN1);
+}
+
 /*------------------------------------------------------------------
  * JCONV_OPEN
  *  Returns ScmConvInfo, setting up some fields.
@@ -1351,6 +1581,14 @@ ScmConvInfo *jconv_open(const char *toCode, const char *fromCode)
     int incode  = conv_name_find(fromCode);
     int outcode = conv_name_find(toCode);
 
+    if ((incode > JCODE_NONE || outcode > JCODE_NONE)
+        && incode != outcode
+        && incode != JCODE_NONE && outcode != JCODE_NONE
+        && incode != JCODE_UTF8 && outcode != JCODE_UTF8) {
+        /* Latin-1 and UTF-16 are only converted from/to UTF-8 by us. */
+        incode = -1;
+    }
+
     if (incode == JCODE_NONE || outcode == JCODE_NONE) {
         /* conversion to/from none means no conversion */
         handler = jconv_ident;
@@ -1372,6 +1610,18 @@ ScmConvInfo *jconv_open(const char *toCode, const char *fromCode)
         handler = jconv_ident;
         convproc[0] = convproc[1] = NULL;
         reset = NULL;
+    } else if (incode > JCODE_NONE) {
+        /* Latin-1/UTF-16 -> UTF-8 */
+        handler = jconv_1tier;
+        convproc[0] = conv_converter[incode].inconv;
+        convproc[1] = NULL;
+        reset = NULL;
+    } else if (outcode > JCODE_NONE) {
+        /* UTF-8 -> Latin-1/UTF-16 */
+        handler = jconv_1tier;
+        convproc[0] = conv_converter[outcode].outconv;
+        convproc[1] = NULL;
+        reset = NULL;
     } else if (incode == JCODE_EUCJ) {
         /* pattern (2) */
         handler = jconv_1tier;
@@ -1398,6 +1648,7 @@ ScmConvInfo *jconv_open(const char *toCode, const char *fromCode)
     info->convproc[1] = convproc[1];
     info->reset = reset;
     info->handle = handle;
+    info->asciiPass = ascii_transparent(incode) && ascii_transparent(outcode);
     info->toCode = toCode;
     info->istate = info->ostate = JIS_ASCII;
     info->fromCode = fromCode;
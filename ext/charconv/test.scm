@@ -286,6 +286,37 @@
           '("EUCJP" "UTF-8" "SJIS" "ISO2022JP")
           '("EUCJP" "UTF-8" "SJIS" "ISO2022JP"))
 
+;; Latin-1 and UTF-16 are converted directly from/to UTF-8
+(test* "ces-convert-to utf-8 -> utf-16le" '#u8(#x61 0 #x42 #x30 #x3d #xd8 #x00 #xde)
+       (ces-convert-to <u8vector> '#u8(#x61 #xe3 #x81 #x82 #xf0 #x9f #x98 #x80)
+                       "utf-8" "utf-16le"))
+(test* "ces-convert-to utf-8 -> utf-16be" '#u8(0 #x61 #x30 #x42 #xd8 #x3d #xde #x00)
+       (ces-convert-to <u8vector> '#u8(#x61 #xe3 #x81 #x82 #xf0 #x9f #x98 #x80)
+                       "utf-8" "utf-16be"))
+(test* "ces-convert-to utf-16be -> utf-8" '#u8(#x61 #xe3 #x81 #x82 #xf0 #x9f #x98 #x80)
+       (ces-convert-to <u8vector> '#u8(0 #x61 #x30 #x42 #xd8 #x3d #xde #x00)
+                       "utf-16be" "utf-8"))
+(test* "ces-convert-to utf-16le (unpaired surrogate)" (test-error)
+       (ces-convert-to <u8vector> '#u8(#x00 #xdc #x61 0) "utf-16le" "utf-8"))
+(test* "ces-convert-to latin1 -> utf-8" '#u8(#x41 #xc3 #xa9 #xc3 #xbf)
+       (ces-convert-to <u8vector> '#u8(#x41 #xe9 #xff) "latin1" "utf-8"))
+(test* "ces-convert-to utf-8 -> latin1" '#u8(#x41 #xe9 #x3f)
+       (ces-convert-to <u8vector> '#u8(#x41 #xc3 #xa9 #xe3 #x81 #x82)
+                       "utf-8" "iso-8859-1"))
+(test* "ces-convert-to utf-8 (overlong)" (test-error)
+       (ces-convert-to <u8vector> '#u8(#x41 #xc0 #x80) "utf-8" "utf-16le"))
+
+;; long ASCII runs interleaved with multibyte characters
+(let ([eucjp (list->u8vector `(,@(make-list 1000 97) #xa4 #xa2
+                               ,@(make-list 37 98)))]
+      [utf8  (list->u8vector `(,@(make-list 1000 97) #xe3 #x81 #x82
+                               ,@(make-list 37 98)))])
+  (when (ces-conversion-supported? "EUCJP" "UTF-8")
+    (test* "ces-convert-to long ascii run EUCJP -> UTF-8" utf8
+           (ces-convert-to <u8vector> eucjp "EUCJP" "UTF-8"))
+    (test* "ces-convert-to long ascii run UTF-8 -> EUCJP" eucjp
+           (ces-convert-to <u8vector> utf8 "UTF-8" "EUCJP"))))
+
 ;;--------------------------------------------------------------------
 (test-section "wrapping conversion")
 
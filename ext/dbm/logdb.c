@@ -0,0 +1,747 @@
+/*
+ * logdb.c - log-structured key-value store
+ *
+ *   Copyright (c) 2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "logdb.h"
+#include <gauche/extend.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(GAUCHE_WINDOWS)
+#include <io.h>
+#define fsync _commit
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/*================================================================
+ * Utilities
+ */
+
+static uint32_t crc_table[256];
+static int crc_table_initialized = FALSE;
+
+static void init_crc_table(void)
+{
+    if (crc_table_initialized) return;
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1)? (0xedb88320UL ^ (c >> 1)) : (c >> 1);
+        }
+        crc_table[n] = c;
+    }
+    crc_table_initialized = TRUE;
+}
+
+static uint32_t crc_update(uint32_t crc, const char *p, size_t n)
+{
+    const u_char *q = (const u_char*)p;
+    while (n-- > 0) crc = crc_table[(crc ^ *q++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void put_u32(char *p, uint32_t v)
+{
+    p[0] = (char)(v & 0xff);
+    p[1] = (char)((v >> 8) & 0xff);
+    p[2] = (char)((v >> 16) & 0xff);
+    p[3] = (char)((v >> 24) & 0xff);
+}
+
+static uint32_t get_u32(const char *p)
+{
+    const u_char *q = (const u_char*)p;
+    return (uint32_t)q[0] | ((uint32_t)q[1] << 8)
+        | ((uint32_t)q[2] << 16) | ((uint32_t)q[3] << 24);
+}
+
+/* Fills the record header HDR, including the CRC, for the given datum. */
+static void make_header(char *hdr, const char *key, uint32_t klen,
+                        const char *val, uint32_t vlen)
+{
+    uint32_t crc = 0xffffffffUL;
+    put_u32(hdr+4, klen);
+    put_u32(hdr+8, vlen);
+    crc = crc_update(crc, hdr+4, 8);
+    crc = crc_update(crc, key, klen);
+    if (vlen != LOGDB_TOMBSTONE) crc = crc_update(crc, val, vlen);
+    put_u32(hdr, crc ^ 0xffffffffUL);
+}
+
+static u_long hash_key(const char *key, uint32_t klen)
+{
+    /* FNV-1a */
+    u_long h = 2166136261UL;
+    for (uint32_t i = 0; i < klen; i++) {
+        h = (h ^ (u_char)key[i]) * 16777619UL;
+    }
+    return h;
+}
+
+static off_t record_size(uint32_t klen, uint32_t vlen)
+{
+    return LOGDB_RECORD_HEADER + (off_t)klen
+        + (vlen == LOGDB_TOMBSTONE ? 0 : (off_t)vlen);
+}
+
+static int write_fully(int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t r;
+        SCM_SYSCALL(r, write(fd, p, n));
+        if (r < 0) return -1;
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+/* Reads N bytes at OFF.  Returns the number of bytes read, or -1. */
+static ssize_t read_fully(int fd, off_t off, char *p, size_t n)
+{
+    size_t done = 0;
+    if (lseek(fd, off, SEEK_SET) < 0) return -1;
+    while (done < n) {
+        ssize_t r;
+        SCM_SYSCALL(r, read(fd, p+done, n-done));
+        if (r < 0) return -1;
+        if (r == 0) break;
+        done += r;
+    }
+    return (ssize_t)done;
+}
+
+/* Returns -1 only if the file is locked by someone else.  If the
+   filesystem doesn't support locking, we go without it. */
+static int lock_file(int fd, int exclusive)
+{
+#if defined(F_SETLK)
+    struct flock lk;
+    int r;
+    lk.l_type = exclusive? F_WRLCK : F_RDLCK;
+    lk.l_whence = SEEK_SET;
+    lk.l_start = 0;
+    lk.l_len = 0;
+    SCM_SYSCALL(r, fcntl(fd, F_SETLK, &lk));
+    if (r < 0 && (errno == EACCES || errno == EAGAIN)) return -1;
+#endif
+    return 0;
+}
+
+static void check_open(LogDB *db)
+{
+    if (db->fd < 0) Scm_Error("logdbm file already closed: %s", db->path);
+}
+
+static void check_writable(LogDB *db)
+{
+    check_open(db);
+    if (db->readonly) Scm_Error("logdbm file is read-only: %s", db->path);
+}
+
+static void check_datum(const char *what, size_t len)
+{
+    if (len > LOGDB_MAX_DATUM) {
+        Scm_Error("logdbm: %s too long (%lu bytes)", what, (u_long)len);
+    }
+}
+
+/*================================================================
+ * Index
+ */
+
+#define INITIAL_CAPACITY 64
+
+static LogDBEntry *table_lookup(LogDB *db, const char *key, uint32_t klen,
+                                u_long hash)
+{
+    u_long mask = db->capacity - 1;
+    for (u_long i = hash & mask;; i = (i+1) & mask) {
+        LogDBEntry *e = &db->table[i];
+        if (e->key == NULL) return NULL;
+        if (e->hash == hash && e->klen == klen
+            && memcmp(e->key, key, klen) == 0) {
+            return e;
+        }
+    }
+}
+
+static void table_grow(LogDB *db)
+{
+    u_long ncap = db->capacity * 2, nmask = ncap - 1;
+    LogDBEntry *nt = SCM_NEW_ARRAY(LogDBEntry, ncap);
+    memset(nt, 0, sizeof(LogDBEntry)*ncap);
+    for (u_long i = 0; i < db->capacity; i++) {
+        LogDBEntry *e = &db->table[i];
+        if (e->key == NULL) continue;
+        u_long j = e->hash & nmask;
+        while (nt[j].key != NULL) j = (j+1) & nmask;
+        nt[j] = *e;
+    }
+    db->table = nt;
+    db->capacity = ncap;
+}
+
+/* Returns the entry for KEY, creating one if necessary.  KEY is copied
+   into the index unless NOCOPY is true.  *CREATED tells which happened. */
+static LogDBEntry *table_intern(LogDB *db, const char *key, uint32_t klen,
+                                u_long hash, int nocopy, int *created)
+{
+    if ((db->count+1)*4 > db->capacity*3) table_grow(db);
+    u_long mask = db->capacity - 1;
+    for (u_long i = hash & mask;; i = (i+1) & mask) {
+        LogDBEntry *e = &db->table[i];
+        if (e->key == NULL) {
+            if (nocopy) {
+                e->key = (char*)key;
+            } else {
+                e->key = SCM_NEW_ATOMIC2(char*, klen+1);
+                memcpy(e->key, key, klen);
+            }
+            e->klen = klen;
+            e->hash = hash;
+            db->count++;
+            *created = TRUE;
+            return e;
+        }
+        if (e->hash == hash && e->klen == klen
+            && memcmp(e->key, key, klen) == 0) {
+            *created = FALSE;
+            return e;
+        }
+    }
+}
+
+/* Removal by backward shifting, so that we don't need tombstones
+   in the index. */
+static void table_remove(LogDB *db, LogDBEntry *e)
+{
+    u_long mask = db->capacity - 1;
+    u_long i = (u_long)(e - db->table), j = i;
+    for (;;) {
+        j = (j+1) & mask;
+        if (db->table[j].key == NULL) break;
+        u_long k = db->table[j].hash & mask;
+        /* Entry at j may stay if its home slot k lies in (i, j]. */
+        if ((i <= j)? (i < k && k <= j) : (i < k || k <= j)) continue;
+        db->table[i] = db->table[j];
+        i = j;
+    }
+    memset(&db->table[i], 0, sizeof(LogDBEntry));
+    db->count--;
+}
+
+/*================================================================
+ * Log I/O
+ */
+
+static void io_error(LogDB *db, const char *what)
+{
+    Scm_SysError("logdbm: %s failed on %s", what, db->path);
+}
+
+static int flush_buffer(LogDB *db)
+{
+    if (db->buflen == 0) return 0;
+    if (lseek(db->fd, db->flushed, SEEK_SET) < 0) return -1;
+    if (write_fully(db->fd, db->buf, db->buflen) < 0) return -1;
+    db->flushed += db->buflen;
+    db->buflen = 0;
+    db->dirty = TRUE;
+    return 0;
+}
+
+/* Appends a record and returns the position where it starts. */
+static off_t append_record(LogDB *db, const char *key, uint32_t klen,
+                           const char *val, uint32_t vlen)
+{
+    char hdr[LOGDB_RECORD_HEADER];
+    size_t vbytes = (vlen == LOGDB_TOMBSTONE)? 0 : vlen;
+    size_t total = LOGDB_RECORD_HEADER + klen + vbytes;
+    off_t pos = db->size;
+
+    make_header(hdr, key, klen, val, vlen);
+    if (db->buflen + total > LOGDB_BUFFER_SIZE) {
+        if (flush_buffer(db) < 0) io_error(db, "write");
+    }
+    if (total > LOGDB_BUFFER_SIZE) {
+        if (lseek(db->fd, db->flushed, SEEK_SET) < 0
+            || write_fully(db->fd, hdr, LOGDB_RECORD_HEADER) < 0
+            || write_fully(db->fd, key, klen) < 0
+            || write_fully(db->fd, val, vbytes) < 0) {
+            io_error(db, "write");
+        }
+        db->flushed += total;
+        db->dirty = TRUE;
+    } else {
+        char *p = db->buf + db->buflen;
+        memcpy(p, hdr, LOGDB_RECORD_HEADER);
+        memcpy(p + LOGDB_RECORD_HEADER, key, klen);
+        if (vbytes) memcpy(p + LOGDB_RECORD_HEADER + klen, val, vbytes);
+        db->buflen += total;
+    }
+    db->size += total;
+    return pos;
+}
+
+/* Reads a value which may be partly in the file and partly still in
+   the write buffer. */
+static int read_value(LogDB *db, off_t off, char *p, size_t n)
+{
+    size_t done = 0;
+    if (off < db->flushed) {
+        size_t k = (size_t)(db->flushed - off);
+        if (k > n) k = n;
+        if (read_fully(db->fd, off, p, k) != (ssize_t)k) return -1;
+        done = k;
+    }
+    if (done < n) {
+        memcpy(p + done, db->buf + (off + done - db->flushed), n - done);
+    }
+    return 0;
+}
+
+/*================================================================
+ * Opening and replaying
+ */
+
+typedef struct ReaderRec {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t pos;
+} Reader;
+
+static int reader_fill(Reader *r)
+{
+    ssize_t k;
+    SCM_SYSCALL(k, read(r->fd, r->buf, LOGDB_BUFFER_SIZE));
+    if (k < 0) return -1;
+    r->len = k;
+    r->pos = 0;
+    return 0;
+}
+
+/* Copies N bytes to DST if it's not NULL, otherwise runs them through
+   *CRC.  Returns the number of bytes consumed, or -1 on error. */
+static ssize_t reader_take(Reader *r, char *dst, size_t n, uint32_t *crc)
+{
+    size_t done = 0;
+    while (done < n) {
+        if (r->pos == r->len) {
+            if (reader_fill(r) < 0) return -1;
+            if (r->len == 0) break;
+        }
+        size_t k = r->len - r->pos;
+        if (k > n - done) k = n - done;
+        if (dst) memcpy(dst + done, r->buf + r->pos, k);
+        else     *crc = crc_update(*crc, r->buf + r->pos, k);
+        r->pos += k;
+        done += k;
+    }
+    return (ssize_t)done;
+}
+
+#define REPLAY_BAD_FORMAT  (-2)
+
+static int replay(LogDB *db)
+{
+    struct stat st;
+    if (fstat(db->fd, &st) < 0) return -1;
+    off_t fsize = st.st_size;
+
+    if (fsize == 0) {
+        if (!db->readonly) {
+            if (write_fully(db->fd, LOGDB_MAGIC, LOGDB_MAGIC_SIZE) < 0) {
+                return -1;
+            }
+            db->size = db->flushed = LOGDB_MAGIC_SIZE;
+            db->dirty = TRUE;
+        }
+        return 0;
+    }
+
+    Reader r;
+    char magic[LOGDB_MAGIC_SIZE];
+    r.fd = db->fd;
+    r.buf = db->buf;            /* write buffer isn't used yet */
+    r.len = r.pos = 0;
+    if (lseek(db->fd, 0, SEEK_SET) < 0) return -1;
+    ssize_t got = reader_take(&r, magic, LOGDB_MAGIC_SIZE, NULL);
+    if (got < 0) return -1;
+    if (got < LOGDB_MAGIC_SIZE
+        || memcmp(magic, LOGDB_MAGIC, LOGDB_MAGIC_SIZE) != 0) {
+        return REPLAY_BAD_FORMAT;
+    }
+
+    off_t off = LOGDB_MAGIC_SIZE;
+    for (;;) {
+        char hdr[LOGDB_RECORD_HEADER];
+        got = reader_take(&r, hdr, LOGDB_RECORD_HEADER, NULL);
+        if (got < 0) return -1;
+        if (got < LOGDB_RECORD_HEADER) break;
+
+        uint32_t klen = get_u32(hdr+4), vlen = get_u32(hdr+8);
+        if (klen > LOGDB_MAX_DATUM) break;
+        if (vlen != LOGDB_TOMBSTONE && vlen > LOGDB_MAX_DATUM) break;
+        off_t rsize = record_size(klen, vlen);
+        if (off + rsize > fsize) break; /* torn tail */
+
+        char *key = SCM_NEW_ATOMIC2(char*, klen+1);
+        uint32_t crc = crc_update(0xffffffffUL, hdr+4, 8);
+        if (reader_take(&r, key, klen, NULL) != (ssize_t)klen) break;
+        crc = crc_update(crc, key, klen);
+        if (vlen != LOGDB_TOMBSTONE) {
+            if (reader_take(&r, NULL, vlen, &crc) != (ssize_t)vlen) break;
+        }
+        if ((crc ^ 0xffffffffUL) != get_u32(hdr)) break;
+
+        u_long h = hash_key(key, klen);
+        if (vlen == LOGDB_TOMBSTONE) {
+            LogDBEntry *e = table_lookup(db, key, klen, h);
+            if (e) {
+                db->live -= record_size(e->klen, e->vlen);
+                table_remove(db, e);
+            }
+        } else {
+            int created;
+            LogDBEntry *e = table_intern(db, key, klen, h, TRUE, &created);
+            if (!created) db->live -= record_size(e->klen, e->vlen);
+            e->vlen = vlen;
+            e->voffset = off + LOGDB_RECORD_HEADER + klen;
+            db->live += rsize;
+        }
+        off += rsize;
+    }
+
+    db->size = db->flushed = off;
+    if (off < fsize && !db->readonly) {
+        /* Drop the garbage at the tail, so that new records follow
+           the last valid one. */
+        if (ftruncate(db->fd, off) < 0) return -1;
+        db->dirty = TRUE;
+    }
+    return 0;
+}
+
+LogDB *LogDBOpen(const char *path, int mode, int perm, int sync)
+{
+    int flags = (mode == LOGDB_READER)? O_RDONLY : (O_RDWR|O_CREAT);
+    int fd, r;
+
+    init_crc_table();
+    SCM_SYSCALL(fd, open(path, flags|O_BINARY, perm));
+    if (fd < 0) Scm_SysError("couldn't open logdbm file %s", path);
+    if (lock_file(fd, mode != LOGDB_READER) < 0) {
+        close(fd);
+        Scm_Error("logdbm file %s is locked by another process", path);
+    }
+    /* We truncate after acquiring the lock, not by O_TRUNC, so that
+       we won't destroy the file someone else is using. */
+    if (mode == LOGDB_CREATE && ftruncate(fd, 0) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        Scm_SysError("couldn't truncate logdbm file %s", path);
+    }
+
+    LogDB *db = SCM_NEW(LogDB);
+    size_t plen = strlen(path);
+    char *p = SCM_NEW_ATOMIC2(char*, plen+1);
+    memcpy(p, path, plen+1);
+    db->path = p;
+    db->fd = fd;
+    db->readonly = (mode == LOGDB_READER);
+    db->sync = sync;
+    db->batch = 0;
+    db->dirty = FALSE;
+    db->size = db->flushed = db->live = 0;
+    db->buf = SCM_NEW_ATOMIC2(char*, LOGDB_BUFFER_SIZE);
+    db->buflen = 0;
+    db->capacity = INITIAL_CAPACITY;
+    db->table = SCM_NEW_ARRAY(LogDBEntry, INITIAL_CAPACITY);
+    memset(db->table, 0, sizeof(LogDBEntry)*INITIAL_CAPACITY);
+    db->count = 0;
+
+    r = replay(db);
+    if (r < 0) {
+        int e = errno;
+        close(fd);
+        db->fd = -1;
+        if (r == REPLAY_BAD_FORMAT) {
+            Scm_Error("not a logdbm file: %s", path);
+        }
+        errno = e;
+        Scm_SysError("couldn't read logdbm file %s", path);
+    }
+    return db;
+}
+
+/* Flushes and closes DB.  The descriptor is closed even if flushing
+   fails.  Returns -1 on failure, leaving errno. */
+int LogDBCloseNoError(LogDB *db)
+{
+    int r = 0;
+    if (db->fd < 0) return 0;
+    if (!db->readonly) {
+        if (flush_buffer(db) < 0) r = -1;
+        else if (db->dirty && fsync(db->fd) < 0) r = -1;
+    }
+    int e = errno;
+    close(db->fd);
+    db->fd = -1;
+    db->table = NULL;
+    db->capacity = db->count = 0;
+    db->buf = NULL;
+    db->buflen = 0;
+    errno = e;
+    return r;
+}
+
+void LogDBClose(LogDB *db)
+{
+    if (LogDBCloseNoError(db) < 0) {
+        Scm_SysError("closing logdbm file %s failed", db->path);
+    }
+}
+
+/*================================================================
+ * Accessors
+ */
+
+ScmObj LogDBGet(LogDB *db, const char *key, uint32_t klen)
+{
+    check_open(db);
+    LogDBEntry *e = table_lookup(db, key, klen, hash_key(key, klen));
+    if (e == NULL) return SCM_FALSE;
+    char *v = SCM_NEW_ATOMIC2(char*, e->vlen+1);
+    if (read_value(db, e->voffset, v, e->vlen) < 0) io_error(db, "read");
+    v[e->vlen] = '\0';
+    return Scm_MakeString(v, e->vlen, -1, 0);
+}
+
+int LogDBExists(LogDB *db, const char *key, uint32_t klen)
+{
+    check_open(db);
+    return table_lookup(db, key, klen, hash_key(key, klen)) != NULL;
+}
+
+static void after_update(LogDB *db, int sync)
+{
+    if (db->batch > 0) return;
+    off_t dead = db->size - LOGDB_MAGIC_SIZE - db->live;
+    if (dead >= LOGDB_COMPACT_MIN && dead > db->live) {
+        LogDBCompact(db);       /* this also syncs */
+    } else if (sync) {
+        LogDBSync(db);
+    }
+}
+
+void LogDBPut(LogDB *db, const char *key, uint32_t klen,
+              const char *val, uint32_t vlen)
+{
+    check_writable(db);
+    check_datum("key", klen);
+    check_datum("value", vlen);
+    u_long h = hash_key(key, klen);
+    off_t pos = append_record(db, key, klen, val, vlen);
+    int created;
+    LogDBEntry *e = table_intern(db, key, klen, h, FALSE, &created);
+    if (!created) db->live -= record_size(e->klen, e->vlen);
+    e->vlen = vlen;
+    e->voffset = pos + LOGDB_RECORD_HEADER + klen;
+    db->live += record_size(klen, vlen);
+    after_update(db, db->sync);
+}
+
+int LogDBDelete(LogDB *db, const char *key, uint32_t klen)
+{
+    check_writable(db);
+    LogDBEntry *e = table_lookup(db, key, klen, hash_key(key, klen));
+    if (e == NULL) return FALSE;
+    append_record(db, key, klen, NULL, LOGDB_TOMBSTONE);
+    db->live -= record_size(e->klen, e->vlen);
+    table_remove(db, e);
+    after_update(db, db->sync);
+    return TRUE;
+}
+
+/* Returns a list of all keys.  We take a snapshot so that the caller
+   can modify the database while traversing. */
+ScmObj LogDBKeys(LogDB *db)
+{
+    ScmObj r = SCM_NIL;
+    check_open(db);
+    for (u_long i = 0; i < db->capacity; i++) {
+        LogDBEntry *e = &db->table[i];
+        if (e->key == NULL) continue;
+        r = Scm_Cons(Scm_MakeString(e->key, e->klen, -1, SCM_STRING_COPYING),
+                     r);
+    }
+    return r;
+}
+
+/*================================================================
+ * Durability and compaction
+ */
+
+void LogDBSync(LogDB *db)
+{
+    check_open(db);
+    if (db->readonly) return;
+    if (flush_buffer(db) < 0) io_error(db, "write");
+    if (db->dirty) {
+        if (fsync(db->fd) < 0) io_error(db, "fsync");
+        db->dirty = FALSE;
+    }
+}
+
+/* Updates made within a batch are written out together and made
+   durable by a single fsync at the end of the outermost batch,
+   regardless of the sync mode. */
+void LogDBBeginBatch(LogDB *db)
+{
+    check_writable(db);
+    db->batch++;
+}
+
+void LogDBEndBatch(LogDB *db)
+{
+    check_open(db);
+    if (db->batch == 0) return;
+    if (--db->batch > 0) return;
+    after_update(db, TRUE);
+}
+
+void LogDBCompact(LogDB *db)
+{
+    check_writable(db);
+    if (db->batch > 0) return;
+    if (flush_buffer(db) < 0) io_error(db, "write");
+
+    struct stat st;
+    if (fstat(db->fd, &st) < 0) io_error(db, "stat");
+
+    size_t plen = strlen(db->path);
+    char *tmp = SCM_NEW_ATOMIC2(char*, plen + sizeof(".compact"));
+    memcpy(tmp, db->path, plen);
+    memcpy(tmp + plen, ".compact", sizeof(".compact"));
+
+    int fd;
+    SCM_SYSCALL(fd, open(tmp, O_RDWR|O_CREAT|O_TRUNC|O_BINARY,
+                         st.st_mode & 0777));
+    if (fd < 0) Scm_SysError("logdbm: couldn't create %s", tmp);
+
+    off_t *newoff = SCM_NEW_ATOMIC_ARRAY(off_t, db->capacity);
+    char *out = SCM_NEW_ATOMIC2(char*, LOGDB_BUFFER_SIZE);
+    size_t outlen = LOGDB_MAGIC_SIZE;
+    off_t pos = LOGDB_MAGIC_SIZE;
+    char *val = NULL;
+    size_t valsize = 0;
+    memcpy(out, LOGDB_MAGIC, LOGDB_MAGIC_SIZE);
+
+    if (lock_file(fd, TRUE) < 0) goto fail;
+    for (u_long i = 0; i < db->capacity; i++) {
+        LogDBEntry *e = &db->table[i];
+        if (e->key == NULL) continue;
+        size_t total = LOGDB_RECORD_HEADER + e->klen + e->vlen;
+        char hdr[LOGDB_RECORD_HEADER];
+
+        if (valsize < e->vlen || val == NULL) {
+            valsize = e->vlen;
+            val = SCM_NEW_ATOMIC2(char*, valsize+1);
+        }
+        if (read_value(db, e->voffset, val, e->vlen) < 0) goto fail;
+        make_header(hdr, e->key, e->klen, val, e->vlen);
+
+        if (outlen + total > LOGDB_BUFFER_SIZE) {
+            if (write_fully(fd, out, outlen) < 0) goto fail;
+            outlen = 0;
+        }
+        if (total > LOGDB_BUFFER_SIZE) {
+            if (write_fully(fd, hdr, LOGDB_RECORD_HEADER) < 0
+                || write_fully(fd, e->key, e->klen) < 0
+                || write_fully(fd, val, e->vlen) < 0) {
+                goto fail;
+            }
+        } else {
+            memcpy(out + outlen, hdr, LOGDB_RECORD_HEADER);
+            memcpy(out + outlen + LOGDB_RECORD_HEADER, e->key, e->klen);
+            memcpy(out + outlen + LOGDB_RECORD_HEADER + e->klen,
+                   val, e->vlen);
+            outlen += total;
+        }
+        newoff[i] = pos + LOGDB_RECORD_HEADER + e->klen;
+        pos += total;
+    }
+    if (write_fully(fd, out, outlen) < 0) goto fail;
+    if (fsync(fd) < 0) goto fail;
+
+#if defined(GAUCHE_WINDOWS)
+    /* Windows can't rename over an open file. */
+    close(db->fd);
+    db->fd = -1;
+    if (unlink(db->path) < 0 || rename(tmp, db->path) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        Scm_SysError("logdbm: couldn't replace %s with compacted log",
+                     db->path);
+    }
+#else
+    if (rename(tmp, db->path) < 0) goto fail;
+    close(db->fd);
+#endif
+    db->fd = fd;
+    for (u_long i = 0; i < db->capacity; i++) {
+        if (db->table[i].key != NULL) db->table[i].voffset = newoff[i];
+    }
+    db->size = db->flushed = pos;
+    db->live = pos - LOGDB_MAGIC_SIZE;
+    db->dirty = FALSE;
+    return;
+
+  fail:
+    {
+        int e = errno;
+        close(fd);
+        unlink(tmp);
+        errno = e;
+        Scm_SysError("logdbm: compaction of %s failed", db->path);
+    }
+}
@@ -0,0 +1,116 @@
+/*
+ * logdb.h - log-structured key-value store
+ *
+ *   Copyright (c) 2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_LOGDB_H
+#define GAUCHE_LOGDB_H
+
+#include <gauche.h>
+
+/* The database is a single append-only file.  It begins with an 8-byte
+ * magic, followed by records:
+ *
+ *   u32 crc      CRC-32 of the rest of the record
+ *   u32 klen     key length
+ *   u32 vlen     value length, or LOGDB_TOMBSTONE for deletion
+ *   key, value
+ *
+ * Integers are little-endian.  Only the last record for a key counts.
+ * On open the log is replayed to build an in-memory hash index from
+ * each live key to the position of its value; a torn record at the
+ * tail (e.g. from a crash during a write) is discarded.  Superseded
+ * records are reclaimed by compaction, which rewrites the live records
+ * to a new file and renames it over the old one.
+ */
+
+#define LOGDB_MAGIC          "GaLogDB1"
+#define LOGDB_MAGIC_SIZE     8
+#define LOGDB_RECORD_HEADER  12
+#define LOGDB_TOMBSTONE      0xffffffffUL
+#define LOGDB_MAX_DATUM      0x7fffffffUL
+
+/* Size of the write buffer.  Records are accumulated here and written
+   out together; a record larger than this is written directly. */
+#define LOGDB_BUFFER_SIZE    65536
+
+/* Automatic compaction kicks in when superseded records occupy more
+   than this many bytes and also outnumber the live ones. */
+#define LOGDB_COMPACT_MIN    (4*1024*1024)
+
+enum {
+    LOGDB_READER,               /* read-only; file must exist */
+    LOGDB_WRITER,               /* read-write; create if necessary */
+    LOGDB_CREATE                /* read-write; truncate existing file */
+};
+
+typedef struct LogDBEntryRec {
+    char *key;                  /* NULL if the slot is empty */
+    u_long hash;
+    uint32_t klen;
+    uint32_t vlen;
+    off_t voffset;              /* position of the value in the log */
+} LogDBEntry;
+
+typedef struct LogDBRec {
+    const char *path;
+    int fd;                     /* -1 if closed */
+    int readonly;
+    int sync;                   /* fsync after each update */
+    int batch;                  /* nesting level of LogDBBeginBatch */
+    int dirty;                  /* written but not fsync-ed yet */
+    off_t size;                 /* size of the log, including buffered data */
+    off_t flushed;              /* bytes actually written to the file */
+    off_t live;                 /* bytes occupied by live records */
+    char *buf;
+    size_t buflen;
+    LogDBEntry *table;          /* open addressing, linear probing */
+    u_long capacity;            /* always power of 2 */
+    u_long count;
+} LogDB;
+
+extern LogDB *LogDBOpen(const char *path, int mode, int perm, int sync);
+extern void   LogDBClose(LogDB *db);
+extern int    LogDBCloseNoError(LogDB *db);
+
+extern ScmObj LogDBGet(LogDB *db, const char *key, uint32_t klen);
+extern int    LogDBExists(LogDB *db, const char *key, uint32_t klen);
+extern void   LogDBPut(LogDB *db, const char *key, uint32_t klen,
+                       const char *val, uint32_t vlen);
+extern int    LogDBDelete(LogDB *db, const char *key, uint32_t klen);
+extern ScmObj LogDBKeys(LogDB *db);
+
+extern void   LogDBSync(LogDB *db);
+extern void   LogDBBeginBatch(LogDB *db);
+extern void   LogDBEndBatch(LogDB *db);
+extern void   LogDBCompact(LogDB *db);
+
+#endif /*GAUCHE_LOGDB_H*/
@@ -0,0 +1,260 @@
+;;;
+;;; logdbm - log-structured dbm
+;;;
+;;;   Copyright (c) 2017  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module dbm.logdbm
+  (extend dbm)
+  (export <logdbm>
+          logdbm-sync logdbm-compact logdbm-batch)
+  )
+(select-module dbm.logdbm)
+
+;;; Logdbm keeps the database in a single append-only file.  Every
+;;; update appends a record; an in-memory hash index maps each key to
+;;; the location of its latest value, and is rebuilt by replaying the
+;;; log when the database is opened.  When superseded records take up
+;;; more than half of the file, the live records are copied to a fresh
+;;; file which replaces the old one.  See logdb.h for the file format.
+;;;
+;;; Records are buffered and written together.  If :sync is true,
+;;; every update is flushed and fsync-ed before returning; otherwise
+;;; it happens at dbm-close or logdbm-sync.  Updates inside logdbm-batch
+;;; are committed together with a single fsync at the end of the batch.
+
+;;;
+;;; High-level dbm interface
+;;;
+
+(define-class <logdbm-meta> (<dbm-meta>)
+  ())
+
+(define-class <logdbm> (<dbm>)
+  ((logdbm-file :initform #f)
+   (sync        :init-keyword :sync :initform #f))
+  :metaclass <logdbm-meta>)
+
+(define-method dbm-open ((self <logdbm>))
+  (next-method)
+  (unless (slot-bound? self 'path)
+    (error "path must be set to open logdbm database"))
+  (when (slot-ref self 'logdbm-file)
+    (errorf "logdbm ~S already opened" self))
+  (let* ([path (slot-ref self 'path)]
+         [mode (case (slot-ref self 'rw-mode)
+                 [(:read) 0]
+                 [(:write) 1]
+                 [(:create) 2]
+                 [else (errorf "bad value for rw-mode: ~s"
+                               (slot-ref self 'rw-mode))])])
+    (slot-set! self 'logdbm-file
+               (%logdbm-open path mode (slot-ref self 'file-mode)
+                             (boolean (slot-ref self 'sync))))
+    self))
+
+(define (logdbm-file-of self)
+  (or (slot-ref self 'logdbm-file)
+      (errorf "logdbm ~S is not opened" self)))
+
+;;
+;; close operation
+;;
+
+(define-method dbm-close ((self <logdbm>))
+  (and-let* ([f (slot-ref self 'logdbm-file)])
+    (%logdbm-close f)))
+
+(define-method dbm-closed? ((self <logdbm>))
+  (let1 f (slot-ref self 'logdbm-file)
+    (or (not f) (%logdbm-closed? f))))
+
+;;
+;; accessors
+;;
+
+(define-method dbm-put! ((self <logdbm>) key value)
+  (next-method)
+  (%logdbm-put! (logdbm-file-of self)
+                (%dbm-k2s self key)
+                (%dbm-v2s self value)))
+
+(define-method dbm-get ((self <logdbm>) key . args)
+  (next-method)
+  (cond [(%logdbm-get (logdbm-file-of self) (%dbm-k2s self key))
+         => (cut %dbm-s2v self <>)]
+        [(pair? args) (car args)]     ;fall-back value
+        [else  (errorf "logdbm: no data for key ~s in database ~s"
+                       key self)]))
+
+(define-method dbm-exists? ((self <logdbm>) key)
+  (next-method)
+  (%logdbm-exists? (logdbm-file-of self) (%dbm-k2s self key)))
+
+(define-method dbm-delete! ((self <logdbm>) key)
+  (next-method)
+  (%logdbm-delete! (logdbm-file-of self) (%dbm-k2s self key)))
+
+;;
+;; Iterations
+;;
+
+;; We traverse a snapshot of keys, so PROC may modify the database.
+(define-method dbm-fold ((self <logdbm>) proc knil)
+  (let1 f (logdbm-file-of self)
+    (let loop ([keys (%logdbm-keys f)] [r knil])
+      (if (null? keys)
+        r
+        (let1 val (%logdbm-get f (car keys))
+          (loop (cdr keys)
+                (if val
+                  (proc (%dbm-s2k self (car keys)) (%dbm-s2v self val) r)
+                  r)))))))
+
+;;
+;; Logdbm specific operations
+;;
+
+(define (logdbm-sync self)
+  (%logdbm-sync (logdbm-file-of self)))
+
+(define (logdbm-compact self)
+  (%logdbm-compact (logdbm-file-of self)))
+
+(define (logdbm-batch self thunk)
+  (let1 f (logdbm-file-of self)
+    (%logdbm-begin-batch f)
+    (unwind-protect (thunk) (%logdbm-end-batch f))))
+
+;;
+;; Metaoperations
+;;
+
+(autoload file.util copy-file move-file)
+
+(define (%with-logdbm-locking path thunk)
+  (let1 f (%logdbm-open path 0 #o664 #f) ;; put read-lock
+    (unwind-protect (thunk) (%logdbm-close f))))
+
+(define-method dbm-db-exists? ((class <logdbm-meta>) name)
+  (file-exists? name))
+
+(define-method dbm-db-remove ((class <logdbm-meta>) name)
+  (sys-unlink name))
+
+(define-method dbm-db-copy ((class <logdbm-meta>) from to . keys)
+  (%with-logdbm-locking from
+   (^[] (apply copy-file from to :safe #t keys))))
+
+(define-method dbm-db-move ((class <logdbm-meta>) from to . keys)
+  (%with-logdbm-locking from
+   (^[] (apply move-file from to :safe #t keys))))
+
+;;;
+;;; Low-level bindings
+;;;
+
+(inline-stub
+ "#include \"logdb.h\""
+
+ "typedef struct ScmLogdbmFileRec {
+    SCM_HEADER;
+    ScmObj name;
+    LogDB *db;
+  } ScmLogdbmFile;"
+
+ (define-cclass <logdbm-file> :private ScmLogdbmFile* "Scm_LogdbmFileClass" ()
+   ()
+   [printer
+    (Scm_Printf port "#<logdbm-file %S>" (-> (SCM_LOGDBM_FILE obj) name))])
+
+ (define-cfn logdbm_finalize (obj data::void*) ::void :static
+   (let* ([f::ScmLogdbmFile* (SCM_LOGDBM_FILE obj)])
+     (LogDBCloseNoError (-> f db))))
+
+ (define-cise-stmt DATUM
+   [(_ ptr len scm)
+    (let ((tmp (gensym)))
+      `(let* ((,tmp :: (const ScmStringBody*) (SCM_STRING_BODY ,scm)))
+         (set! ,ptr (SCM_STRING_BODY_START ,tmp))
+         (set! ,len (SCM_STRING_BODY_SIZE ,tmp))))])
+
+ (define-cproc %logdbm-open (name::<string> mode::<fixnum> fmode::<fixnum>
+                             sync::<boolean>)
+   (let* ([z::ScmLogdbmFile* (SCM_NEW ScmLogdbmFile)])
+     (SCM_SET_CLASS z (& Scm_LogdbmFileClass))
+     (set! (-> z name) (SCM_OBJ name))
+     (set! (-> z db) (LogDBOpen (Scm_GetStringConst name) mode fmode sync))
+     (Scm_RegisterFinalizer (SCM_OBJ z) logdbm_finalize NULL)
+     (return (SCM_OBJ z))))
+
+ (define-cproc %logdbm-close (f::<logdbm-file>) ::<void>
+   (LogDBClose (-> f db)))
+
+ (define-cproc %logdbm-closed? (f::<logdbm-file>) ::<boolean>
+   (return (< (-> (-> f db) fd) 0)))
+
+ (define-cproc %logdbm-put! (f::<logdbm-file> key::<string> val::<string>)
+   ::<void>
+   (let* ([k::(const char*)] [v::(const char*)] [klen::u_int] [vlen::u_int])
+     (DATUM k klen key)
+     (DATUM v vlen val)
+     (LogDBPut (-> f db) k klen v vlen)))
+
+ (define-cproc %logdbm-get (f::<logdbm-file> key::<string>)
+   (let* ([k::(const char*)] [klen::u_int])
+     (DATUM k klen key)
+     (return (LogDBGet (-> f db) k klen))))
+
+ (define-cproc %logdbm-exists? (f::<logdbm-file> key::<string>) ::<boolean>
+   (let* ([k::(const char*)] [klen::u_int])
+     (DATUM k klen key)
+     (return (LogDBExists (-> f db) k klen))))
+
+ (define-cproc %logdbm-delete! (f::<logdbm-file> key::<string>) ::<boolean>
+   (let* ([k::(const char*)] [klen::u_int])
+     (DATUM k klen key)
+     (return (LogDBDelete (-> f db) k klen))))
+
+ (define-cproc %logdbm-keys (f::<logdbm-file>)
+   (return (LogDBKeys (-> f db))))
+
+ (define-cproc %logdbm-sync (f::<logdbm-file>) ::<void>
+   (LogDBSync (-> f db)))
+
+ (define-cproc %logdbm-compact (f::<logdbm-file>) ::<void>
+   (LogDBCompact (-> f db)))
+
+ (define-cproc %logdbm-begin-batch (f::<logdbm-file>) ::<void>
+   (LogDBBeginBatch (-> f db)))
+
+ (define-cproc %logdbm-end-batch (f::<logdbm-file>) ::<void>
+   (LogDBEndBatch (-> f db)))
+ )
@@ -257,6 +257,66 @@
 (test-module 'dbm.fsdbm)
 (full-test <fsdbm>)
 
+;;
+;; LOGDBM test
+;;
+
+(use dbm.logdbm)
+(test-module 'dbm.logdbm)
+(full-test <logdbm>)
+
+(test-section "logdbm specific")
+
+(dynamic-wind
+ clean-up
+ (^[]
+   (define db (dbm-open <logdbm> :path *test-dbm* :rw-mode :create))
+   (define (fill! val)
+     (dotimes [i 1000] (dbm-put! db (x->string i) val)))
+
+   (test* "batch" 1000
+          (begin (logdbm-batch db (^[] (fill! "a")))
+                 (length (dbm-map db cons))))
+   (test* "batch (error)" "b"
+          (begin (guard (e [else #f])
+                   (logdbm-batch db (^[] (dbm-put! db "0" "b") (error "oops"))))
+                 (dbm-get db "0")))
+   (test* "delete inside fold" 500
+          (begin (dbm-for-each db (^[k v] (when (odd? (string->number k))
+                                            (dbm-delete! db k))))
+                 (length (dbm-map db cons))))
+   (test* "compact" '(#t 999 "x")
+          (begin (dotimes [n 10] (fill! (make-string 100 #\x)))
+                 (dbm-put! db "0" "x")
+                 (let1 before (file-size *test-dbm*)
+                   (logdbm-compact db)
+                   (list (< (* 3 (file-size *test-dbm*)) before)
+                         (count (cut equal? (make-string 100 #\x) <>)
+                                (dbm-map db (^[k v] v)))
+                         (dbm-get db "0")))))
+   (test* "reopen" '(1000 "x")
+          (begin (dbm-close db)
+                 (set! db (dbm-open <logdbm> :path *test-dbm* :rw-mode :write
+                                    :sync #t))
+                 (list (length (dbm-map db cons)) (dbm-get db "0"))))
+   (test* "torn tail is discarded" '(1000 "y" #t)
+          (begin (dbm-close db)
+                 (with-output-to-file *test-dbm*
+                   (cut display "\x10;\x20;\x30;garbage-garbage")
+                   :if-exists :append)
+                 (set! db (dbm-open <logdbm> :path *test-dbm* :rw-mode :write))
+                 (dbm-put! db "1" "y")
+                 (dbm-close db)
+                 (set! db (dbm-open <logdbm> :path *test-dbm* :rw-mode :read))
+                 (list (length (dbm-map db cons)) (dbm-get db "1")
+                       (equal? (dbm-get db "2") (make-string 100 #\x)))))
+   (test* "not a logdbm file" (test-error)
+          (begin (dbm-close db)
+                 (with-output-to-file *test-dbm* (cut display "hello, world"))
+                 (dbm-open <logdbm> :path *test-dbm* :rw-mode :read)))
+   )
+ clean-up)
+
 ;;
 ;; GDBM test
 ;;
@@ -42,39 +42,42 @@
           <sha224> sha224-digest sha224-digest-string
           <sha256> sha256-digest sha256-digest-string
           <sha384> sha384-digest sha384-digest-string
-          <sha512> sha512-digest sha512-digest-string))
+          <sha512> sha512-digest sha512-digest-string
+          sha-digest-batch sha-tree-digest))
 (select-module rfc.sha)
 
 ;;;
 ;;;  High-level API
 ;;;
 
-(define-constant *sha-unit-len* 4096)
-
-(define (gen-digest init update end)
-  (^[] (let ([ctx (make <sha-context>)]
-             [buf (make-u8vector *sha-unit-len*)])
-         (init ctx)
-         (generator-for-each
-          (^x (update ctx x))
-          (^[] (let1 count (read-block! buf)
-                 (cond [(eof-object? count) count]
-                       [(< count *sha-unit-len*)
-                        (uvector-alias <u8vector> buf 0 count)]
-                       [else buf]))))
-         (end ctx))))
-
-(define sha1-digest   (gen-digest %sha1-init   %sha1-update   %sha1-final))
-(define sha224-digest (gen-digest %sha224-init %sha224-update %sha224-final))
-(define sha256-digest (gen-digest %sha256-init %sha256-update %sha256-final))
-(define sha384-digest (gen-digest %sha384-init %sha384-update %sha384-final))
-(define sha512-digest (gen-digest %sha512-init %sha512-update %sha512-final))
-
-(define (sha1-digest-string s)   (with-input-from-string s sha1-digest))
-(define (sha224-digest-string s) (with-input-from-string s sha224-digest))
-(define (sha256-digest-string s) (with-input-from-string s sha256-digest))
-(define (sha384-digest-string s) (with-input-from-string s sha384-digest))
-(define (sha512-digest-string s) (with-input-from-string s sha512-digest))
+(define (sha1-digest)   (%sha-port-digest 1   (current-input-port)))
+(define (sha224-digest) (%sha-port-digest 224 (current-input-port)))
+(define (sha256-digest) (%sha-port-digest 256 (current-input-port)))
+(define (sha384-digest) (%sha-port-digest 384 (current-input-port)))
+(define (sha512-digest) (%sha-port-digest 512 (current-input-port)))
+
+(define (sha1-digest-string s)   (%sha-string-digest 1   s))
+(define (sha224-digest-string s) (%sha-string-digest 224 s))
+(define (sha256-digest-string s) (%sha-string-digest 256 s))
+(define (sha384-digest-string s) (%sha-string-digest 384 s))
+(define (sha512-digest-string s) (%sha-string-digest 512 s))
+
+(define (sha-class-bits class)
+  (cond [(eq? class <sha1>)   1]
+        [(eq? class <sha224>) 224]
+        [(eq? class <sha256>) 256]
+        [(eq? class <sha384>) 384]
+        [(eq? class <sha512>) 512]
+        [else (error "SHA algorithm class required, but got:" class)]))
+
+;; MSGS is a list or a vector of strings and/or u8vectors.  Returns
+;; the digests in the same kind of sequence.
+(define (sha-digest-batch class msgs)
+  (%sha-digest-batch (sha-class-bits class) msgs))
+
+;; SOURCE may be a string, a u8vector or an input port.
+(define (sha-tree-digest class source :optional (chunk-size 1048576))
+  (%sha-tree-digest (sha-class-bits class) source chunk-size))
 
 ;;;
 ;;; Digest framework
@@ -121,6 +124,8 @@
  "#define SHA2_USE_INTTYPES_H" ; use uintXX_t
  "#include \"sha2.h\""
 
+ "#include \"shabulk.h\""
+
  "#define LIBGAUCHE_EXT_BODY"
  "#include <gauche/extern.h>  /* fix SCM_EXTERN in SCM_CLASS_DECL */"
 
@@ -192,6 +197,15 @@
    (common-final SHA384_Final ctx SHA384_DIGEST_LENGTH))
  (define-cproc %sha512-final (ctx::<sha-context>)
    (common-final SHA512_Final ctx SHA512_DIGEST_LENGTH))
+
+ (define-cproc %sha-port-digest (bits::<int> port::<input-port>)
+   (return (Scm_ShaPortDigest (Scm_ShaAlgorithm bits) port)))
+ (define-cproc %sha-string-digest (bits::<int> s::<string>)
+   (return (Scm_ShaBytesDigest (Scm_ShaAlgorithm bits) (SCM_OBJ s))))
+ (define-cproc %sha-digest-batch (bits::<int> msgs)
+   (return (Scm_ShaBatchDigestObjs (Scm_ShaAlgorithm bits) msgs)))
+ (define-cproc %sha-tree-digest (bits::<int> source chunk-size::<long>)
+   (return (Scm_ShaTreeDigest (Scm_ShaAlgorithm bits) source chunk-size)))
  )
 
 
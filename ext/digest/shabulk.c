@@ -0,0 +1,366 @@
+/*
+ * shabulk.c - batch and tree hashing
+ *
+ *   Copyright (c) 2008-2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shabulk.h"
+#include <gauche/extend.h>
+#include <gauche/priv/systemP.h>
+
+static const ShaAlgorithm algorithms[] = {
+    { 1,   SHA1_DIGEST_LENGTH,   SHA1_Init,   SHA1_Update,   SHA1_Final },
+    { 224, SHA224_DIGEST_LENGTH, SHA224_Init, SHA224_Update, SHA224_Final },
+    { 256, SHA256_DIGEST_LENGTH, SHA256_Init, SHA256_Update, SHA256_Final },
+    { 384, SHA384_DIGEST_LENGTH, SHA384_Init, SHA384_Update, SHA384_Final },
+    { 512, SHA512_DIGEST_LENGTH, SHA512_Init, SHA512_Update, SHA512_Final },
+};
+
+const ShaAlgorithm *Scm_ShaAlgorithm(int bits)
+{
+    for (size_t i=0; i<sizeof(algorithms)/sizeof(algorithms[0]); i++) {
+        if (algorithms[i].bits == bits) return &algorithms[i];
+    }
+    Scm_Error("unsupported SHA variant: %d", bits);
+    return NULL;                /* dummy */
+}
+
+static ScmObj digest_string(const uint8_t *digest, int len)
+{
+    return Scm_MakeString((const char*)digest, len, len,
+                          SCM_STRING_INCOMPLETE|SCM_STRING_COPYING);
+}
+
+static void get_bytes(ScmObj data, const uint8_t **p, size_t *len)
+{
+    if (SCM_U8VECTORP(data)) {
+        *p = (const uint8_t*)SCM_U8VECTOR_ELEMENTS(data);
+        *len = SCM_U8VECTOR_SIZE(data);
+    } else if (SCM_STRINGP(data)) {
+        const ScmStringBody *b = SCM_STRING_BODY(data);
+        *p = (const uint8_t*)SCM_STRING_BODY_START(b);
+        *len = SCM_STRING_BODY_SIZE(b);
+    } else {
+        SCM_TYPE_ERROR(data, "u8vector or string");
+    }
+}
+
+/*
+ * Reading from a port
+ *
+ *  We read into a C buffer directly, instead of going through read-block!
+ *  and u8vector aliases for each block.
+ */
+#define SHA_PORT_BUFSIZ 16384
+
+void Scm_ShaUpdatePort(const ShaAlgorithm *alg, SHA_CTX *ctx, ScmPort *port)
+{
+    uint8_t buf[SHA_PORT_BUFSIZ];
+    for (;;) {
+        int n = Scm_Getz((char*)buf, SHA_PORT_BUFSIZ, port);
+        if (n <= 0) break;
+        alg->update(ctx, buf, n);
+    }
+}
+
+ScmObj Scm_ShaPortDigest(const ShaAlgorithm *alg, ScmPort *port)
+{
+    SHA_CTX ctx;
+    uint8_t digest[SHA512_DIGEST_LENGTH];
+    alg->init(&ctx);
+    Scm_ShaUpdatePort(alg, &ctx, port);
+    alg->final(digest, &ctx);
+    return digest_string(digest, alg->digestLength);
+}
+
+ScmObj Scm_ShaBytesDigest(const ShaAlgorithm *alg, ScmObj data)
+{
+    SHA_CTX ctx;
+    uint8_t digest[SHA512_DIGEST_LENGTH];
+    const uint8_t *p;
+    size_t len;
+    get_bytes(data, &p, &len);
+    alg->init(&ctx);
+    alg->update(&ctx, p, len);
+    alg->final(digest, &ctx);
+    return digest_string(digest, alg->digestLength);
+}
+
+/* Fill BUF with up to SIZE bytes, unless we hit EOF.  Returns the number
+   of bytes read. */
+static size_t read_full(ScmPort *port, uint8_t *buf, size_t size)
+{
+    size_t nread = 0;
+    while (nread < size) {
+        int n = Scm_Getz((char*)buf+nread, (int)(size-nread), port);
+        if (n <= 0) break;
+        nread += n;
+    }
+    return nread;
+}
+
+/*
+ * Hashing multiple messages
+ *
+ *  The messages are independent, so if there's enough data, we split
+ *  them into groups of about the same total size and hash each group in
+ *  its own thread.  The workers don't touch Scheme objects except reading
+ *  the bytes the caller keeps alive.  The jobs are run by
+ *  Scm__RunParallelJobs.
+ */
+
+/* Total size below which we don't bother to create threads. */
+#define SHA_PARALLEL_THRESHOLD  (1024*1024)
+#define SHA_MAX_THREADS 8
+
+typedef struct ShaJobRec {
+    const ShaAlgorithm *alg;
+    int prefix;                 /* byte to prepend to each message, or -1 */
+    int count;
+    const uint8_t **data;
+    const size_t *len;
+    uint8_t *out;
+} ShaJob;
+
+static void sha_do_job(void *data)
+{
+    ShaJob *j = (ShaJob*)data;
+    SHA_CTX ctx;
+    for (int i=0; i<j->count; i++) {
+        j->alg->init(&ctx);
+        if (j->prefix >= 0) {
+            uint8_t b = (uint8_t)j->prefix;
+            j->alg->update(&ctx, &b, 1);
+        }
+        j->alg->update(&ctx, j->data[i], j->len[i]);
+        j->alg->final(j->out + (size_t)i*j->alg->digestLength, &ctx);
+    }
+}
+
+static void sha_hash_messages(const ShaAlgorithm *alg, int prefix, int n,
+                              const uint8_t **data, const size_t *len,
+                              uint8_t *out)
+{
+    ShaJob jobs[SHA_MAX_THREADS];
+    size_t total = 0;
+    for (int i=0; i<n; i++) total += len[i];
+
+    int nthreads = Scm__ParallelJobCount(SHA_MAX_THREADS);
+    if (nthreads > n) nthreads = n;
+    if (total < SHA_PARALLEL_THRESHOLD || nthreads <= 1) {
+        ShaJob j = { alg, prefix, n, data, len, out };
+        sha_do_job(&j);
+        return;
+    }
+
+    /* Cut the sequence where the running total crosses each share. */
+    size_t share = total / nthreads, acc = 0;
+    int njobs = 0, start = 0;
+    for (int i=0; i<n && njobs < nthreads-1; i++) {
+        acc += len[i];
+        if (acc >= share * (njobs+1)) {
+            jobs[njobs].count = i+1-start;
+            jobs[njobs].data = data+start;
+            jobs[njobs].len = len+start;
+            jobs[njobs].out = out + (size_t)start*alg->digestLength;
+            njobs++;
+            start = i+1;
+        }
+    }
+    if (start < n) {
+        jobs[njobs].count = n-start;
+        jobs[njobs].data = data+start;
+        jobs[njobs].len = len+start;
+        jobs[njobs].out = out + (size_t)start*alg->digestLength;
+        njobs++;
+    }
+    for (int i=0; i<njobs; i++) {
+        jobs[i].alg = alg;
+        jobs[i].prefix = prefix;
+    }
+    Scm__RunParallelJobs(sha_do_job, jobs, sizeof(ShaJob), njobs);
+}
+
+void Scm_ShaBatchDigest(const ShaAlgorithm *alg, int n,
+                        const uint8_t **data, const size_t *len,
+                        uint8_t *out)
+{
+    sha_hash_messages(alg, -1, n, data, len, out);
+}
+
+/* MSGS is a list or a vector of strings and/or u8vectors.  Returns
+   the digests in the same kind of sequence. */
+ScmObj Scm_ShaBatchDigestObjs(const ShaAlgorithm *alg, ScmObj msgs)
+{
+    int n, vecp = SCM_VECTORP(msgs);
+    if (vecp) {
+        n = SCM_VECTOR_SIZE(msgs);
+    } else {
+        n = Scm_Length(msgs);
+        if (n < 0) SCM_TYPE_ERROR(msgs, "list or vector");
+    }
+    const uint8_t **data = SCM_NEW_ARRAY(const uint8_t*, n);
+    size_t *len = SCM_NEW_ATOMIC2(size_t*, n*sizeof(size_t));
+    uint8_t *out = SCM_NEW_ATOMIC2(uint8_t*, (size_t)n*alg->digestLength);
+
+    ScmObj cp = msgs;
+    for (int i=0; i<n; i++) {
+        if (vecp) {
+            get_bytes(SCM_VECTOR_ELEMENT(msgs, i), &data[i], &len[i]);
+        } else {
+            get_bytes(SCM_CAR(cp), &data[i], &len[i]);
+            cp = SCM_CDR(cp);
+        }
+    }
+    Scm_ShaBatchDigest(alg, n, data, len, out);
+
+    if (vecp) {
+        ScmObj v = Scm_MakeVector(n, SCM_FALSE);
+        for (int i=0; i<n; i++) {
+            SCM_VECTOR_ELEMENT(v, i) =
+                digest_string(out + (size_t)i*alg->digestLength,
+                              alg->digestLength);
+        }
+        return v;
+    } else {
+        ScmObj h = SCM_NIL, t = SCM_NIL;
+        for (int i=0; i<n; i++) {
+            SCM_APPEND1(h, t, digest_string(out + (size_t)i*alg->digestLength,
+                                            alg->digestLength));
+        }
+        return h;
+    }
+}
+
+/*
+ * Tree hash
+ *
+ *  We follow the Merkle tree hash of RFC 6962: the data is split into
+ *  CHUNK-byte pieces, each piece is hashed as H(0x00 || piece), and
+ *  adjacent pairs are combined as H(0x01 || left || right) level by
+ *  level, with an odd one carried up as is.  The empty data hashes to
+ *  H("").  The leaves are independent and hashed in parallel; the inner
+ *  nodes are few and hashed sequentially.
+ */
+
+typedef struct LeafDigestsRec {
+    uint8_t *buf;
+    size_t count;
+    size_t size;                /* allocated # of digests */
+} LeafDigests;
+
+static uint8_t *leaf_digests_extend(LeafDigests *ld, size_t n, int dlen)
+{
+    if (ld->count + n > ld->size) {
+        size_t newsize = ld->size ? ld->size*2 : 64;
+        while (newsize < ld->count + n) newsize *= 2;
+        uint8_t *nb = SCM_NEW_ATOMIC2(uint8_t*, newsize*dlen);
+        if (ld->count > 0) memcpy(nb, ld->buf, ld->count*dlen);
+        ld->buf = nb;
+        ld->size = newsize;
+    }
+    uint8_t *p = ld->buf + ld->count*dlen;
+    ld->count += n;
+    return p;
+}
+
+static void add_leaves(const ShaAlgorithm *alg, LeafDigests *ld,
+                       const uint8_t *data, size_t len, size_t chunk)
+{
+    size_t n = (len + chunk - 1) / chunk;
+    if (n == 0) return;
+    if (n > INT_MAX) Scm_Error("data too large for tree hash: %lu bytes",
+                               (u_long)len);
+    const uint8_t **ptrs = SCM_NEW_ARRAY(const uint8_t*, n);
+    size_t *lens = SCM_NEW_ATOMIC2(size_t*, n*sizeof(size_t));
+    for (size_t i=0; i<n; i++) {
+        ptrs[i] = data + i*chunk;
+        lens[i] = (i == n-1)? len - i*chunk : chunk;
+    }
+    uint8_t *out = leaf_digests_extend(ld, n, alg->digestLength);
+    sha_hash_messages(alg, 0x00, (int)n, ptrs, lens, out);
+}
+
+static void tree_root(const ShaAlgorithm *alg, LeafDigests *ld,
+                      uint8_t *result)
+{
+    int dlen = alg->digestLength;
+    SHA_CTX ctx;
+
+    if (ld->count == 0) {
+        alg->init(&ctx);
+        alg->final(result, &ctx);
+        return;
+    }
+    size_t n = ld->count;
+    uint8_t *d = ld->buf;
+    uint8_t tmp[SHA512_DIGEST_LENGTH];
+    static const uint8_t node_prefix = 0x01;
+    while (n > 1) {
+        size_t i;
+        for (i=0; i+1<n; i+=2) {
+            alg->init(&ctx);
+            alg->update(&ctx, &node_prefix, 1);
+            alg->update(&ctx, d + i*dlen, 2*dlen);
+            alg->final(tmp, &ctx);
+            memcpy(d + (i/2)*dlen, tmp, dlen);
+        }
+        if (i < n) memmove(d + (i/2)*dlen, d + i*dlen, dlen);
+        n = (n+1)/2;
+    }
+    memcpy(result, d, dlen);
+}
+
+ScmObj Scm_ShaTreeDigest(const ShaAlgorithm *alg, ScmObj source, long chunk)
+{
+    LeafDigests ld = { NULL, 0, 0 };
+    uint8_t result[SHA512_DIGEST_LENGTH];
+
+    if (chunk <= 0 || chunk > SHA_TREE_MAX_CHUNK) {
+        Scm_Error("chunk size out of range: %ld", chunk);
+    }
+    if (SCM_IPORTP(source)) {
+        /* Read as many chunks as we can hash in parallel at a time. */
+        size_t bufsize = (size_t)chunk * Scm__ParallelJobCount(SHA_MAX_THREADS);
+        uint8_t *buf = SCM_NEW_ATOMIC2(uint8_t*, bufsize);
+        for (;;) {
+            size_t n = read_full(SCM_PORT(source), buf, bufsize);
+            add_leaves(alg, &ld, buf, n, chunk);
+            if (n < bufsize) break;
+        }
+    } else {
+        const uint8_t *p;
+        size_t len;
+        get_bytes(source, &p, &len);
+        add_leaves(alg, &ld, p, len, chunk);
+    }
+    tree_root(alg, &ld, result);
+    return digest_string(result, alg->digestLength);
+}
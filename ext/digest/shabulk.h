@@ -0,0 +1,76 @@
+/*
+ * shabulk.h - batch and tree hashing
+ *
+ *   Copyright (c) 2008-2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_SHABULK_H
+#define GAUCHE_SHABULK_H
+
+#include <gauche.h>
+#include "sha2.h"
+
+/* Descriptor of each variant.  BITS is 1 for SHA-1, and the digest
+   length in bits for SHA-2 variants. */
+typedef struct ShaAlgorithmRec {
+    int bits;
+    int digestLength;
+    void (*init)(SHA_CTX*);
+    void (*update)(SHA_CTX*, const uint8_t*, size_t);
+    void (*final)(uint8_t*, SHA_CTX*);
+} ShaAlgorithm;
+
+extern const ShaAlgorithm *Scm_ShaAlgorithm(int bits);
+
+/* Feed all the data from PORT until EOF. */
+extern void Scm_ShaUpdatePort(const ShaAlgorithm *alg, SHA_CTX *ctx,
+                              ScmPort *port);
+
+/* One-shot digests of a port's content and of a string/u8vector.
+   They return the digest as an incomplete string. */
+extern ScmObj Scm_ShaPortDigest(const ShaAlgorithm *alg, ScmPort *port);
+extern ScmObj Scm_ShaBytesDigest(const ShaAlgorithm *alg, ScmObj data);
+
+/* Digests of N independent messages.  OUT must have room for
+   N * alg->digestLength bytes. */
+extern void Scm_ShaBatchDigest(const ShaAlgorithm *alg, int n,
+                               const uint8_t **data, const size_t *len,
+                               uint8_t *out);
+
+/* Merkle tree hash (RFC 6962) over CHUNK-byte pieces of the data.
+   SOURCE may be a u8vector, a string, or an input port. */
+#define SHA_TREE_DEFAULT_CHUNK  (1024*1024)
+#define SHA_TREE_MAX_CHUNK      (64*1024*1024)
+
+extern ScmObj Scm_ShaTreeDigest(const ShaAlgorithm *alg, ScmObj source,
+                                long chunk);
+extern ScmObj Scm_ShaBatchDigestObjs(const ShaAlgorithm *alg, ScmObj msgs);
+
+#endif /*GAUCHE_SHABULK_H*/
@@ -99,3 +99,29 @@
 
 (for-each test-from-file (glob "data/*.info"))
 
+
+(let1 msgs (list "" "abc" (make-string 1000 #\a) (string->u8vector "xyz"))
+  (define (each-digest digest-string)
+    (map (^m (digest-string (if (string? m) m (u8vector->string m)))) msgs))
+  (test* "sha-digest-batch (list)" (each-digest sha256-digest-string)
+         (sha-digest-batch <sha256> msgs))
+  (test* "sha-digest-batch (vector)" (list->vector (each-digest sha1-digest-string))
+         (sha-digest-batch <sha1> (list->vector msgs)))
+  (test* "sha-digest-batch (empty)" '() (sha-digest-batch <sha512> '())))
+
+;; RFC 6962 Merkle tree hash
+(test* "sha-tree-digest empty"
+       "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+       (digest-hexify (sha-tree-digest <sha256> "")))
+(test* "sha-tree-digest single chunk"
+       (digest-hexify (sha256-digest-string "\x00;abc"))
+       (digest-hexify (sha-tree-digest <sha256> "abc")))
+(test* "sha-tree-digest multiple chunks"
+       "2a5b33d54d89d05737a7dd798d9862d55951564aafb5460691ad8a7a9ab6c678"
+       (digest-hexify (sha-tree-digest <sha256> "abcdefghij" 4)))
+(test* "sha-tree-digest from port"
+       (sha-tree-digest <sha384> (make-string 100000 #\z) 1000)
+       (call-with-input-string (make-string 100000 #\z)
+         (cut sha-tree-digest <sha384> <> 1000)))
+(test* "sha-tree-digest bad chunk" (test-error)
+       (sha-tree-digest <sha256> "abc" 0))
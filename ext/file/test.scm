@@ -338,6 +338,78 @@
                                                     files))))))
        )
 
+(use gauche.generator)
+(test* "directory-generator"
+       (n "test.out/test.d"
+          "test.out/test.d/test10.o"
+          "test.out/test.d/test11.o"
+          "test.out/test.d/test12.o"
+          "test.out/test1.o"
+          "test.out/test2.d"
+          "test.out/test2.d/test10.o"
+          "test.out/test2.d/test11.o"
+          "test.out/test2.d/test12.o"
+          "test.out/test2.o" "test.out/test3.o"
+          "test.out/test4.o" "test.out/test5.o"
+          "test.out/test6.o" "test.out/test7.o")
+       (generator->list (directory-generator "test.out")))
+
+(test* "directory-generator :with-type? :descend?"
+       `((,(n "test.out/test.d") . directory)
+         (,(n "test.out/test.d/test10.o") . regular)
+         (,(n "test.out/test.d/test11.o") . regular)
+         (,(n "test.out/test.d/test12.o") . regular)
+         (,(n "test.out/test1.o") . regular)
+         (,(n "test.out/test2.d") . directory))
+       (generator->list (directory-generator "test.out"
+                                             :with-type? #t
+                                             :descend? (^p (not (#/test2/ p))))
+                        6))
+
+(cond-expand
+ [gauche.sys.symlink
+  (test* "directory-generator :follow-link? #f"
+         `((,(n "test.out/test2.d") . symlink)
+           (,(n "test.out/test2.o") . regular)
+           (,(n "test.out/test6.o") . symlink))
+         (filter (^e (#/test[26]\.[do]$/ (car e)))
+                 (generator->list (directory-generator "test.out"
+                                                       :with-type? #t
+                                                       :follow-link? #f))))]
+ [else])
+
+(cond-expand
+ [gauche.sys.threads
+  (test* "directory-generator :num-threads"
+         (directory-fold "test.out" cons '())
+         (sort (filter file-is-regular?
+                       (generator->list
+                        (directory-generator "test.out" :num-threads 4)))
+               string>?))
+  (test* "directory-generator :num-threads error" (test-error)
+         (generator->list (directory-generator "test.out/test1.o"
+                                               :num-threads 2)))
+  (test* "directory-generator :num-threads non-condition error" '(oops)
+         (guard (e [else e])
+           (generator->list (directory-generator "test.out"
+                                                 :descend? (^_ (raise '(oops)))
+                                                 :num-threads 2))))
+  ;; A wide tree, so that many directories are read at the same time.
+  (let ()
+    (define (level names k)
+      (map (^i (if (zero? k)
+                 (string->symbol #"f~i")
+                 `(,(string->symbol #"d~i") ,(level names (- k 1)))))
+           names))
+    (cmd-rmrf "test.wide")
+    (create-directory-tree "." `(test.wide ,(level (iota 8) 3)))
+    (test* "directory-generator :num-threads (wide tree)"
+           (generator->list (directory-generator "test.wide"))
+           (sort (generator->list
+                  (directory-generator "test.wide" :num-threads 8))))
+    (cmd-rmrf "test.wide"))]
+ [else])
+
 (cmd-rmrf "test.out")
 
 ;;=====================================================================
@@ -23,10 +23,39 @@
     (define record ($sep-by ($->rope field) comma 1))
     ($sep-by record newline)))
 
+;; Lazy sequence input, as peg-parse-string used to do
+(time (peg-run-parser csv-parser (x->lseq data)))
+
+;; Cursor input
 ;(profiler-start)
 (time (peg-parse-string csv-parser data))
 ;(profiler-stop)
 
+(time (call-with-input-string data (cut peg-parse-port csv-parser <>)))
+
+;; A grammar that backtracks.  A record may end with a comment, and
+;; it is naively written as two alternatives, so a record without a comment
+;; is parsed twice.  With $memo, the fields aren't parsed again in the
+;; second alternative.
+(define (make-backtracking-csv-parser memo)
+  (let ()
+    (define ws     ($skip-many ($one-of #[ \t])))
+    (define comma  ($seq ws ($char #\,) ws))
+    (define dquote ($char #\"))
+    (define double-dquote ($do [($string "\"\"")] ($return #\")))
+    (define quoted-body ($many ($or ($one-of #[^\"]) double-dquote)))
+    (define quoted ($between dquote quoted-body dquote))
+    (define unquoted ($many-chars #[^ \t\r\n,]))
+    (define field  (memo ($->rope ($or quoted unquoted))))
+    (define fields ($sep-by field comma 1))
+    (define comment ($seq ws ($char #\#) ($skip-many ($none-of #[\n]))))
+    (define record ($or ($try ($followed-by fields comment))
+                        fields))
+    ($sep-by record newline)))
+
+(time (peg-parse-string (make-backtracking-csv-parser identity) data))
+(time (peg-parse-string (make-backtracking-csv-parser $memo) data))
+
 ;(profiler-show)
 
 #|
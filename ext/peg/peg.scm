@@ -59,7 +59,7 @@
           $sep-by $end-by $sep-end-by
           $count $between $followed-by
           $not $many-till $chain-left $chain-right
-          $lazy
+          $lazy $memo
 
           $s $c $y
           $string $string-ci
@@ -142,6 +142,16 @@
 ;;;    fail-unexpect    string (message)
 ;;;    fail-compound    ((Status . Value) ...)
 ;;;
+;;;  The input can also be a CURSOR, which is a fixnum byte offset into
+;;;  the text of the current input (a <peg-input>).  Drivers for strings
+;;;  and ports (peg-parse-string and peg-parse-port) use cursors, so that
+;;;  we don't need to allocate a lazy pair for every input character.
+;;;  The primitive parsers ($satisfy, $string, anychar, eof etc.) handle
+;;;  both kinds of input; other combinators just pass it around and
+;;;  compare it with eq?.  If you write a primitive parser by hand that
+;;;  looks into the input with car/cdr, run it with peg-run-parser on a
+;;;  list or a lazy sequence.
+;;;
 ;;;  A DRIVER is a wrapper to take a parser and an input.
 ;;;  DRIVER applies the parser on the input, and on success, it returns the
 ;;;  value and the rest of the input.  On failure, it translates the error
@@ -243,14 +253,38 @@
                                 [else (loop (+ c 1) (cdr s))]))
                         s1))
 
+;; Error from a cursor-based run.  POS is the cursor where the error
+;; is detected.
+(define (construct-peg-cursor-error in r v pos)
+  (make-peg-parse-error r v (%peg-input-position in pos)
+                        (let1 c (%peg-input-ref in pos)
+                          (if (eof-object? c) '() (list c)))))
+
+;; Run THUNK while IN is the current <peg-input>.
+(define (%with-peg-input in thunk)
+  (let1 prev (%current-peg-input)
+    (dynamic-wind
+      (^[] (%current-peg-input in))
+      thunk
+      (^[] (%current-peg-input prev)))))
+
 ;; API
 ;;   Default driver.  Returns parsed value and next stream
 (define (peg-run-parser parser s)
-  (receive (r v s1) (parser s)
+  (receive (r v s1) (%with-peg-input (make-peg-input #f) (^[] (parser s)))
     (if (parse-success? r)
       (values (rope-finalize v) s1)
       (raise (construct-peg-parser-error r v s s1)))))
 
+;; Driver for strings and ports.  SRC is wrapped by <peg-input>, and
+;; the parser is called with the cursor pointing the beginning of it.
+(define (peg-run-parser/cursor parser src)
+  (let1 in (make-peg-input src)
+    (receive (r v s1) (%with-peg-input in (^[] (parser 0)))
+      (if (parse-success? r)
+        (rope-finalize v)
+        (raise (construct-peg-cursor-error in r v s1))))))
+
 ;; Coerce something to lseq.  accepts generator.
 ;; We check applicability of x->lseq first, since an object can be both
 ;; passed to x->lseq and applicable as a thunk, but x->lseq should take
@@ -265,23 +299,24 @@
         [else (error "object cannot be used as a source of PEG parser:" obj)]))
 
 ;; API
-;;   NB: We can consolidate peg-parse-string and peg-parse-port via
-;;   x->generator, but should we?
+;;   These use cursors instead of lazy sequences.  The port is read
+;;   on demand, one character at a time, as the parser looks ahead.
 (define (peg-parse-string parser str)
   (check-arg string? str)
-  (values-ref (peg-run-parser parser (x->lseq str)) 0))
+  (peg-run-parser/cursor parser str))
 ;; API
 (define (peg-parse-port parser port)
   (check-arg input-port? port)
-  (values-ref (peg-run-parser parser (x->lseq port)) 0))
+  (peg-run-parser/cursor parser port))
 
 ;; API
 ;;  Returns a generator
 (define (peg-parser->generator parser src)
-  (let1 s (%->lseq src)
+  (let ([s (%->lseq src)]
+        [in (make-peg-input #f)])
     (^[] (if (null? s)
            (eof-object)
-           (receive (r v s1) (parser s)
+           (receive (r v s1) (%with-peg-input in (^[] (parser s)))
              (cond [(not (parse-success? r))
                     (raise (construct-peg-parser-error r v s s1))]
                    [(eof-object? v) (set! s '()) v]
@@ -319,6 +354,170 @@
      (return (Scm_GetOutputString (SCM_PORT p) 0))))
  )
 
+;;;============================================================
+;;; Input and cursors
+;;;
+
+;; <peg-input> keeps the text a cursor points into, and per-run data
+;; such as memo tables for $memo.  For a string, the text is the string
+;; body itself.  For a port, characters are read into a buffer as the
+;; parser looks ahead, so that we can backtrack to any position.
+;; Drivers for lists make a <peg-input> without text, only for memo.
+
+(inline-stub
+ "typedef struct ScmPegInputRec {
+    SCM_HEADER;
+    ScmObj source;              /* string, input port, or #f */
+    const ScmStringBody *body;  /* source string body, or NULL */
+    const char *start;          /* text read so far */
+    char *buf;                  /* buffer for port input */
+    long size;                  /* # of bytes in start */
+    long capacity;              /* allocated size of buf */
+    int eofp;                   /* TRUE if we've seen EOF on the port */
+    ScmObj memo;                /* hash table for $memo, or #f */
+  } ScmPegInput;"
+
+ (define-cclass <peg-input> :private ScmPegInput* "Scm_PegInputClass" ()
+   ()
+   [printer
+    (Scm_Printf port "#<peg-input %S>" (-> (SCM_PEG_INPUT obj) source))])
+
+ (declcode "static ScmParameterLoc current_peg_input;")
+ (initcode (Scm_InitParameterLoc (Scm_VM) (& current_peg_input) SCM_FALSE))
+
+ ;; Make sure we have NEED bytes from POS, reading from the port if
+ ;; necessary.  Returns FALSE if the input ends before that.
+ (define-cfn peg_fill (in::ScmPegInput* pos::long need::long) ::int :static
+   (while (< (-> in size) (+ pos need))
+     (unless (and (SCM_PORTP (-> in source)) (not (-> in eofp)))
+       (return FALSE))
+     (let* ([ch::ScmChar (Scm_Getc (SCM_PORT (-> in source)))])
+       (when (== ch EOF)
+         (set! (-> in eofp) TRUE)
+         (return FALSE))
+       (let* ([n::int (SCM_CHAR_NBYTES ch)])
+         (when (> (+ (-> in size) n) (-> in capacity))
+           (let* ([cap::long (* (-> in capacity) 2)])
+             (while (> (+ (-> in size) n) cap) (set! cap (* cap 2)))
+             (let* ([b::char* (SCM_NEW_ATOMIC2 (char*) cap)])
+               (memcpy b (-> in buf) (-> in size))
+               (set! (-> in buf) b
+                     (-> in start) b
+                     (-> in capacity) cap))))
+         (SCM_CHAR_PUT (+ (-> in buf) (-> in size)) ch)
+         (set! (-> in size) (+ (-> in size) n)))))
+   (return TRUE))
+
+ (define-cfn peg_check_cursor (in::ScmPegInput* pos::ScmSmallInt) ::void :static
+   (when (== (-> in start) NULL)
+     (Scm_Error "parser.peg: cursor used on non-text input: %ld" pos))
+   (when (or (< pos 0) (> pos (-> in size)))
+     (Scm_Error "parser.peg: cursor out of range: %ld" pos)))
+
+ ;; Returns the character at POS, or EOF.
+ (define-cfn peg_ref (in::ScmPegInput* pos::ScmSmallInt) :static
+   (peg_check_cursor in pos)
+   (unless (peg_fill in pos 1) (return SCM_EOF))
+   (let* ([nf::int (SCM_CHAR_NFOLLOWS (aref (-> in start) pos))]
+          [ch::ScmChar])
+     (unless (peg_fill in pos (+ nf 1)) (return SCM_EOF))
+     (SCM_CHAR_GET (+ (-> in start) pos) ch)
+     (return (SCM_MAKE_CHAR ch))))
+
+ (define-cfn peg_current_input () ::ScmPegInput* :static
+   (let* ([in (Scm_ParameterRef (Scm_VM) (& current_peg_input))])
+     (unless (SCM_PEG_INPUT_P in)
+       (Scm_Error "parser.peg: cursor used outside of a parser run"))
+     (return (SCM_PEG_INPUT in))))
+
+ (define-cproc make-peg-input (source)
+   (let* ([in::ScmPegInput* (SCM_NEW ScmPegInput)])
+     (SCM_SET_CLASS in (& Scm_PegInputClass))
+     (set! (-> in source) source
+           (-> in memo) SCM_FALSE)
+     (cond [(SCM_STRINGP source)
+            (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY source)])
+              (set! (-> in body) b
+                    (-> in start) (SCM_STRING_BODY_START b)
+                    (-> in size) (SCM_STRING_BODY_SIZE b)))]
+           [(SCM_IPORTP source)
+            (set! (-> in capacity) 256
+                  (-> in buf) (SCM_NEW_ATOMIC2 (char*) 256)
+                  (-> in start) (-> in buf))]
+           [(not (SCM_FALSEP source))
+            (Scm_Error "string, input port or #f required, but got: %S"
+                       source)])
+     (return (SCM_OBJ in))))
+
+ (define-cproc %current-peg-input (:optional obj)
+   (let* ([val (Scm_ParameterRef (Scm_VM) (& current_peg_input))])
+     (unless (SCM_UNBOUNDP obj)
+       (Scm_ParameterSet (Scm_VM) (& current_peg_input) obj))
+     (return val)))
+
+ ;; Character at cursor POS of the current input, or EOF.
+ (define-cproc %peg-ref (pos::<fixnum>)
+   (return (peg_ref (peg_current_input) pos)))
+
+ ;; Cursor next to the character CH at POS.
+ (define-cproc %peg-next (pos::<fixnum> ch::<char>) ::<fixnum>
+   (return (+ pos (SCM_CHAR_NBYTES ch))))
+
+ ;; If the input at POS begins with STR, returns the cursor after it.
+ ;; Otherwise returns #f.
+ (define-cproc %peg-match (pos::<fixnum> str::<string>)
+   (let* ([in::ScmPegInput* (peg_current_input)]
+          [b::(const ScmStringBody*) (SCM_STRING_BODY str)]
+          [len::long (SCM_STRING_BODY_SIZE b)])
+     (peg_check_cursor in pos)
+     (if (and (peg_fill in pos len)
+              (== (memcmp (+ (-> in start) pos) (SCM_STRING_BODY_START b) len)
+                  0))
+       (return (SCM_MAKE_INT (+ pos len)))
+       (return SCM_FALSE))))
+
+ ;; Reads characters in CS from POS, up to HI (#f for unlimited).
+ ;; Returns a list of characters and the cursor after them.  If less than
+ ;; LO characters are read, the list is #f.
+ (define-cproc %peg-span (pos::<fixnum> cs::<char-set> lo::<fixnum> hi)
+   (let* ([in::ScmPegInput* (peg_current_input)]
+          [h SCM_NIL] [t SCM_NIL]
+          [cnt::ScmSmallInt 0]
+          [lim::ScmSmallInt (?: (SCM_INTP hi) (SCM_INT_VALUE hi) -1)])
+     (while (or (< lim 0) (< cnt lim))
+       (let* ([c (peg_ref in pos)])
+         (when (or (SCM_EOFP c)
+                   (not (Scm_CharSetContains cs (SCM_CHAR_VALUE c))))
+           (break))
+         (SCM_APPEND1 h t c)
+         (set! pos (+ pos (SCM_CHAR_NBYTES (SCM_CHAR_VALUE c))))
+         (post++ cnt)))
+     (return (Scm_Values2 (?: (< cnt lo) SCM_FALSE h) (SCM_MAKE_INT pos)))))
+
+ ;; Memo table of PARSER for the current run, or #f if we're not in
+ ;; a driver.
+ (define-cproc %peg-memo-table (parser)
+   (let* ([in (Scm_ParameterRef (Scm_VM) (& current_peg_input))])
+     (unless (SCM_PEG_INPUT_P in) (return SCM_FALSE))
+     (when (SCM_FALSEP (-> (SCM_PEG_INPUT in) memo))
+       (set! (-> (SCM_PEG_INPUT in) memo)
+             (Scm_MakeHashTableSimple SCM_HASH_EQ 0)))
+     (let* ([memo (-> (SCM_PEG_INPUT in) memo)]
+            [tab (Scm_HashTableRef (SCM_HASH_TABLE memo) parser SCM_FALSE)])
+       (when (SCM_FALSEP tab)
+         (set! tab (Scm_MakeHashTableSimple SCM_HASH_EQ 0))
+         (Scm_HashTableSet (SCM_HASH_TABLE memo) parser tab 0))
+       (return tab))))
+
+ (define-cproc %peg-input-ref (in::<peg-input> pos::<fixnum>)
+   (return (peg_ref in pos)))
+
+ ;; Character count from the beginning to POS, for error messages.
+ (define-cproc %peg-input-position (in::<peg-input> pos::<fixnum>) ::<fixnum>
+   (peg_check_cursor in pos)
+   (return (Scm_MBLen (-> in start) (+ (-> in start) pos))))
+ )
+
 ;;;============================================================
 ;;; Primitives
 ;;;
@@ -488,6 +687,22 @@
      (let ((p (delay parse)))
        (lambda (s) ((force p) s)))]))
 
+;; API
+;; $memo p
+;;   Remembers the result of P for each input position during one run
+;;   of the driver, so that P isn't applied to the same input twice when
+;;   the enclosing parser backtracks (packrat parsing).  P must not depend
+;;   on anything but the input, and the caller must not destructively
+;;   modify its semantic value, since it may be shared.
+(define ($memo parse)
+  (^s (if-let1 tab (%peg-memo-table parse)
+        (if-let1 e (hash-table-get tab s #f)
+          (values (vector-ref e 0) (vector-ref e 1) (vector-ref e 2))
+          (receive (r v s1) (parse s)
+            (hash-table-put! tab s (vector r v s1))
+            (values r v s1)))
+        (parse s))))
+
 ;; alternative $lazy possibility (need benchmark!)
 ;(define-syntax $lazy
 ;  (syntax-rules ()
@@ -687,14 +902,24 @@
   (syntax-rules (cut <>)
     [(_ (cut p x <>) expect)            ;TODO: hygiene!
      (lambda (s)
-       (if (and (pair? s) (p x (car s)))
-         (return-result (car s) (cdr s))
-         (return-failure/expect expect s)))]
+       (if (fixnum? s)
+         (let1 c (%peg-ref s)
+           (if (and (char? c) (p x c))
+             (return-result c (%peg-next s c))
+             (return-failure/expect expect s)))
+         (if (and (pair? s) (p x (car s)))
+           (return-result (car s) (cdr s))
+           (return-failure/expect expect s))))]
     [(_ pred expect)
      (lambda (s)
-       (if (and (pair? s) (pred (car s)))
-         (return-result (car s) (cdr s))
-         (return-failure/expect expect s)))]))
+       (if (fixnum? s)
+         (let1 c (%peg-ref s)
+           (if (and (char? c) (pred c))
+             (return-result c (%peg-next s c))
+             (return-failure/expect expect s)))
+         (if (and (pair? s) (pred (car s)))
+           (return-result (car s) (cdr s))
+           (return-failure/expect expect s))))]))
 
 ;;;============================================================
 ;;; Intermediate structure constructor
@@ -728,23 +953,44 @@
              (cons ca cd)))]
         [else obj]))
 
+;; Helpers of $string and $string-ci on cursors.  Return the list of
+;; matched characters and the next cursor, or #f and #f.
+(define (%cursor-match-string s str lis)
+  (if-let1 s1 (%peg-match s str)
+    (values (string->list str) s1)
+    (values #f #f)))
+
+(define (%cursor-match-string-ci s str lis)
+  (let loop ((r '()) (s s) (lis lis))
+    (if (null? lis)
+      (values (reverse! r) s)
+      (let1 c (%peg-ref s)
+        (if (and (char? c) (char-ci=? c (car lis)))
+          (loop (cons c r) (%peg-next s c) (cdr lis))
+          (values #f #f))))))
+
 (define-values ($string $string-ci)
   (let-syntax
       ([expand
         (syntax-rules ()
-          ((_ char=)
+          ((_ char= cursor-match)
            (lambda (str)
              (let1 lis (string->list str)
                (lambda (s0)
-                 (let loop ((r '()) (s s0) (lis lis))
-                   (if (null? lis)
-                     (return-result (make-rope (reverse! r)) s)
-                     (if (and (pair? s)
-                              (char= (car s) (car lis)))
-                       (loop (cons (car s) r) (cdr s) (cdr lis))
-                       (return-failure/expect str s0)))))))))])
-    (values (expand char=?)
-            (expand char-ci=?))))
+                 (if (fixnum? s0)
+                   (receive (r s) (cursor-match s0 str lis)
+                     (if r
+                       (return-result (make-rope r) s)
+                       (return-failure/expect str s0)))
+                   (let loop ((r '()) (s s0) (lis lis))
+                     (if (null? lis)
+                       (return-result (make-rope (reverse! r)) s)
+                       (if (and (pair? s)
+                                (char= (car s) (car lis)))
+                         (loop (cons (car s) r) (cdr s) (cdr lis))
+                         (return-failure/expect str s0))))))))))])
+    (values (expand char=? %cursor-match-string)
+            (expand char-ci=? %cursor-match-string-ci))))
 
 (define ($char c)
   ($satisfy (cut char=? c <>) c))
@@ -764,20 +1010,27 @@
 (define ($y x) ($lift ($ string->symbol $ rope->string $) ($s x)))
 
 ;; ($many-chars charset [min [max]]) == ($many ($one-of charset) [min [max]])
-;;   with possible optimization.
-(define-syntax $many-chars
-  (syntax-rules ()
-    [(_ parser) ($many ($one-of parser))]
-    [(_ parser min) ($many ($one-of parser) min)]
-    [(_ parser min max) ($many ($one-of parser) min max)]))
+;;   On cursors, the characters are scanned in one go.
+(define ($many-chars charset :optional (min 0) (max #f))
+  (let1 p ($many ($one-of charset) min max)
+    (^s (if (fixnum? s)
+          (receive (vs s1) (%peg-span s charset min max)
+            (if vs
+              (return-result vs s1)
+              (return-failure/expect charset s1)))
+          (p s)))))
 
 (define ($none-of charset)
   ($one-of (char-set-complement charset)))
 
 (define (anychar s)
-  (if (pair? s)
-    (return-result (car s) (cdr s))
-    (return-failure/expect "character" s)))
+  (cond [(fixnum? s)
+         (let1 c (%peg-ref s)
+           (if (char? c)
+             (return-result c (%peg-next s c))
+             (return-failure/expect "character" s)))]
+        [(pair? s) (return-result (car s) (cdr s))]
+        [else (return-failure/expect "character" s)]))
 
 (define-syntax define-char-parser
   (syntax-rules ()
@@ -798,7 +1051,7 @@
 (define spaces ($lift make-rope ($many space)))
 
 (define (eof s)
-  (if (pair? s)
+  (if (if (fixnum? s) (char? (%peg-ref s)) (pair? s))
     (return-failure/expect "end of input" s)
     (return-result (eof-object) s)))
 
@@ -469,6 +469,69 @@
 (test-fail "$lazy" '(0 #\a)
            ($lazy ($char #\a)) "b")
 
+;; $memo
+(let* ([count 0]
+       [word ($memo ($do [v ($many-chars #[a-z] 1)]
+                         ($return (begin (inc! count) (list->string v)))))]
+       [p ($or ($try ($seq word ($char #\!)))
+               ($try ($seq word ($char #\?)))
+               word)])
+  (test* "$memo" '("abc" 1)
+         (let1 r (peg-parse-string p "abc.")
+           (list r count)))
+  (set! count 0)
+  (test* "$memo (list input)" '("abc" 1)
+         (let1 r (values-ref (peg-run-parser p (string->list "abc.")) 0)
+           (list r count)))
+  (set! count 0)
+  (test* "$memo (not shared between runs)" '("abc" "abc" 2)
+         (list (peg-parse-string p "abc.")
+               (peg-parse-string p "abc.")
+               count)))
+
+;;;============================================================
+;;; Input
+;;;
+(test-section "input")
+
+(let1 p ($seq ($string "ab") ($many-chars #[a-z]))
+  (test* "list input" '((#\c #\d) (#\0))
+         (receive (v rest) (peg-run-parser p (string->list "abcd0"))
+           (list v rest)))
+  (test* "lazy sequence input" '(#\c #\d)
+         (values-ref (peg-run-parser p (x->lseq "abcd0")) 0))
+  (test* "port input" '(#\c #\d)
+         (peg-parse-port p (open-input-string "abcd0"))))
+
+(test* "port input (error position)"
+       (test-error <parse-error> "expecting abd at 2, but got #\\a")
+       (peg-parse-port ($seq ($string "ab") ($string "abd"))
+                       (open-input-string "ababc")))
+
+(test* "port input (reads only what's needed)" "cd"
+       (let1 port (open-input-string "abcd")
+         (peg-parse-port ($string "ab") port)
+         (port->string port)))
+
+(test* "port input (large)" 10000
+       (length (peg-parse-port ($many-chars #[x])
+                               (open-input-string (make-string 10000 #\x)))))
+
+(test-succ "$string-ci" "aBc" ($string-ci "abc") "aBcd")
+
+(unless (eq? (gauche-character-encoding) 'none)
+  (let ([str (string (integer->char #x3b1) (integer->char #x3b2) #\x)]
+        [alpha (integer->char #x3b1)])
+    (test-succ "multibyte" (list alpha (integer->char #x3b2))
+               ($many ($none-of #[x])) str)
+    (test-fail "multibyte" '(2 #\y)
+               ($seq ($char alpha) anychar ($char #\y)) str)
+    (test* "multibyte (port)" '(2 #\y)
+           (guard (e [(<parse-error> e)
+                      (list (ref e 'position) (ref e 'objects))])
+             (peg-parse-port ($seq ($char alpha) anychar ($char #\y))
+                             (open-input-string str))))))
+
 ;;;============================================================
 ;;; Backtrack control
 ;;;
@@ -662,188 +725,4 @@
   (test-succ "calculator" 36 expr "2/2+5*(3+4)")
   (test-succ "calculator" -1 expr "1-2"))
 
-
-;;;============================================================
-;;; rfc.json
-;;;   Test is here since the module uses parser.peg.
-
-(test-section "rfc.json")
-(use rfc.json)
-(test-module 'rfc.json)
-
-(let ()
-  (define (t str val)
-    (test* "primitive" `(("x" . ,val)) (parse-json-string str)))
-  (t "{\"x\": 100 }" 100)
-  (t "{\"x\" : -100}" -100)
-  (t "{\"x\":  +100 }" 100)
-  (t "{\"x\": 12.5} " 12.5)
-  (t "{\"x\":-12.5}" -12.5)
-  (t "{\"x\":+12.5}"  12.5)
-  (t "{\"x\": 1.25e1 }" 12.5)
-  (t "{\"x\":125e-1}" 12.5)
-  (t "{\"x\":1250.0e-2}" 12.5)
-  (t "{\"x\":  false  }" 'false)
-  (t "{\"x\":true}" 'true)
-  (t "{\"x\":null}" 'null)
-  (t "{\"x\": \"abc\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0040abc\"}"
-     "abc\"\\/\u0008\u000c\u000a\u000d\u0009@abc")
-  )
-
-(let ()
-  (define (t str)
-    (test* #"parse error ~str" (test-error <json-parse-error>)
-           (parse-json-string str)))
-  (t "{\"x\": 100")
-  (t "{x : 100}}")
-  )
-
-(test* "parsing an object"
-       '(("Image"
-          ("Width"  . 800)
-          ("Height" . 600)
-          ("Title"  . "View from 15th Floor")
-          ("Thumbnail"
-           ("Url"    . "http://www.example.com/image/481989943")
-           ("Height" . 125)
-           ("Width"  . "100"))
-          ("IDs" . #(116 943 234 38793))))
-       (parse-json-string "{
-   \"Image\": {
-       \"Width\":  800,
-       \"Height\": 600,
-       \"Title\":  \"View from 15th Floor\",
-       \"Thumbnail\": {
-           \"Url\":    \"http://www.example.com/image/481989943\",
-           \"Height\": 125,
-           \"Width\":  \"100\"
-       },
-       \"IDs\": [116, 943, 234, 38793]
-     }
-}"))
-
-(test* "parsing an array containing two objects"
-       '#((("precision" . "zip")
-           ("Latitude"  . 37.7668)
-           ("Longitude" . -122.3959)
-           ("Address"   . "")
-           ("City"      . "SAN FRANCISCO")
-           ("State"     . "CA")
-           ("Zip"       . "94107")
-           ("Country"   . "US"))
-          (("precision" . "zip")
-           ("Latitude"  . 37.371991)
-           ("Longitude" . -122.026020)
-           ("Address"   . "")
-           ("City"      . "SUNNYVALE")
-           ("State"     . "CA")
-           ("Zip"       . "94085")
-           ("Country"   . "US")))
-       (parse-json-string "[
-   {
-      \"precision\": \"zip\",
-      \"Latitude\":  37.7668,
-      \"Longitude\": -122.3959,
-      \"Address\":   \"\",
-      \"City\":      \"SAN FRANCISCO\",
-      \"State\":     \"CA\",
-      \"Zip\":       \"94107\",
-      \"Country\":   \"US\"
-   },
-   {
-      \"precision\": \"zip\",
-      \"Latitude\":  37.371991,
-      \"Longitude\": -122.026020,
-      \"Address\":   \"\",
-      \"City\":      \"SUNNYVALE\",
-      \"State\":     \"CA\",
-      \"Zip\":       \"94085\",
-      \"Country\":   \"US\"
-   }
-]"))
-
-(test* "Parsing sequence of json objects"
-       '((("a" . 1)("b" . 2)) (("c" . 3) ("d" . 4)))
-       (with-input-from-string "{\"a\":1, \"b\":2}{\"c\":3, \"d\":4}"
-         parse-json*))
-
-(test* "Customizing consturctors"
-       '(object ("x" array 1 2 3) ("y" array #f #t null))
-       (parameterize ([json-array-handler (^[elts] (cons 'array elts))]
-                      [json-object-handler (^[pairs] (cons 'object pairs))]
-                      [json-special-handler (^y (case y
-                                                  [(false) #f]
-                                                  [(true) #t]
-                                                  [(null) 'null]))])
-         (parse-json-string "{\"x\":[1,2,3],\"y\":[false,true,null]}")))
-
-(let ()
-  (define (test-writer name obj)
-    (test* name obj
-           (parse-json-string (construct-json-string obj))))
-
-  (test-writer "writing an object"
-               '(("Image"
-                  ("Width"  . 800)
-                  ("Height" . 600)
-                  ("Title"  . "View from 15th Floor \"magnificent\"")
-                  ("Thumbnail"
-                   ("Url"    . "http://www.example.com/image/481989943")
-                   ("Height" . 125)
-                   ("Width"  . "100"))
-                  ("Description" . "Foo\nbackslash \\and tab\t and \u00a1")
-                  ("IDs" . #(116 943 234 38793))
-                  ("Misc" . ()))))
-
-  (test-writer "writing an array containing two objects"
-               '#((("precision" . "zip")
-                   ("Latitude"  . 37.7668)
-                   ("Longitude" . -122.3959)
-                   ("Address"   . "")
-                   ("City"      . "SAN FRANCISCO")
-                   ("State"     . "CA")
-                   ("Zip"       . "94107")
-                   ("Country"   . "US"))
-                  (("precision" . "zip")
-                   ("Latitude"  . 37.371991)
-                   ("Longitude" . -122.026020)
-                   ("Address"   . "")
-                   ("City"      . "SUNNYVALE")
-                   ("State"     . "CA")
-                   ("Zip"       . "94085")
-                   ("Country"   . "US"))))
-  )
-
-(cond-expand
- [gauche.ces.utf8
-  (let1 data `(("[\"\\u03bb\"]" #("\x3bb;"))
-               ("[\"\\ud800\"]" ,(test-error <json-parse-error>))
-               ("[\"\\ud867\\ude3d\\u03bb\"]" #("\x29e3d;\x3bb;"))
-               ("[\"\\ude3d\\ud867\"]" ,(test-error <json-parse-error>))
-               ("[\"\\uf020\\u03bb\"]"  #("\xf020;\x3bb;")))
-    (dolist [d data]
-      (test* (format "unicode escape reading (~s)" (car d))
-             (cadr d)
-             (parse-json-string (car d)))
-      (when (vector? (cadr data))
-        (test* (format "unicode escape writing (~s)" (cadr d))
-               (car d)
-               (construct-json-string (cadr d))))))]
- [else])
-
-(let ()
-  (define (t obj)
-    (test* #"writer error ~obj" (test-error <json-construct-error>)
-           (construct-json-string obj)))
-  (t "a")
-  (t '#(1 2 x))
-  (t '(("a" . 2) 9)))
-
-(test* "generalized array" "[1,2,3]"
-       (construct-json-string '#u8(1 2 3)))
-(test* "generalized object" (test-one-of "{\"a\":1,\"b\":2}"
-                                         "{\"b\":2,\"a\":1}")
-       (construct-json-string (hash-table 'eq? '(a . 1) '(b . 2))))
-
-
 (test-end)
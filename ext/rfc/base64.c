@@ -0,0 +1,359 @@
+/*
+ * base64.c - Base64 codec
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Ref: RFC2045 section 6.8  <http://www.rfc-editor.org/rfc/rfc2045.txt>
+   and RFC4648 <http://www.rfc-editor.org/rfc/rfc4648.txt>
+
+   The codec works on a chunk of bytes at a time.  The inner loops
+   handle a full group (3 bytes to 4 chars, or 4 chars to 3 bytes) per
+   iteration, and fall back to the character-wise state machine only
+   when the input contains characters outside of the alphabet (e.g.
+   line breaks) or reaches the end.
+*/
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include <gauche/priv/portP.h>
+#include "base64.h"
+
+/* # of input bytes we process at once for port I/O.
+   Must be a multiple of 3. */
+#define CHUNK_SIZE  3072
+
+static const char std_encode_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char url_encode_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/* Decode tables are built from the encode tables at initialization.
+   The values 0-63 are valid digits; the characters mapped to SKIP are
+   silently ignored, and PAD terminates decoding. */
+#define SKIP  0xff
+#define PAD   0xfe
+
+static unsigned char std_decode_table[256];
+static unsigned char url_decode_table[256];
+
+static void init_decode_table(unsigned char *dtab, const char *etab)
+{
+    memset(dtab, SKIP, 256);
+    for (int i=0; i<64; i++) dtab[(unsigned char)etab[i]] = (unsigned char)i;
+    dtab['='] = PAD;
+}
+
+void Scm_Init_base64(void)
+{
+    init_decode_table(std_decode_table, std_encode_table);
+    init_decode_table(url_decode_table, url_encode_table);
+}
+
+/*================================================================
+ * Encoder
+ */
+
+typedef struct encoder_rec {
+    const char *table;
+    int line_width;             /* 0 if no line splitting */
+    int column;                 /* current column */
+    void (*sink)(const char *buf, ScmSmallInt size, void *data);
+    void *data;
+} encoder;
+
+/* Encode LEN bytes in SRC.  LEN must be a multiple of 3, unless
+   this is the last call.  Returns # of chars written to DST, which must
+   have room for ((LEN+2)/3)*4 chars. */
+static ScmSmallInt encode_raw(const char *table, const unsigned char *src,
+                          ScmSmallInt len, char *dst)
+{
+    char *d = dst;
+    const unsigned char *end3 = src + (len/3)*3;
+
+    for (; src < end3; src += 3, d += 4) {
+        u_long w = ((u_long)src[0] << 16) | ((u_long)src[1] << 8) | src[2];
+        d[0] = table[(w >> 18) & 0x3f];
+        d[1] = table[(w >> 12) & 0x3f];
+        d[2] = table[(w >> 6) & 0x3f];
+        d[3] = table[w & 0x3f];
+    }
+    switch (len % 3) {
+    case 1:
+        d[0] = table[src[0] >> 2];
+        d[1] = table[(src[0] & 0x03) << 4];
+        d[2] = d[3] = '=';
+        d += 4;
+        break;
+    case 2:
+        d[0] = table[src[0] >> 2];
+        d[1] = table[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+        d[2] = table[(src[1] & 0x0f) << 2];
+        d[3] = '=';
+        d += 4;
+        break;
+    }
+    return d - dst;
+}
+
+/* Pass encoded chars to the sink, inserting newlines to keep the
+   line width.  As the original Scheme version did, a newline is
+   emitted right after the char that fills the line, even if it is
+   the last one. */
+static void encoder_emit(encoder *e, const char *buf, ScmSmallInt size)
+{
+    if (e->line_width <= 0) {
+        e->sink(buf, size, e->data);
+        return;
+    }
+    while (size > 0) {
+        ScmSmallInt room = e->line_width - e->column;
+        if (size < room) {
+            e->sink(buf, size, e->data);
+            e->column += (int)size;
+            return;
+        }
+        e->sink(buf, room, e->data);
+        e->sink("\n", 1, e->data);
+        e->column = 0;
+        buf += room;
+        size -= room;
+    }
+}
+
+static void encode_bytes(encoder *e, const unsigned char *src, ScmSmallInt len)
+{
+    char buf[CHUNK_SIZE/3*4];
+    while (len > 0) {
+        ScmSmallInt n = (len > CHUNK_SIZE)? CHUNK_SIZE : len;
+        ScmSmallInt m = encode_raw(e->table, src, n, buf);
+        encoder_emit(e, buf, m);
+        src += n;
+        len -= n;
+    }
+}
+
+static void port_sink(const char *buf, ScmSmallInt size, void *data)
+{
+    Scm_Putz(buf, (int)size, SCM_PORT(data));
+}
+
+static void dstring_sink(const char *buf, ScmSmallInt size, void *data)
+{
+    Scm_DStringPutz((ScmDString*)data, buf, size);
+}
+
+/* Read up to LEN bytes from IPORT.  Returns the # of bytes read, which is
+   less than LEN only at EOF. */
+static ScmSmallInt read_chunk(ScmPort *iport, char *buf, ScmSmallInt len)
+{
+    ScmSmallInt nread = 0;
+    while (nread < len) {
+        int r = Scm_Getz(buf+nread, (int)(len-nread), iport);
+        if (r <= 0) break;
+        nread += r;
+    }
+    return nread;
+}
+
+void Scm_Base64EncodePort(ScmPort *iport, ScmPort *oport,
+                          int line_width, int url_safe)
+{
+    char buf[CHUNK_SIZE];
+    encoder e;
+    e.table = url_safe? url_encode_table : std_encode_table;
+    e.line_width = line_width;
+    e.column = 0;
+    e.sink = port_sink;
+    e.data = oport;
+
+    for (;;) {
+        ScmSmallInt n = read_chunk(iport, buf, CHUNK_SIZE);
+        if (n > 0) encode_bytes(&e, (unsigned char*)buf, n);
+        if (n < CHUNK_SIZE) break;
+    }
+}
+
+ScmObj Scm_Base64EncodeBytes(const unsigned char *src, ScmSmallInt len,
+                             int line_width, int url_safe)
+{
+    ScmDString ds;
+    encoder e;
+    Scm_DStringInit(&ds);
+    e.table = url_safe? url_encode_table : std_encode_table;
+    e.line_width = line_width;
+    e.column = 0;
+    e.sink = dstring_sink;
+    e.data = &ds;
+    encode_bytes(&e, src, len);
+    return Scm_DStringGet(&ds, 0);
+}
+
+/*================================================================
+ * Decoder
+ */
+
+typedef struct decoder_rec {
+    const unsigned char *table;
+    u_long bits;                /* accumulated bits */
+    int ndigits;                /* # of digits in bits (0-3) */
+    int done;                   /* TRUE if we've seen the termination */
+} decoder;
+
+/* Decode LEN chars from SRC into DST, which must have room for
+   (LEN/4+1)*3 bytes.  Returns # of bytes written.  If CONSUMED is not
+   NULL, # of chars read from SRC is stored there; it is less than LEN
+   if we see the termination character, which is counted as read. */
+static ScmSmallInt decode_chunk(decoder *d, const unsigned char *src,
+                                ScmSmallInt len, unsigned char *dst,
+                                ScmSmallInt *consumed)
+{
+    const unsigned char *start = src;
+    const unsigned char *tab = d->table;
+    const unsigned char *end = src + len;
+    unsigned char *p = dst;
+
+    while (src < end && !d->done) {
+        /* Fast path: full group of four valid digits */
+        if (d->ndigits == 0) {
+            while (end - src >= 4) {
+                unsigned int a = tab[src[0]], b = tab[src[1]];
+                unsigned int c = tab[src[2]], e = tab[src[3]];
+                if ((a|b|c|e) & 0xc0) break;
+                u_long w = (a << 18) | (b << 12) | (c << 6) | e;
+                p[0] = (unsigned char)(w >> 16);
+                p[1] = (unsigned char)(w >> 8);
+                p[2] = (unsigned char)w;
+                p += 3;
+                src += 4;
+            }
+            if (src >= end) break;
+        }
+        /* Slow path: one char at a time */
+        unsigned int v = tab[*src++];
+        if (v == SKIP) continue;
+        if (v == PAD) { d->done = TRUE; break; }
+        switch (d->ndigits) {
+        case 0:
+            d->bits = v;
+            d->ndigits = 1;
+            break;
+        case 1:
+            *p++ = (unsigned char)((d->bits << 2) | (v >> 4));
+            d->bits = v & 0x0f;
+            d->ndigits = 2;
+            break;
+        case 2:
+            *p++ = (unsigned char)((d->bits << 4) | (v >> 2));
+            d->bits = v & 0x03;
+            d->ndigits = 3;
+            break;
+        case 3:
+            *p++ = (unsigned char)((d->bits << 6) | v);
+            d->ndigits = 0;
+            break;
+        }
+    }
+    if (consumed) *consumed = src - start;
+    return p - dst;
+}
+
+/* Decode from IPORT until EOF or the termination.  IPORT must be locked.
+   We take the input directly from the port buffer if possible, so that
+   we don't read beyond the termination; the data following the encoded
+   part can be read from IPORT afterwards. */
+static void decode_port(decoder *d, ScmPort *iport, ScmPort *oport)
+{
+    unsigned char obuf[CHUNK_SIZE/4*3+3];
+
+    while (!d->done) {
+        const char *start, *end;
+        ScmSmallInt n, m, used;
+        if (Scm__PortInputBuffer(iport, &start, &end) && start < end) {
+            n = (end - start > CHUNK_SIZE)? CHUNK_SIZE : end - start;
+            m = decode_chunk(d, (const unsigned char*)start, n, obuf, &used);
+            u_long nlines = 0;
+            for (const char *p = start; p < start + used; p++) {
+                if (*p == '\n') nlines++;
+            }
+            Scm__PortInputConsumed(iport, used, nlines);
+        } else {
+            /* The buffer is empty, or the port doesn't have one.
+               Getb refills the buffer if possible. */
+            int b = Scm_GetbUnsafe(iport);
+            if (b == EOF) break;
+            unsigned char c = (unsigned char)b;
+            m = decode_chunk(d, &c, 1, obuf, NULL);
+        }
+        if (m > 0) Scm_Putz((char*)obuf, (int)m, oport);
+    }
+    /* Consume the second '=' of the padding of a 1-octet group. */
+    if (d->done && d->ndigits == 2 && Scm_PeekbUnsafe(iport) == '=') {
+        Scm_GetbUnsafe(iport);
+    }
+}
+
+void Scm_Base64DecodePort(ScmPort *iport, ScmPort *oport, int url_safe)
+{
+    ScmVM *vm = Scm_VM();
+    decoder d;
+    d.table = url_safe? url_decode_table : std_decode_table;
+    d.bits = 0;
+    d.ndigits = 0;
+    d.done = FALSE;
+
+    if (PORT_LOCKED(iport, vm)) {
+        decode_port(&d, iport, oport);
+    } else {
+        PORT_LOCK(iport, vm);
+        PORT_SAFE_CALL(iport, decode_port(&d, iport, oport), /*no cleanup*/);
+        PORT_UNLOCK(iport);
+    }
+}
+
+ScmObj Scm_Base64DecodeBytes(const char *src, ScmSmallInt len,
+                             int url_safe, int result_type)
+{
+    decoder d;
+    d.table = url_safe? url_decode_table : std_decode_table;
+    d.bits = 0;
+    d.ndigits = 0;
+    d.done = FALSE;
+
+    unsigned char *buf = SCM_NEW_ATOMIC2(unsigned char*, (len/4+1)*3 + 1);
+    ScmSmallInt m = decode_chunk(&d, (const unsigned char*)src, len, buf,
+                                 NULL);
+    if (result_type == SCM_BASE64_RESULT_U8VECTOR) {
+        return Scm_MakeU8VectorFromArrayShared(m, buf);
+    } else {
+        buf[m] = '\0';
+        return Scm_MakeString((char*)buf, m, -1, 0);
+    }
+}
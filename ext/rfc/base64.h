@@ -0,0 +1,63 @@
+/*
+ * base64.h - Base64 codec
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_BASE64_H
+#define GAUCHE_RFC_BASE64_H
+
+#include <gauche.h>
+
+extern void   Scm_Init_base64(void);
+
+/* Encoding from/to ports.  Input is consumed until EOF (for encoding)
+   or until EOF or the termination character '=' (for decoding).
+   LINE_WIDTH <= 0 suppresses line splitting. */
+extern void   Scm_Base64EncodePort(ScmPort *iport, ScmPort *oport,
+                                   int line_width, int url_safe);
+extern void   Scm_Base64DecodePort(ScmPort *iport, ScmPort *oport,
+                                   int url_safe);
+
+/* Encoding from/to memory.  Encoder returns a string; decoder returns
+   either a string (possibly incomplete) or a u8vector, depending on
+   RESULT_TYPE. */
+enum {
+    SCM_BASE64_RESULT_STRING,
+    SCM_BASE64_RESULT_U8VECTOR
+};
+
+extern ScmObj Scm_Base64EncodeBytes(const unsigned char *src,
+                                    ScmSmallInt len,
+                                    int line_width, int url_safe);
+extern ScmObj Scm_Base64DecodeBytes(const char *src, ScmSmallInt len,
+                                    int url_safe, int result_type);
+
+#endif /* GAUCHE_RFC_BASE64_H */
@@ -0,0 +1,106 @@
+;;;
+;;; base64.scm - base64 encoding/decoding routine
+;;;
+;;;   Copyright (c) 2000-2018  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Implements Base64 encoding/decoding routine
+;; Ref: RFC2045 section 6.8  <http://www.rfc-editor.org/rfc/rfc2045.txt>
+;; and RFC3548 <http://www.rfc-editor.org/rfc/rfc3548.txt>
+
+;; The actual codec is in base64.c.
+
+(define-module rfc.base64
+  (export base64-encode base64-encode-string base64-encode-bytevector
+          base64-decode base64-decode-string base64-decode-bytevector))
+(select-module rfc.base64)
+
+(inline-stub
+ "#include \"base64.h\""
+
+ (define-cproc %base64-encode (iport::<input-port> oport::<output-port>
+                               line-width::<int> url-safe::<boolean>)
+   ::<void> Scm_Base64EncodePort)
+
+ (define-cproc %base64-decode (iport::<input-port> oport::<output-port>
+                               url-safe::<boolean>)
+   ::<void> Scm_Base64DecodePort)
+
+ ;; DATA can be a string (taken as a byte sequence) or a u8vector.
+ (define-cproc %base64-encode-bytes (data line-width::<int>
+                                     url-safe::<boolean>)
+   (cond
+    [(SCM_U8VECTORP data)
+     (return (Scm_Base64EncodeBytes (SCM_U8VECTOR_ELEMENTS data)
+                                    (SCM_U8VECTOR_SIZE data)
+                                    line-width url-safe))]
+    [(SCM_STRINGP data)
+     (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+       (return (Scm_Base64EncodeBytes
+                (cast (const unsigned char*) (SCM_STRING_BODY_START b))
+                (SCM_STRING_BODY_SIZE b)
+                line-width url-safe)))]
+    [else (SCM_TYPE_ERROR data "u8vector or string") (return SCM_UNDEFINED)]))
+
+ (define-cproc %base64-decode-bytes (string::<string> url-safe::<boolean>
+                                     u8vector-result::<boolean>)
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY string)])
+     (return (Scm_Base64DecodeBytes (SCM_STRING_BODY_START b)
+                                    (SCM_STRING_BODY_SIZE b)
+                                    url-safe
+                                    (?: u8vector-result
+                                        SCM_BASE64_RESULT_U8VECTOR
+                                        SCM_BASE64_RESULT_STRING)))))
+
+ (initcode (Scm_Init_base64))
+ )
+
+(define (%line-width line-width)
+  (if (and line-width (> line-width 0)) line-width 0))
+
+(define (base64-decode :key (url-safe #f))
+  (%base64-decode (current-input-port) (current-output-port) url-safe))
+
+(define (base64-decode-string string :key (url-safe #f))
+  (%base64-decode-bytes string url-safe #f))
+
+(define (base64-decode-bytevector string :key (url-safe #f))
+  (%base64-decode-bytes string url-safe #t))
+
+(define (base64-encode :key (line-width 76) (url-safe #f))
+  (%base64-encode (current-input-port) (current-output-port)
+                  (%line-width line-width) url-safe))
+
+(define (base64-encode-string string :key (line-width 76) (url-safe #f))
+  (%base64-encode-bytes string (%line-width line-width) url-safe))
+
+(define (base64-encode-bytevector u8v :key (line-width 76) (url-safe #f))
+  (assume-type u8v <u8vector>)
+  (%base64-encode-bytes u8v (%line-width line-width) url-safe))
@@ -0,0 +1,447 @@
+/*
+ * http-parser.c - HTTP/1.x message head parser
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* RFC7230 Hypertext Transfer Protocol (HTTP/1.1): Message Syntax and Routing
+ *  https://tools.ietf.org/html/rfc7230
+ *
+ * We read lines directly from the port buffer when possible; the head of
+ * a typical request fits in one buffer, so we don't need to go through
+ * the per-character port API at all.
+ */
+
+#include <ctype.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include <gauche/priv/portP.h>
+#include "http-parser.h"
+
+static ScmObj http_module = SCM_UNDEFINED;
+static ScmObj parse_error_class = SCM_UNDEFINED; /* <http-parse-error> */
+
+/* STATUS is the status code the server should reply with, or 0
+   when we're reading a response. */
+static void parse_error(int status, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    ScmObj msg = Scm_Vsprintf(fmt, ap, TRUE);
+    va_end(ap);
+    SCM_BIND_PROC(parse_error_class, "<http-parse-error>",
+                  SCM_MODULE(http_module));
+    Scm_RaiseCondition(parse_error_class,
+                       "status", (status? SCM_MAKE_INT(status) : SCM_FALSE),
+                       SCM_RAISE_CONDITION_MESSAGE, "%A", msg);
+}
+
+/*================================================================
+ * Line reader
+ */
+
+#define LINE_EOF         (-1)   /* input ended before any byte */
+#define LINE_INCOMPLETE  (-2)   /* input ended in the middle of a line */
+#define LINE_TOO_LONG    (-3)   /* line exceeds the limit */
+
+#define LINE_BUF_INITIAL_SIZE 256
+
+typedef struct line_buf_rec {
+    char *buf;
+    ScmSmallInt size;
+    ScmSmallInt cap;
+} line_buf;
+
+static void line_buf_append(line_buf *lb, const char *s, ScmSmallInt n)
+{
+    if (lb->size + n > lb->cap) {
+        ScmSmallInt ncap = lb->cap * 2;
+        while (ncap < lb->size + n) ncap *= 2;
+        char *nbuf = SCM_NEW_ATOMIC_ARRAY(char, ncap);
+        memcpy(nbuf, lb->buf, lb->size);
+        lb->buf = nbuf;
+        lb->cap = ncap;
+    }
+    memcpy(lb->buf + lb->size, s, n);
+    lb->size += n;
+}
+
+/* Reads a line terminated by LF into LB, and returns its length
+   excluding the terminator and the preceding CR, if any.  Returns
+   a negative LINE_* code on failure.  The port must be locked. */
+static ScmSmallInt read_line(ScmPort *port, line_buf *lb, ScmSmallInt limit)
+{
+    lb->size = 0;
+    for (;;) {
+        const char *start, *end;
+        if (Scm__PortInputBuffer(port, &start, &end) && start < end) {
+            const char *nl = memchr(start, '\n', end - start);
+            ScmSmallInt n = nl? (nl - start + 1) : (end - start);
+            /* +2 for CRLF */
+            if (lb->size + n > limit + 2) return LINE_TOO_LONG;
+            line_buf_append(lb, start, n);
+            Scm__PortInputConsumed(port, n, nl? 1 : 0);
+            if (nl) break;
+        } else {
+            /* The buffer is empty, or the port isn't a buffered one.
+               Getb refills the buffer, so we're likely to take the
+               fast path in the next iteration. */
+            int b = Scm_GetbUnsafe(port);
+            if (b == EOF) {
+                return (lb->size == 0)? LINE_EOF : LINE_INCOMPLETE;
+            }
+            char c = (char)b;
+            line_buf_append(lb, &c, 1);
+            if (c == '\n') break;
+            if (lb->size > limit + 2) return LINE_TOO_LONG;
+        }
+    }
+    ScmSmallInt len = lb->size - 1;
+    if (len > 0 && lb->buf[len-1] == '\r') len--;
+    if (len > limit) return LINE_TOO_LONG;
+    return len;
+}
+
+/*================================================================
+ * Parsers
+ */
+
+/* tchar in RFC7230 3.2.6 */
+static inline int tchar_p(unsigned char c)
+{
+    if (c >= 0x80) return FALSE;
+    if (isalnum(c)) return TRUE;
+    return c != 0 && strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+static inline int ows_p(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/* Parses "HTTP/" DIGIT "." DIGIT at P.  Returns TRUE on success. */
+static int parse_version(const char *p, const char *end)
+{
+    return (end - p == 8
+            && memcmp(p, "HTTP/", 5) == 0
+            && isdigit((unsigned char)p[5])
+            && p[6] == '.'
+            && isdigit((unsigned char)p[7]));
+}
+
+static ScmObj make_ascii_string(const char *s, ScmSmallInt n)
+{
+    return Scm_MakeString(s, n, n, SCM_STRING_COPYING);
+}
+
+/* Reads header fields up to the empty line.  STATUS is passed to
+   parse_error. */
+static ScmObj read_headers(ScmPort *port, line_buf *lb,
+                           const ScmHttpLimits *limits, int status)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmObj last = SCM_FALSE;    /* the last (name value) */
+    ScmSmallInt total = 0, count = 0;
+
+    for (;;) {
+        ScmSmallInt len = read_line(port, lb, limits->max_line);
+        if (len == LINE_TOO_LONG) {
+            parse_error(status? 431 : 0, "header field too long");
+        }
+        if (len < 0) {
+            parse_error(status, "input ended in header fields");
+        }
+        if (len == 0) break;
+        total += len;
+        if (total > limits->max_header_size) {
+            parse_error(status? 431 : 0, "header fields too large");
+        }
+
+        char *p = lb->buf, *e = lb->buf + len;
+        while (e > p && ows_p(e[-1])) e--;
+
+        if (ows_p(*p)) {
+            /* obs-fold (RFC7230 3.2.4).  We replace it with a space. */
+            if (SCM_FALSEP(last)) {
+                parse_error(status, "header starts with whitespace");
+            }
+            while (p < e && ows_p(*p)) p++;
+            ScmObj v = SCM_CADR(last);
+            v = Scm_StringAppendC(SCM_STRING(v), " ", 1, 1);
+            v = Scm_StringAppendC(SCM_STRING(v), p, e - p, -1);
+            SCM_SET_CAR(SCM_CDR(last), v);
+            continue;
+        }
+
+        if (++count > limits->max_headers) {
+            parse_error(status? 431 : 0, "too many header fields");
+        }
+        char *q = p;
+        for (; q < e && tchar_p(*q); q++) {
+            *q = tolower((unsigned char)*q);
+        }
+        if (q == p || q == e || *q != ':') {
+            parse_error(status, "malformed header field: %S",
+                        Scm_MakeString(lb->buf, len, -1, SCM_STRING_COPYING));
+        }
+        ScmObj name = make_ascii_string(p, q - p);
+        for (q++; q < e && ows_p(*q); q++)
+            ;
+        ScmObj value = Scm_MakeString(q, e - q, -1, SCM_STRING_COPYING);
+        last = SCM_LIST2(name, value);
+        SCM_APPEND1(h, t, last);
+    }
+    return h;
+}
+
+/* Reads a line skipping empty lines before the start line
+   (RFC7230 3.5).  Returns LINE_EOF, or the length of the line. */
+static ScmSmallInt read_start_line(ScmPort *port, line_buf *lb,
+                                   const ScmHttpLimits *limits, int status)
+{
+    for (ScmSmallInt i = 0; ; i++) {
+        ScmSmallInt len = read_line(port, lb, limits->max_line);
+        if (len == LINE_EOF) return LINE_EOF;
+        if (len == LINE_TOO_LONG) {
+            parse_error(status? 414 : 0, "start line too long");
+        }
+        if (len == LINE_INCOMPLETE) {
+            parse_error(status, "input ended in the start line");
+        }
+        if (len > 0) return len;
+        if (i >= limits->max_headers) {
+            parse_error(status, "too many empty lines");
+        }
+    }
+}
+
+struct request_head {
+    ScmObj method;
+    ScmObj target;
+    ScmObj version;
+    ScmObj headers;
+};
+
+static ScmObj read_request_head(ScmPort *port, const ScmHttpLimits *limits,
+                                struct request_head *r)
+{
+    char ibuf[LINE_BUF_INITIAL_SIZE];
+    line_buf lb = { ibuf, 0, LINE_BUF_INITIAL_SIZE };
+
+    ScmSmallInt len = read_start_line(port, &lb, limits, 400);
+    if (len == LINE_EOF) return SCM_EOF;
+
+    /* method SP request-target SP HTTP-version */
+    const char *p = lb.buf, *e = lb.buf + len, *q;
+    for (q = p; q < e && tchar_p(*q); q++)
+        ;
+    if (q == p || q == e || *q != ' ') goto bad;
+    r->method = make_ascii_string(p, q - p);
+
+    for (p = ++q; q < e && *q > ' ' && *q != 0x7f; q++)
+        ;
+    if (q == p || q == e || *q != ' ') goto bad;
+    r->target = make_ascii_string(p, q - p);
+
+    p = q + 1;
+    if (!parse_version(p, e)) goto bad;
+    if (p[5] != '1') {
+        parse_error(505, "unsupported HTTP version: %S",
+                    make_ascii_string(p, e - p));
+    }
+    r->version = make_ascii_string(p, e - p);
+
+    r->headers = read_headers(port, &lb, limits, 400);
+    return SCM_TRUE;
+  bad:
+    parse_error(400, "malformed request line: %S",
+                Scm_MakeString(lb.buf, len, -1, SCM_STRING_COPYING));
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+struct response_head {
+    ScmObj version;
+    ScmObj status;
+    ScmObj reason;
+    ScmObj headers;
+};
+
+static ScmObj read_response_head(ScmPort *port, const ScmHttpLimits *limits,
+                                 struct response_head *r)
+{
+    char ibuf[LINE_BUF_INITIAL_SIZE];
+    line_buf lb = { ibuf, 0, LINE_BUF_INITIAL_SIZE };
+
+    ScmSmallInt len = read_start_line(port, &lb, limits, 0);
+    if (len == LINE_EOF) return SCM_EOF;
+
+    /* HTTP-version SP status-code SP reason-phrase
+       We allow missing SP after status-code for lenient parsing. */
+    const char *p = lb.buf, *e = lb.buf + len;
+    if (len < 12 || !parse_version(p, p + 8) || p[8] != ' ') goto bad;
+    if (!isdigit((unsigned char)p[9]) || !isdigit((unsigned char)p[10])
+        || !isdigit((unsigned char)p[11])) goto bad;
+    if (len > 12 && p[12] != ' ') goto bad;
+
+    r->version = make_ascii_string(p, 8);
+    r->status = SCM_MAKE_INT((p[9]-'0')*100 + (p[10]-'0')*10 + (p[11]-'0'));
+    p = (len > 12)? p + 13 : e;
+    r->reason = Scm_MakeString(p, e - p, -1, SCM_STRING_COPYING);
+    r->headers = read_headers(port, &lb, limits, 0);
+    return SCM_TRUE;
+  bad:
+    parse_error(0, "malformed status line: %S",
+                Scm_MakeString(lb.buf, len, -1, SCM_STRING_COPYING));
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+/* Chunked transfer coding (RFC7230 4.1).  These are used while reading
+   a request body, so errors have status 400 (or 431 for oversized
+   trailer fields). */
+
+static ScmObj read_chunk_size(ScmPort *port, const ScmHttpLimits *limits)
+{
+    char ibuf[LINE_BUF_INITIAL_SIZE];
+    line_buf lb = { ibuf, 0, LINE_BUF_INITIAL_SIZE };
+
+    ScmSmallInt len = read_line(port, &lb, limits->max_line);
+    if (len == LINE_TOO_LONG) {
+        parse_error(400, "chunk size line too long");
+    }
+    if (len < 0) {
+        parse_error(400, "input ended in chunked body");
+    }
+
+    /* chunk-size [ chunk-ext ].  We ignore chunk-ext. */
+    const char *p = lb.buf, *e = lb.buf + len;
+    ScmSmallInt size = 0;
+    for (; p < e && isxdigit((unsigned char)*p); p++) {
+        if (size > (SCM_SMALL_INT_MAX >> 4)) {
+            parse_error(400, "chunk size too large");
+        }
+        size = size * 16 + (isdigit((unsigned char)*p)
+                            ? *p - '0'
+                            : tolower((unsigned char)*p) - 'a' + 10);
+    }
+    if (p == lb.buf || (p < e && *p != ';' && !ows_p(*p))) {
+        parse_error(400, "bad chunk size: %S",
+                    Scm_MakeString(lb.buf, len, -1, SCM_STRING_COPYING));
+    }
+    return SCM_MAKE_INT(size);
+}
+
+static ScmObj read_trailer(ScmPort *port, const ScmHttpLimits *limits)
+{
+    char ibuf[LINE_BUF_INITIAL_SIZE];
+    line_buf lb = { ibuf, 0, LINE_BUF_INITIAL_SIZE };
+    return read_headers(port, &lb, limits, 400);
+}
+
+/*================================================================
+ * Entry points
+ */
+
+ScmObj Scm_HttpReadRequestHead(ScmPort *port, const ScmHttpLimits *limits,
+                               ScmObj *method, ScmObj *target,
+                               ScmObj *version, ScmObj *headers)
+{
+    ScmVM *vm = Scm_VM();
+    struct request_head r = { SCM_FALSE, SCM_FALSE, SCM_FALSE, SCM_FALSE };
+    volatile ScmObj v = SCM_UNDEFINED;
+
+    if (PORT_LOCKED(port, vm)) {
+        v = read_request_head(port, limits, &r);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, v = read_request_head(port, limits, &r),
+                       /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    *method = r.method;
+    *target = r.target;
+    *version = r.version;
+    *headers = r.headers;
+    return v;
+}
+
+ScmObj Scm_HttpReadResponseHead(ScmPort *port, const ScmHttpLimits *limits,
+                                ScmObj *version, ScmObj *status,
+                                ScmObj *reason, ScmObj *headers)
+{
+    ScmVM *vm = Scm_VM();
+    struct response_head r = { SCM_FALSE, SCM_FALSE, SCM_FALSE, SCM_FALSE };
+    volatile ScmObj v = SCM_UNDEFINED;
+
+    if (PORT_LOCKED(port, vm)) {
+        v = read_response_head(port, limits, &r);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, v = read_response_head(port, limits, &r),
+                       /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    *version = r.version;
+    *status = r.status;
+    *reason = r.reason;
+    *headers = r.headers;
+    return v;
+}
+
+/* Calls READER with PORT locked. */
+static ScmObj with_port_locked(ScmObj (*reader)(ScmPort*, const ScmHttpLimits*),
+                               ScmPort *port, const ScmHttpLimits *limits)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj v = SCM_UNDEFINED;
+
+    if (PORT_LOCKED(port, vm)) {
+        v = reader(port, limits);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, v = reader(port, limits), /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    return v;
+}
+
+ScmObj Scm_HttpReadChunkSize(ScmPort *port, const ScmHttpLimits *limits)
+{
+    return with_port_locked(read_chunk_size, port, limits);
+}
+
+ScmObj Scm_HttpReadTrailer(ScmPort *port, const ScmHttpLimits *limits)
+{
+    return with_port_locked(read_trailer, port, limits);
+}
+
+void Scm_Init_http_parser(ScmModule *mod)
+{
+    http_module = SCM_OBJ(mod);
+}
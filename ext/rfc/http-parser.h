@@ -0,0 +1,86 @@
+/*
+ * http-parser.h - HTTP/1.x message head parser
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_HTTP_PARSER_H
+#define GAUCHE_RFC_HTTP_PARSER_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTRFC_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/* Limits to protect the reader from malicious or broken peers.
+   All sizes are in bytes, excluding line terminators. */
+typedef struct ScmHttpLimitsRec {
+    ScmSmallInt max_line;         /* request/status line and each field */
+    ScmSmallInt max_header_size;  /* total size of header fields */
+    ScmSmallInt max_headers;      /* number of header fields */
+} ScmHttpLimits;
+
+extern void   Scm_Init_http_parser(ScmModule *mod);
+
+/* Reads a request line and header fields from PORT, up to and including
+   the empty line that terminates them.  On success, stores the method,
+   the request target and the version ("HTTP/1.1") as strings, and the
+   header fields as a list of (name value), with the names downcased,
+   and returns #t.  Returns EOF if the input ends before any request.
+   Malformed input raises <http-parse-error>, whose status slot has
+   the status code the server should respond with. */
+extern ScmObj Scm_HttpReadRequestHead(ScmPort *port,
+                                      const ScmHttpLimits *limits,
+                                      ScmObj *method, ScmObj *target,
+                                      ScmObj *version, ScmObj *headers);
+
+/* Same as above, but reads a status line.  The status code is stored
+   as an integer. */
+extern ScmObj Scm_HttpReadResponseHead(ScmPort *port,
+                                       const ScmHttpLimits *limits,
+                                       ScmObj *version, ScmObj *status,
+                                       ScmObj *reason, ScmObj *headers);
+
+/* Reads a chunk-size line of the chunked transfer coding and returns
+   the size as an integer; chunk extensions are ignored.  Only
+   MAX_LINE of LIMITS is used. */
+extern ScmObj Scm_HttpReadChunkSize(ScmPort *port,
+                                    const ScmHttpLimits *limits);
+
+/* Reads the trailer fields after the last chunk, up to and including
+   the empty line, and returns them in the same format as the header
+   fields. */
+extern ScmObj Scm_HttpReadTrailer(ScmPort *port,
+                                  const ScmHttpLimits *limits);
+
+#endif /* GAUCHE_RFC_HTTP_PARSER_H */
@@ -0,0 +1,106 @@
+;;;
+;;; http-parser.scm - HTTP/1.x message head parser
+;;;
+;;;   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; RFC7230 https://tools.ietf.org/html/rfc7230
+
+;; Reads the start line and header fields of HTTP/1.x messages.  The
+;; parser is written in C (http-parser.c), since it's on the hot path of
+;; both the server (rfc.http-server) and the client.  Header fields are
+;; returned in the same format as rfc822-read-headers, so that
+;; rfc822-header-ref can be used on them.
+
+(define-module rfc.http-parser
+  (export <http-parse-error>
+          http-read-request-head http-read-response-head
+          http-read-chunk-size http-read-trailer))
+(select-module rfc.http-parser)
+
+;; STATUS is the status code the server should respond with (400, 414,
+;; 431 or 505), or #f if the error is in a response.  The readers of
+;; the chunked coding always set it, since they're used for requests.
+(define-condition-type <http-parse-error> <error> #f
+  (status))
+
+(inline-stub
+ "#include \"http-parser.h\""
+
+ (initcode "Scm_Init_http_parser(Scm_CurrentModule());")
+
+ (define-cproc http-read-request-head (port::<input-port>
+                                       :key (max-line-size::<fixnum> 8190)
+                                            (max-header-size::<fixnum> 65536)
+                                            (max-headers::<fixnum> 100))
+   ::(<top> <top> <top> <top>)
+   (let* ([lim::ScmHttpLimits] [method] [target] [version] [headers])
+     (set! (ref lim max_line) max-line-size
+           (ref lim max_header_size) max-header-size
+           (ref lim max_headers) max-headers)
+     (let* ([r (Scm_HttpReadRequestHead port (& lim) (& method) (& target)
+                                        (& version) (& headers))])
+       (if (SCM_EOFP r)
+         (return r SCM_FALSE SCM_FALSE SCM_FALSE)
+         (return method target version headers)))))
+
+ (define-cproc http-read-response-head (port::<input-port>
+                                        :key (max-line-size::<fixnum> 8190)
+                                             (max-header-size::<fixnum> 65536)
+                                             (max-headers::<fixnum> 100))
+   ::(<top> <top> <top> <top>)
+   (let* ([lim::ScmHttpLimits] [version] [status] [reason] [headers])
+     (set! (ref lim max_line) max-line-size
+           (ref lim max_header_size) max-header-size
+           (ref lim max_headers) max-headers)
+     (let* ([r (Scm_HttpReadResponseHead port (& lim) (& version) (& status)
+                                         (& reason) (& headers))])
+       (if (SCM_EOFP r)
+         (return r SCM_FALSE SCM_FALSE SCM_FALSE)
+         (return version status reason headers)))))
+
+ (define-cproc http-read-chunk-size (port::<input-port>
+                                     :key (max-line-size::<fixnum> 8190))
+   (let* ([lim::ScmHttpLimits])
+     (set! (ref lim max_line) max-line-size
+           (ref lim max_header_size) 0
+           (ref lim max_headers) 0)
+     (return (Scm_HttpReadChunkSize port (& lim)))))
+
+ (define-cproc http-read-trailer (port::<input-port>
+                                  :key (max-line-size::<fixnum> 8190)
+                                       (max-header-size::<fixnum> 65536)
+                                       (max-headers::<fixnum> 100))
+   (let* ([lim::ScmHttpLimits])
+     (set! (ref lim max_line) max-line-size
+           (ref lim max_header_size) max-header-size
+           (ref lim max_headers) max-headers)
+     (return (Scm_HttpReadTrailer port (& lim)))))
+ )
@@ -0,0 +1,808 @@
+/*
+ * json.c - JSON reader and writer
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The reader is a pull parser; next_event() returns one event (the
+   beginning or end of a container, an object key, or a scalar value)
+   at a time.  The tree reader builds Scheme objects from the events,
+   keeping the partially constructed containers in its own stack
+   instead of the C stack, so deeply nested input doesn't overflow.
+*/
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include <gauche/priv/portP.h>
+#include "json.h"
+
+static ScmObj json_module = SCM_UNDEFINED;
+static ScmObj parse_error_class = SCM_UNDEFINED; /* <json-parse-error> */
+
+static ScmObj sym_true;
+static ScmObj sym_false;
+static ScmObj sym_null;
+static ScmObj sym_key;
+static ScmObj sym_value;
+static ScmObj sym_begin_array;
+static ScmObj sym_end_array;
+static ScmObj sym_begin_object;
+static ScmObj sym_end_object;
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_JsonEventReaderClass, NULL);
+
+static void input_sync(ScmJsonInput *in);
+
+static void json_error(ScmJsonInput *in, ScmObj objs, const char *fmt, ...)
+{
+    input_sync(in);
+    va_list ap;
+    va_start(ap, fmt);
+    ScmObj msg = Scm_Vsprintf(fmt, ap, TRUE);
+    va_end(ap);
+    SCM_BIND_PROC(parse_error_class, "<json-parse-error>",
+                  SCM_MODULE(json_module));
+    Scm_RaiseCondition(parse_error_class,
+                       "position", Scm_MakeInteger(in->pos),
+                       "objects", objs,
+                       SCM_RAISE_CONDITION_MESSAGE, "%A", msg);
+}
+
+/*================================================================
+ * Input
+ */
+
+static void input_init_port(ScmJsonInput *in, ScmPort *port)
+{
+    in->port = port;
+    in->start = in->cur = in->end = in->last = NULL;
+    in->pos = 0;
+}
+
+static void input_init_string(ScmJsonInput *in, ScmString *str)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    in->port = NULL;
+    in->start = in->cur = in->last = SCM_STRING_BODY_START(b);
+    in->end = in->cur + SCM_STRING_BODY_SIZE(b);
+    in->pos = 0;
+}
+
+/* Port input: tells the port how many bytes we've taken from its buffer,
+   and lets go of the buffer.  Must be called before the port is used
+   by others, e.g. when we return or call back Scheme. */
+static void input_sync(ScmJsonInput *in)
+{
+    if (in->port == NULL) return;
+    if (in->cur > in->start) {
+        u_long nlines = 0;
+        for (const char *p = in->start;
+             (p = memchr(p, '\n', in->cur - p)) != NULL;
+             p++) {
+            nlines++;
+        }
+        Scm__PortInputConsumed(in->port, in->cur - in->start, nlines);
+    }
+    in->start = in->cur = in->end = in->last = NULL;
+}
+
+/* Called when the fast path of json_getc can't read a char: at the
+   end of input, or of the port buffer, or at a multibyte char that
+   straddles the end of the port buffer. */
+static ScmChar json_getc_slow(ScmJsonInput *in)
+{
+    if (in->port == NULL) {
+        if (in->cur >= in->end) return EOF;
+        json_error(in, SCM_FALSE, "incomplete character in input");
+    }
+    input_sync(in);
+    const char *s, *e;
+    if (Scm__PortInputBuffer(in->port, &s, &e) && s < e
+        && s + SCM_CHAR_NFOLLOWS(*s) + 1 <= e) {
+        in->start = in->cur = s;
+        in->end = e;
+        unsigned char b = (unsigned char)*s;
+        ScmChar ch;
+        in->last = in->cur;
+        if (b < 0x80) {
+            ch = b;
+        } else {
+            SCM_CHAR_GET(in->cur, ch);
+        }
+        in->cur += SCM_CHAR_NFOLLOWS(b) + 1;
+        in->pos++;
+        return ch;
+    }
+    /* The buffer is empty, or it isn't directly accessible (e.g.
+       there's an ungotten char).  Getc takes care of it, and may
+       refill the buffer, so that the next call can take it. */
+    ScmChar ch = Scm_GetcUnsafe(in->port);
+    if (ch == EOF) return EOF;
+    in->pos++;
+    return ch;
+}
+
+/* The port is locked by the caller, so we can use its buffer. */
+static inline ScmChar json_getc(ScmJsonInput *in)
+{
+    if (in->cur < in->end) {
+        unsigned char b = (unsigned char)*in->cur;
+        if (b < 0x80) {
+            in->last = in->cur++;
+            in->pos++;
+            return b;
+        }
+        int nfollows = SCM_CHAR_NFOLLOWS(b);
+        if (in->cur + nfollows + 1 <= in->end) {
+            ScmChar ch;
+            in->last = in->cur;
+            SCM_CHAR_GET(in->cur, ch);
+            in->cur += nfollows + 1;
+            in->pos++;
+            return ch;
+        }
+    }
+    return json_getc_slow(in);
+}
+
+static inline void json_ungetc(ScmJsonInput *in, ScmChar ch)
+{
+    if (ch == EOF) return;
+    if (in->last) in->cur = in->last;
+    else          Scm_UngetcUnsafe(ch, in->port);
+    in->last = NULL;
+    in->pos--;
+}
+
+/* Skips whitespaces, and returns the next char (consumed). */
+static inline ScmChar skip_ws(ScmJsonInput *in)
+{
+    for (;;) {
+        ScmChar ch = json_getc(in);
+        if (ch != ' ' && ch != '\n' && ch != '\r' && ch != '\t') return ch;
+    }
+}
+
+/*================================================================
+ * Scalars
+ */
+
+static int hexdigit(ScmChar ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+static int read_hex4(ScmJsonInput *in)
+{
+    int code = 0;
+    for (int i=0; i<4; i++) {
+        ScmChar ch = json_getc(in);
+        int d = hexdigit(ch);
+        if (d < 0) {
+            json_error(in, (ch == EOF)? SCM_EOF : SCM_MAKE_CHAR(ch),
+                       "invalid \\u escape in string");
+        }
+        code = code*16 + d;
+    }
+    return code;
+}
+
+/* We've read a backslash in a string. */
+static void read_escape(ScmJsonInput *in, ScmDString *ds)
+{
+    ScmChar ch = json_getc(in);
+    switch (ch) {
+    case '"': case '\\': case '/': Scm_DStringPutc(ds, ch); break;
+    case 'b': Scm_DStringPutc(ds, 0x08); break;
+    case 'f': Scm_DStringPutc(ds, 0x0c); break;
+    case 'n': Scm_DStringPutc(ds, '\n'); break;
+    case 'r': Scm_DStringPutc(ds, '\r'); break;
+    case 't': Scm_DStringPutc(ds, '\t'); break;
+    case 'u': {
+        int code = read_hex4(in);
+        if (code >= 0xd800 && code <= 0xdbff) {
+            ScmChar c1 = json_getc(in);
+            ScmChar c2 = (c1 == '\\')? json_getc(in) : EOF;
+            int lo = (c2 == 'u')? read_hex4(in) : -1;
+            if (lo < 0xdc00 || lo > 0xdfff) {
+                json_error(in, Scm_MakeInteger(code),
+                           "unpaired surrogate: \\u%04x", code);
+            }
+            code = 0x10000 + ((code - 0xd800) << 10) + (lo - 0xdc00);
+        } else if (code >= 0xdc00 && code <= 0xdfff) {
+            json_error(in, Scm_MakeInteger(code),
+                       "unpaired surrogate: \\u%04x", code);
+        }
+        Scm_DStringPutc(ds, Scm_UcsToChar(code));
+        break;
+    }
+    case EOF:
+        json_error(in, SCM_EOF, "unterminated string");
+        break;
+    default:
+        json_error(in, SCM_MAKE_CHAR(ch), "invalid escape in string: \\%C",
+                   ch);
+    }
+}
+
+/* We've read an opening double quote. */
+static ScmObj read_string(ScmJsonInput *in)
+{
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+
+    for (;;) {
+        {
+            /* Fast path: copy the run of unescaped chars at once. */
+            const char *p = in->cur;
+            ScmSmallInt nchars = 0;
+            while (p < in->end) {
+                unsigned char b = (unsigned char)*p;
+                if (b == '"' || b == '\\') break;
+                if (b < 0x80) {
+                    p++;
+                } else {
+                    int n = SCM_CHAR_NFOLLOWS(b) + 1;
+                    if (p + n > in->end) break;
+                    p += n;
+                }
+                nchars++;
+            }
+            if (p > in->cur) {
+                Scm_DStringPutz(&ds, in->cur, (int)(p - in->cur));
+                in->cur = p;
+                in->pos += nchars;
+            }
+        }
+        ScmChar ch = json_getc(in);
+        if (ch == '"') break;
+        if (ch == '\\') {
+            read_escape(in, &ds);
+        } else if (ch == EOF) {
+            json_error(in, SCM_EOF, "unterminated string");
+        } else {
+            Scm_DStringPutc(&ds, ch);
+        }
+    }
+    return Scm_DStringGet(&ds, 0);
+}
+
+/* Number text is accumulated in a small buffer, which we switch to
+   a DString in case it overflows. */
+#define NUMBUF_SIZE 64
+
+typedef struct numbuf_rec {
+    char buf[NUMBUF_SIZE];
+    int n;
+    ScmDString *ds;
+    ScmDString dsbody;
+} numbuf;
+
+static void numbuf_put(numbuf *nb, ScmChar ch)
+{
+    if (nb->ds) {
+        Scm_DStringPutc(nb->ds, ch);
+    } else if (nb->n < NUMBUF_SIZE) {
+        nb->buf[nb->n++] = (char)ch;
+    } else {
+        nb->ds = &nb->dsbody;
+        Scm_DStringInit(nb->ds);
+        Scm_DStringPutz(nb->ds, nb->buf, nb->n);
+        Scm_DStringPutc(nb->ds, ch);
+    }
+}
+
+#define DIGITP(ch)  ((ch) >= '0' && (ch) <= '9')
+
+/* Max # of digits we can accumulate in a long without overflow. */
+#if SIZEOF_LONG >= 8
+#define FAST_DIGITS 18
+#else
+#define FAST_DIGITS 9
+#endif
+
+/* We've read the first char (a sign or a digit) of a number.
+   Integers without fraction and exponent are read as exact integers;
+   others are inexact.  Short integers are computed on the fly; other
+   numbers are handed to the Scheme number parser. */
+static ScmObj read_number(ScmJsonInput *in, ScmChar ch)
+{
+    numbuf nb;
+    nb.n = 0;
+    nb.ds = NULL;
+    int negative = FALSE, inexact = FALSE, ndigits = 0;
+    long acc = 0;
+
+    if (ch == '-' || ch == '+') {
+        negative = (ch == '-');
+        numbuf_put(&nb, ch);
+        ch = json_getc(in);
+    }
+    if (!DIGITP(ch)) goto bad;
+    do {
+        numbuf_put(&nb, ch);
+        if (ndigits++ < FAST_DIGITS) acc = acc*10 + (ch - '0');
+        ch = json_getc(in);
+    } while (DIGITP(ch));
+
+    if (ch == '.') {
+        inexact = TRUE;
+        numbuf_put(&nb, ch);
+        ch = json_getc(in);
+        if (!DIGITP(ch)) goto bad;
+        do {
+            numbuf_put(&nb, ch);
+            ch = json_getc(in);
+        } while (DIGITP(ch));
+    }
+    if (ch == 'e' || ch == 'E') {
+        inexact = TRUE;
+        numbuf_put(&nb, ch);
+        ch = json_getc(in);
+        if (ch == '-' || ch == '+') {
+            numbuf_put(&nb, ch);
+            ch = json_getc(in);
+        }
+        if (!DIGITP(ch)) goto bad;
+        do {
+            numbuf_put(&nb, ch);
+            ch = json_getc(in);
+        } while (DIGITP(ch));
+    }
+    json_ungetc(in, ch);
+
+    if (!inexact && ndigits <= FAST_DIGITS) {
+        return Scm_MakeInteger(negative? -acc : acc);
+    } else {
+        ScmObj s = (nb.ds
+                    ? Scm_DStringGet(nb.ds, 0)
+                    : Scm_MakeString(nb.buf, nb.n, nb.n, SCM_STRING_COPYING));
+        ScmObj r = Scm_StringToNumber(SCM_STRING(s), 10, 0);
+        if (!SCM_NUMBERP(r)) {
+            json_error(in, s, "invalid number: %S", s);
+        }
+        return r;
+    }
+  bad:
+    json_error(in, (ch == EOF)? SCM_EOF : SCM_MAKE_CHAR(ch),
+               "invalid number");
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+/* We've read the first char of true, false or null. */
+static ScmObj read_special(ScmJsonEventReader *r, ScmChar ch)
+{
+    ScmJsonInput *in = &r->input;
+    const char *name;
+    ScmObj sym;
+    switch (ch) {
+    case 't': name = "true";  sym = sym_true;  break;
+    case 'f': name = "false"; sym = sym_false; break;
+    default:  name = "null";  sym = sym_null;  break;
+    }
+    for (const char *p = name+1; *p; p++) {
+        ch = json_getc(in);
+        if (ch != *p) {
+            json_error(in, (ch == EOF)? SCM_EOF : SCM_MAKE_CHAR(ch),
+                       "invalid literal (%s expected)", name);
+        }
+    }
+    if (SCM_FALSEP(r->handlers.special_handler)) return sym;
+    input_sync(in);
+    return Scm_ApplyRec1(r->handlers.special_handler, sym);
+}
+
+/*================================================================
+ * Event reader
+ */
+
+/* Events */
+enum {
+    EV_EOF,
+    EV_BEGIN_ARRAY,
+    EV_END_ARRAY,
+    EV_BEGIN_OBJECT,
+    EV_END_OBJECT,
+    EV_KEY,
+    EV_VALUE
+};
+
+/* States */
+enum {
+    ST_TOP,                     /* toplevel; a value or EOF */
+    ST_VALUE,                   /* a value is required */
+    ST_FIRST_ELEMENT,           /* after '[' */
+    ST_FIRST_KEY,               /* after '{' */
+    ST_KEY,                     /* after ',' in an object */
+    ST_SEPARATOR                /* after a value in a container */
+};
+
+#define INITIAL_STACK_SIZE 32
+
+static void reader_init(ScmJsonEventReader *r, ScmJsonHandlers *handlers,
+                        char *stack, int stack_size)
+{
+    r->handlers = *handlers;
+    r->state = ST_TOP;
+    r->depth = 0;
+    r->stack = stack;
+    r->stack_size = stack_size;
+}
+
+static int push_container(ScmJsonEventReader *r, char kind)
+{
+    if (r->depth >= r->stack_size) {
+        int newsize = r->stack_size * 2;
+        char *newstack = SCM_NEW_ATOMIC2(char*, newsize);
+        memcpy(newstack, r->stack, r->depth);
+        r->stack = newstack;
+        r->stack_size = newsize;
+    }
+    r->stack[r->depth++] = kind;
+    if (kind == 'a') {
+        r->state = ST_FIRST_ELEMENT;
+        return EV_BEGIN_ARRAY;
+    } else {
+        r->state = ST_FIRST_KEY;
+        return EV_BEGIN_OBJECT;
+    }
+}
+
+static int pop_container(ScmJsonEventReader *r)
+{
+    char kind = r->stack[--r->depth];
+    r->state = (r->depth > 0)? ST_SEPARATOR : ST_TOP;
+    return (kind == 'a')? EV_END_ARRAY : EV_END_OBJECT;
+}
+
+static int read_value(ScmJsonEventReader *r, ScmChar ch, ScmObj *val)
+{
+    switch (ch) {
+    case '[': return push_container(r, 'a');
+    case '{': return push_container(r, 'o');
+    case '"': *val = read_string(&r->input); break;
+    case 't': case 'f': case 'n': *val = read_special(r, ch); break;
+    case '-': case '+':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        *val = read_number(&r->input, ch); break;
+    case EOF:
+        json_error(&r->input, SCM_EOF, "unexpected EOF");
+        break;
+    default:
+        json_error(&r->input, SCM_MAKE_CHAR(ch),
+                   "unexpected character: %C", ch);
+    }
+    r->state = (r->depth > 0)? ST_SEPARATOR : ST_TOP;
+    return EV_VALUE;
+}
+
+/* Returns the next event.  If it is EV_KEY or EV_VALUE, *VAL is set. */
+static int next_event(ScmJsonEventReader *r, ScmObj *val)
+{
+    ScmJsonInput *in = &r->input;
+    for (;;) {
+        ScmChar ch = skip_ws(in);
+        switch (r->state) {
+        case ST_TOP:
+            if (ch == EOF) return EV_EOF;
+            return read_value(r, ch, val);
+        case ST_VALUE:
+            return read_value(r, ch, val);
+        case ST_FIRST_ELEMENT:
+            if (ch == ']') return pop_container(r);
+            return read_value(r, ch, val);
+        case ST_FIRST_KEY:
+            if (ch == '}') return pop_container(r);
+            /* FALLTHROUGH */
+        case ST_KEY:
+            if (ch != '"') {
+                json_error(in, (ch == EOF)? SCM_EOF : SCM_MAKE_CHAR(ch),
+                           "string expected for an object key");
+            }
+            *val = read_string(in);
+            ch = skip_ws(in);
+            if (ch != ':') {
+                json_error(in, (ch == EOF)? SCM_EOF : SCM_MAKE_CHAR(ch),
+                           "':' expected after an object key");
+            }
+            r->state = ST_VALUE;
+            return EV_KEY;
+        case ST_SEPARATOR: {
+            char kind = r->stack[r->depth-1];
+            if (ch == ',') {
+                r->state = (kind == 'a')? ST_VALUE : ST_KEY;
+                continue;
+            }
+            if ((kind == 'a' && ch == ']') || (kind == 'o' && ch == '}')) {
+                return pop_container(r);
+            }
+            json_error(in, (ch == EOF)? SCM_EOF : SCM_MAKE_CHAR(ch),
+                       "',' or '%c' expected", (kind == 'a')? ']' : '}');
+        }
+        }
+    }
+}
+
+/*================================================================
+ * Tree reader
+ */
+
+/* A container being constructed. */
+typedef struct frame_rec {
+    ScmObj head;                /* elements or (key . value) pairs */
+    ScmObj tail;
+    ScmObj key;                 /* pending key in an object, or #f */
+} frame;
+
+#define INITIAL_FRAMES 32
+
+static ScmObj read_tree(ScmJsonEventReader *r)
+{
+    frame frames0[INITIAL_FRAMES];
+    frame *frames = frames0;
+    int nframes = INITIAL_FRAMES, sp = 0;
+    ScmObj val = SCM_UNDEFINED;
+
+    for (;;) {
+        switch (next_event(r, &val)) {
+        case EV_EOF:
+            return SCM_EOF;
+        case EV_BEGIN_ARRAY:
+        case EV_BEGIN_OBJECT:
+            if (sp >= nframes) {
+                frame *newframes = SCM_NEW_ARRAY(frame, nframes*2);
+                memcpy(newframes, frames, sizeof(frame)*nframes);
+                frames = newframes;
+                nframes *= 2;
+            }
+            frames[sp].head = frames[sp].tail = SCM_NIL;
+            frames[sp].key = SCM_FALSE;
+            sp++;
+            continue;
+        case EV_KEY:
+            frames[sp-1].key = val;
+            continue;
+        case EV_END_ARRAY:
+            sp--;
+            if (SCM_FALSEP(r->handlers.array_handler)) {
+                val = Scm_ListToVector(frames[sp].head, 0, -1);
+            } else {
+                input_sync(&r->input);
+                val = Scm_ApplyRec1(r->handlers.array_handler,
+                                    frames[sp].head);
+            }
+            break;
+        case EV_END_OBJECT:
+            sp--;
+            if (SCM_FALSEP(r->handlers.object_handler)) {
+                val = frames[sp].head;
+            } else {
+                input_sync(&r->input);
+                val = Scm_ApplyRec1(r->handlers.object_handler,
+                                    frames[sp].head);
+            }
+            break;
+        case EV_VALUE:
+            break;
+        }
+        /* We've got a complete value. */
+        if (sp == 0) return val;
+        frame *f = &frames[sp-1];
+        if (!SCM_FALSEP(f->key)) {
+            val = Scm_Cons(f->key, val);
+            f->key = SCM_FALSE;
+        }
+        SCM_APPEND1(f->head, f->tail, val);
+    }
+}
+
+/* Read a value and skip trailing whitespaces. */
+static ScmObj read_toplevel(ScmJsonEventReader *r)
+{
+    ScmObj v = read_tree(r);
+    if (!SCM_EOFP(v)) json_ungetc(&r->input, skip_ws(&r->input));
+    return v;
+}
+
+ScmObj Scm_JsonReadPort(ScmPort *port, ScmJsonHandlers *handlers)
+{
+    ScmVM *vm = Scm_VM();
+    ScmJsonEventReader r;
+    char stack[INITIAL_STACK_SIZE];
+    volatile ScmObj v = SCM_UNDEFINED;
+
+    reader_init(&r, handlers, stack, INITIAL_STACK_SIZE);
+    input_init_port(&r.input, port);
+    if (PORT_LOCKED(port, vm)) {
+        SCM_UNWIND_PROTECT {
+            v = read_toplevel(&r);
+        } SCM_WHEN_ERROR {
+            input_sync(&r.input);
+            SCM_NEXT_HANDLER;
+        } SCM_END_PROTECT;
+        input_sync(&r.input);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, v = read_toplevel(&r), input_sync(&r.input));
+        PORT_UNLOCK(port);
+    }
+    return v;
+}
+
+ScmObj Scm_JsonReadString(ScmString *str, ScmJsonHandlers *handlers)
+{
+    ScmJsonEventReader r;
+    char stack[INITIAL_STACK_SIZE];
+
+    reader_init(&r, handlers, stack, INITIAL_STACK_SIZE);
+    input_init_string(&r.input, str);
+    return read_tree(&r);
+}
+
+/*================================================================
+ * Event reader API
+ */
+
+ScmObj Scm_MakeJsonEventReader(ScmPort *port, ScmJsonHandlers *handlers)
+{
+    ScmJsonEventReader *r = SCM_NEW(ScmJsonEventReader);
+    SCM_SET_CLASS(r, SCM_CLASS_JSON_EVENT_READER);
+    reader_init(r, handlers, SCM_NEW_ATOMIC2(char*, INITIAL_STACK_SIZE),
+                INITIAL_STACK_SIZE);
+    input_init_port(&r->input, port);
+    return SCM_OBJ(r);
+}
+
+ScmObj Scm_JsonReadEvent(ScmJsonEventReader *r)
+{
+    ScmVM *vm = Scm_VM();
+    ScmPort *port = r->input.port;
+    ScmObj val = SCM_UNDEFINED;
+    volatile int ev = EV_EOF;
+
+    if (PORT_LOCKED(port, vm)) {
+        SCM_UNWIND_PROTECT {
+            ev = next_event(r, &val);
+        } SCM_WHEN_ERROR {
+            input_sync(&r->input);
+            SCM_NEXT_HANDLER;
+        } SCM_END_PROTECT;
+        input_sync(&r->input);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, ev = next_event(r, &val), input_sync(&r->input));
+        PORT_UNLOCK(port);
+    }
+    switch (ev) {
+    case EV_BEGIN_ARRAY:  return sym_begin_array;
+    case EV_END_ARRAY:    return sym_end_array;
+    case EV_BEGIN_OBJECT: return sym_begin_object;
+    case EV_END_OBJECT:   return sym_end_object;
+    case EV_KEY:          return Scm_Cons(sym_key, val);
+    case EV_VALUE:        return Scm_Cons(sym_value, val);
+    default:              return SCM_EOF;
+    }
+}
+
+/*================================================================
+ * Writer
+ */
+
+/* Non-ASCII chars and control chars are written as \uXXXX, so that
+   the output is safe regardless of the encoding of the receiver. */
+void Scm_JsonWriteString(ScmString *str, ScmPort *port)
+{
+    static const char hexchars[] = "0123456789abcdef";
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    const char *p = SCM_STRING_BODY_START(b);
+    const char *end = p + SCM_STRING_BODY_SIZE(b);
+    char buf[256];
+    int n = 0;
+
+#define HEXESCAPE(code)                                 \
+    do {                                                \
+        buf[n++] = '\\'; buf[n++] = 'u';                \
+        buf[n++] = hexchars[((code) >> 12) & 0xf];      \
+        buf[n++] = hexchars[((code) >> 8) & 0xf];       \
+        buf[n++] = hexchars[((code) >> 4) & 0xf];       \
+        buf[n++] = hexchars[(code) & 0xf];              \
+    } while (0)
+
+    if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
+        Scm_Error("incomplete string can't be written in JSON: %S", str);
+    }
+
+    buf[n++] = '"';
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c < 0x80) {
+            p++;
+            switch (c) {
+            case '"':  buf[n++] = '\\'; buf[n++] = '"';  break;
+            case '\\': buf[n++] = '\\'; buf[n++] = '\\'; break;
+            case 0x08: buf[n++] = '\\'; buf[n++] = 'b';  break;
+            case 0x0c: buf[n++] = '\\'; buf[n++] = 'f';  break;
+            case '\n': buf[n++] = '\\'; buf[n++] = 'n';  break;
+            case '\r': buf[n++] = '\\'; buf[n++] = 'r';  break;
+            case '\t': buf[n++] = '\\'; buf[n++] = 't';  break;
+            default:
+                if (c < 0x20 || c == 0x7f) HEXESCAPE(c);
+                else buf[n++] = (char)c;
+            }
+        } else {
+            ScmChar ch;
+            SCM_CHAR_GET(p, ch);
+            p += SCM_CHAR_NFOLLOWS(c) + 1;
+            int ucs = Scm_CharToUcs(ch);
+            if (ucs < 0) {
+                Scm_Error("character can't be represented in JSON: %C", ch);
+            }
+            if (ucs >= 0x10000) {
+                ucs -= 0x10000;
+                HEXESCAPE(0xd800 + (ucs >> 10));
+                HEXESCAPE(0xdc00 + (ucs & 0x3ff));
+            } else {
+                HEXESCAPE(ucs);
+            }
+        }
+        /* Each iteration adds at most 12 bytes. */
+        if (n > (int)sizeof(buf) - 12) {
+            Scm_Putz(buf, n, port);
+            n = 0;
+        }
+    }
+    buf[n++] = '"';
+    Scm_Putz(buf, n, port);
+#undef HEXESCAPE
+}
+
+/*================================================================
+ * Initialization
+ */
+
+void Scm_Init_json(ScmModule *mod)
+{
+    json_module = SCM_OBJ(mod);
+    Scm_InitStaticClass(&Scm_JsonEventReaderClass, "<json-event-reader>",
+                        mod, NULL, 0);
+    sym_true  = SCM_INTERN("true");
+    sym_false = SCM_INTERN("false");
+    sym_null  = SCM_INTERN("null");
+    sym_key   = SCM_INTERN("key");
+    sym_value = SCM_INTERN("value");
+    sym_begin_array  = SCM_INTERN("begin-array");
+    sym_end_array    = SCM_INTERN("end-array");
+    sym_begin_object = SCM_INTERN("begin-object");
+    sym_end_object   = SCM_INTERN("end-object");
+}
@@ -0,0 +1,104 @@
+/*
+ * json.h - JSON reader and writer
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_JSON_H
+#define GAUCHE_RFC_JSON_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTRFC_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/* The input source.  We read directly from the body of a string, or
+   from the buffer of a port.  In the latter case, [cur, end) is the
+   part of the port's buffer we're reading, and the bytes since START
+   are consumed but not yet reported to the port.  The port's own
+   getc is used only when the buffer isn't directly accessible. */
+typedef struct ScmJsonInputRec {
+    ScmPort *port;              /* input port, or NULL for string input */
+    const char *start;          /* port input: beginning of unsynced bytes */
+    const char *cur;            /* current position */
+    const char *end;            /* end of input (or of the port buffer) */
+    const char *last;           /* the last char read, or NULL if it's
+                                   read by the port's getc */
+    ScmSmallInt pos;            /* # of chars consumed so far */
+} ScmJsonInput;
+
+/* Procedures to construct Scheme objects.  #f means the default
+   behavior (list->vector for arrays, identity for objects and
+   specials), which we handle without calling back Scheme. */
+typedef struct ScmJsonHandlersRec {
+    ScmObj array_handler;
+    ScmObj object_handler;
+    ScmObj special_handler;
+} ScmJsonHandlers;
+
+/* Event (pull) reader.  Instead of recursion, we keep the nesting
+   of containers in STACK, so that the caller can pull one event at
+   a time, and there's no limit of nesting other than the memory. */
+typedef struct ScmJsonEventReaderRec {
+    SCM_HEADER;
+    ScmJsonInput input;
+    ScmJsonHandlers handlers;
+    int state;                  /* what we expect next */
+    int depth;                  /* current nesting level */
+    int stack_size;             /* allocated size of stack */
+    char *stack;                /* 'a' for array, 'o' for object */
+} ScmJsonEventReader;
+
+SCM_CLASS_DECL(Scm_JsonEventReaderClass);
+#define SCM_CLASS_JSON_EVENT_READER   (&Scm_JsonEventReaderClass)
+#define SCM_JSON_EVENT_READER(obj)    ((ScmJsonEventReader*)(obj))
+#define SCM_JSON_EVENT_READER_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_JSON_EVENT_READER)
+
+extern void   Scm_Init_json(ScmModule *mod);
+
+/* Reads one JSON value and following whitespaces.  Returns EOF if
+   the input is exhausted before any value. */
+extern ScmObj Scm_JsonReadPort(ScmPort *port, ScmJsonHandlers *handlers);
+extern ScmObj Scm_JsonReadString(ScmString *str, ScmJsonHandlers *handlers);
+
+/* Event reader.  Scm_JsonReadEvent returns one of the symbols
+   begin-array, end-array, begin-object, end-object, a pair
+   (key . <string>) or (value . <obj>), or EOF at the end of input. */
+extern ScmObj Scm_MakeJsonEventReader(ScmPort *port,
+                                      ScmJsonHandlers *handlers);
+extern ScmObj Scm_JsonReadEvent(ScmJsonEventReader *reader);
+
+/* Writes a Scheme string as a JSON string literal. */
+extern void   Scm_JsonWriteString(ScmString *str, ScmPort *port);
+
+#endif /* GAUCHE_RFC_JSON_H */
@@ -33,19 +33,20 @@
 
 ;;; http://www.ietf.org/rfc/rfc7159.txt
 
-;; NOTE: This module depends on parser.peg, whose API is not officially
+;; The reader and the string writer are implemented in C (json.c).
+;; The parser.peg-based parser json-parser is kept for the backward
+;; compatibility, and for the ones who want to combine it with other
+;; parsers.
+
+;; NOTE: json-parser depends on parser.peg, whose API is not officially
 ;; fixed.  Hence do not take this code as an example of parser.peg;
 ;; this will likely to be rewritten once parser.peg's API is changed.
 
 (define-module rfc.json
   (use gauche.parameter)
   (use gauche.sequence)
-  (use gauche.generator)
   (use parser.peg)
   (use gauche.unicode)
-  (use srfi-13)
-  (use srfi-14)
-  (use srfi-43)
   (export <json-parse-error> <json-construct-error>
           parse-json parse-json-string
           parse-json*
@@ -53,6 +54,8 @@
 
           json-array-handler json-object-handler json-special-handler
 
+          json-event-generator
+
           json-parser                   ;experimental
           ))
 (select-module rfc.json)
@@ -74,9 +77,88 @@
 (define (build-object pairs) ((json-object-handler) pairs))
 (define (build-special symbol) ((json-special-handler) symbol))
 
+(inline-stub
+ "#include \"json.h\""
+
+ (initcode "Scm_Init_json(Scm_CurrentModule());")
+
+ (define-type <json-event-reader> "ScmJsonEventReader*" "json event reader"
+   "SCM_JSON_EVENT_READER_P" "SCM_JSON_EVENT_READER")
+
+ ;; Handlers are #f when the default behavior is wanted, so that
+ ;; the C reader can skip calling back Scheme.
+ (define-cproc %parse-json (port::<input-port> array-handler object-handler
+                            special-handler)
+   (let* ([h::ScmJsonHandlers])
+     (set! (ref h array_handler) array-handler
+           (ref h object_handler) object-handler
+           (ref h special_handler) special-handler)
+     (return (Scm_JsonReadPort port (& h)))))
+
+ (define-cproc %parse-json-string (str::<string> array-handler object-handler
+                                   special-handler)
+   (let* ([h::ScmJsonHandlers])
+     (set! (ref h array_handler) array-handler
+           (ref h object_handler) object-handler
+           (ref h special_handler) special-handler)
+     (return (Scm_JsonReadString str (& h)))))
+
+ (define-cproc %make-json-event-reader (port::<input-port> special-handler)
+   (let* ([h::ScmJsonHandlers])
+     (set! (ref h array_handler) SCM_FALSE
+           (ref h object_handler) SCM_FALSE
+           (ref h special_handler) special-handler)
+     (return (Scm_MakeJsonEventReader port (& h)))))
+
+ (define-cproc %json-read-event (reader::<json-event-reader>)
+   Scm_JsonReadEvent)
+
+ (define-cproc %json-write-string (str::<string> port::<output-port>)
+   ::<void> Scm_JsonWriteString)
+ )
+
+(define (%handler param default)
+  (let1 p (param) (if (eq? p default) #f p)))
+
+(define (%handlers)
+  (values (%handler json-array-handler list->vector)
+          (%handler json-object-handler identity)
+          (%handler json-special-handler identity)))
+
 ;;;============================================================
 ;;; Parser
 ;;;
+
+;; entry point
+(define (parse-json :optional (port (current-input-port)))
+  (receive (a o s) (%handlers)
+    (%parse-json port a o s)))
+
+(define (parse-json-string str)
+  (receive (a o s) (%handlers)
+    (%parse-json-string str a o s)))
+
+(define (parse-json* :optional (port (current-input-port)))
+  (receive (a o s) (%handlers)
+    (let loop ([r '()])
+      (let1 v (%parse-json port a o s)
+        (if (eof-object? v)
+          (reverse! r)
+          (loop (cons v r)))))))
+
+;; Event (pull) parser.  Returns a generator that yields one of
+;; begin-array, end-array, begin-object, end-object, (key . <string>)
+;; or (value . <scalar>) for each call, and EOF at the end of input.
+;; Unlike parse-json, it doesn't construct the whole tree, so it can
+;; be used for huge input.
+(define (json-event-generator :optional (port (current-input-port)))
+  (let1 r (%make-json-event-reader port
+                                   (%handler json-special-handler identity))
+    (^[] (%json-read-event r))))
+
+;;;============================================================
+;;; Parser combinators
+;;;
 (define %ws ($skip-many ($one-of #[ \t\r\n])))
 
 (define %begin-array     ($seq ($char #\[) %ws))
@@ -177,101 +259,66 @@
 
 (define json-parser ($seq %ws ($or eof %value)))
 
-;; entry point
-(define (parse-json :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (peg-parse-port json-parser port)))
-
-(define (parse-json-string str)
-  (call-with-input-string str (cut parse-json <>)))
-
-(define (parse-json* :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (generator->list (peg-parser->generator json-parser port))))
-
 ;;;============================================================
 ;;; Writer
 ;;;
 
-(define (print-value obj)
-  (cond [(or (eq? obj 'false) (eq? obj #f)) (display "false")]
-        [(or (eq? obj 'true) (eq? obj #t))  (display "true")]
-        [(eq? obj 'null)  (display "null")]
-        [(list? obj)      (print-object obj)]
-        [(string? obj)    (print-string obj)]
-        [(number? obj)    (print-number obj)]
-        [(is-a? obj <dictionary>) (print-object obj)]
-        [(is-a? obj <sequence>)   (print-array obj)]
+(define (print-value obj port)
+  (cond [(or (eq? obj 'false) (eq? obj #f)) (write-string "false" port)]
+        [(or (eq? obj 'true) (eq? obj #t))  (write-string "true" port)]
+        [(eq? obj 'null)  (write-string "null" port)]
+        [(list? obj)      (print-object obj port)]
+        [(string? obj)    (print-string obj port)]
+        [(number? obj)    (print-number obj port)]
+        [(is-a? obj <dictionary>) (print-object obj port)]
+        [(is-a? obj <sequence>)   (print-array obj port)]
         [else (error <json-construct-error> :object obj
                      "can't convert Scheme object to json:" obj)]))
 
-(define (print-object obj)
-  (display "{")
+(define (print-object obj port)
+  (write-char #\{ port)
   (fold (^[attr comma]
           (unless (pair? attr)
             (error <json-construct-error> :object obj
                    "construct-json needs an assoc list or dictionary, \
                     but got:" obj))
-          (display comma)
-          (print-string (x->string (car attr)))
-          (display ":")
-          (print-value (cdr attr))
-          ",")
-        "" obj)
-  (display "}"))
-
-(define (print-array obj)
-  (display "[")
+          (when comma (write-char #\, port))
+          (print-string (x->string (car attr)) port)
+          (write-char #\: port)
+          (print-value (cdr attr) port)
+          #t)
+        #f obj)
+  (write-char #\} port))
+
+(define (print-array obj port)
+  (write-char #\[ port)
   (for-each-with-index (^[i val]
-                         (unless (zero? i) (display ","))
-                         (print-value val))
+                         (unless (zero? i) (write-char #\, port))
+                         (print-value val port))
                        obj)
-  (display "]"))
+  (write-char #\] port))
 
-(define (print-number num)
-  (cond [(or (not (real? num)) (not (finite? num)))
+(define (print-number num port)
+  (cond [(fixnum? num) (write num port)]
+        [(or (not (real? num)) (not (finite? num)))
          (error <json-construct-error> :object num
                 "json cannot represent a number" num)]
         [(and (rational? num) (not (integer? num)))
-         (write (exact->inexact num))]
-        [else (write num)]))
-
-(define (print-string str)
-  (define specials
-    '((#\" . #\") (#\\ . #\\) (#\x08 . #\b) (#\page . #\f)
-      (#\newline . #\n) (#\return . #\r) (#\tab . #\t)))
-  (define (hexescape code) (format #t "\\u~4,'0x" code))
-  (define (print-char c)
-    (cond [(assv c specials) => (^p (write-char #\\) (write-char (cdr p)))]
-          [(and (char-set-contains? char-set:ascii c)
-                (not (eq? (char-general-category c) 'Cc)))
-           (write-char c)]
-          [else
-           (let1 code (char->ucs c)
-             (if (>= code #x10000)
-               (for-each hexescape (ucs4->utf16 code))
-               (hexescape code)))]))
-  (display "\"")
-  (string-for-each print-char str)
-  (display "\""))
+         (write (exact->inexact num) port)]
+        [else (write num port)]))
+
+(define (print-string str port)
+  (when (string-incomplete? str)
+    (error <json-construct-error> :object str
+           "json cannot represent an incomplete string" str))
+  (%json-write-string str port))
 
 (define (construct-json x :optional (oport (current-output-port)))
-  (with-output-to-port oport
-    (^()
-      (cond [(or (list? x) (is-a? x <dictionary>)) (print-object x)]
-            [(and (is-a? x <sequence>) (not (string? x))) (print-array x)]
-            [else (error <json-construct-error> :object x
-                         "construct-json expects a list or a vector, \
-                          but got" x)]))))
+  (cond [(or (list? x) (is-a? x <dictionary>)) (print-object x oport)]
+        [(and (is-a? x <sequence>) (not (string? x))) (print-array x oport)]
+        [else (error <json-construct-error> :object x
+                     "construct-json expects a list or a vector, \
+                      but got" x)]))
 
 (define (construct-json-string x)
   (call-with-output-string (cut construct-json x <>)))
-
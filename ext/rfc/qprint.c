@@ -0,0 +1,306 @@
+/*
+ * qprint.c - Quoted-printable codec
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Ref: RFC2045 section 6.7  <http://www.rfc-editor.org/rfc/rfc2045.txt> */
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "qprint.h"
+
+#define CHUNK_SIZE  4096
+
+/* Characters that can be passed through as is.  We escape '?' as well,
+   for it interferes the header field encoding defined in RFC2047. */
+#define QP_LITERAL_P(c) \
+    (((c) > 0x20 && (c) < 0x3d) || (c) == 0x3e || ((c) > 0x3f && (c) < 0x7f))
+
+static const char hexdigits[] = "0123456789ABCDEF";
+
+static inline int hexval(unsigned char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/*================================================================
+ * Encoder
+ */
+
+typedef struct qp_encoder_rec {
+    ScmSmallInt limit;          /* max # of chars before a soft line break,
+                                   or -1 not to break lines */
+    int binary;                 /* TRUE to encode CR and LF as well */
+    ScmSmallInt lcnt;           /* # of chars in the current output line */
+} qp_encoder;
+
+static void qp_encoder_init(qp_encoder *e, int line_width, int binary)
+{
+    /* One encoded octet and a soft line break require 4 chars */
+    e->limit = (line_width >= 4)? line_width - 3 : -1;
+    e->binary = binary;
+    e->lcnt = 0;
+}
+
+/* Encode LEN bytes from S into DS.  Returns # of bytes consumed, which
+   is less than LEN only if S ends with CR and EOF is FALSE; we need to
+   see the next byte to tell if it's CRLF. */
+static ScmSmallInt qp_encode(qp_encoder *e, const unsigned char *s,
+                             ScmSmallInt len, int eof, ScmDString *ds)
+{
+    ScmSmallInt limit = e->limit;
+    ScmSmallInt lcnt = e->lcnt;
+    const unsigned char *start = s;
+    const unsigned char *end = s + len;
+
+    while (s < end) {
+        unsigned char c = *s;
+        if (limit >= 0 && lcnt >= limit) {
+            Scm_DStringPutz(ds, "=\r\n", 3);
+            lcnt = 0;
+            continue;
+        }
+        if (e->binary && (c == 0x0a || c == 0x0d)) {
+            Scm_DStringPutz(ds, (c == 0x0a)? "=0A" : "=0D", 3);
+            lcnt++;
+            s++;
+        } else if (c == 0x0d) {
+            if (s+1 == end && !eof) break;
+            s++;
+            if (s < end && *s == 0x0a) s++;
+            Scm_DStringPutz(ds, "\r\n", 2);
+            lcnt = 0;
+        } else if (c == 0x0a) {
+            s++;
+            Scm_DStringPutz(ds, "\r\n", 2);
+            lcnt = 0;
+        } else if (QP_LITERAL_P(c)) {
+            /* pass through the run of literal chars that fits the line */
+            const unsigned char *p = s + 1;
+            while (p < end && QP_LITERAL_P(*p)
+                   && (limit < 0 || lcnt + (p - s) < limit)) {
+                p++;
+            }
+            Scm_DStringPutz(ds, (const char*)s, p - s);
+            lcnt += p - s;
+            s = p;
+        } else {
+            char buf[3];
+            buf[0] = '=';
+            buf[1] = hexdigits[c >> 4];
+            buf[2] = hexdigits[c & 0x0f];
+            Scm_DStringPutz(ds, buf, 3);
+            lcnt += 3;
+            s++;
+        }
+    }
+    e->lcnt = lcnt;
+    return s - start;
+}
+
+/*================================================================
+ * Decoder
+ */
+
+/* Decode LEN bytes from S into DS.  Returns # of bytes consumed.
+   Unless EOF is TRUE, we stop before an escape sequence that may
+   continue beyond S+LEN; the caller should pass it again with the
+   following input. */
+static ScmSmallInt qp_decode(const unsigned char *s, ScmSmallInt len,
+                             int eof, ScmDString *ds)
+{
+    const unsigned char *start = s;
+    const unsigned char *end = s + len;
+
+    while (s < end) {
+        const unsigned char *eq = memchr(s, '=', end - s);
+        if (eq == NULL) {
+            Scm_DStringPutz(ds, (const char*)s, end - s);
+            s = end;
+            break;
+        }
+        if (eq > s) Scm_DStringPutz(ds, (const char*)s, eq - s);
+        s = eq + 1;
+        /* '=' at the end is illegal, but we recognize it as
+           a soft newline */
+        if (s >= end) {
+            if (!eof) s = eq;
+            break;
+        }
+
+        unsigned char c1 = *s++;
+        if (c1 == '\n') continue;                   /* soft newline */
+        if (c1 == '\r') {                           /* soft newline */
+            if (s >= end && !eof) { s = eq; break; }
+            if (s < end && *s == '\n') s++;
+            continue;
+        }
+        if (c1 == ' ' || c1 == '\t') {              /* possibly soft newline */
+            const unsigned char *p = s;
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+            if (p >= end || (*p == '\r' && p+1 == end && !eof)) {
+                if (!eof) s = eq;
+                else      s = end;
+                break;
+            }
+            if (*p == '\n') { s = p + 1; continue; }
+            if (*p == '\r') {
+                s = p + 1;
+                if (s < end && *s == '\n') s++;
+                continue;
+            }
+            Scm_DStringPutc(ds, '=');
+            Scm_DStringPutz(ds, (const char*)s - 1, p - s + 1);
+            s = p;
+            continue;
+        }
+        int hi = hexval(c1);
+        if (hi >= 0) {
+            if (s >= end && !eof) { s = eq; break; }
+            int lo = (s < end)? hexval(*s) : -1;
+            if (lo >= 0) {
+                Scm_DStringPutb(ds, (char)(hi*16 + lo));
+                s++;
+            } else {
+                Scm_DStringPutc(ds, '=');
+                Scm_DStringPutb(ds, (char)c1);
+            }
+            continue;
+        }
+        /* Not an escape sequence.  Emit '=' and rescan from c1. */
+        Scm_DStringPutc(ds, '=');
+        s--;
+    }
+    return s - start;
+}
+
+/*================================================================
+ * Entry points
+ */
+
+ScmObj Scm_QuotedPrintableEncodeBytes(const unsigned char *src,
+                                      ScmSmallInt len,
+                                      int line_width, int binary)
+{
+    ScmDString ds;
+    qp_encoder e;
+    Scm_DStringInit(&ds);
+    qp_encoder_init(&e, line_width, binary);
+    qp_encode(&e, src, len, TRUE, &ds);
+    return Scm_DStringGet(&ds, 0);
+}
+
+ScmObj Scm_QuotedPrintableDecodeBytes(const char *src, ScmSmallInt len)
+{
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    qp_decode((const unsigned char*)src, len, TRUE, &ds);
+    return Scm_DStringGet(&ds, 0);
+}
+
+/* Read up to LEN bytes from IPORT.  Returns the # of bytes read, which is
+   less than LEN only at EOF. */
+static ScmSmallInt read_chunk(ScmPort *iport, char *buf, ScmSmallInt len)
+{
+    ScmSmallInt nread = 0;
+    while (nread < len) {
+        int r = Scm_Getz(buf+nread, (int)(len-nread), iport);
+        if (r <= 0) break;
+        nread += r;
+    }
+    return nread;
+}
+
+/* Write out the content of DS and empty it. */
+static void flush_dstring(ScmDString *ds, ScmPort *oport)
+{
+    int siz;
+    const char *s = Scm_DStringPeek(ds, &siz, NULL);
+    if (siz > 0) Scm_Putz(s, siz, oport);
+    Scm_DStringTruncate(ds, 0);
+}
+
+/* The port versions work on a buffer of CHUNK_SIZE bytes.  The bytes
+   the codec can't process without further input (an incomplete escape
+   sequence or CR) are carried over to the beginning of the buffer. */
+
+void Scm_QuotedPrintableEncodePort(ScmPort *iport, ScmPort *oport,
+                                   int line_width, int binary)
+{
+    char buf[CHUNK_SIZE];
+    ScmSmallInt len = 0;
+    ScmDString ds;
+    qp_encoder e;
+    Scm_DStringInit(&ds);
+    qp_encoder_init(&e, line_width, binary);
+
+    for (;;) {
+        ScmSmallInt n = read_chunk(iport, buf+len, CHUNK_SIZE-len);
+        int eof = (n < CHUNK_SIZE-len);
+        len += n;
+        ScmSmallInt m = qp_encode(&e, (unsigned char*)buf, len, eof, &ds);
+        flush_dstring(&ds, oport);
+        if (eof) break;
+        memmove(buf, buf+m, len-m);
+        len -= m;
+    }
+}
+
+void Scm_QuotedPrintableDecodePort(ScmPort *iport, ScmPort *oport)
+{
+    char buf[CHUNK_SIZE];
+    ScmSmallInt len = 0;
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+
+    for (;;) {
+        ScmSmallInt n = read_chunk(iport, buf+len, CHUNK_SIZE-len);
+        int eof = (n < CHUNK_SIZE-len);
+        len += n;
+        ScmSmallInt m = qp_decode((unsigned char*)buf, len, eof, &ds);
+        flush_dstring(&ds, oport);
+        if (eof) break;
+        if (m == 0 && len == CHUNK_SIZE) {
+            /* The buffer is '=' followed by whitespaces, possibly
+               ending with CR.  Such a long run can only be a transport
+               padding, so we drop it and keep looking for the end of
+               line. */
+            if (buf[len-1] == '\r') buf[1] = '\r', len = 2;
+            else len = 1;
+            continue;
+        }
+        memmove(buf, buf+m, len-m);
+        len -= m;
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * qprint.h - Quoted-printable codec
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_QPRINT_H
+#define GAUCHE_RFC_QPRINT_H
+
+#include <gauche.h>
+
+/* Encoding from/to memory.  Results are returned as strings.
+   LINE_WIDTH less than 4 suppresses soft line breaks.  If BINARY is true,
+   CR and LF are encoded as well. */
+extern ScmObj Scm_QuotedPrintableEncodeBytes(const unsigned char *src,
+                                             ScmSmallInt len,
+                                             int line_width, int binary);
+extern ScmObj Scm_QuotedPrintableDecodeBytes(const char *src,
+                                             ScmSmallInt len);
+
+/* Encoding from/to ports.  Input is consumed until EOF. */
+extern void   Scm_QuotedPrintableEncodePort(ScmPort *iport, ScmPort *oport,
+                                            int line_width, int binary);
+extern void   Scm_QuotedPrintableDecodePort(ScmPort *iport, ScmPort *oport);
+
+#endif /* GAUCHE_RFC_QPRINT_H */
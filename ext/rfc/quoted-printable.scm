@@ -0,0 +1,84 @@
+;;;
+;;; quoted-printable.scm - quoted-printable encoding/decoding routine
+;;;
+;;;   Copyright (c) 2000-2018  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;; Ref: RFC2045 section 6.7  <http://www.rfc-editor.org/rfc/rfc2045.txt>
+
+;; The actual codec is in qprint.c.
+
+(define-module rfc.quoted-printable
+  (export quoted-printable-encode quoted-printable-encode-string
+          quoted-printable-decode quoted-printable-decode-string)
+  )
+(select-module rfc.quoted-printable)
+
+(inline-stub
+ "#include \"qprint.h\""
+
+ (define-cproc %qp-encode (iport::<input-port> oport::<output-port>
+                           line-width::<int> binary::<boolean>)
+   ::<void> Scm_QuotedPrintableEncodePort)
+
+ (define-cproc %qp-decode (iport::<input-port> oport::<output-port>)
+   ::<void> Scm_QuotedPrintableDecodePort)
+
+ (define-cproc %qp-encode-string (string::<string> line-width::<int>
+                                  binary::<boolean>)
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY string)])
+     (return (Scm_QuotedPrintableEncodeBytes
+              (cast (const unsigned char*) (SCM_STRING_BODY_START b))
+              (SCM_STRING_BODY_SIZE b)
+              line-width binary))))
+
+ (define-cproc %qp-decode-string (string::<string>)
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY string)])
+     (return (Scm_QuotedPrintableDecodeBytes (SCM_STRING_BODY_START b)
+                                             (SCM_STRING_BODY_SIZE b)))))
+ )
+
+;; The minimum line width is 4, since one encoded octed and one soft
+;; line break requires 4 characters.  Line-width #f (or less than 4)
+;; suppresses soft line breaks.
+;; If binary is #f, we encode CR and LF.  See RFC2045 for this consideration.
+(define (quoted-printable-encode :key (line-width 76) (binary #f))
+  (%qp-encode (current-input-port) (current-output-port)
+              (or line-width 0) binary))
+
+(define (quoted-printable-encode-string string :key (line-width 76) (binary #f))
+  (%qp-encode-string string (or line-width 0) binary))
+
+(define (quoted-printable-decode)
+  (%qp-decode (current-input-port) (current-output-port)))
+
+(define (quoted-printable-decode-string string)
+  (%qp-decode-string string))
@@ -452,4 +452,336 @@ Content-Length: 4349
                      
 (dotimes (n 8) (mime-roundtrip-tester n))
     
+;;--------------------------------------------------------------------
+(test-section "rfc.json")
+(use rfc.json)
+(use gauche.generator)
+(use parser.peg)
+(test-module 'rfc.json)
+
+(let ()
+  (define (t str val)
+    (test* "primitive" `(("x" . ,val)) (parse-json-string str)))
+  (t "{\"x\": 100 }" 100)
+  (t "{\"x\" : -100}" -100)
+  (t "{\"x\":  +100 }" 100)
+  (t "{\"x\": 12.5} " 12.5)
+  (t "{\"x\":-12.5}" -12.5)
+  (t "{\"x\":+12.5}"  12.5)
+  (t "{\"x\": 1.25e1 }" 12.5)
+  (t "{\"x\":125e-1}" 12.5)
+  (t "{\"x\":1250.0e-2}" 12.5)
+  (t "{\"x\":  false  }" 'false)
+  (t "{\"x\":true}" 'true)
+  (t "{\"x\":null}" 'null)
+  (t "{\"x\": \"abc\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0040abc\"}"
+     "abc\"\\/\u0008\u000c\u000a\u000d\u0009@abc")
+  )
+
+(let ()
+  (define (t str)
+    (test* #"parse error ~str" (test-error <json-parse-error>)
+           (parse-json-string str)))
+  (t "{\"x\": 100")
+  (t "{x : 100}}")
+  )
+
+(test* "parsing an object"
+       '(("Image"
+          ("Width"  . 800)
+          ("Height" . 600)
+          ("Title"  . "View from 15th Floor")
+          ("Thumbnail"
+           ("Url"    . "http://www.example.com/image/481989943")
+           ("Height" . 125)
+           ("Width"  . "100"))
+          ("IDs" . #(116 943 234 38793))))
+       (parse-json-string "{
+   \"Image\": {
+       \"Width\":  800,
+       \"Height\": 600,
+       \"Title\":  \"View from 15th Floor\",
+       \"Thumbnail\": {
+           \"Url\":    \"http://www.example.com/image/481989943\",
+           \"Height\": 125,
+           \"Width\":  \"100\"
+       },
+       \"IDs\": [116, 943, 234, 38793]
+     }
+}"))
+
+(test* "parsing an array containing two objects"
+       '#((("precision" . "zip")
+           ("Latitude"  . 37.7668)
+           ("Longitude" . -122.3959)
+           ("Address"   . "")
+           ("City"      . "SAN FRANCISCO")
+           ("State"     . "CA")
+           ("Zip"       . "94107")
+           ("Country"   . "US"))
+          (("precision" . "zip")
+           ("Latitude"  . 37.371991)
+           ("Longitude" . -122.026020)
+           ("Address"   . "")
+           ("City"      . "SUNNYVALE")
+           ("State"     . "CA")
+           ("Zip"       . "94085")
+           ("Country"   . "US")))
+       (parse-json-string "[
+   {
+      \"precision\": \"zip\",
+      \"Latitude\":  37.7668,
+      \"Longitude\": -122.3959,
+      \"Address\":   \"\",
+      \"City\":      \"SAN FRANCISCO\",
+      \"State\":     \"CA\",
+      \"Zip\":       \"94107\",
+      \"Country\":   \"US\"
+   },
+   {
+      \"precision\": \"zip\",
+      \"Latitude\":  37.371991,
+      \"Longitude\": -122.026020,
+      \"Address\":   \"\",
+      \"City\":      \"SUNNYVALE\",
+      \"State\":     \"CA\",
+      \"Zip\":       \"94085\",
+      \"Country\":   \"US\"
+   }
+]"))
+
+(test* "Parsing sequence of json objects"
+       '((("a" . 1)("b" . 2)) (("c" . 3) ("d" . 4)))
+       (with-input-from-string "{\"a\":1, \"b\":2}{\"c\":3, \"d\":4}"
+         parse-json*))
+
+(test* "Customizing consturctors"
+       '(object ("x" array 1 2 3) ("y" array #f #t null))
+       (parameterize ([json-array-handler (^[elts] (cons 'array elts))]
+                      [json-object-handler (^[pairs] (cons 'object pairs))]
+                      [json-special-handler (^y (case y
+                                                  [(false) #f]
+                                                  [(true) #t]
+                                                  [(null) 'null]))])
+         (parse-json-string "{\"x\":[1,2,3],\"y\":[false,true,null]}")))
+
+(let ()
+  (define (test-writer name obj)
+    (test* name obj
+           (parse-json-string (construct-json-string obj))))
+
+  (test-writer "writing an object"
+               '(("Image"
+                  ("Width"  . 800)
+                  ("Height" . 600)
+                  ("Title"  . "View from 15th Floor \"magnificent\"")
+                  ("Thumbnail"
+                   ("Url"    . "http://www.example.com/image/481989943")
+                   ("Height" . 125)
+                   ("Width"  . "100"))
+                  ("Description" . "Foo\nbackslash \\and tab\t and \u00a1")
+                  ("IDs" . #(116 943 234 38793))
+                  ("Misc" . ()))))
+
+  (test-writer "writing an array containing two objects"
+               '#((("precision" . "zip")
+                   ("Latitude"  . 37.7668)
+                   ("Longitude" . -122.3959)
+                   ("Address"   . "")
+                   ("City"      . "SAN FRANCISCO")
+                   ("State"     . "CA")
+                   ("Zip"       . "94107")
+                   ("Country"   . "US"))
+                  (("precision" . "zip")
+                   ("Latitude"  . 37.371991)
+                   ("Longitude" . -122.026020)
+                   ("Address"   . "")
+                   ("City"      . "SUNNYVALE")
+                   ("State"     . "CA")
+                   ("Zip"       . "94085")
+                   ("Country"   . "US"))))
+  )
+
+(cond-expand
+ [gauche.ces.utf8
+  (let1 data `(("[\"\\u03bb\"]" #("\x3bb;"))
+               ("[\"\\ud800\"]" ,(test-error <json-parse-error>))
+               ("[\"\\ud867\\ude3d\\u03bb\"]" #("\x29e3d;\x3bb;"))
+               ("[\"\\ude3d\\ud867\"]" ,(test-error <json-parse-error>))
+               ("[\"\\uf020\\u03bb\"]"  #("\xf020;\x3bb;")))
+    (dolist [d data]
+      (test* (format "unicode escape reading (~s)" (car d))
+             (cadr d)
+             (parse-json-string (car d)))
+      (when (vector? (cadr data))
+        (test* (format "unicode escape writing (~s)" (cadr d))
+               (car d)
+               (construct-json-string (cadr d))))))]
+ [else])
+
+(let ()
+  (define (t obj)
+    (test* #"writer error ~obj" (test-error <json-construct-error>)
+           (construct-json-string obj)))
+  (t "a")
+  (t '#(1 2 x))
+  (t '(("a" . 2) 9)))
+
+(test* "generalized array" "[1,2,3]"
+       (construct-json-string '#u8(1 2 3)))
+(test* "generalized object" (test-one-of "{\"a\":1,\"b\":2}"
+                                         "{\"b\":2,\"a\":1}")
+       (construct-json-string (hash-table 'eq? '(a . 1) '(b . 2))))
+
+(test* "big numbers" '#(12345678901234567890 -98765432109876543210 1.0e300)
+       (parse-json-string "[12345678901234567890,-98765432109876543210,1e300]"))
+
+(test* "deep nesting" 10000
+       (let loop ([v (parse-json-string
+                      (string-append (make-string 10000 #\[)
+                                     (make-string 10000 #\])))]
+                  [n 0])
+         (if (and (vector? v) (= (vector-length v) 1))
+           (loop (vector-ref v 0) (+ n 1))
+           (+ n 1))))
+
+(test* "reading from port leaves the rest"
+       '(#(1 2) "rest")
+       (call-with-input-string "[1, 2]  rest"
+         (^p (let1 v (parse-json p) (list v (read-line p))))))
+
+;; unicode literal doesn't work with none encoding
+(unless (eq? (gauche-character-encoding) 'none)
+  (test* "reading from file port"
+         '((#("\u3042\u3044" 1) (("k" . "\u3046"))) 5 "rest")
+         (begin
+           (with-output-to-file "test.json"
+             (^[] (display "[\"\u3042\u3044\",\n 1]\n{\"k\":\n\"\u3046\"}\n")
+                  (display "rest\n")))
+           (unwind-protect
+               (call-with-input-file "test.json"
+                 (^p (let1 vs (list (parse-json p) (parse-json p))
+                       (read-line p)
+                       (list vs (port-current-line p) (read-line p)))))
+             (sys-unlink "test.json")))))
+
+(test* "reading empty input" (eof-object) (parse-json-string "  "))
+
+(let ()
+  (define (t str)
+    (test* #"parse error ~str" (test-error <json-parse-error>)
+           (parse-json-string str)))
+  (t "[1,2,]")
+  (t "[1 2]")
+  (t "{\"a\" 1}")
+  (t "[1.]")
+  (t "[tru]")
+  (t "[\"abc]")
+  (t "[\"\\q\"]"))
+
+(test* "event generator"
+       '(begin-object (key . "a") begin-array (value . 1) (value . "s")
+         begin-object end-object end-array (key . "b") (value . null)
+         end-object begin-array end-array (value . 3))
+       (with-input-from-string "{\"a\":[1,\"s\",{}],\"b\":null} [] 3"
+         (^[] (generator->list (json-event-generator)))))
+
+(test* "event generator with special handler"
+       '(begin-array (value . #t) (value . #f) end-array)
+       (parameterize ([json-special-handler (^y (eq? y 'true))])
+         (generator->list
+          (json-event-generator (open-input-string "[true, false]")))))
+
+(test* "event generator error" (test-error <json-parse-error>)
+       (generator->list (json-event-generator (open-input-string "[1,"))))
+
+(test* "writing escapes" "[\"a\\\"\\\\\\n\\u0001\\u007f\"]"
+       (construct-json-string '#("a\"\\\n\x01;\x7f;")))
+
+(test* "json-parser (peg)" '(("x" . #(1 2 3)))
+       (peg-parse-string json-parser "{\"x\": [1, 2, 3]}"))
+;;-------------------------------------------------------------------
+(test-section "rfc.http-parser")
+(use rfc.http-parser)
+(test-module 'rfc.http-parser)
+
+(define (read-request-heads str . opts)
+  (call-with-input-string str
+    (^p (let loop ([r '()])
+          (receive (method target version headers)
+              (apply http-read-request-head p opts)
+            (if (eof-object? method)
+              (reverse r)
+              (loop (cons (list method target version headers
+                                (read-line p))
+                          r))))))))
+
+(test* "request head"
+       '(("GET" "/index.html?q=1" "HTTP/1.1"
+          (("host" "example.com") ("x-foo" "bar baz")) "body"))
+       (read-request-heads
+        "GET /index.html?q=1 HTTP/1.1\r\nHost:  example.com \r\n\
+         X-Foo:bar\r\n  baz\r\n\r\nbody"))
+
+(test* "pipelined request heads, bare LF, leading empty line"
+       '(("GET" "/a" "HTTP/1.1" (("host" "x")) "")
+         ("POST" "*" "HTTP/1.0" () ""))
+       (read-request-heads
+        "\r\nGET /a HTTP/1.1\nHost: x\n\n\nPOST * HTTP/1.0\r\n\r\n\n"))
+
+(let ()
+  (define (t status str . opts)
+    (test* #"request parse error ~status ~(write-to-string str)" status
+           (guard (e [(<http-parse-error> e) (condition-ref e 'status)])
+             (apply read-request-heads str opts))))
+  (t 400 "GET / HTTP/1.1\r\nHost")
+  (t 400 "GET  / HTTP/1.1\r\n\r\n")
+  (t 400 "GET / HTTP/1.1x\r\n\r\n")
+  (t 400 "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n")
+  (t 400 "GET / HTTP/1.1\r\n folded\r\n\r\n")
+  (t 505 "GET / HTTP/2.0\r\n\r\n")
+  (t 414 (string-append "GET /" (make-string 100 #\a) " HTTP/1.1\r\n\r\n")
+     :max-line-size 64)
+  (t 431 "GET / HTTP/1.1\r\na: 1\r\nb: 2\r\nc: 3\r\n\r\n"
+     :max-headers 2)
+  (t 431 "GET / HTTP/1.1\r\na: 1\r\nb: 2\r\nc: 3\r\n\r\n"
+     :max-header-size 10))
+
+(test* "response head"
+       '("HTTP/1.1" 404 "Not Found" (("content-length" "3")) "abc")
+       (call-with-input-string
+           "HTTP/1.1 404 Not Found\r\nContent-Length: 3\r\n\r\nabc"
+         (^p (receive (version status reason headers)
+                 (http-read-response-head p)
+               (list version status reason headers (read-line p))))))
+
+(test* "chunked coding" '(5 10 0 (("x-sum" "abc")) "rest")
+       (call-with-input-string "5\r\nhello\r\na;ext=1\r\n0123456789\r\n\
+                                0\r\nX-Sum: abc\r\n\r\nrest"
+         (^p (let* ([a (http-read-chunk-size p)]
+                    [_ (read-block (+ a 2) p)]
+                    [b (http-read-chunk-size p)]
+                    [_ (read-block (+ b 2) p)]
+                    [c (http-read-chunk-size p)]
+                    [t (http-read-trailer p)])
+               (list a b c t (read-line p))))))
+
+(let ()
+  (define (t status str thunk)
+    (test* #"chunked coding parse error ~status ~(write-to-string str)" status
+           (guard (e [(<http-parse-error> e) (condition-ref e 'status)])
+             (call-with-input-string str thunk))))
+  (t 400 "xyz\r\n" http-read-chunk-size)
+  (t 400 "" http-read-chunk-size)
+  (t 400 "ffffffffffffffffffff\r\n" http-read-chunk-size)
+  (t 400 (string-append "5;" (make-string 100 #\x) "\r\n")
+     (cut http-read-chunk-size <> :max-line-size 64))
+  (t 431 (string-append "X: " (make-string 100 #\x) "\r\n\r\n")
+     (cut http-read-trailer <> :max-line-size 64)))
+
+(test* "response head error" (test-error <http-parse-error>)
+       (call-with-input-string "HTTP/1.1 2x0 OK\r\n\r\n"
+         http-read-response-head))
+
+
 (test-end)
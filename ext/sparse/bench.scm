@@ -68,6 +68,62 @@
     (print name " lookup:    " (calc-time ref-timer))
     ))
 
+;; Bulk workloads: load a dense run of *problem-size* keys starting from
+;; a random base, scan the middle half in key order, then delete it.
+;; For hash tables, the ordered scan has to collect and sort the keys.
+
+(define *run-base* (random-integer (expt 2 31)))
+(define *run-values* (list-tabulate *problem-size* (^i (logand i #xffff))))
+(define *scan-lo* (+ *run-base* (quotient *problem-size* 4)))
+(define *scan-hi* (+ *scan-lo* (quotient *problem-size* 2)))
+
+(define (ht-load ht)
+  (do ([k *run-base* (+ k 1)]
+       [vs *run-values* (cdr vs)])
+      [(null? vs)]
+    (hash-table-put! ht k (car vs))))
+
+(define (ht-scan ht)
+  (let1 ks (hash-table-fold ht (^[k v s] (if (<= *scan-lo* k (- *scan-hi* 1))
+                                          (cons k s)
+                                          s))
+                            '())
+    (fold (^[k s] (+ s (hash-table-get ht k))) 0 (sort ks))))
+
+(define (ht-delete ht)
+  (do ([k *scan-lo* (+ k 1)])
+      [(= k *scan-hi*)]
+    (hash-table-delete! ht k)))
+
+(define (sv-load spv)
+  (sparse-vector-set-run! spv *run-base* *run-values*))
+
+(define (sv-scan spv)
+  (sparse-vector-range-fold spv (^[k v s] (+ s v)) 0 *scan-lo* *scan-hi*))
+
+(define (sv-delete spv)
+  (sparse-vector-delete-range! spv *scan-lo* *scan-hi*))
+
+(define (bench-bulk name %make %load %scan %delete)
+  (let ([load-timer   (make <user-time-counter>)]
+        [scan-timer   (make <user-time-counter>)]
+        [delete-timer (make <user-time-counter>)]
+        [n (ceiling->exact (/ *num-repeat* 4))])
+
+    (define (calc-time timer)
+      (* (/. (time-counter-value timer) n *problem-size*) 1e9)) ;nanosec
+
+    (dotimes [i n]
+      (let1 obj (%make)
+        (with-time-counter load-timer (%load obj))
+        (with-time-counter scan-timer (%scan obj))
+        (with-time-counter delete-timer (%delete obj))))
+
+    (print name " bulk load:    " (calc-time load-timer))
+    (print name " ordered scan: " (calc-time scan-timer))
+    (print name " range delete: " (calc-time delete-timer))
+    ))
+
 (define (active-memory-size)
   (gc) (gc)
   (let1 s (gc-stat)
@@ -89,6 +145,14 @@
     [("st" "speed") (bench-speed "Sparse table" (cut make-sparse-table 'eqv?)
                                  st-ref st-set sparse-table-clear!)]
 
+    [("ht" "bulk") (bench-bulk "Hash table" (cut make-hash-table 'eqv?)
+                               ht-load ht-scan ht-delete)]
+    [("sv" "bulk") (bench-bulk "Sparse vector" (cut make-sparse-vector)
+                               sv-load sv-scan sv-delete)]
+    [("suv" "bulk") (bench-bulk "Sparse u32vector"
+                                (cut make-sparse-vector 'u32)
+                                sv-load sv-scan sv-delete)]
+
     [("ht" "mem") (print "Hash table mem: "
                          (bench-mem (cut ht-set (make-hash-table 'eqv?))))]
     [("sv" "mem") (print "Sparse vector mem: "
@@ -97,6 +161,6 @@
                         (bench-mem (cut sv-set (make-sparse-vector 'u32))))]
     [("st" "mem") (print "Sparse table mem: "
                          (bench-mem (cut st-set (make-sparse-table 'eqv?))))]
-    [_ (exit 1 "Usage: bench ht|sv|st speed|mem")])
+    [_ (exit 1 "Usage: bench ht|sv|suv|st speed|mem|bulk")])
   (print "size: "  *problem-size*)
   0)
@@ -48,6 +48,10 @@ void CompactTrieInit(CompactTrie *t)
 {
     t->numEntries = 0;
     t->root = NULL;
+    for (int i=0; i<CTRIE_POOL_CLASSES; i++) {
+        t->pool[i] = NULL;
+        t->poolCount[i] = 0;
+    }
 }
 
 /*
@@ -76,14 +80,48 @@ void CompactTrieInit(CompactTrie *t)
    reallocation.   Must be a power of two. */
 #define NODE_SIZE_INCR 2
 
-static Node *make_node(int nentry)
+#define NODE_ALLOC_SIZE(nentry) \
+    (((nentry)+NODE_SIZE_INCR-1)&(~(NODE_SIZE_INCR-1)))
+#define NODE_POOL_CLASS(nalloc)  ((nalloc)/NODE_SIZE_INCR - 1)
+
+#if CTRIE_POOL_CLASSES != MAX_NODE_SIZE/NODE_SIZE_INCR
+#error "CTRIE_POOL_CLASSES doesn't match the node size classes"
+#endif
+
+static Node *make_node(CompactTrie *ct, int nentry)
 {
-    int nalloc = (nentry+NODE_SIZE_INCR-1)&(~(NODE_SIZE_INCR-1));
+    int nalloc = NODE_ALLOC_SIZE(nentry);
+    int c = NODE_POOL_CLASS(nalloc);
+    Node *n = ct->pool[c];
+    if (n != NULL) {
+        ct->pool[c] = (Node*)n->entries[0];
+        ct->poolCount[c]--;
+        n->entries[0] = NULL;
+        return n;
+    }
     /* SCM_NEW2 returns zero cleared chunk. */
     return SCM_NEW2(Node*, sizeof(Node) + sizeof(void*)*(nalloc-2));
 }
 
-static Node *node_insert(Node *orig, u_long ind, void *entry, int leafp)
+/* Give node N, which is no longer referenced from the trie, back to
+   the pool.  NENTRY is the number of children N had.  The node may
+   actually be larger than that if it has shrunk, but we only need the
+   lower bound; the entries beyond the number of children are always
+   NULL (see node_delete). */
+static void recycle_node(CompactTrie *ct, Node *n, int nentry)
+{
+    int nalloc = NODE_ALLOC_SIZE(nentry > 0 ? nentry : 1);
+    int c = NODE_POOL_CLASS(nalloc);
+    if (ct->poolCount[c] >= CTRIE_POOL_LIMIT) return;
+    n->emap = n->lmap = 0;
+    for (int i=0; i<nalloc; i++) n->entries[i] = NULL;
+    n->entries[0] = ct->pool[c];
+    ct->pool[c] = n;
+    ct->poolCount[c]++;
+}
+
+static Node *node_insert(CompactTrie *ct, Node *orig, u_long ind,
+                         void *entry, int leafp)
 {
     int size = NODE_NCHILDREN(orig);
     int insertpoint = Scm__CountBitsBelow(orig->emap, ind);
@@ -101,7 +139,7 @@ static Node *node_insert(Node *orig, u_long ind, void *entry, int leafp)
         return orig;
     } else {
         /* we need to extend the node */
-        Node *newn = make_node(size+NODE_SIZE_INCR);
+        Node *newn = make_node(ct, size+NODE_SIZE_INCR);
         newn->emap = orig->emap;
         newn->lmap = orig->lmap;
         NODE_ARC_SET(newn, ind);
@@ -110,6 +148,7 @@ static Node *node_insert(Node *orig, u_long ind, void *entry, int leafp)
         for (; i<insertpoint; i++) newn->entries[i] = orig->entries[i];
         newn->entries[insertpoint] = entry;
         for (; i<size; i++) newn->entries[i+1] = orig->entries[i];
+        recycle_node(ct, orig, size);
         return newn;
     }
 }
@@ -126,6 +165,7 @@ static int node_delete(Node *orig, u_long ind)
     for (int i=deletepoint; i<size-1; i++) {
       orig->entries[i] = orig->entries[i+1];
     }
+    orig->entries[size-1] = NULL;
     return size-1;
 }
 
@@ -177,7 +217,7 @@ static Node *add_rec(CompactTrie *ct, Node *n, u_long key, int level,
         Leaf *l = new_leaf(key, creator, data);
         *result = l;
         ct->numEntries++;
-        return node_insert(n, ind, (void*)l, TRUE);
+        return node_insert(ct, n, ind, (void*)l, TRUE);
     }
     else if (!NODE_ARC_IS_LEAF(n, ind)) {
         u_long off = NODE_INDEX2OFF(n, ind);
@@ -193,7 +233,7 @@ static Node *add_rec(CompactTrie *ct, Node *n, u_long key, int level,
 
         if (key == k0) { *result = l0; return n; }
         u_long i0 = KEY2INDEX(leaf_key(l0), level+1);
-        Node *m = make_node(NODE_SIZE_INCR);
+        Node *m = make_node(ct, NODE_SIZE_INCR);
         NODE_ARC_SET(m, i0);
         NODE_LEAF_SET(m, i0);
         NODE_ENTRY(m, 0) = l0;
@@ -209,7 +249,7 @@ Leaf *CompactTrieAdd(CompactTrie *ct, u_long key,
     KEY_MASK(key);
     if (ct->root == NULL) {
         Leaf *l = new_leaf(key, creator, data);
-        ct->root = make_node(NODE_SIZE_INCR);
+        ct->root = make_node(ct, NODE_SIZE_INCR);
         ct->numEntries = 1;
         NODE_ARC_SET(ct->root, key&TRIE_MASK);
         NODE_LEAF_SET(ct->root, key&TRIE_MASK);
@@ -243,7 +283,10 @@ void *del_rec(CompactTrie *ct, Node *n, u_long key, int level,
             Node *orig = (Node*)NODE_ENTRY(n, off);
             void *m = del_rec(ct, orig, key, level+1, deleted_leaf);
             if (m != (void*)orig) {
-                if (NODE_NCHILDREN(n) == 1 && level > 0) return m;
+                if (NODE_NCHILDREN(n) == 1 && level > 0) {
+                    recycle_node(ct, n, 1);
+                    return m;
+                }
                 NODE_ENTRY(n, off) = m;
                 NODE_LEAF_SET(n, ind);
             }
@@ -258,10 +301,13 @@ void *del_rec(CompactTrie *ct, Node *n, u_long key, int level,
                 *deleted_leaf = l0;
                 ct->numEntries--;
                 if (nc == 1 && n->lmap != 0 && level > 0) {
-                    return NODE_ENTRY(n, 0); /* the only leaf */
+                    void *l = NODE_ENTRY(n, 0); /* the only leaf */
+                    recycle_node(ct, n, 1);
+                    return l;
                 } else if (nc == 0) {
                     /* this only happens when N is root. */
                     SCM_ASSERT(level == 0);
+                    recycle_node(ct, n, 1);
                     return NULL;
                 }
             }
@@ -300,6 +346,7 @@ static void clear_rec(CompactTrie *ct, Node *n,
         NODE_ENTRY(n, i) = NULL;
     }
     n->emap = n->lmap = 0;
+    recycle_node(ct, n, size);
 }
 
 void CompactTrieClear(CompactTrie *ct,
@@ -386,10 +433,11 @@ Leaf *CompactTrieLastLeaf(CompactTrie *ct)
  * tree in dst is detached but otherwise remains intact, and may not be
  * friendly to GC.
  */
-static Node *copy_rec(const Node *s, Leaf *(*copy)(Leaf*, void*), void *data)
+static Node *copy_rec(CompactTrie *ct, const Node *s,
+                      Leaf *(*copy)(Leaf*, void*), void *data)
 {
     int size = Scm__CountBitsInWord(s->emap);
-    Node *d = make_node(size);
+    Node *d = make_node(ct, size);
     d->emap = s->emap;
     d->lmap = s->lmap;
     for (int i=0, off=0; i<MAX_NODE_SIZE && off < size; i++) {
@@ -397,7 +445,8 @@ static Node *copy_rec(const Node *s, Leaf *(*copy)(Leaf*, void*), void *data)
         if (NODE_ARC_IS_LEAF(s, i)) {
             NODE_ENTRY(d,off) = copy((Leaf*)NODE_ENTRY(s,off), data);
         } else {
-            NODE_ENTRY(d,off) = copy_rec((Node*)NODE_ENTRY(s,off), copy, data);
+            NODE_ENTRY(d,off) = copy_rec(ct, (Node*)NODE_ENTRY(s,off),
+                                         copy, data);
         }
         off++;
     }
@@ -407,11 +456,96 @@ static Node *copy_rec(const Node *s, Leaf *(*copy)(Leaf*, void*), void *data)
 void CompactTrieCopy(CompactTrie *dst, const CompactTrie *src,
                      Leaf *(*copy)(Leaf*, void*), void *data)
 {
-    if (src->root) dst->root = copy_rec(src->root, copy, data);
+    if (src->root) dst->root = copy_rec(dst, src->root, copy, data);
     else           dst->root = NULL;
     dst->numEntries = src->numEntries;
 }
 
+/*
+ * Range
+ *
+ * KEY2INDEX takes the lowest bits first, so the trie order isn't the
+ * key order, and a subtree can't be skipped just by comparing its
+ * position with the bounds.  What we know is that every key under a node
+ * at level L shares its lower L*TRIE_SHIFT bits, so a subtree can be
+ * skipped if no integer in [lo, hi] has those lower bits.  That prunes
+ * well for narrow ranges.  For a range narrower than the number of
+ * leaves, probing each key is cheaper still, and yields sorted result
+ * for free; otherwise we walk and sort what we collected.
+ */
+typedef struct LeafBufRec {
+    Leaf  **leaves;
+    u_long count;
+    u_long size;
+} LeafBuf;
+
+static void leafbuf_push(LeafBuf *b, Leaf *l)
+{
+    if (b->count == b->size) {
+        u_long newsize = b->size ? b->size*2 : 32;
+        Leaf **newl = SCM_NEW_ARRAY(Leaf*, newsize);
+        if (b->count > 0) memcpy(newl, b->leaves, b->count*sizeof(Leaf*));
+        b->leaves = newl;
+        b->size = newsize;
+    }
+    b->leaves[b->count++] = l;
+}
+
+/* Is there any integer in [lo, hi] whose lower BITS bits equal PREFIX? */
+static int range_reachable(u_long prefix, int bits, u_long lo, u_long hi)
+{
+    if (bits >= SIZEOF_LONG*8) return (lo <= prefix && prefix <= hi);
+    u_long mask = (1UL<<bits)-1;
+    u_long x = lo + ((prefix - lo) & mask); /* smallest such x >= lo */
+    return (x >= lo && x <= hi);            /* x < lo on wraparound */
+}
+
+static void range_rec(Node *n, int level, u_long prefix,
+                      u_long lo, u_long hi, LeafBuf *b)
+{
+    for (int i=0, off=0; i<MAX_NODE_SIZE; i++) {
+        if (!NODE_HAS_ARC(n, i)) continue;
+        void *e = NODE_ENTRY(n, off++);
+        if (NODE_ARC_IS_LEAF(n, i)) {
+            u_long k = leaf_key((Leaf*)e);
+            if (lo <= k && k <= hi) leafbuf_push(b, (Leaf*)e);
+        } else {
+            u_long p = prefix | ((u_long)i << (level*TRIE_SHIFT));
+            if (range_reachable(p, (level+1)*TRIE_SHIFT, lo, hi)) {
+                range_rec((Node*)e, level+1, p, lo, hi, b);
+            }
+        }
+    }
+}
+
+static int leaf_key_compare(const void *a, const void *b)
+{
+    u_long ka = leaf_key(*(Leaf**)a);
+    u_long kb = leaf_key(*(Leaf**)b);
+    return (ka < kb)? -1 : (ka > kb)? 1 : 0;
+}
+
+Leaf **CompactTrieRange(CompactTrie *ct, u_long lo, u_long hi, u_long *count)
+{
+    LeafBuf b = { NULL, 0, 0 };
+    if (ct->root != NULL && lo <= hi) {
+        if (hi - lo < ct->numEntries) {
+            for (u_long k = lo;; k++) {
+                Leaf *l = get_rec(ct->root, k, 0);
+                if (l) leafbuf_push(&b, l);
+                if (k == hi) break;
+            }
+        } else {
+            range_rec(ct->root, 0, 0, lo, hi, &b);
+            if (b.count > 1) {
+                qsort(b.leaves, b.count, sizeof(Leaf*), leaf_key_compare);
+            }
+        }
+    }
+    *count = b.count;
+    return b.leaves;
+}
+
 /*
  * Iterator
  */
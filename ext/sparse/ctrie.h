@@ -137,10 +137,21 @@ static inline void leaf_data_bit_reset(Leaf *leaf, int bit)
 
 /*
  * Anchor to hold the trie
+ *
+ * Nodes are reallocated whenever they grow, and dropped when they shrink
+ * to a single leaf.  Instead of leaving those to GC, we keep a small
+ * number of them per size class in POOL and reuse them for the next
+ * allocation of the same size.  The pooled nodes are zero-cleared and
+ * chained through entries[0].
  */
+#define CTRIE_POOL_CLASSES  16  /* MAX_NODE_SIZE / NODE_SIZE_INCR */
+#define CTRIE_POOL_LIMIT    64  /* max # of pooled nodes per class */
+
 typedef struct CompactTrieRec {
     u_int    numEntries;
     Node     *root;
+    Node     *pool[CTRIE_POOL_CLASSES];
+    u_char   poolCount[CTRIE_POOL_CLASSES];
 } CompactTrie;
 
 typedef struct CompactTrieIterRec {
@@ -170,6 +181,10 @@ extern Leaf *CompactTrieFirstLeaf(CompactTrie *ct);
 extern Leaf *CompactTrieLastLeaf(CompactTrie *ct);
 extern Leaf *CompactTrieNextLeaf(CompactTrie *ct, u_long key);
 
+/* Leaves whose key is within [lo, hi], sorted by key. */
+extern Leaf **CompactTrieRange(CompactTrie *ct, u_long lo, u_long hi,
+                               u_long *count);
+
 
 /* Iterator */
 extern void  CompactTrieIterInit(CompactTrieIter *it, CompactTrie *ct);
@@ -56,6 +56,8 @@
           sparse-vector-push! sparse-vector-pop!
           sparse-vector-fold sparse-vector-map sparse-vector-for-each
           sparse-vector-keys sparse-vector-values
+          sparse-vector-set-run! sparse-vector-delete-range!
+          sparse-vector-range-fold sparse-vector-range-for-each
           %sparse-vector-dump
 
           <sparse-matrix-base> <sparse-matrix> <sparse-s8matrix>
@@ -349,8 +351,77 @@
 
  (define-cproc %sparse-vector-dump (sv::<sparse-vector>) ::<void>
    SparseVectorDump)
+
+ ;; Converts index range [start, end) to inclusive [*pfirst, *plast].
+ ;; END can be #f to mean the end of the vector.  Returns FALSE if the
+ ;; range is empty.
+ (define-cfn spvec-range (start end pfirst::u_long* plast::u_long*)
+   ::int :static
+   (unless (and (SCM_INTEGERP start) (>= (Scm_Sign start) 0))
+     (Scm_Error "start index must be a nonnegative exact integer, but got %S"
+                start))
+   (unless (or (SCM_FALSEP end)
+               (and (SCM_INTEGERP end) (>= (Scm_Sign end) 0)))
+     (Scm_Error "end index must be a nonnegative exact integer or #f, but got %S"
+                end))
+   (let* ([oor::int FALSE]
+          [first::u_long (Scm_GetIntegerUClamp start SCM_CLAMP_NONE (& oor))])
+     (when oor (return FALSE))
+     (let* ([last::u_long ULONG_MAX])
+       (unless (SCM_FALSEP end)
+         (let* ([e::u_long (Scm_GetIntegerUClamp end SCM_CLAMP_NONE (& oor))])
+           (unless oor
+             (when (<= e first) (return FALSE))
+             (set! last (- e 1)))))
+       (set! (* pfirst) first)
+       (set! (* plast) last)
+       (return TRUE))))
+
+ (define-cproc sparse-vector-set-run! (sv::<sparse-vector> start::<ulong> vals)
+   ::<void>
+   SparseVectorSetRun)
+
+ (define-cproc sparse-vector-delete-range! (sv::<sparse-vector> start
+                                            :optional (end #f))
+   ::<ulong>
+   (let* ([first::u_long 0] [last::u_long 0])
+     (if (spvec-range start end (& first) (& last))
+       (return (SparseVectorDeleteRange sv first last))
+       (return 0))))
+
+ (define-cfn sparse-vector-range-iter (args::ScmObj* nargs::int data::void*)
+   :static
+   (let* ([iter::SparseVectorRangeIter* (cast SparseVectorRangeIter* data)]
+          [r (SparseVectorRangeIterNext iter)]
+          [eofval (aref args 0)])
+     (if (SCM_FALSEP r)
+       (return (values eofval eofval))
+       (return (values (SCM_CAR r) (SCM_CDR r))))))
+
+ (define-cproc %sparse-vector-range-iter (sv::<sparse-vector> start end)
+   (let* ([iter::SparseVectorRangeIter* (SCM_NEW SparseVectorRangeIter)]
+          [first::u_long 1] [last::u_long 0])
+     (spvec-range start end (& first) (& last))
+     (SparseVectorRangeIterInit iter sv first last)
+     (return
+      (Scm_MakeSubr sparse-vector-range-iter iter 1 0
+                    '"sparse-vector-range-iterator"))))
  )
 
+;; Unlike sparse-vector-fold, these visit the entries in increasing order
+;; of the index.
+(define (sparse-vector-range-fold sv proc seed :optional (start 0) (end #f))
+  (let ([iter (%sparse-vector-range-iter sv start end)]
+        [eof  (list #f)])
+    (let loop ([seed seed])
+      (receive (key val) (iter eof)
+        (if (eq? key eof)
+          seed
+          (loop (proc key val seed)))))))
+
+(define (sparse-vector-range-for-each sv proc :optional (start 0) (end #f))
+  (sparse-vector-range-fold sv (^[k v _] (proc k v)) #f start end))
+
 (define (sparse-vector-push! spvec key val)
   ;; Can be optimized
   (if (undefined? (sparse-vector-default-value spvec))
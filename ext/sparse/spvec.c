@@ -171,6 +171,118 @@ void SparseVectorDump(SparseVector *sv)
     CompactTrieDump(SCM_CUROUT, &sv->trie, sv->desc->dump, sv->desc);
 }
 
+/*-------------------------------------------------------------------
+ * Bulk operations
+ */
+
+/* Store the elements of VALS (a list or a vector) at START, START+1, ...
+   Consecutive indexes mostly fall into the same leaf, so we only descend
+   the trie when we cross the leaf boundary. */
+void SparseVectorSetRun(SparseVector *sv, u_long start, ScmObj vals)
+{
+    long len;
+    if (SCM_VECTORP(vals)) {
+        len = SCM_VECTOR_SIZE(vals);
+    } else {
+        len = Scm_Length(vals);
+        if (len < 0) Scm_TypeError("vals", "list or vector", vals);
+    }
+    if (len == 0) return;
+    if (start + (u_long)(len-1) < start) {
+        Scm_Error("run of %ld elements starting at %lu exceeds the index "
+                  "range of %S", (long)len, start, SCM_OBJ(sv));
+    }
+
+    int shift = sv->desc->shift;
+    int (*setter)(Leaf*, u_long, ScmObj) = sv->desc->set;
+    Leaf *leaf = NULL;
+    u_long leafkey = 0;
+    ScmObj cp = vals;
+    for (long i=0; i<len; i++) {
+        u_long index = start + (u_long)i;
+        ScmObj v;
+        if (SCM_VECTORP(vals)) {
+            v = SCM_VECTOR_ELEMENT(vals, i);
+        } else {
+            v = SCM_CAR(cp);
+            cp = SCM_CDR(cp);
+        }
+        if (leaf == NULL || (index >> shift) != leafkey) {
+            leafkey = index >> shift;
+            leaf = CompactTrieAdd(&sv->trie, leafkey, sv->desc->allocate, sv);
+        }
+        if (setter(leaf, index, v)) sv->numEntries++;
+    }
+}
+
+/* Delete entries whose index is within [first, last].  Leaves that are
+   entirely covered are removed from the trie at once.
+   Returns the number of deleted entries. */
+u_long SparseVectorDeleteRange(SparseVector *sv, u_long first, u_long last)
+{
+    int shift = sv->desc->shift;
+    u_long nleaves, ndeleted = 0;
+    if (first > last) return 0;
+    Leaf **leaves = CompactTrieRange(&sv->trie, first >> shift, last >> shift,
+                                     &nleaves);
+    for (u_long i=0; i<nleaves; i++) {
+        Leaf *leaf = leaves[i];
+        u_long base = leaf_key(leaf) << shift;
+        u_long top  = base + ((1UL << shift) - 1);
+        if (first <= base && top <= last) {
+            ndeleted += sv->desc->count(leaf);
+            CompactTrieDelete(&sv->trie, leaf_key(leaf));
+            sv->desc->clear(leaf, sv->desc);
+        } else {
+            for (u_long k = (base < first)? first : base;; k++) {
+                if (!SCM_UNBOUNDP(sv->desc->delete(leaf, k))) ndeleted++;
+                if (k == top || k == last) break;
+            }
+        }
+    }
+    sv->numEntries -= ndeleted;
+    return ndeleted;
+}
+
+void SparseVectorRangeIterInit(SparseVectorRangeIter *iter, SparseVector *sv,
+                               u_long first, u_long last)
+{
+    int shift = sv->desc->shift;
+    iter->sv = sv;
+    iter->first = first;
+    iter->last = last;
+    iter->pos = 0;
+    iter->leafIndex = -1;
+    if (first > last) {
+        iter->leaves = NULL;
+        iter->numLeaves = 0;
+    } else {
+        iter->leaves = CompactTrieRange(&sv->trie, first >> shift,
+                                        last >> shift, &iter->numLeaves);
+    }
+}
+
+ScmObj SparseVectorRangeIterNext(SparseVectorRangeIter *iter)
+{
+    ScmObj (*iterproc)(Leaf*,int*) = iter->sv->desc->iter;
+    int shift = iter->sv->desc->shift;
+    while (iter->pos < iter->numLeaves) {
+        Leaf *leaf = iter->leaves[iter->pos];
+        ScmObj r = iterproc(leaf, &iter->leafIndex);
+        if (SCM_UNBOUNDP(r)) {
+            iter->pos++;
+            iter->leafIndex = -1;
+            continue;
+        }
+        u_long ind = (leaf_key(leaf) << shift) + iter->leafIndex;
+        if (ind < iter->first) continue;
+        if (ind > iter->last) break;
+        return Scm_Cons(Scm_MakeIntegerU(ind), r);
+    }
+    iter->pos = iter->numLeaves;
+    return SCM_FALSE;
+}
+
 /*===================================================================
  * Individual vector types
  */
@@ -248,8 +360,15 @@ static void g_dump(ScmPort *out, Leaf *leaf, int indent, void *data)
     }
 }
 
+static int g_count(Leaf *leaf)
+{
+    GLeaf *z = (GLeaf*)leaf;
+    return !SCM_UNBOUNDP(z->val[0]) + !SCM_UNBOUNDP(z->val[1]);
+}
+
 static SparseVectorDescriptor g_desc = {
-    g_ref, g_set, g_allocate, g_delete, g_clear, g_copy, g_iter, g_dump, 1
+    g_ref, g_set, g_allocate, g_delete, g_clear, g_copy, g_iter, g_dump,
+    g_count, 1
 };
 
 SCM_DEFINE_BUILTIN_CLASS(Scm_SparseVectorClass, NULL, NULL, NULL, NULL,
@@ -322,6 +441,11 @@ static Leaf *u_copy(Leaf *leaf, void *data)
     return (Leaf*)z;
 }
 
+static int u_count(Leaf *leaf)
+{
+    return Scm__CountBitsInWord(leaf_data(leaf));
+}
+
 /*-------------------------------------------------------------------
  * Uniform Sparse Vector Ref
  */
@@ -541,7 +665,9 @@ U_ITER(f64, MASK64)
         u_clear,                                                        \
         u_copy,                                                         \
         SCM_CPP_CAT(tag,_iter),                                         \
-        NULL, shift,                                                    \
+        NULL,                                                           \
+        u_count,                                                        \
+        shift,                                                          \
     };                                                                  \
     SCM_DEFINE_BUILTIN_CLASS(SCM_CPP_CAT3(Scm_Sparse,TAG,VectorClass),  \
                              NULL, NULL, NULL, NULL, spvec_cpl);        \
@@ -70,6 +70,19 @@ typedef struct SparseVectorIterRec {
     CompactTrieIter citer;
 } SparseVectorIter;
 
+/* Range iterator.  Visits entries whose index is within [first, last]
+   in increasing order of index.  The set of leaves is taken when the
+   iterator is initialized. */
+typedef struct SparseVectorRangeIterRec {
+    SparseVector   *sv;
+    Leaf          **leaves;
+    u_long          numLeaves;
+    u_long          pos;
+    int             leafIndex;
+    u_long          first;
+    u_long          last;
+} SparseVectorRangeIter;
+
 /* SparseVectorDescriptor has common information per class (it should be
    a part of each class, but we just hack for the time being.)
    The constructor of each class sets appropriate descriptor to the instance.
@@ -85,6 +98,7 @@ typedef struct SparseVectorIterRec {
                  and updates I.  SCM_UNBOUND if the next object is not in L.
                  I is intra-leaf index, not the vector-wide index.
    dump(P,L,I,_) - Dumps leaf data.
+   count(L)   - Returns the number of elements in the leaf L.
 
    The numEntries field is taken care of by generic routine.
  */
@@ -97,6 +111,7 @@ struct SparseVectorDescriptorRec {
     Leaf    *(*copy)(Leaf*, void*);
     ScmObj   (*iter)(Leaf*, int*);
     void     (*dump)(ScmPort *out, Leaf *leaf, int indent, void *data);
+    int      (*count)(Leaf*);
 
     int shift;                  /* # of shift bits to access Leaf */
 };
@@ -121,9 +136,19 @@ extern ScmObj SparseVectorInc(SparseVector *sv, u_long index, ScmObj delta,
                               ScmObj fallback);
 extern void   SparseVectorDump(SparseVector *sv);
 
+/* Bulk operations */
+extern void   SparseVectorSetRun(SparseVector *sv, u_long start, ScmObj vals);
+extern u_long SparseVectorDeleteRange(SparseVector *sv,
+                                      u_long first, u_long last);
+
 extern void   SparseVectorIterInit(SparseVectorIter *iter, SparseVector *sv);
 extern ScmObj SparseVectorIterNext(SparseVectorIter *iter);
 
+extern void   SparseVectorRangeIterInit(SparseVectorRangeIter *iter,
+                                        SparseVector *sv,
+                                        u_long first, u_long last);
+extern ScmObj SparseVectorRangeIterNext(SparseVectorRangeIter *iter);
+
 extern void   Scm_Init_spvec(ScmModule *mod);
 
 /*
@@ -182,6 +182,68 @@
 (spvec-heavy 'f32 (^x (exact->inexact (logand x #xfffff))))
 (spvec-heavy 'f64 exact->inexact)
 
+(let ()
+  (define (range-alist sv . args)
+    (reverse (apply sparse-vector-range-fold sv acons '() args)))
+  (define (spvec-range tag)
+    (define (val k)
+      (if (eq? tag 'f64) (exact->inexact (logand k 127)) (logand k 127)))
+    (let ([sv (make-sparse-vector tag)]
+          [keys (hash-table-keys *data-set*)])
+      (dolist [k keys] (sparse-vector-set! sv k (val k)))
+      (test* #"sparse-~(or tag \"\")vector range-fold whole"
+             (sort keys)
+             (map car (range-alist sv)))
+      (let* ([sorted (sort keys)]
+             [lo (list-ref sorted 100)]
+             [hi (list-ref sorted 200)])
+        (test* #"sparse-~(or tag \"\")vector range-fold partial"
+               (map (^k (cons k (val k)))
+                    (filter (^k (<= lo k (- hi 1))) sorted))
+               (range-alist sv lo hi))
+        (test* #"sparse-~(or tag \"\")vector range-fold narrow"
+               (list (cons lo (val lo)))
+               (range-alist sv lo (+ lo 1)))
+        (test* #"sparse-~(or tag \"\")vector delete-range!"
+               (list 100 (- *data-set-size* 100) #f #t)
+               (list (sparse-vector-delete-range! sv lo hi)
+                     (sparse-vector-num-entries sv)
+                     (sparse-vector-exists? sv lo)
+                     (sparse-vector-exists? sv hi))))
+      (test* #"sparse-~(or tag \"\")vector set-run!"
+             (map (^k (cons k (val k))) '(1000 1001 1002 1003 1004))
+             (begin
+               (sparse-vector-delete-range! sv 0 2000)
+               (sparse-vector-set-run! sv 1000 (map val '(1000 1001 1002)))
+               (sparse-vector-set-run! sv 1003 (vector (val 1003) (val 1004)))
+               (range-alist sv 0 2000)))
+      (test* #"sparse-~(or tag \"\")vector delete-range! to the end"
+             (list 0 (map (^k (cons k (val k))) '(1000 1001)))
+             (begin
+               (sparse-vector-delete-range! sv 1002)
+               (list (sparse-vector-range-fold sv (^[k v s] (+ s 1)) 0 1002)
+                     (range-alist sv))))))
+  (for-each spvec-range '(#f u8 s32 f64)))
+
+(test* "sparse-vector range args" (test-error)
+       (sparse-vector-range-fold (make-sparse-vector) acons '() -1))
+(test* "sparse-vector range args (end)"
+       (test-error <error>
+                   "end index must be a nonnegative exact integer or #f, but got -1")
+       (sparse-vector-range-fold (make-sparse-vector) acons '() 0 -1))
+(test* "sparse-vector empty range" '()
+       (let1 sv (make-sparse-vector)
+         (sparse-vector-set! sv 5 'a)
+         (sparse-vector-range-fold sv acons '() 5 5)))
+(test* "sparse-vector range near the max index" '(a b)
+       (let ([sv (make-sparse-vector)]
+             [m (- (expt 2 (sparse-vector-max-index-bits)) 1)])
+         (sparse-vector-set! sv (- m 1) 'a)
+         (sparse-vector-set! sv m 'b)
+         (sparse-vector-set! sv 0 'c)
+         (reverse (sparse-vector-range-fold sv (^[k v s] (cons v s)) '()
+                                            (- m 1)))))
+
 
 ;; sparse table----------------------------------------------------
 (test-section "sparse-table")
@@ -35,6 +35,7 @@
 #include <gauche.h>
 #include <gauche/class.h>
 #include <gauche/extend.h>
+#include <gauche/priv/systemP.h>
 
 #include "gauche-termios.h"
 
@@ -125,25 +126,36 @@ ScmObj Scm_Openpty(ScmObj slaveterm)
 #endif /*HAVE_OPENPTY*/
 
 #ifdef HAVE_FORKPTY
+typedef struct forkpty_args_rec {
+    int master;
+    struct termios *term;
+} forkpty_args;
+
+/* Called through Scm__ForkWith, which tells GC about the fork. */
+static pid_t do_forkpty(void *data)
+{
+    forkpty_args *a = (forkpty_args*)data;
+    return forkpty(&a->master, NULL, a->term, NULL);
+}
+
 ScmObj Scm_Forkpty(ScmObj slaveterm)
 {
-    int master;
+    forkpty_args a = { -1, NULL };
     pid_t pid;
-    struct termios *term = NULL;
     if (SCM_SYS_TERMIOS_P(slaveterm)) {
-        term = &SCM_SYS_TERMIOS(slaveterm)->term;
+        a.term = &SCM_SYS_TERMIOS(slaveterm)->term;
     }
-    if ((pid = forkpty(&master, NULL, term, NULL)) < 0) {
+    if ((pid = Scm__ForkWith(do_forkpty, &a)) < 0) {
         Scm_SysError("forkpty failed");
     }
-    return Scm_Values2(Scm_MakeInteger(pid), SCM_MAKE_INT(master));
+    return Scm_Values2(Scm_MakeInteger(pid), SCM_MAKE_INT(a.master));
 }
 
 ScmObj Scm_ForkptyAndExec(ScmString *file, ScmObj args, ScmObj iomap,
                           ScmObj slaveterm, ScmSysSigset *mask)
 {
     int argc = Scm_Length(args);
-    struct termios *term = NULL;
+    forkpty_args a = { -1, NULL };
 
     if (argc < 1) {
         Scm_Error("argument list must have at least one element: %S", args);
@@ -152,14 +164,13 @@ ScmObj Scm_ForkptyAndExec(ScmString *file, ScmObj args, ScmObj iomap,
     const char *program = Scm_GetStringConst(file);
 
     if (SCM_SYS_TERMIOS_P(slaveterm)) {
-        term = &SCM_SYS_TERMIOS(slaveterm)->term;
+        a.term = &SCM_SYS_TERMIOS(slaveterm)->term;
     }
 
     int *fds = Scm_SysPrepareFdMap(iomap);
 
-    int master;
     pid_t pid;
-    if ((pid = forkpty(&master, NULL, term, NULL)) < 0) {
+    if ((pid = Scm__ForkWith(do_forkpty, &a)) < 0) {
         Scm_SysError("forkpty failed");
     }
     if (pid == 0) {
@@ -172,7 +183,7 @@ ScmObj Scm_ForkptyAndExec(ScmString *file, ScmObj args, ScmObj iomap,
         /* here, we failed */
         Scm_Panic("exec failed: %s: %s", program, strerror(errno));
     }
-    return Scm_Values2(Scm_MakeInteger(pid), SCM_MAKE_INT(master));
+    return Scm_Values2(Scm_MakeInteger(pid), SCM_MAKE_INT(a.master));
 }
 #endif /*HAVE_FORKPTY*/
 
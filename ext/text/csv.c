@@ -0,0 +1,626 @@
+/*
+ * csv.c - CSV tokenizer
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The tokenizer reads one record at a time into a fresh buffer,
+   fetching lines directly from the port buffer, and splits it into
+   fields in place.  The field strings share the record buffer, so
+   we don't copy the contents again.  The unescaping of doubled quote
+   characters is also done in place.
+
+   The tokenizing rule is the same as the former Scheme version:
+   whitespaces around an unquoted field are trimmed, and the chars
+   after the closing quote of a quoted field, up to the next separator,
+   are ignored.
+*/
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include <gauche/priv/portP.h>
+#include "csv.h"
+
+#include <ctype.h>
+
+/*================================================================
+ * Record buffer
+ */
+
+typedef struct csv_record_rec {
+    char *buf;
+    ScmSmallInt size;           /* # of bytes in buf */
+    ScmSmallInt capa;           /* allocated size of buf */
+    ScmSmallInt *fields;        /* start and end offsets of fields */
+    int nfields;
+    int fcapa;                  /* allocated # of fields */
+} csv_record;
+
+#define INITIAL_RECORD_SIZE 256
+#define INITIAL_FIELDS      16
+
+static void record_init(csv_record *r)
+{
+    r->buf = NULL;
+    r->size = 0;
+    r->capa = INITIAL_RECORD_SIZE;
+    r->fields = SCM_NEW_ATOMIC2(ScmSmallInt*,
+                                INITIAL_FIELDS * 2 * sizeof(ScmSmallInt));
+    r->nfields = 0;
+    r->fcapa = INITIAL_FIELDS;
+}
+
+/* Each record gets a new buffer, since the field strings of the
+   previous record may still refer to the old one. */
+static void record_reset(csv_record *r)
+{
+    r->buf = SCM_NEW_ATOMIC2(char*, r->capa);
+    r->size = 0;
+    r->nfields = 0;
+}
+
+static void record_append(csv_record *r, const char *s, ScmSmallInt n)
+{
+    if (r->size + n > r->capa) {
+        ScmSmallInt newcapa = r->capa * 2;
+        while (r->size + n > newcapa) newcapa *= 2;
+        char *newbuf = SCM_NEW_ATOMIC2(char*, newcapa);
+        memcpy(newbuf, r->buf, r->size);
+        r->buf = newbuf;
+        r->capa = newcapa;
+    }
+    memcpy(r->buf + r->size, s, n);
+    r->size += n;
+}
+
+static void record_add_field(csv_record *r, ScmSmallInt start,
+                             ScmSmallInt end)
+{
+    if (r->nfields >= r->fcapa) {
+        ScmSmallInt *newfields =
+            SCM_NEW_ATOMIC2(ScmSmallInt*,
+                            r->fcapa * 4 * sizeof(ScmSmallInt));
+        memcpy(newfields, r->fields, r->fcapa * 2 * sizeof(ScmSmallInt));
+        r->fields = newfields;
+        r->fcapa *= 2;
+    }
+    r->fields[r->nfields*2]   = start;
+    r->fields[r->nfields*2+1] = end;
+    r->nfields++;
+}
+
+/* Appends bytes up to and including the next newline to the record.
+   Returns the number of bytes appended; 0 means EOF.
+   The port must be locked.  If the port's pending input is available
+   in its buffer, we search the newline directly in it. */
+static ScmSmallInt fetch_line(ScmPort *p, csv_record *r)
+{
+    ScmSmallInt start = r->size;
+
+    for (;;) {
+        const char *cur, *end;
+        if (Scm__PortInputBuffer(p, &cur, &end) && cur < end) {
+            const char *nl = memchr(cur, '\n', end - cur);
+            const char *stop = nl ? nl+1 : end;
+            record_append(r, cur, stop - cur);
+            Scm__PortInputConsumed(p, stop - cur, nl? 1 : 0);
+            if (nl) return r->size - start;
+        } else {
+            /* The buffer is empty, or the port doesn't have one.
+               Getb refills the buffer if possible. */
+            int b = Scm_GetbUnsafe(p);
+            if (b == EOF) return r->size - start;
+            char c = (char)b;
+            record_append(r, &c, 1);
+            if (b == '\n') {
+                Scm__PortInputConsumed(p, 0, 1); /* Getb doesn't count lines */
+                return r->size - start;
+            }
+        }
+    }
+}
+
+/*================================================================
+ * Tokenizer
+ */
+
+/* Decodes a char at offset I.  Returns the # of bytes. */
+static inline int get_char(csv_record *r, ScmSmallInt i, ScmChar *ch)
+{
+    unsigned char b = (unsigned char)r->buf[i];
+    if (b < 0x80) {
+        *ch = b;
+        return 1;
+    }
+    int n = SCM_CHAR_NFOLLOWS(b) + 1;
+    if (i + n > r->size) {      /* incomplete char at the end */
+        *ch = b;
+        return 1;
+    }
+    SCM_CHAR_GET(r->buf + i, *ch);
+    return n;
+}
+
+#define WHITESPACEP(ch) \
+    (((ch) < 0x80)? isspace(ch) : SCM_CHAR_EXTRA_WHITESPACE(ch))
+
+#define EOR_P(r, i)  ((i) >= (r)->size || (r)->buf[i] == '\n')
+
+/* Reads one record into R.  Returns FALSE on EOF.  The port must
+   be locked. */
+static int read_record(ScmPort *port, ScmChar sep, ScmChar quo,
+                       csv_record *r)
+{
+    ScmSmallInt i = 0, fstart, last;
+    ScmChar ch;
+    int n;
+
+    record_reset(r);
+    if (fetch_line(port, r) == 0) return FALSE;
+
+  field_start:
+    /* Skip leading whitespaces.  Note that the separator may be
+       a whitespace (e.g. tab), so we check it first. */
+    for (;;) {
+        if (EOR_P(r, i)) {
+            record_add_field(r, i, i);
+            return TRUE;
+        }
+        n = get_char(r, i, &ch);
+        if (ch == sep) {
+            record_add_field(r, i, i);
+            i += n;
+            continue;
+        }
+        if (ch == quo) {
+            i += n;
+            goto quoted;
+        }
+        if (!WHITESPACEP(ch)) break;
+        i += n;
+    }
+
+    /* Unquoted field.  LAST tracks the end of the last non-whitespace
+       char, so that trailing whitespaces are trimmed. */
+    fstart = last = i;
+    for (;;) {
+        if (EOR_P(r, i)) {
+            record_add_field(r, fstart, last);
+            return TRUE;
+        }
+        n = get_char(r, i, &ch);
+        if (ch == sep) {
+            record_add_field(r, fstart, last);
+            i += n;
+            goto field_start;
+        }
+        i += n;
+        if (!WHITESPACEP(ch)) last = i;
+    }
+
+  quoted:
+    /* Quoted field may span multiple lines.  We unescape doubled quote
+       chars by shifting the content toward FSTART; LAST is the write
+       pointer. */
+    fstart = last = i;
+    for (;;) {
+        if (i >= r->size) {
+            if (fetch_line(port, r) == 0) {
+                Scm_Error("unterminated quoted field");
+            }
+            continue;
+        }
+        n = get_char(r, i, &ch);
+        if (ch == quo) {
+            ScmChar ch2 = SCM_CHAR_INVALID;
+            int n2 = 0;
+            /* If the record buffer ends here, it is the end of input;
+               otherwise we have a newline after this char. */
+            if (i + n < r->size) n2 = get_char(r, i + n, &ch2);
+            if (ch2 != quo) {
+                record_add_field(r, fstart, last);
+                i += n;
+                break;
+            }
+            if (last != i) memmove(r->buf + last, r->buf + i, n);
+            last += n;
+            i += n + n2;
+            continue;
+        }
+        if (last != i) memmove(r->buf + last, r->buf + i, n);
+        last += n;
+        i += n;
+    }
+
+    /* Skip garbage after the closing quote. */
+    for (;;) {
+        if (EOR_P(r, i)) return TRUE;
+        n = get_char(r, i, &ch);
+        i += n;
+        if (ch == sep) goto field_start;
+    }
+}
+
+static ScmObj field_string(csv_record *r, int k)
+{
+    ScmSmallInt start = r->fields[k*2], end = r->fields[k*2+1];
+    return Scm_MakeString(r->buf + start, end - start, -1, 0);
+}
+
+static ScmObj read_record_body(ScmPort *port, ScmChar sep, ScmChar quo,
+                               int as_vector)
+{
+    csv_record r;
+    record_init(&r);
+    if (!read_record(port, sep, quo, &r)) return SCM_EOF;
+
+    if (as_vector) {
+        ScmObj v = Scm_MakeVector(r.nfields, SCM_FALSE);
+        for (int k=0; k<r.nfields; k++) {
+            SCM_VECTOR_ELEMENT(v, k) = field_string(&r, k);
+        }
+        return v;
+    } else {
+        ScmObj h = SCM_NIL, t = SCM_NIL;
+        for (int k=0; k<r.nfields; k++) {
+            SCM_APPEND1(h, t, field_string(&r, k));
+        }
+        return h;
+    }
+}
+
+ScmObj Scm_CsvReadRecord(ScmPort *port, ScmChar sep, ScmChar quo,
+                         int as_vector)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj v = SCM_UNDEFINED;
+
+    if (PORT_LOCKED(port, vm)) {
+        v = read_record_body(port, sep, quo, as_vector);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, v = read_record_body(port, sep, quo, as_vector),
+                       /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    return v;
+}
+
+/*================================================================
+ * Typed columns
+ *
+ *  Each element of TYPES specifies how the corresponding column
+ *  is stored:
+ *
+ *   string        - a vector of strings
+ *   number        - a vector of numbers (#f if the field isn't a number)
+ *   s8, u8, ..., f64 - a uvector of the type.  An empty field is
+ *                   read as NaN for flonum types, and is an error for
+ *                   integer types.
+ *   #f            - the column is skipped.
+ */
+
+enum {
+    COL_SKIP,
+    COL_STRING,
+    COL_NUMBER,
+    COL_UVECTOR
+};
+
+typedef struct column_rec {
+    int kind;
+    ScmObj head, tail;          /* COL_STRING, COL_NUMBER */
+    ScmUVectorType utype;       /* COL_UVECTOR */
+    ScmClass *klass;
+    int eltsize;
+    char *data;
+    ScmSmallInt capa;
+    ScmObj view;                /* uvector sharing DATA, for Scm_UVectorSet */
+} column;
+
+static const struct {
+    const char *name;
+    ScmClass *klass;
+} uvector_types[] = {
+    { "s8",  SCM_CLASS_S8VECTOR },
+    { "u8",  SCM_CLASS_U8VECTOR },
+    { "s16", SCM_CLASS_S16VECTOR },
+    { "u16", SCM_CLASS_U16VECTOR },
+    { "s32", SCM_CLASS_S32VECTOR },
+    { "u32", SCM_CLASS_U32VECTOR },
+    { "s64", SCM_CLASS_S64VECTOR },
+    { "u64", SCM_CLASS_U64VECTOR },
+    { "f16", SCM_CLASS_F16VECTOR },
+    { "f32", SCM_CLASS_F32VECTOR },
+    { "f64", SCM_CLASS_F64VECTOR },
+    { NULL, NULL }
+};
+
+static void column_init(column *c, ScmObj type)
+{
+    c->head = c->tail = SCM_NIL;
+    c->data = NULL;
+    c->view = SCM_FALSE;
+    if (SCM_FALSEP(type)) { c->kind = COL_SKIP; return; }
+    if (SCM_SYMBOLP(type)) {
+        const char *name = Scm_GetStringConst(SCM_SYMBOL_NAME(type));
+        if (strcmp(name, "string") == 0) { c->kind = COL_STRING; return; }
+        if (strcmp(name, "number") == 0) { c->kind = COL_NUMBER; return; }
+        for (int i=0; uvector_types[i].name; i++) {
+            if (strcmp(name, uvector_types[i].name) == 0) {
+                c->kind = COL_UVECTOR;
+                c->klass = uvector_types[i].klass;
+                c->utype = Scm_UVectorType(c->klass);
+                c->eltsize = Scm_UVectorElementSize(c->klass);
+                c->capa = 0;
+                return;
+            }
+        }
+    }
+    Scm_Error("invalid csv column type: %S", type);
+}
+
+static void column_ensure(column *c, ScmSmallInt k)
+{
+    if (k < c->capa) return;
+    ScmSmallInt newcapa = (c->capa == 0)? 256 : c->capa * 2;
+    char *newdata = SCM_NEW_ATOMIC2(char*, newcapa * c->eltsize);
+    if (c->data) memcpy(newdata, c->data, c->capa * c->eltsize);
+    c->data = newdata;
+    c->capa = newcapa;
+    c->view = Scm_MakeUVector(c->klass, newcapa, newdata);
+}
+
+/* Fast path of decimal to double conversion.  If the mantissa fits
+   in 15 digits and the exponent is small enough, both are exactly
+   representable and a single multiplication or division gives the
+   correctly rounded result.  Otherwise returns FALSE, and the caller
+   falls back to the full number parser. */
+static int parse_double_fast(const char *s, const char *end, double *r)
+{
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+        1e22
+    };
+    int neg = FALSE, ndigits = 0, exp10 = 0;
+    int64_t m = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) neg = (*s++ == '-');
+    for (; s < end && isdigit((unsigned char)*s); s++) {
+        if (++ndigits > 15) return FALSE;
+        m = m*10 + (*s - '0');
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && isdigit((unsigned char)*s); s++) {
+            if (++ndigits > 15) return FALSE;
+            m = m*10 + (*s - '0');
+            exp10--;
+        }
+    }
+    if (ndigits == 0) return FALSE;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        int eneg = FALSE, e = 0, edigits = 0;
+        s++;
+        if (s < end && (*s == '-' || *s == '+')) eneg = (*s++ == '-');
+        for (; s < end && isdigit((unsigned char)*s); s++) {
+            if (++edigits > 3) return FALSE;
+            e = e*10 + (*s - '0');
+        }
+        if (edigits == 0) return FALSE;
+        exp10 += eneg? -e : e;
+    }
+    if (s != end) return FALSE;
+    if (exp10 < -22 || exp10 > 22) return FALSE;
+
+    double d = (double)m;
+    if (exp10 < 0) d /= pow10[-exp10];
+    else           d *= pow10[exp10];
+    *r = neg? -d : d;
+    return TRUE;
+}
+
+/* Fast path of decimal integers that fit in int64_t. */
+static int parse_int_fast(const char *s, const char *end, int64_t *r)
+{
+    int neg = FALSE, ndigits = 0;
+    int64_t v = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) neg = (*s++ == '-');
+    for (; s < end && isdigit((unsigned char)*s); s++) {
+        if (++ndigits > 18) return FALSE;
+        v = v*10 + (*s - '0');
+    }
+    if (ndigits == 0 || s != end) return FALSE;
+    *r = neg? -v : v;
+    return TRUE;
+}
+
+static int int_in_range(ScmUVectorType t, int64_t v)
+{
+    switch (t) {
+    case SCM_UVECTOR_S8:  return v >= -128 && v <= 127;
+    case SCM_UVECTOR_U8:  return v >= 0 && v <= 255;
+    case SCM_UVECTOR_S16: return v >= -32768 && v <= 32767;
+    case SCM_UVECTOR_U16: return v >= 0 && v <= 65535;
+    case SCM_UVECTOR_S32: return v >= INT32_MIN && v <= INT32_MAX;
+    case SCM_UVECTOR_U32: return v >= 0 && v <= UINT32_MAX;
+    case SCM_UVECTOR_S64: return TRUE;
+    case SCM_UVECTOR_U64: return v >= 0;
+    default:              return FALSE;
+    }
+}
+
+static void store_int(column *c, ScmSmallInt k, int64_t v)
+{
+    void *p = c->data + k * c->eltsize;
+    switch (c->utype) {
+    case SCM_UVECTOR_S8:  *(int8_t*)p   = (int8_t)v;   break;
+    case SCM_UVECTOR_U8:  *(uint8_t*)p  = (uint8_t)v;  break;
+    case SCM_UVECTOR_S16: *(int16_t*)p  = (int16_t)v;  break;
+    case SCM_UVECTOR_U16: *(uint16_t*)p = (uint16_t)v; break;
+    case SCM_UVECTOR_S32: *(int32_t*)p  = (int32_t)v;  break;
+    case SCM_UVECTOR_U32: *(uint32_t*)p = (uint32_t)v; break;
+    case SCM_UVECTOR_S64: *(int64_t*)p  = v;           break;
+    case SCM_UVECTOR_U64: *(uint64_t*)p = (uint64_t)v; break;
+    default: break;
+    }
+}
+
+static void column_store(column *c, ScmSmallInt k, csv_record *r, int field)
+{
+    const char *s = "", *e = s;
+    if (field < r->nfields) {
+        s = r->buf + r->fields[field*2];
+        e = r->buf + r->fields[field*2+1];
+    }
+
+    switch (c->kind) {
+    case COL_SKIP:
+        return;
+    case COL_STRING:
+        SCM_APPEND1(c->head, c->tail, Scm_MakeString(s, e - s, -1, 0));
+        return;
+    case COL_NUMBER: {
+        int64_t iv;
+        ScmObj v;
+        if (parse_int_fast(s, e, &iv)) {
+            v = Scm_MakeInteger64(iv);
+        } else {
+            v = Scm_StringToNumber(SCM_STRING(Scm_MakeString(s, e-s, -1, 0)),
+                                   10, 0);
+        }
+        SCM_APPEND1(c->head, c->tail, v);
+        return;
+    }
+    }
+
+    /* uvector columns */
+    column_ensure(c, k);
+    if (c->utype == SCM_UVECTOR_F32 || c->utype == SCM_UVECTOR_F64) {
+        double d;
+        if (s == e) {
+            d = SCM_DBL_NAN;
+        } else if (!parse_double_fast(s, e, &d)) {
+            ScmObj str = Scm_MakeString(s, e-s, -1, 0);
+            ScmObj v = Scm_StringToNumber(SCM_STRING(str), 10, 0);
+            if (!SCM_REALP(v)) {
+                Scm_Error("invalid value for %s column: %S",
+                          Scm_UVectorTypeName(c->utype), str);
+            }
+            d = Scm_GetDouble(v);
+        }
+        if (c->utype == SCM_UVECTOR_F32) {
+            ((float*)c->data)[k] = (float)d;
+        } else {
+            ((double*)c->data)[k] = d;
+        }
+        return;
+    }
+    if (c->utype != SCM_UVECTOR_F16) {
+        int64_t iv;
+        if (parse_int_fast(s, e, &iv) && int_in_range(c->utype, iv)) {
+            store_int(c, k, iv);
+            return;
+        }
+    }
+    /* Slow path; let Scm_UVectorSet handle conversion and range check. */
+    ScmObj str = Scm_MakeString(s, e-s, -1, 0);
+    ScmObj v = Scm_StringToNumber(SCM_STRING(str), 10, 0);
+    if (!SCM_REALP(v)) {
+        if (c->utype == SCM_UVECTOR_F16 && s == e) {
+            v = Scm_MakeFlonum(SCM_DBL_NAN);
+        } else {
+            Scm_Error("invalid value for %s column: %S",
+                      Scm_UVectorTypeName(c->utype), str);
+        }
+    }
+    Scm_UVectorSet(SCM_UVECTOR(c->view), c->utype, k, v, SCM_CLAMP_ERROR);
+}
+
+static ScmObj read_columns_body(ScmPort *port, ScmChar sep, ScmChar quo,
+                                ScmObj types, ScmSmallInt max_rows)
+{
+    int ncols = Scm_Length(types);
+    if (ncols < 0) Scm_Error("proper list required, but got: %S", types);
+    column *cols = SCM_NEW_ARRAY(column, ncols);
+    ScmObj cp = types;
+    for (int i=0; i<ncols; i++, cp = SCM_CDR(cp)) {
+        column_init(&cols[i], SCM_CAR(cp));
+    }
+
+    csv_record r;
+    record_init(&r);
+    ScmSmallInt nrows = 0;
+    while (max_rows < 0 || nrows < max_rows) {
+        if (!read_record(port, sep, quo, &r)) {
+            if (nrows == 0) return SCM_EOF;
+            break;
+        }
+        for (int i=0; i<ncols; i++) column_store(&cols[i], nrows, &r, i);
+        nrows++;
+    }
+
+    ScmObj result = Scm_MakeVector(ncols, SCM_FALSE);
+    for (int i=0; i<ncols; i++) {
+        column *c = &cols[i];
+        switch (c->kind) {
+        case COL_STRING:
+        case COL_NUMBER:
+            SCM_VECTOR_ELEMENT(result, i) = Scm_ListToVector(c->head, 0, -1);
+            break;
+        case COL_UVECTOR:
+            SCM_VECTOR_ELEMENT(result, i) =
+                Scm_MakeUVector(c->klass, nrows, (nrows > 0)? c->data : NULL);
+            break;
+        default:
+            break;
+        }
+    }
+    return result;
+}
+
+ScmObj Scm_CsvReadColumns(ScmPort *port, ScmChar sep, ScmChar quo,
+                          ScmObj types, ScmSmallInt max_rows)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj v = SCM_UNDEFINED;
+
+    if (PORT_LOCKED(port, vm)) {
+        v = read_columns_body(port, sep, quo, types, max_rows);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port,
+                       v = read_columns_body(port, sep, quo, types, max_rows),
+                       /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    return v;
+}
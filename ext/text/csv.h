@@ -0,0 +1,50 @@
+/*
+ * csv.h - CSV tokenizer
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_TEXT_CSV_H
+#define GAUCHE_TEXT_CSV_H
+
+#include <gauche.h>
+
+/* Reads one record from PORT and returns a list (or a vector, if
+   AS_VECTOR is true) of fields, or EOF if the input is exhausted. */
+extern ScmObj Scm_CsvReadRecord(ScmPort *port, ScmChar sep, ScmChar quo,
+                                int as_vector);
+
+/* Reads up to MAX_ROWS records (all records if MAX_ROWS < 0), and
+   returns a vector of columns.  TYPES is a list of column types;
+   see csv.c for the details.  Returns EOF if no records are read. */
+extern ScmObj Scm_CsvReadColumns(ScmPort *port, ScmChar sep, ScmChar quo,
+                                 ScmObj types, ScmSmallInt max_rows);
+
+#endif /* GAUCHE_TEXT_CSV_H */
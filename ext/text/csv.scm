@@ -1,7 +1,7 @@
 ;;;
 ;;; csv.scm - read and write CSV (actually, xSV) format.
 ;;;
-;;;   Copyright (c) 2000-2017  Shiro Kawai  <shiro@acm.org>
+;;;   Copyright (c) 2000-2018  Shiro Kawai  <shiro@acm.org>
 ;;;
 ;;;   Redistribution and use in source and binary forms, with or without
 ;;;   modification, are permitted provided that the following conditions
@@ -39,6 +39,7 @@
   (use srfi-42)
   (use gauche.sequence)
   (export make-csv-reader
+          make-csv-column-reader
           make-csv-writer
           make-csv-header-parser
           make-csv-record-parser
@@ -51,49 +52,34 @@
 ;;;
 
 ;; API
-(define (make-csv-reader separator :optional (quote-char #\"))
-  (^[:optional (port (current-input-port))]
-    (csv-reader separator quote-char port)))
-
-(define (csv-reader sep quo port)
-  (define (eor? ch) (or (eqv? ch #\newline) (eof-object? ch)))
-
-  (define (start fields)
-    (let1 ch (read-char port)
-      (cond [(eor? ch) (reverse! (cons "" fields))]
-            [(eqv? ch sep) (start (cons "" fields))]
-            [(eqv? ch quo) (quoted fields)]
-            [(char-whitespace? ch) (start fields)]
-            [else (unquoted (list ch) fields)])))
-
-  (define (unquoted chs fields)
-    (let loop ([ch (read-char port)] [last chs] [chs chs])
-      (cond [(eor? ch) (reverse! (cons (finish last) fields))]
-            [(eqv? ch sep) (start (cons (finish last) fields))]
-            [(char-whitespace? ch) (loop (read-char port) last (cons ch chs))]
-            [else (let1 chs (cons ch chs)
-                    (loop (read-char port) chs chs))])))
-
-  (define (finish rchrs) (list->string (reverse! rchrs)))
-
-  (define (quoted fields)
-    (let loop ([ch (read-char port)] [chs '()])
-      (cond [(eof-object? ch) (error "unterminated quoted field")]
-            [(eqv? ch quo)
-             (if (eqv? (peek-char port) quo)
-               (begin (read-char port) (loop (read-char port) (cons quo chs)))
-               (quoted-tail (cons (finish chs) fields)))]
-            [else (loop (read-char port) (cons ch chs))])))
-
-  (define (quoted-tail fields)
-    (let loop ([ch (read-char port)])
-      (cond [(eor? ch) (reverse! fields)]
-            [(eqv? ch sep) (start fields)]
-            [else (loop (read-char port))])))
-
-  (if (eof-object? (peek-char port))
-    (eof-object)
-    (start '())))
+(define (make-csv-reader separator :optional (quote-char #\") (row-type 'list))
+  (let1 as-vector? (ecase row-type
+                     [(list) #f]
+                     [(vector) #t])
+    (^[:optional (port (current-input-port))]
+      (%csv-read-record port separator quote-char as-vector?))))
+
+;; API
+;; Reads rows into per-column vectors.  Column-types is a list of
+;; string, number, s8, u8, ..., f64, or #f (to skip the column).
+;; Returns a vector of columns, or EOF if no more rows.
+(define (make-csv-column-reader separator column-types
+                                :optional (quote-char #\"))
+  (^[:optional (port (current-input-port)) (max-rows #f)]
+    (%csv-read-columns port separator quote-char column-types
+                       (or max-rows -1))))
+
+(inline-stub
+ "#include \"csv.h\""
+
+ (define-cproc %csv-read-record (port::<input-port> sep::<char> quo::<char>
+                                 as-vector::<boolean>)
+   (return (Scm_CsvReadRecord port sep quo as-vector)))
+
+ (define-cproc %csv-read-columns (port::<input-port> sep::<char> quo::<char>
+                                  types max-rows::<fixnum>)
+   (return (Scm_CsvReadColumns port sep quo types max-rows)))
+ )
 
 ;; API
 (define (make-csv-writer separator :optional
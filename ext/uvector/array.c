@@ -0,0 +1,679 @@
+/*
+ * array.c - strided array engine for gauche.array
+ *
+ *   Copyright (c) 2000-2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * An array of gauche.array is a backing storage (a vector or a uvector)
+ * plus an affine map from an index (i0 ... iN) to a position in the
+ * storage:
+ *
+ *    pos = offset + s0*i0 + s1*i1 + ... + sN*iN
+ *
+ * where Si are the strides.  Every array made by make-array is row-major
+ * and contiguous, but share-array and the views derived from it can
+ * have any strides, including negative ones (reversed axes) and zero
+ * (broadcast axes).
+ *
+ * The routines here take a "view" of an array as a triple of a storage,
+ * the position of the first element, and the strides, and a common
+ * vector of dimension lengths.  They walk the elements in row-major
+ * order one innermost row at a time, after merging adjacent dimensions
+ * that are contiguous in every view involved.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#define EXTUVECTOR_EXPORTS
+#include "gauche/uvector.h"
+#include "uvectorP.h"
+
+/* Maximum number of views an operation walks at once. */
+#define MAX_VIEWS 3
+
+/* Cache block sizes (in elements) for the matrix multiplication. */
+#define MM_BLOCK_I  64
+#define MM_BLOCK_K  128
+#define MM_BLOCK_J  256
+
+/*==================================================================
+ * Index calculation
+ */
+
+static void index_rank_error(ScmS32Vector *start, ScmObj index)
+{
+    Scm_Error("array index must have %d elements, but got: %S",
+              (int)SCM_S32VECTOR_SIZE(start), index);
+}
+
+static ScmSmallInt check_index_element(ScmS32Vector *start,
+                                       ScmS32Vector *end,
+                                       int dim, ScmObj i)
+{
+    if (!SCM_INTP(i)) {
+        Scm_Error("exact integer required for array index, but got: %S", i);
+    }
+    ScmSmallInt k = SCM_INT_VALUE(i);
+    if (k >= SCM_S32VECTOR_ELEMENTS(end)[dim]) {
+        Scm_Error("index of dimension %d is too big: %S", dim, i);
+    }
+    if (k < SCM_S32VECTOR_ELEMENTS(start)[dim]) {
+        Scm_Error("index of dimension %d is too small: %S", dim, i);
+    }
+    return k;
+}
+
+/* Returns the storage position of INDEX, which may be a list, a vector
+   or an s32vector of indices.  Raises an error if INDEX is out of
+   the range [START, END). */
+ScmSmallInt Scm_ArrayStorageIndex(ScmSmallInt offset,
+                                  ScmS32Vector *strides,
+                                  ScmS32Vector *start,
+                                  ScmS32Vector *end,
+                                  ScmObj index)
+{
+    int rank = SCM_S32VECTOR_SIZE(start);
+    const int32_t *s = SCM_S32VECTOR_ELEMENTS(strides);
+    ScmSmallInt pos = offset;
+
+    if (SCM_S32VECTORP(index)) {
+        if (SCM_S32VECTOR_SIZE(index) != rank) index_rank_error(start, index);
+        const int32_t *ii = SCM_S32VECTOR_ELEMENTS(index);
+        for (int k = 0; k < rank; k++) {
+            if (ii[k] >= SCM_S32VECTOR_ELEMENTS(end)[k]) {
+                Scm_Error("index of dimension %d is too big: %d", k, ii[k]);
+            }
+            if (ii[k] < SCM_S32VECTOR_ELEMENTS(start)[k]) {
+                Scm_Error("index of dimension %d is too small: %d", k, ii[k]);
+            }
+            pos += (ScmSmallInt)s[k] * ii[k];
+        }
+    } else if (SCM_VECTORP(index)) {
+        if (SCM_VECTOR_SIZE(index) != rank) index_rank_error(start, index);
+        for (int k = 0; k < rank; k++) {
+            ScmObj i = SCM_VECTOR_ELEMENT(index, k);
+            pos += (ScmSmallInt)s[k] * check_index_element(start, end, k, i);
+        }
+    } else if (SCM_LISTP(index)) {
+        ScmObj cp = index;
+        int k = 0;
+        for (; k < rank && SCM_PAIRP(cp); k++, cp = SCM_CDR(cp)) {
+            ScmObj i = SCM_CAR(cp);
+            pos += (ScmSmallInt)s[k] * check_index_element(start, end, k, i);
+        }
+        if (k < rank || !SCM_NULLP(cp)) index_rank_error(start, index);
+    } else {
+        Scm_Error("list, vector or s32vector required for array index, "
+                  "but got: %S", index);
+    }
+    return pos;
+}
+
+/*==================================================================
+ * Walking views
+ */
+
+typedef struct walker_rec {
+    int rank;                   /* rank after merging dimensions */
+    int nviews;
+    ScmSmallInt size;           /* total number of elements */
+    ScmSmallInt *dims;
+    ScmSmallInt *strides[MAX_VIEWS];
+    ScmSmallInt base[MAX_VIEWS];
+} walker;
+
+/* Sets up a walker over DIMS for NVIEWS views, dropping dimensions of
+   length 1 and merging a dimension into the next one when every view
+   steps through both of them contiguously. */
+static void walker_init(walker *w, ScmS32Vector *dims, int nviews,
+                        const ScmSmallInt *bases, ScmS32Vector **strides)
+{
+    int rank = SCM_S32VECTOR_SIZE(dims);
+    const int32_t *d = SCM_S32VECTOR_ELEMENTS(dims);
+
+    for (int v = 0; v < nviews; v++) {
+        if (SCM_S32VECTOR_SIZE(strides[v]) != rank) {
+            Scm_Error("array strides %S don't match the rank %d",
+                      SCM_OBJ(strides[v]), rank);
+        }
+    }
+    w->nviews = nviews;
+    w->size = 1;
+    w->dims = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, rank+1);
+    for (int v = 0; v < nviews; v++) {
+        w->strides[v] = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, rank+1);
+        w->base[v] = bases[v];
+    }
+
+    int r = 0;
+    for (int k = 0; k < rank; k++) {
+        if (d[k] < 0) Scm_Error("invalid array dimension: %d", d[k]);
+        w->size *= d[k];
+        if (d[k] == 1) continue;
+        if (r > 0) {
+            int mergeable = TRUE;
+            for (int v = 0; v < nviews; v++) {
+                ScmSmallInt sk = SCM_S32VECTOR_ELEMENTS(strides[v])[k];
+                if (w->strides[v][r-1] != sk * d[k]) {
+                    mergeable = FALSE;
+                    break;
+                }
+            }
+            if (mergeable) {
+                w->dims[r-1] *= d[k];
+                for (int v = 0; v < nviews; v++) {
+                    w->strides[v][r-1] = SCM_S32VECTOR_ELEMENTS(strides[v])[k];
+                }
+                continue;
+            }
+        }
+        w->dims[r] = d[k];
+        for (int v = 0; v < nviews; v++) {
+            w->strides[v][r] = SCM_S32VECTOR_ELEMENTS(strides[v])[k];
+        }
+        r++;
+    }
+    if (r == 0) {
+        /* A single element; treat it as one row of length 1. */
+        w->dims[0] = 1;
+        for (int v = 0; v < nviews; v++) w->strides[v][0] = 0;
+        r = 1;
+    }
+    w->rank = r;
+}
+
+/* Makes sure every position VIEW reaches lies in [0, LEN). */
+static void walker_check_range(walker *w, int view, ScmSmallInt len,
+                               ScmObj storage)
+{
+    if (w->size == 0) return;
+    ScmSmallInt lo = w->base[view], hi = w->base[view];
+    for (int k = 0; k < w->rank; k++) {
+        ScmSmallInt span = w->strides[view][k] * (w->dims[k] - 1);
+        if (span < 0) lo += span;
+        else          hi += span;
+    }
+    if (lo < 0 || hi >= len) {
+        Scm_Error("array view [%ld, %ld] exceeds its backing storage "
+                  "of length %ld: %S", (long)lo, (long)hi, (long)len, storage);
+    }
+}
+
+typedef void (*row_proc)(const ScmSmallInt *pos, const ScmSmallInt *step,
+                         ScmSmallInt len, void *data);
+
+/* Calls PROC with the starting positions of each innermost row. */
+static void walker_run(walker *w, row_proc proc, void *data)
+{
+    if (w->size == 0) return;
+
+    int r = w->rank;
+    ScmSmallInt pos[MAX_VIEWS], step[MAX_VIEWS];
+    ScmSmallInt *count = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, r);
+
+    for (int v = 0; v < w->nviews; v++) {
+        pos[v] = w->base[v];
+        step[v] = w->strides[v][r-1];
+    }
+    for (int k = 0; k < r; k++) count[k] = 0;
+
+    for (;;) {
+        proc(pos, step, w->dims[r-1], data);
+        int k = r - 2;
+        for (; k >= 0; k--) {
+            for (int v = 0; v < w->nviews; v++) pos[v] += w->strides[v][k];
+            if (++count[k] < w->dims[k]) break;
+            for (int v = 0; v < w->nviews; v++) {
+                pos[v] -= w->strides[v][k] * w->dims[k];
+            }
+            count[k] = 0;
+        }
+        if (k < 0) break;
+    }
+}
+
+/*==================================================================
+ * Storage indices
+ */
+
+static void indices_row(const ScmSmallInt *pos, const ScmSmallInt *step,
+                        ScmSmallInt len, void *data)
+{
+    int32_t **p = (int32_t**)data;
+    for (ScmSmallInt i = 0; i < len; i++) *(*p)++ = pos[0] + i*step[0];
+}
+
+/* Returns an s32vector of the storage positions of all the elements
+   of the view, in row-major order. */
+ScmObj Scm_ArrayStorageIndices(ScmS32Vector *dims,
+                               ScmSmallInt base, ScmS32Vector *strides)
+{
+    walker w;
+    walker_init(&w, dims, 1, &base, &strides);
+    ScmObj r = Scm_MakeUVector(SCM_CLASS_S32VECTOR, w.size, NULL);
+    int32_t *p = SCM_S32VECTOR_ELEMENTS(r);
+    walker_run(&w, indices_row, &p);
+    return r;
+}
+
+/*==================================================================
+ * Copy
+ */
+
+static ScmSmallInt storage_length(ScmObj s)
+{
+    if (SCM_VECTORP(s)) return SCM_VECTOR_SIZE(s);
+    return SCM_UVECTOR_SIZE(s);
+}
+
+static char *storage_elements(ScmObj s)
+{
+    if (SCM_VECTORP(s)) return (char*)SCM_VECTOR_ELEMENTS(s);
+    return (char*)SCM_UVECTOR_ELEMENTS(s);
+}
+
+static int storage_element_size(ScmObj s)
+{
+    if (SCM_VECTORP(s)) return sizeof(ScmObj);
+    return Scm_UVectorElementSize(Scm_ClassOf(s));
+}
+
+typedef struct copy_data_rec {
+    char *dst;
+    const char *src;
+    int esize;
+} copy_data;
+
+static void copy_row(const ScmSmallInt *pos, const ScmSmallInt *step,
+                     ScmSmallInt len, void *data)
+{
+    copy_data *c = (copy_data*)data;
+    int es = c->esize;
+    char *d = c->dst + pos[0]*es;
+    const char *s = c->src + pos[1]*es;
+
+    if (step[0] == 1 && step[1] == 1) {
+        memmove(d, s, len*es);
+    } else {
+        for (ScmSmallInt i = 0; i < len; i++) {
+            memcpy(d + i*step[0]*es, s + i*step[1]*es, es);
+        }
+    }
+}
+
+/* Copies the elements of the source view into the destination view.
+   Both storages must be of the same class.  Returns FALSE without doing
+   anything if they aren't. */
+int Scm_ArrayCopy(ScmS32Vector *dims,
+                  ScmObj dst, ScmSmallInt dbase, ScmS32Vector *dstrides,
+                  ScmObj src, ScmSmallInt sbase, ScmS32Vector *sstrides)
+{
+    if (!(SCM_VECTORP(dst) || SCM_UVECTORP(dst))) return FALSE;
+    if (!SCM_EQ(Scm_ClassOf(dst), Scm_ClassOf(src))) return FALSE;
+    if (SCM_UVECTORP(dst)) SCM_UVECTOR_CHECK_MUTABLE(dst);
+
+    walker w;
+    ScmSmallInt bases[2] = { dbase, sbase };
+    ScmS32Vector *strides[2] = { dstrides, sstrides };
+    walker_init(&w, dims, 2, bases, strides);
+    walker_check_range(&w, 0, storage_length(dst), dst);
+    walker_check_range(&w, 1, storage_length(src), src);
+
+    copy_data c;
+    c.dst = storage_elements(dst);
+    c.src = storage_elements(src);
+    c.esize = storage_element_size(dst);
+    walker_run(&w, copy_row, &c);
+    return TRUE;
+}
+
+/*==================================================================
+ * Elementwise arithmetic
+ *
+ *  The operands are either views of the same flonum uvector class as
+ *  the destination or real numbers.  Elements are combined in double
+ *  and rounded once when stored, which gives the same result as doing
+ *  the operation with Scheme numbers and storing it with f32vector-set!
+ *  or f64vector-set!.
+ */
+
+typedef struct arith_data_rec {
+    int op;
+    char *d;
+    const char *a;              /* NULL if the operand is a scalar */
+    const char *b;
+    double av, bv;
+} arith_data;
+
+#define ARITH_LOOP(T, X, Y)                                             \
+    do {                                                                \
+        switch (c->op) {                                                \
+        case '+':                                                       \
+            for (i = 0; i < len; i++) d[i*ds] = (T)((X) + (Y));         \
+            break;                                                      \
+        case '-':                                                       \
+            for (i = 0; i < len; i++) d[i*ds] = (T)((X) - (Y));         \
+            break;                                                      \
+        case '*':                                                       \
+            for (i = 0; i < len; i++) d[i*ds] = (T)((X) * (Y));         \
+            break;                                                      \
+        default:                                                        \
+            for (i = 0; i < len; i++) d[i*ds] = (T)((X) / (Y));         \
+            break;                                                      \
+        }                                                               \
+    } while (0)
+
+#define DEFINE_ARITH_ROW(name, T)                                       \
+static void name(const ScmSmallInt *pos, const ScmSmallInt *step,       \
+                 ScmSmallInt len, void *data)                           \
+{                                                                       \
+    arith_data *c = (arith_data*)data;                                  \
+    T *d = (T*)c->d + pos[0];                                           \
+    ScmSmallInt ds = step[0], i;                                        \
+    int v = 1;                                                          \
+    const T *a = NULL, *b = NULL;                                       \
+    ScmSmallInt as = 0, bs = 0;                                         \
+    double av = c->av, bv = c->bv;                                      \
+                                                                        \
+    if (c->a) { a = (const T*)c->a + pos[v]; as = step[v]; v++; }       \
+    if (c->b) { b = (const T*)c->b + pos[v]; bs = step[v]; }            \
+                                                                        \
+    if (a && b) ARITH_LOOP(T, (double)a[i*as], (double)b[i*bs]);        \
+    else if (a) ARITH_LOOP(T, (double)a[i*as], bv);                     \
+    else if (b) ARITH_LOOP(T, av, (double)b[i*bs]);                     \
+    else        ARITH_LOOP(T, av, bv);                                  \
+}
+
+DEFINE_ARITH_ROW(arith_row_f32, float)
+DEFINE_ARITH_ROW(arith_row_f64, double)
+
+/* Stores A op B into the destination view, where op is one of the
+   characters + - * /.  Returns FALSE without doing anything if the
+   operands can't be handled here; the caller should fall back to
+   the generic path then. */
+int Scm_ArrayArith(int op, ScmS32Vector *dims,
+                   ScmObj dst, ScmSmallInt dbase, ScmS32Vector *dstrides,
+                   ScmObj a, ScmSmallInt abase, ScmS32Vector *astrides,
+                   ScmObj b, ScmSmallInt bbase, ScmS32Vector *bstrides)
+{
+    ScmClass *klass = Scm_ClassOf(dst);
+    row_proc proc;
+
+    if (SCM_EQ(klass, SCM_CLASS_F32VECTOR))      proc = arith_row_f32;
+    else if (SCM_EQ(klass, SCM_CLASS_F64VECTOR)) proc = arith_row_f64;
+    else return FALSE;
+
+    if (!(op == '+' || op == '-' || op == '*' || op == '/')) {
+        Scm_Error("invalid array arithmetic operator: %C", op);
+    }
+    if (!(SCM_REALP(a) || SCM_EQ(Scm_ClassOf(a), klass))) return FALSE;
+    if (!(SCM_REALP(b) || SCM_EQ(Scm_ClassOf(b), klass))) return FALSE;
+    SCM_UVECTOR_CHECK_MUTABLE(dst);
+
+    walker w;
+    ScmSmallInt bases[MAX_VIEWS];
+    ScmS32Vector *strides[MAX_VIEWS];
+    int nviews = 0;
+    arith_data c;
+
+    c.op = op;
+    c.d = SCM_UVECTOR_ELEMENTS(dst);
+    c.a = c.b = NULL;
+    c.av = c.bv = 0.0;
+    bases[nviews] = dbase; strides[nviews++] = dstrides;
+    if (SCM_REALP(a)) {
+        c.av = Scm_GetDouble(a);
+    } else {
+        c.a = SCM_UVECTOR_ELEMENTS(a);
+        bases[nviews] = abase; strides[nviews++] = astrides;
+    }
+    if (SCM_REALP(b)) {
+        c.bv = Scm_GetDouble(b);
+    } else {
+        c.b = SCM_UVECTOR_ELEMENTS(b);
+        bases[nviews] = bbase; strides[nviews++] = bstrides;
+    }
+
+    walker_init(&w, dims, nviews, bases, strides);
+    walker_check_range(&w, 0, SCM_UVECTOR_SIZE(dst), dst);
+    int v = 1;
+    if (c.a) { walker_check_range(&w, v, SCM_UVECTOR_SIZE(a), a); v++; }
+    if (c.b) { walker_check_range(&w, v, SCM_UVECTOR_SIZE(b), b); }
+    walker_run(&w, proc, &c);
+    return TRUE;
+}
+
+/*==================================================================
+ * Linear algebra on flonum matrices
+ *
+ *  Matrices are packed into contiguous row-major double buffers first,
+ *  so that the kernels don't need to care about strides or the
+ *  element type.
+ */
+
+static int flonum_storage_p(ScmObj s)
+{
+    return SCM_F32VECTORP(s) || SCM_F64VECTORP(s);
+}
+
+/* Packs an N x M view of a flonum storage into a row-major buffer. */
+static double *pack_matrix(ScmObj s, ScmSmallInt base,
+                           ScmS32Vector *strides, int n, int m)
+{
+    if (SCM_S32VECTOR_SIZE(strides) != 2) {
+        Scm_Error("matrix strides must have two elements, but got: %S",
+                  SCM_OBJ(strides));
+    }
+    ScmSmallInt rs = SCM_S32VECTOR_ELEMENTS(strides)[0];
+    ScmSmallInt cs = SCM_S32VECTOR_ELEMENTS(strides)[1];
+    double *r = SCM_NEW_ATOMIC_ARRAY(double, (size_t)n*m + 1);
+
+    if (n > 0 && m > 0) {
+        ScmSmallInt lo = base, hi = base;
+        if (rs < 0) lo += rs*(n-1); else hi += rs*(n-1);
+        if (cs < 0) lo += cs*(m-1); else hi += cs*(m-1);
+        if (lo < 0 || hi >= SCM_UVECTOR_SIZE(s)) {
+            Scm_Error("matrix view [%ld, %ld] exceeds its backing storage "
+                      "of length %ld: %S", (long)lo, (long)hi,
+                      (long)SCM_UVECTOR_SIZE(s), s);
+        }
+    }
+    if (SCM_F32VECTORP(s)) {
+        const float *e = SCM_F32VECTOR_ELEMENTS(s);
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < m; j++)
+                r[(size_t)i*m+j] = e[base + i*rs + j*cs];
+    } else {
+        const double *e = SCM_F64VECTOR_ELEMENTS(s);
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < m; j++)
+                r[(size_t)i*m+j] = e[base + i*rs + j*cs];
+    }
+    return r;
+}
+
+/* Stores a row-major buffer of LEN doubles into a contiguous flonum
+   storage. */
+static void unpack_matrix(ScmObj s, const double *r, size_t len)
+{
+    if ((size_t)SCM_UVECTOR_SIZE(s) < len) {
+        Scm_Error("storage too small for the result matrix: %S", s);
+    }
+    SCM_UVECTOR_CHECK_MUTABLE(s);
+    if (SCM_F32VECTORP(s)) {
+        float *e = SCM_F32VECTOR_ELEMENTS(s);
+        for (size_t i = 0; i < len; i++) e[i] = (float)r[i];
+    } else {
+        memcpy(SCM_F64VECTOR_ELEMENTS(s), r, len*sizeof(double));
+    }
+}
+
+/* C = A * B, where A is N x M and B is M x P, all row-major.  The loops
+   are blocked so that a strip of B stays in cache while it is reused,
+   and the innermost loop runs along contiguous rows of B and C.  Each
+   element of C still accumulates its terms in the order of k. */
+static void matmul_blocked(double *c, const double *a, const double *b,
+                           int n, int m, int p)
+{
+    for (size_t i = 0; i < (size_t)n*p; i++) c[i] = 0.0;
+
+    for (int i0 = 0; i0 < n; i0 += MM_BLOCK_I) {
+        int i1 = (i0 + MM_BLOCK_I < n)? i0 + MM_BLOCK_I : n;
+        for (int k0 = 0; k0 < m; k0 += MM_BLOCK_K) {
+            int k1 = (k0 + MM_BLOCK_K < m)? k0 + MM_BLOCK_K : m;
+            for (int j0 = 0; j0 < p; j0 += MM_BLOCK_J) {
+                int j1 = (j0 + MM_BLOCK_J < p)? j0 + MM_BLOCK_J : p;
+                for (int i = i0; i < i1; i++) {
+                    double *ci = c + (size_t)i*p;
+                    for (int k = k0; k < k1; k++) {
+                        double aik = a[(size_t)i*m + k];
+                        const double *bk = b + (size_t)k*p;
+                        for (int j = j0; j < j1; j++) ci[j] += aik * bk[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Multiplies the N x M view of A by the M x P view of B and stores the
+   result into C, a contiguous row-major storage.  Returns FALSE if the
+   storages aren't flonum uvectors. */
+int Scm_ArrayMatMul(ScmObj c,
+                    ScmObj a, ScmSmallInt abase, ScmS32Vector *astrides,
+                    ScmObj b, ScmSmallInt bbase, ScmS32Vector *bstrides,
+                    int n, int m, int p)
+{
+    if (!flonum_storage_p(a) || !flonum_storage_p(b) || !flonum_storage_p(c))
+        return FALSE;
+    if (n < 0 || m < 0 || p < 0) {
+        Scm_Error("invalid matrix dimensions: %dx%d * %dx%d", n, m, m, p);
+    }
+    double *pa = pack_matrix(a, abase, astrides, n, m);
+    double *pb = pack_matrix(b, bbase, bstrides, m, p);
+    double *pc = SCM_NEW_ATOMIC_ARRAY(double, (size_t)n*p + 1);
+    matmul_blocked(pc, pa, pb, n, m, p);
+    unpack_matrix(c, pc, (size_t)n*p);
+    return TRUE;
+}
+
+/* LU decomposition with partial pivoting, in place on the N x N matrix
+   LU.  PERM receives the row permutation.  Returns the sign of the
+   permutation, or 0 if the matrix is singular. */
+static int lu_decompose(double *lu, int *perm, int n)
+{
+    int sign = 1;
+    for (int i = 0; i < n; i++) perm[i] = i;
+
+    for (int k = 0; k < n; k++) {
+        int piv = k;
+        double max = fabs(lu[(size_t)k*n + k]);
+        for (int i = k+1; i < n; i++) {
+            double v = fabs(lu[(size_t)i*n + k]);
+            if (v > max) { max = v; piv = i; }
+        }
+        if (max == 0.0) return 0;
+        if (piv != k) {
+            double *rk = lu + (size_t)k*n, *rp = lu + (size_t)piv*n;
+            for (int j = 0; j < n; j++) {
+                double t = rk[j]; rk[j] = rp[j]; rp[j] = t;
+            }
+            int t = perm[k]; perm[k] = perm[piv]; perm[piv] = t;
+            sign = -sign;
+        }
+        const double *rk = lu + (size_t)k*n;
+        double pivot = rk[k];
+        for (int i = k+1; i < n; i++) {
+            double *ri = lu + (size_t)i*n;
+            double f = ri[k] / pivot;
+            ri[k] = f;
+            if (f == 0.0) continue;
+            for (int j = k+1; j < n; j++) ri[j] -= f * rk[j];
+        }
+    }
+    return sign;
+}
+
+/* Computes the inverse of the N x N view of A into DST, a contiguous
+   row-major flonum storage.  Returns FALSE if A is singular. */
+int Scm_ArrayInverse(ScmObj dst,
+                     ScmObj a, ScmSmallInt abase, ScmS32Vector *astrides,
+                     int n)
+{
+    if (!flonum_storage_p(a) || !flonum_storage_p(dst)) {
+        Scm_Error("flonum uniform vectors required, but got %S and %S",
+                  a, dst);
+    }
+    double *lu = pack_matrix(a, abase, astrides, n, n);
+    int *perm = SCM_NEW_ATOMIC_ARRAY(int, n+1);
+    if (n > 0 && lu_decompose(lu, perm, n) == 0) return FALSE;
+
+    /* Solve LU x = P e_j for each column j of the identity. */
+    double *inv = SCM_NEW_ATOMIC_ARRAY(double, (size_t)n*n + 1);
+    double *col = SCM_NEW_ATOMIC_ARRAY(double, n+1);
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) col[i] = (perm[i] == j)? 1.0 : 0.0;
+        for (int i = 0; i < n; i++) {
+            const double *ri = lu + (size_t)i*n;
+            double s = col[i];
+            for (int k = 0; k < i; k++) s -= ri[k] * col[k];
+            col[i] = s;
+        }
+        for (int i = n-1; i >= 0; i--) {
+            const double *ri = lu + (size_t)i*n;
+            double s = col[i];
+            for (int k = i+1; k < n; k++) s -= ri[k] * col[k];
+            col[i] = s / ri[i];
+        }
+        for (int i = 0; i < n; i++) inv[(size_t)i*n + j] = col[i];
+    }
+    unpack_matrix(dst, inv, (size_t)n*n);
+    return TRUE;
+}
+
+/* Returns the determinant of the N x N view of A. */
+double Scm_ArrayDeterminant(ScmObj a, ScmSmallInt abase,
+                            ScmS32Vector *astrides, int n)
+{
+    if (!flonum_storage_p(a)) {
+        Scm_Error("flonum uniform vector required, but got %S", a);
+    }
+    double *lu = pack_matrix(a, abase, astrides, n, n);
+    int *perm = SCM_NEW_ATOMIC_ARRAY(int, n+1);
+    int sign = (n > 0)? lu_decompose(lu, perm, n) : 1;
+    if (sign == 0) return 0.0;
+    double r = sign;
+    for (int i = 0; i < n; i++) r *= lu[(size_t)i*n + i];
+    return r;
+}
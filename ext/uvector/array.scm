@@ -16,6 +16,8 @@
 
 ;; Conceptually, an array is a backing storage and a procedure to
 ;; map n-dimensional indices to an index of the backing storage.
+;; The map is always affine, so we keep it as an offset and a vector
+;; of strides, which the native routines in array.c can walk directly.
 
 (define-module gauche.array
   (use srfi-1)
@@ -41,6 +43,7 @@
           make-f16array make-f32array make-f64array
           u8array s8array u16array s16array u32array s32array
           u64array s64array f16array f32array f64array
+          array-view-transpose array-view-slice array-broadcast
           array-concatenate array-transpose array-rotate-90 array-flip array-flip!
           identity-array array-inverse determinant determinant! array-mul array-expt
           array-div-left array-div-right array-add-elements array-add-elements!
@@ -49,6 +52,14 @@
           ))
 (select-module gauche.array)
 
+(define %array-storage-index   (with-module gauche.uvector %array-storage-index))
+(define %array-storage-indices (with-module gauche.uvector %array-storage-indices))
+(define %array-copy!           (with-module gauche.uvector %array-copy!))
+(define %array-arith!          (with-module gauche.uvector %array-arith!))
+(define %array-matmul!         (with-module gauche.uvector %array-matmul!))
+(define %array-inverse!        (with-module gauche.uvector %array-inverse!))
+(define %array-determinant     (with-module gauche.uvector %array-determinant))
+
 (autoload "gauche/matrix"
   array-concatenate array-transpose array-rotate-90 array-flip array-flip!
   identity-array array-inverse determinant determinant! array-mul array-expt
@@ -75,7 +86,7 @@
     (when name
       (define-method write-object ((self class) port)
         (format port "#,(~A ~S" name (array->list (array-shape self)))
-        (array-for-each (cut format port " ~S" <>) self)
+        (for-each (cut format port " ~S" <>) (array->list self))
         (format port ")"))
       (define-reader-ctor name
         (^[sh . inits]
@@ -85,6 +96,13 @@
 (define-class <array-base> ()
   ((start-vector    :init-keyword :start-vector :getter start-vector-of)
    (end-vector      :init-keyword :end-vector   :getter end-vector-of)
+   ;; The storage index of (i0 ... iN) is offset + s0*i0 + ... + sN*iN,
+   ;; where #s32(s0 ... sN) is strides.  If strides is #f, we only have
+   ;; the mapper procedure.
+   (offset          :init-keyword :offset       :getter offset-of
+                    :init-value 0)
+   (strides         :init-keyword :strides      :getter strides-of
+                    :init-value #f)
    (mapper          :init-keyword :mapper       :getter mapper-of)
    (getter          :getter getter-of)
    (setter          :getter setter-of)
@@ -98,7 +116,13 @@
         [set   (backing-storage-setter-of (class-of self))]
         [store (backing-storage-of self)])
     (set! (slot-ref self 'getter) (^[index] (get store index)))
-    (set! (slot-ref self 'setter) (^[index value] (set store index value)))))
+    (set! (slot-ref self 'setter) (^[index value] (set store index value))))
+  (and-let* ([strides (strides-of self)]
+             [offset  (offset-of self)]
+             [Vb      (start-vector-of self)]
+             [Ve      (end-vector-of self)])
+    (set! (slot-ref self 'mapper)
+          (^[Vi] (%array-storage-index offset strides Vb Ve Vi)))))
 
 (define-class <array> (<array-base>)
   ()
@@ -188,6 +212,8 @@
   (make (class-of self)
     :start-vector (start-vector-of self)
     :end-vector   (end-vector-of self)
+    :offset       (offset-of self)
+    :strides      (strides-of self)
     :mapper       (mapper-of self)
     :backing-storage (copy-object (backing-storage-of self))))
 
@@ -211,43 +237,67 @@
 ;;  Given begin-vector Vb = #s32(b0 b1 ... bN)
 ;;        end-vector   Ve = #s32(e0 e1 ... eN)
 ;;        where b0 <= e0, ..., bN <= eN
-;;  Returns a procedure,
-;;    which calculates 1-dimentional offset off to the backing storage,
-;;          from given index vector #s32(i0 i1 ... iN)
+;;  the storage index of the index #s32(i0 i1 ... iN) is
 ;;
-;;  Pre-calculation:
-;;    sizes          s0 = e0 - b0, s1 = e1 - b1 ...
-;;    coefficients   c0   = s1 * s2 * ... * sN
-;;                   c1   = s2 * ... * sN
-;;                   cN-1 = sN
-;;                   cN   = 1
+;;   off = offset + s0*i0 + s1*i1 + .. + sN*iN
 ;;
-;;  Mapping
-;;   off = c0*(i0-b0) + c1*(i1-b1) + .. + cN*(iN-bN)
+;;  For a freshly allocated array, the elements are in row-major order:
+;;    sizes          z0 = e0 - b0, z1 = e1 - b1 ...
+;;    strides        s0   = z1 * z2 * ... * zN
+;;                   s1   = z2 * ... * zN
+;;                   sN-1 = zN
+;;                   sN   = 1
+;;    offset         - (s0*b0 + s1*b1 + ... + sN*bN)
 ;;
+;;  Shared arrays compose their affine map with the original one, so
+;;  they have the same form with arbitrary (even zero or negative)
+;;  strides.  The index calculation itself is done in C
+;;  (%array-storage-index).
 ;;
 
-(define (zero-vector? vec)
-  (not (s32vector-range-check vec 0 0)))
-
-(define (generate-amap Vb Ve)
+;; Returns strides and offset of the row-major layout of [Vb, Ve).
+(define (row-major-layout Vb Ve)
   (let* ([rank    (s32vector-length Vb)]
-         [indices (iota rank)]
          [Vs      (s32vector-sub Ve Vb)]
-         [-Vb     (map-to <s32vector> - Vb)]
-         [Ve-1    (s32vector-sub Ve 1)]
-         [vcl     (fold-right (^[sN l] (cons (* sN (car l)) l))
-                              '(1)
-                              (s32vector->list Vs))]
-         [Vc      (coerce-to <s32vector> (cdr vcl))])
-    (^[Vi]
-      (cond [(s32vector-range-check Ve-1 Vi #f)
-             => (^i (errorf "index of dimension ~s is too big: ~s"
-                            i (ref Vi i)))]
-            [(s32vector-range-check Vb #f Vi)
-             => (^i (errorf "index of dimension ~s is too small: ~s"
-                            i (ref Vi i)))]
-            [else (s32vector-dot Vc (s32vector-add -Vb Vi))]))))
+         [strides (make-s32vector rank 1)])
+    (do ([k (- rank 2) (- k 1)])
+        [(< k 0)]
+      (s32vector-set! strides k (* (s32vector-ref strides (+ k 1))
+                                   (s32vector-ref Vs (+ k 1)))))
+    (values strides (- (s32vector-dot strides Vb)))))
+
+;; Lengths of each dimension of AR.
+(define (array-dimensions ar)
+  (s32vector-sub (end-vector-of ar) (start-vector-of ar)))
+
+;; The storage index of the first element of AR (which may not exist
+;; if AR is empty).
+(define (array-base-index ar)
+  (+ (offset-of ar) (s32vector-dot (strides-of ar) (start-vector-of ar))))
+
+;; Returns an s32vector of the storage indices of all the elements
+;; in row-major order, or #f if AR doesn't have strides.
+(define (array-storage-indices ar)
+  (and (strides-of ar)
+       (%array-storage-indices (array-dimensions ar)
+                               (array-base-index ar)
+                               (strides-of ar))))
+
+;; Returns #t iff AR occupies the whole backing storage in row-major
+;; order, i.e. walking the storage is the same as walking AR.
+(define (array-plain? ar)
+  (and (strides-of ar)
+       (receive (strides offset)
+           (row-major-layout (start-vector-of ar) (end-vector-of ar))
+         (and (= offset (offset-of ar))
+              (equal? strides (strides-of ar))
+              (= ((backing-storage-length-of (class-of ar))
+                  (backing-storage-of ar))
+                 (array-size ar))))))
+
+(define (same-shape? a b)
+  (and (equal? (start-vector-of a) (start-vector-of b))
+       (equal? (end-vector-of a) (end-vector-of b))))
 
 ;; shape index tests
 
@@ -303,7 +353,8 @@
       (make <array>
         :start-vector (s32vector 0 0)
         :end-vector (s32vector rank 2)
-        :mapper (^[Vi] (s32vector-dot (s32vector 2 1) Vi))
+        :offset 0
+        :strides (s32vector 2 1)
         :backing-storage (list->vector args)))))
 
 (define (shape->start/end-vector shape)
@@ -325,13 +376,15 @@
 
 (define (make-array-internal class shape . maybe-init)
   (receive (Vb Ve) (shape->start/end-vector shape)
-    (make class
-      :start-vector Vb
-      :end-vector Ve
-      :mapper (generate-amap Vb Ve)
-      :backing-storage (apply (backing-storage-creator-of class)
-                              (fold * 1 (s32vector-sub Ve Vb))
-                              maybe-init))))
+    (receive (strides offset) (row-major-layout Vb Ve)
+      (make class
+        :start-vector Vb
+        :end-vector Ve
+        :offset offset
+        :strides strides
+        :backing-storage (apply (backing-storage-creator-of class)
+                                (fold * 1 (s32vector-sub Ve Vb))
+                                maybe-init)))))
 
 (define (list-fill-array! a inits)
   (let* ([bv  (backing-storage-of a)]
@@ -363,11 +416,23 @@
     (let* ([rank (s32vector-length Vb)]
            [Vb2 (make-s32vector rank 0)]
            [Ve2 (s32vector-sub Ve Vb)]
-           [new-shape (start/end-vector->shape Vb2 Ve2)])
-      (tabulate-array new-shape
-                      (^[ind] (array-ref ar (s32vector->vector
-                                             (s32vector-add Vb ind))))
-                      (make-vector rank)))))
+           [new-shape (start/end-vector->shape Vb2 Ve2)]
+           [offsets (s32vector->list Vb)])
+      (array-copy-elements! (make-array new-shape)
+                            (share-array ar new-shape
+                                         (^ ind (apply values
+                                                       (map + ind offsets))))))))
+
+;; Copies the elements of SRC into DST of the same shape, and returns DST.
+(define (array-copy-elements! dst src)
+  (unless (and (strides-of dst) (strides-of src)
+               (%array-copy! (array-dimensions dst)
+                             (backing-storage-of dst) (array-base-index dst)
+                             (strides-of dst)
+                             (backing-storage-of src) (array-base-index src)
+                             (strides-of src)))
+    (array-map! dst identity src))
+  dst)
 
 (define (array? obj)
   (is-a? obj <array-base>))
@@ -457,14 +522,116 @@
   (^[Vi] (omap (map (^[ci cvec] (+ ci (s32vector-dot cvec Vi)))
                     constants coeffs))))
 
+;; Checks that the affine map given by constants and coefficients sends
+;; every index in [Vb, Ve) into the index range of ARRAY.  Since the map
+;; is affine, we only need to look at the extremes of each dimension.
+(define (check-shared-range array Vb Ve constants coeffs)
+  (unless (s32vector-range-check Vb #f (s32vector-sub Ve 1)) ; non-empty
+    (for-each
+     (^[dim c cvec]
+       (let loop ([i 0] [lo c] [hi c])
+         (if (< i (s32vector-length cvec))
+           (let ([x (* (s32vector-ref cvec i) (s32vector-ref Vb i))]
+                 [y (* (s32vector-ref cvec i) (- (s32vector-ref Ve i) 1))])
+             (loop (+ i 1) (+ lo (min x y)) (+ hi (max x y))))
+           (unless (and (<= (array-start array dim) lo)
+                        (< hi (array-end array dim)))
+             (errorf "share-array: index of dimension ~s mapped out of range: ~s"
+                     dim (if (< lo (array-start array dim)) lo hi))))))
+     (iota (length constants)) constants coeffs)))
+
 (define (share-array array shape proc)
   (receive (Vb Ve) (shape->start/end-vector shape)
     (receive (constants coeffs) (affine-proc->coeffs proc (size-of Vb))
-      (make (class-of array)
-        :start-vector Vb
-        :end-vector   Ve
-        :mapper (generate-shared-map (mapper-of array) constants coeffs)
-        :backing-storage (backing-storage-of array)))))
+      (if-let1 strides (strides-of array)
+        (let1 rank (size-of Vb)
+          (check-shared-range array Vb Ve constants coeffs)
+          (make (class-of array)
+            :start-vector Vb
+            :end-vector   Ve
+            :offset  (+ (offset-of array)
+                        (s32vector-dot strides (list->s32vector constants)))
+            :strides (fold (^[s cvec acc] (s32vector-add acc (s32vector-mul cvec s)))
+                           (make-s32vector rank 0)
+                           (s32vector->list strides) coeffs)
+            :backing-storage (backing-storage-of array)))
+        (make (class-of array)
+          :start-vector Vb
+          :end-vector   Ve
+          :mapper (generate-shared-map (mapper-of array) constants coeffs)
+          :backing-storage (backing-storage-of array))))))
+
+;;---------------------------------------------------------------
+;; Views
+;;   These return arrays sharing the backing storage with the original,
+;;   just as share-array does, but are much cheaper to create.
+;;
+
+(define (array-view-transpose array :optional (dim1 0) (dim2 1))
+  (let ([Vb (s32vector-copy (start-vector-of array))]
+        [Ve (s32vector-copy (end-vector-of array))])
+    (define (swap! v)
+      (let1 tmp (s32vector-ref v dim1)
+        (s32vector-set! v dim1 (s32vector-ref v dim2))
+        (s32vector-set! v dim2 tmp)))
+    (swap! Vb)
+    (swap! Ve)
+    (share-array array (start/end-vector->shape Vb Ve)
+                 (^ind (let1 v (list->vector ind)
+                         (vector-set! v dim1 (list-ref ind dim2))
+                         (vector-set! v dim2 (list-ref ind dim1))
+                         (apply values (vector->list v)))))))
+
+;; Returns a view of ARRAY where the dimension DIM is restricted to
+;; START, START+STEP, ... below END (above END if STEP is negative),
+;; renumbered from 0.
+(define (array-view-slice array dim start end :optional (step 1))
+  (when (zero? step)
+    (error "array-view-slice: step must not be zero"))
+  (let* ([n  (max 0 (quotient (+ (- end start) step (if (> step 0) -1 1))
+                              step))]
+         [Vb (s32vector-copy (start-vector-of array))]
+         [Ve (s32vector-copy (end-vector-of array))])
+    (s32vector-set! Vb dim 0)
+    (s32vector-set! Ve dim n)
+    (share-array array (start/end-vector->shape Vb Ve)
+                 (^ind (let1 v (list->vector ind)
+                         (vector-set! v dim (+ start (* step (list-ref ind dim))))
+                         (apply values (vector->list v)))))))
+
+;; Returns a view of ARRAY with the shape SHAPE, following the usual
+;; broadcasting rule: dimensions are matched from the last one, and
+;; a dimension of ARRAY must either have the same length as the
+;; corresponding one of SHAPE or have the length 1, in which case the
+;; element is repeated.  SHAPE may have more dimensions than ARRAY.
+(define (array-broadcast array shape)
+  (receive (Vb Ve) (shape->start/end-vector shape)
+    (let* ([rank  (s32vector-length Vb)]
+           [orank (array-rank array)]
+           [skip  (- rank orank)])
+      (when (< skip 0)
+        (errorf "can't broadcast an array of rank ~s to rank ~s" orank rank))
+      (let1 dims
+          (map (^[k]
+                 (let ([olen (array-length array k)]
+                       [len  (- (s32vector-ref Ve (+ k skip))
+                                (s32vector-ref Vb (+ k skip)))])
+                   (cond [(= olen len) #t]
+                         [(= olen 1) #f]
+                         [else (errorf "can't broadcast shape ~s to ~s"
+                                       (array->list (array-shape array))
+                                       (array->list shape))])))
+               (iota orank))
+        (share-array array shape
+                     (^ind (apply values
+                                  (map (^[k i follow?]
+                                         (if follow?
+                                           (+ (- i (s32vector-ref Vb (+ k skip)))
+                                              (array-start array k))
+                                           (array-start array k)))
+                                       (iota orank)
+                                       (drop ind skip)
+                                       dims))))))))
 
 ;;---------------------------------------------------------------
 ;; Array utilities
@@ -510,17 +677,24 @@
            (proc (vector-ref vec 0) (vector-ref vec 1) (vector-ref vec 2)))]
     [else (^[proc vec] (apply proc (vector->list vec)))]))
 
+;; Returns a sequence of the elements of AR; the backing storage itself
+;; if possible.
+(define (array-elements ar)
+  (if (or (array-plain? ar) (not (strides-of ar)))
+    (backing-storage-of ar)
+    (array->list ar)))
+
 (define (array-for-each proc ar)
-  (for-each proc (backing-storage-of ar)))
+  (for-each proc (array-elements ar)))
 
 (define (array-any pred ar)
   (let/cc found
-    (for-each (^x (if (pred x) (found #t))) (backing-storage-of ar))
+    (for-each (^x (if (pred x) (found #t))) (array-elements ar))
     #f))
 
 (define (array-every pred ar)
   (let/cc found
-    (for-each (^x (if (not (pred x)) (found #f))) (backing-storage-of ar))
+    (for-each (^x (if (not (pred x)) (found #f))) (array-elements ar))
     #t))
 
 ;; repeat construct
@@ -643,6 +817,19 @@
   (apply array-map! ar proc ar0 more-arrays))
 
 (define-method array-map! ((ar <array-base>) (proc <procedure>) ar0)
+  (if (and (same-shape? ar ar0) (strides-of ar) (strides-of ar0))
+    (let ([set (backing-storage-setter-of (class-of ar))]
+          [store (backing-storage-of ar)]
+          [ix (array-storage-indices ar)]
+          [get0 (backing-storage-getter-of (class-of ar0))]
+          [store0 (backing-storage-of ar0)]
+          [ix0 (array-storage-indices ar0)])
+      (dotimes [k (s32vector-length ix)]
+        (set store (s32vector-ref ix k)
+             (proc (get0 store0 (s32vector-ref ix0 k))))))
+    (array-map-1-generic! ar proc ar0)))
+
+(define (array-map-1-generic! ar proc ar0)
   (let ([set (backing-storage-setter-of (class-of ar))]
         [store (backing-storage-of ar)]
         [mapper (mapper-of ar)]
@@ -654,6 +841,24 @@
       (make-vector (array-rank ar)))))
 
 (define-method array-map! ((ar <array-base>) (proc <procedure>) ar0 ar1)
+  (if (and (same-shape? ar ar0) (same-shape? ar ar1)
+           (strides-of ar) (strides-of ar0) (strides-of ar1))
+    (let ([set (backing-storage-setter-of (class-of ar))]
+          [store (backing-storage-of ar)]
+          [ix (array-storage-indices ar)]
+          [get0 (backing-storage-getter-of (class-of ar0))]
+          [store0 (backing-storage-of ar0)]
+          [ix0 (array-storage-indices ar0)]
+          [get1 (backing-storage-getter-of (class-of ar1))]
+          [store1 (backing-storage-of ar1)]
+          [ix1 (array-storage-indices ar1)])
+      (dotimes [k (s32vector-length ix)]
+        (set store (s32vector-ref ix k)
+             (proc (get0 store0 (s32vector-ref ix0 k))
+                   (get1 store1 (s32vector-ref ix1 k))))))
+    (array-map-2-generic! ar proc ar0 ar1)))
+
+(define (array-map-2-generic! ar proc ar0 ar1)
   (let ([set (backing-storage-setter-of (class-of ar))]
         [store (backing-storage-of ar)]
         [mapper (mapper-of ar)]
@@ -684,16 +889,29 @@
     (apply array-map! target proc ar0 more)))
 
 (define (array->vector ar)
-  (with-builder (<vector> add! get :size (array-size ar))
-    (array-for-each-index ar
-      (^[ind] (add! (array-ref ar ind)))
-      (make-vector (array-rank ar)))
-    (get)))
+  (if-let1 ix (array-storage-indices ar)
+    (let ([get (backing-storage-getter-of (class-of ar))]
+          [store (backing-storage-of ar)])
+      (rlet1 v (make-vector (s32vector-length ix))
+        (dotimes [k (s32vector-length ix)]
+          (vector-set! v k (get store (s32vector-ref ix k))))))
+    (with-builder (<vector> add! get :size (array-size ar))
+      (array-for-each-index ar
+        (^[ind] (add! (array-ref ar ind)))
+        (make-vector (array-rank ar)))
+      (get))))
 
 (define (array->list ar)
-  (with-builder (<list> add! get)
-    (array-for-each-index ar
-      (^[ind] (add! (array-ref ar ind)))
-      (make-vector (array-rank ar)))
-    (get)))
+  (if-let1 ix (array-storage-indices ar)
+    (let ([get (backing-storage-getter-of (class-of ar))]
+          [store (backing-storage-of ar)])
+      (let loop ([k (- (s32vector-length ix) 1)] [r '()])
+        (if (< k 0)
+          r
+          (loop (- k 1) (cons (get store (s32vector-ref ix k)) r)))))
+    (with-builder (<list> add! get)
+      (array-for-each-index ar
+        (^[ind] (add! (array-ref ar ind)))
+        (make-vector (array-rank ar)))
+      (get))))
 
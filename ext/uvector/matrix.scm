@@ -55,22 +55,8 @@
         c))))
 
 (define (array-transpose a :optional (dim1 0) (dim2 1))
-  (let* ([sh (copy-object (array-shape a))]
-         [rank (array-rank a)]
-         [tmp0 (array-ref sh dim1 0)]
-         [tmp1 (array-ref sh dim1 1)])
-    (array-set! sh dim1 0 (array-ref sh dim2 0))
-    (array-set! sh dim1 1 (array-ref sh dim2 1))
-    (array-set! sh dim2 0 tmp0)
-    (array-set! sh dim2 1 tmp1)
-    (rlet1 res (make-array sh)
-      (array-for-each-index a
-        (^[vec1] (let* ([vec2 (vector-copy vec1)]
-                        [tmp (vector-ref vec2 dim1)])
-                   (vector-set! vec2 dim1 (vector-ref vec2 dim2))
-                   (vector-set! vec2 dim2 tmp)
-                   (array-set! res vec2 (array-ref a vec1))))
-        (make-vector rank)))))
+  (let1 view (array-view-transpose a dim1 dim2)
+    (array-copy-elements! (make-array (array-shape view)) view)))
 
 (define (array-rotate-90 a :optional (dim1 0) (dim2 1))
   (let* ([sh (copy-object (array-shape a))]
@@ -123,6 +109,12 @@
         [(= i n) res]
       (array-set! res i i 1))))
 
+;; Flonum matrices are handled by the native routines in array.c.
+(define (flonum-array? a)
+  (and (or (is-a? a <f32array>) (is-a? a <f64array>))
+       (strides-of a)
+       #t))
+
 ;; Gaussian elimination, returns factor applied to determinant
 (define (array-row-echelon! a)
   (let* ([start (start-vector-of a)]
@@ -208,16 +200,27 @@
       (error "can only compute inverses of 2D arrays"))
     (unless (= n m)
       (error "can only compute inverses of square matrices"))
-    (let* ([class (class-of a)]
-           [id (identity-array n (if (or (eq? class <f32array>)
-                                         (eq? class <f64array>))
-                                   class <array>))]
-           [tmp (array-concatenate a id 1)])
-      (array-solve-left-identity! tmp)
-      (and (= 1 (array-ref tmp (- (s32vector-ref end 0) 1)
-                           (- (s32vector-ref end 1) 1)))
-           (subarray tmp (shape (s32vector-ref start 0) (s32vector-ref end 0)
-                                (s32vector-ref end 1) (+ (s32vector-ref end 1) n)))))))
+    (if (flonum-array? a)
+      (let1 res (make-array-internal (class-of a) (shape 0 n 0 n))
+        (and (%array-inverse! (backing-storage-of res)
+                              (backing-storage-of a)
+                              (array-base-index a) (strides-of a) n)
+             res))
+      (array-inverse-generic a n))))
+
+(define (array-inverse-generic a n)
+  (let* ([start (start-vector-of a)]
+         [end (end-vector-of a)]
+         [class (class-of a)]
+         [id (identity-array n (if (or (eq? class <f32array>)
+                                       (eq? class <f64array>))
+                                 class <array>))]
+         [tmp (array-concatenate a id 1)])
+    (array-solve-left-identity! tmp)
+    (and (= 1 (array-ref tmp (- (s32vector-ref end 0) 1)
+                         (- (s32vector-ref end 1) 1)))
+         (subarray tmp (shape (s32vector-ref start 0) (s32vector-ref end 0)
+                              (s32vector-ref end 1) (+ (s32vector-ref end 1) n))))))
 
 
 (define (determinant! a)
@@ -235,15 +238,22 @@
 
 (define (determinant a)
   (let1 class (class-of a)
-    (if (or (eq? class <f32array>)
-            (eq? class <f64array>)
-            (eq? class <array>))
-      (determinant! (copy-object a))
+    (cond
+     [(and (flonum-array? a)
+           (= (array-rank a) 2)
+           (= (array-length a 0) (array-length a 1)))
+      (%array-determinant (backing-storage-of a) (array-base-index a)
+                          (strides-of a) (array-length a 0))]
+     [(or (eq? class <f32array>)
+          (eq? class <f64array>)
+          (eq? class <array>))
+      (determinant! (copy-object a))]
+     [else
       (let* ([rank (s32vector-length (start-vector-of a))]
              [b (tabulate-array (array-shape a)
                                 (^[ind] (array-ref a ind))
                                 (make-vector rank))])
-        (determinant! b)))))
+        (determinant! b))])))
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -256,29 +266,40 @@
         [b-end (end-vector-of b)])
     (unless (= 2 (s32vector-length a-start) (s32vector-length b-start))
       (error "array-mul matrices must be of rank 2"))
-    (let* ([a-start-row (s32vector-ref a-start 0)]
-           [a-end-row (s32vector-ref a-end 0)]
-           [a-start-col (s32vector-ref a-start 1)]
-           [a-end-col (s32vector-ref a-end 1)]
-           [b-start-col (s32vector-ref b-start 1)]
-           [b-end-col (s32vector-ref b-end 1)]
-           [n (- a-end-row a-start-row)]
-           [m (- a-end-col a-start-col)]
-           [p (- b-end-col b-start-col)]
-           [a-col-b-row-off (- a-start-col (s32vector-ref b-start 0))]
+    (let* ([n (- (s32vector-ref a-end 0) (s32vector-ref a-start 0))]
+           [m (- (s32vector-ref a-end 1) (s32vector-ref a-start 1))]
+           [p (- (s32vector-ref b-end 1) (s32vector-ref b-start 1))]
            [res (make-minimal-backend-array (list a b) (shape 0 n 0 p))])
       (unless (= m (- (s32vector-ref b-end 0) (s32vector-ref b-start 0)))
         (errorf "dimension mismatch: can't mul shapes ~S and ~S"
                 (array-shape a) (array-shape b)))
-      (do ([i a-start-row (+ i 1)])       ; for-each row of a
-          [(= i a-end-row) res]
-        (do ([k b-start-col (+ k 1)])     ; for-each col of b
-            [(= k b-end-col)]
-          (let1 tmp 0
-            (do ([j a-start-col (+ j 1)]) ; for-each col of a & row of b
-                [(= j a-end-col)]
-              (inc! tmp (* (array-ref a i j) (array-ref b (- j a-col-b-row-off) k))))
-            (array-set! res (- i a-start-row) (- k b-start-col) tmp)))))))
+      (if (and (flonum-array? a) (flonum-array? b)
+               (%array-matmul! (backing-storage-of res)
+                               (backing-storage-of a)
+                               (array-base-index a) (strides-of a)
+                               (backing-storage-of b)
+                               (array-base-index b) (strides-of b)
+                               n m p))
+        res
+        (array-mul-generic! res a b)))))
+
+(define (array-mul-generic! res a b)
+  (let ([a-start-row (array-start a 0)]
+        [a-end-row (array-end a 0)]
+        [a-start-col (array-start a 1)]
+        [a-end-col (array-end a 1)]
+        [b-start-col (array-start b 1)]
+        [b-end-col (array-end b 1)]
+        [a-col-b-row-off (- (array-start a 1) (array-start b 0))])
+    (do ([i a-start-row (+ i 1)])       ; for-each row of a
+        [(= i a-end-row) res]
+      (do ([k b-start-col (+ k 1)])     ; for-each col of b
+          [(= k b-end-col)]
+        (let1 tmp 0
+          (do ([j a-start-col (+ j 1)]) ; for-each col of a & row of b
+              [(= j a-end-col)]
+            (inc! tmp (* (array-ref a i j) (array-ref b (- j a-col-b-row-off) k))))
+          (array-set! res (- i a-start-row) (- k b-start-col) tmp))))))
 
 (define (array-div-left a b)
   (if-let1 b-1 (array-inverse b)
@@ -307,6 +328,35 @@
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; element-wise operations (advantage over a direct array-map! is
 ;; ability to intermingle scalars)
+;;
+;; An array operand whose shape differs from the target is broadcast
+;; to it (see array-broadcast).  Flonum arrays are computed by the
+;; native routine; other arrays go through array-map!.
+
+;; DST := X op Y, where X and Y are arrays or numbers.  OP is one of
+;; #\+, #\-, #\* and #\/, and PROC is the corresponding procedure.
+(define (array-elementwise! op proc dst x y)
+  (define (conform z)
+    (if (and (array? z) (not (same-shape? z dst)))
+      (array-broadcast z (array-shape dst))
+      z))
+  (define (view-args z)
+    (if (array? z)
+      (list (backing-storage-of z) (array-base-index z) (strides-of z))
+      (list z 0 #f)))
+  (let ([x (conform x)]
+        [y (conform y)])
+    (unless (and (flonum-array? dst)
+                 (or (not (array? x)) (strides-of x))
+                 (or (not (array? y)) (strides-of y))
+                 (apply %array-arith! op (array-dimensions dst)
+                        (backing-storage-of dst) (array-base-index dst)
+                        (strides-of dst)
+                        (append (view-args x) (view-args y))))
+      (cond [(and (array? x) (array? y)) (array-map! dst proc x y)]
+            [(array? x) (array-map! dst (^i (proc i y)) x)]
+            [else       (array-map! dst (^j (proc x j)) y)]))
+    dst))
 
 ;; add
 
@@ -318,13 +368,13 @@
   a)
 
 (define-method array-add-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (+ b i)) a))
+  (array-elementwise! #\+ + a a b))
 
 (define-method array-add-elements! ((a <number>) (b <array-base>))
-  (array-map! (copy-object b) (^i (+ a i)) b))
+  (array-elementwise! #\+ + (copy-object b) a b))
 
 (define-method array-add-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (+ i j)) a b))
+  (array-elementwise! #\+ + a a b))
 
 (define (array-add-elements a . rest)
   (rlet1 res (copy-object a)
@@ -340,13 +390,13 @@
   (apply array-sub-elements! a c rest))
 
 (define-method array-sub-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (- i b)) a))
+  (array-elementwise! #\- - a a b))
 
 (define-method array-sub-elements! ((a <number>) (b <array-base>))
-  (array-map! (copy-object b) (^i (- a i)) b))
+  (array-elementwise! #\- - (copy-object b) a b))
 
 (define-method array-sub-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (- i j)) a b))
+  (array-elementwise! #\- - a a b))
 
 (define (array-sub-elements a . rest)
   (rlet1 res (copy-object a)
@@ -362,13 +412,13 @@
   a)
 
 (define-method array-mul-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (* b i)) a))
+  (array-elementwise! #\* * a a b))
 
 (define-method array-mul-elements! ((a <number>) (b <array-base>))
-  (array-map! (copy-object b) (^i (* a i)) b))
+  (array-elementwise! #\* * (copy-object b) a b))
 
 (define-method array-mul-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (* i j)) a b))
+  (array-elementwise! #\* * a a b))
 
 (define (array-mul-elements a . rest)
   (rlet1 res (copy-object a)
@@ -384,13 +434,13 @@
   a)
 
 (define-method array-div-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (/ i b)) a))
+  (array-elementwise! #\/ / a a b))
 
 (define-method array-div-elements! ((a <number>) (b <array-base>))
-  (array-map! (copy-object b) (^i (/ a i)) b))
+  (array-elementwise! #\/ / (copy-object b) a b))
 
 (define-method array-div-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (/ i j)) a b))
+  (array-elementwise! #\/ / a a b))
 
 (define (array-div-elements a . rest)
   (rlet1 res (copy-object a)
@@ -1033,6 +1033,218 @@
 (dotprod-test-generate f64 #f64(32767 -32767 32767 -32767 32767)
                        #f64(32767 -32767 32767 -32767 32767))
 
+;;-------------------------------------------------------------------
+(test-section "vector kernels")
+
+;; Uvector-uvector arithmetic on vectors of the same type uses vectorized
+;; kernels.  We check them against the results via lists, which take
+;; the generic path.  The vectors are long enough to cover several blocks
+;; and the tail.
+(define (kernel-test-data tag len lo hi seed)
+  (let1 s seed
+    (define (rand27)
+      (set! s (modulo (+ (* s 1103515245) 12345) 2147483648))
+      (quotient s 16))
+    (define (rand)
+      (+ lo (modulo (+ (* (rand27) (expt 2 54)) (* (rand27) (expt 2 27)) (rand27))
+                    (+ (- hi lo) 1))))
+    ((uvector-proc #"list->~|tag|vector") (list-tabulate len (^_ (rand))))))
+
+(define (uvector-proc name)
+  (global-variable-ref (current-module) (string->symbol name)))
+
+(define (kernel-arith-test tag op lo hi)
+  (let* ([proc (uvector-proc #"~|tag|vector-~op")]
+         [v0 (kernel-test-data tag 1037 (quotient lo 2) (quotient hi 2) 1)]
+         [v1 (kernel-test-data tag 1037 (quotient lo 2) (quotient hi 2) 2)]
+         [w0 (kernel-test-data tag 1037 lo hi 3)]
+         [w1 (kernel-test-data tag 1037 lo hi 4)])
+    (test* #"~|tag|vector-~op (no overflow)"
+           (proc v0 (coerce-to <list> v1))
+           (proc v0 v1))
+    (test* #"~|tag|vector-~op (clamp)"
+           (proc w0 (coerce-to <list> w1) 'both)
+           (proc w0 w1 'both))
+    (let1 r (uvector-copy w0)
+      (test* #"~|tag|vector-~op! (clamp)"
+             (proc w0 (coerce-to <list> w1) 'both)
+             (begin ((uvector-proc #"~|tag|vector-~|op|!") r w1 'both)
+                    r)))))
+
+(dolist [op '(add sub mul)]
+  (kernel-arith-test 's8 op -128 127)
+  (kernel-arith-test 'u8 op 0 255)
+  (kernel-arith-test 's16 op -32768 32767)
+  (kernel-arith-test 'u16 op 0 65535)
+  (kernel-arith-test 's32 op -2147483648 2147483647)
+  (kernel-arith-test 'u32 op 0 4294967295)
+  (kernel-arith-test 'f32 op -1000 1000)
+  (kernel-arith-test 'f64 op -1000 1000))
+
+(test* "s16vector-add overflow in the middle" (test-error)
+       (s16vector-add (make-s16vector 1000 30000)
+                      (rlet1 v (make-s16vector 1000 0)
+                        (s16vector-set! v 700 30000))))
+
+(test* "s16vector-add overflow in the middle (clamp)"
+       (rlet1 v (make-s16vector 1000 30000)
+         (s16vector-set! v 700 32767))
+       (s16vector-add (make-s16vector 1000 30000)
+                      (rlet1 v (make-s16vector 1000 0)
+                        (s16vector-set! v 700 30000))
+                      'both))
+
+(test* "f64vector-div" (f64vector-div (kernel-test-data 'f64 301 1 50 5)
+                                      (coerce-to <list>
+                                                 (kernel-test-data 'f64 301 1 50 6)))
+       (f64vector-div (kernel-test-data 'f64 301 1 50 5)
+                      (kernel-test-data 'f64 301 1 50 6)))
+
+(test* "f32vector-mul by constant" (f32vector-mul (make-f32vector 100 1.5)
+                                                  (make-list 100 0.25))
+       (f32vector-mul (make-f32vector 100 1.5) 0.25))
+
+(test* "s32vector-add! with overlapping alias"
+       #s32(0 1 3 6 10 15 21 28)
+       (let* ([v (s32vector 0 1 2 3 4 5 6 7 8)]
+              [a (uvector-alias <s32vector> v 1 9)]
+              [b (uvector-alias <s32vector> v 0 8)])
+         (s32vector-add! a b)
+         (uvector-alias <s32vector> v 0 8)))
+
+(test* "f64vector-dot (long)"
+       (f64vector-dot (kernel-test-data 'f64 1001 -100 100 7)
+                      (coerce-to <list> (kernel-test-data 'f64 1001 -100 100 8)))
+       (f64vector-dot (kernel-test-data 'f64 1001 -100 100 7)
+                      (kernel-test-data 'f64 1001 -100 100 8)))
+(test* "f32vector-dot (long)"
+       (f32vector-dot (kernel-test-data 'f32 1001 -100 100 7)
+                      (coerce-to <list> (kernel-test-data 'f32 1001 -100 100 8)))
+       (f32vector-dot (kernel-test-data 'f32 1001 -100 100 7)
+                      (kernel-test-data 'f32 1001 -100 100 8)))
+
+;; Flonum dot products and sums are accumulated into 8 partial sums
+;; of every 8th element, whatever the vector width is.
+(let ()
+  (define (dot-in-kernel-order x y)
+    (let* ([n (uvector-length x)]
+           [nb (* 8 (quotient n 8))]
+           [acc (make-vector 8 0.0)])
+      (dotimes [i nb]
+        (let1 k (modulo i 8)
+          (vector-set! acc k (+ (vector-ref acc k)
+                                (* (uvector-ref x i) (uvector-ref y i))))))
+      (let loop ([i nb]
+                 [r (+ (+ (+ (vector-ref acc 0) (vector-ref acc 1))
+                          (+ (vector-ref acc 2) (vector-ref acc 3)))
+                       (+ (+ (vector-ref acc 4) (vector-ref acc 5))
+                          (+ (vector-ref acc 6) (vector-ref acc 7))))])
+        (if (= i n)
+          r
+          (loop (+ i 1) (+ r (* (uvector-ref x i) (uvector-ref y i))))))))
+  (define (data len seed)
+    (list->f64vector
+     (list-tabulate len (^i (* (/ (+ i seed) 7.0) (expt 10.0 (modulo i 17)))))))
+  (let ([x (data 1003 1)] [y (data 1003 2)])
+    (test* "f64vector-dot (summation order)" (dot-in-kernel-order x y)
+           (f64vector-dot x y))
+    (test* "uvector-sum (f64, summation order)"
+           (dot-in-kernel-order x (make-f64vector 1003 1.0))
+           (uvector-sum x))))
+
+;;-------------------------------------------------------------------
+(test-section "reductions")
+
+(let ()
+  (define (reduction-test tag lo hi)
+    (let* ([v (kernel-test-data tag 517 lo hi 11)]
+           [lis (coerce-to <list> v)]
+           [sub (drop (take lis 300) 5)])
+      (test* #"uvector-sum (~tag)" (apply + lis) (uvector-sum v))
+      (test* #"uvector-sum (~tag, range)" (apply + sub) (uvector-sum v 5 300))
+      (test* #"uvector-min (~tag)" (apply min lis) (uvector-min v))
+      (test* #"uvector-max (~tag)" (apply max lis) (uvector-max v))
+      (test* #"uvector-min (~tag, range)" (apply min sub) (uvector-min v 5 300))
+      (test* #"uvector-max (~tag, range)" (apply max sub) (uvector-max v 5 300))
+      (test* #"uvector-argmin (~tag)" (list-index (cut = <> (apply min lis)) lis)
+             (uvector-argmin v))
+      (test* #"uvector-argmax (~tag, range)"
+             (+ 5 (list-index (cut = <> (apply max sub)) sub))
+             (uvector-argmax v 5 300))))
+  (reduction-test 's8 -128 127)
+  (reduction-test 'u8 0 255)
+  (reduction-test 's16 -32768 32767)
+  (reduction-test 'u16 0 65535)
+  (reduction-test 's32 -2147483648 2147483647)
+  (reduction-test 'u32 0 4294967295)
+  (reduction-test 's64 (- (expt 2 63)) (- (expt 2 63) 1))
+  (reduction-test 'u64 0 (- (expt 2 64) 1))
+  (reduction-test 'f16 -100 100)
+  (reduction-test 'f32 -100000 100000)
+  (reduction-test 'f64 -100000 100000))
+
+(test* "uvector-sum (s64, overflow)" (* 3 (- (expt 2 63) 1))
+       (uvector-sum (make-s64vector 3 (- (expt 2 63) 1))))
+(test* "uvector-sum (u64, overflow)" (* 3 (- (expt 2 64) 1))
+       (uvector-sum (make-u64vector 3 (- (expt 2 64) 1))))
+(test* "uvector-sum (empty)" 0 (uvector-sum #s8()))
+(test* "uvector-sum (empty)" 0.0 (uvector-sum #f64()))
+(test* "uvector-min (empty)" (test-error) (uvector-min #u8()))
+(test* "uvector-argmax (empty range)" (test-error) (uvector-argmax #u8(1 2 3) 1 1))
+
+(test* "uvector-min skips NaN" 1.0
+       (uvector-min (f64vector +nan.0 3.0 +nan.0 1.0 2.0 +nan.0)))
+(test* "uvector-max skips NaN" 3.0
+       (uvector-max (f32vector +nan.0 3.0 +nan.0 1.0 2.0 +nan.0)))
+(test* "uvector-argmin skips NaN" 3
+       (uvector-argmin (f64vector +nan.0 3.0 +nan.0 1.0 2.0 +nan.0)))
+(test* "uvector-min all NaN" #t
+       (nan? (uvector-min (f64vector +nan.0 +nan.0))))
+(test* "uvector-argmax all NaN" 0
+       (uvector-argmax (f64vector +nan.0 +nan.0)))
+(test* "uvector-argmax first occurrence" 2
+       (uvector-argmax (make-u8vector 100 7) 2))
+
+;;-------------------------------------------------------------------
+(test-section "fused multiply-add")
+
+(test* "uvector-fma (f64, uvector)" #f64(5.0 11.0 19.0)
+       (uvector-fma #f64(1 2 3) #f64(2 3 4) #f64(2 3 4)))
+(test* "uvector-fma (f32, constant)" #f32(3.0 5.0 7.0)
+       (uvector-fma #f32(1 1 1) #f32(1 2 3) 2))
+(test* "uvector-fma (f16, constant)" #f16(3.0 5.0 7.0)
+       (uvector-fma #f16(1 1 1) #f16(1 2 3) 2))
+;; x*x is 1+2^-26+2^-54 for f64, and 1+2^-11+2^-24 for f32; the last
+;; term is lost unless the multiplication and addition are fused.
+(let ([x64 (+ 1 (expt 2.0 -27))]
+      [x32 (+ 1 (expt 2.0 -12))])
+  (test* "uvector-fma (f64, single rounding)"
+         (f64vector (expt 2.0 -54) (expt 2.0 -54))
+         (uvector-fma (make-f64vector 2 (- (* x64 x64)))
+                      (make-f64vector 2 x64) (make-f64vector 2 x64)))
+  (test* "uvector-fma (f32, single rounding)"
+         (make-f32vector 9 (expt 2.0 -24))
+         (uvector-fma (make-f32vector 9 (- (+ 1 (expt 2.0 -11))))
+                      (make-f32vector 9 x32) x32)))
+(test* "uvector-fma doesn't modify" #f64(1 2 3)
+       (let1 z (f64vector 1 2 3)
+         (uvector-fma z #f64(2 3 4) 1.0)
+         z))
+(test* "uvector-fma! (long)"
+       (let ([z (kernel-test-data 'f64 301 -10 10 21)]
+             [x (kernel-test-data 'f64 301 -10 10 22)]
+             [y (kernel-test-data 'f64 301 -10 10 23)])
+         (f64vector-add z (f64vector-mul x y)))
+       (rlet1 z (kernel-test-data 'f64 301 -10 10 21)
+         (uvector-fma! z (kernel-test-data 'f64 301 -10 10 22)
+                       (kernel-test-data 'f64 301 -10 10 23))))
+(test* "uvector-fma (type mismatch)" (test-error)
+       (uvector-fma #f64(1 2) #f32(1 2) 1.0))
+(test* "uvector-fma (size mismatch)" (test-error)
+       (uvector-fma #f64(1 2) #f64(1 2) #f64(1 2 3)))
+(test* "uvector-fma (integer vector)" (test-error)
+       (uvector-fma #s32(1 2) #s32(1 2) 1))
+
 ;;-------------------------------------------------------------------
 (test-section "range-check")
 
@@ -2145,6 +2357,45 @@
                  (array-ref sub 1 1)))
     ))
 
+(test-section "array views")
+(let1 ar (tabulate-array (shape 0 3 0 4) (^[i j] (+ (* i 10) j)))
+  (test* "array-view-transpose" '((0 10 20) (1 11 21) (2 12 22) (3 13 23))
+         (let1 v (array-view-transpose ar)
+           (map (^i (map (^j (array-ref v i j)) (iota 3))) (iota 4))))
+  (test* "array-view-transpose shares storage" 99
+         (let1 v (array-view-transpose (copy-object ar))
+           (array-set! v 2 1 99)
+           (array-ref v 2 1)))
+  (test* "array-view-transpose (write)" "#,(<array> (0 2 0 2) 0 10 1 11)"
+         (write-to-string
+          (array-view-transpose (share-array ar (shape 0 2 0 2)
+                                             (^[i j] (values i j))))))
+  (test* "array-view-slice" '(1 3)
+         (array->list (array-view-slice (array-view-slice ar 0 0 1) 1 1 4 2)))
+  (test* "array-view-slice (reverse)" '(23 13 3)
+         (array->list (array-view-slice (array-view-slice ar 1 3 4) 0 2 -1 -1)))
+  (test* "array-view-slice (empty)" '()
+         (array->list (array-view-slice ar 0 2 2)))
+  (test* "array-broadcast" '(0 1 2 3 0 1 2 3)
+         (array->list (array-broadcast (array-view-slice ar 0 0 1)
+                                       (shape 5 7 0 4))))
+  (test* "array-broadcast (rank)" '(7 7 7 7)
+         (array->list (array-broadcast (array (shape) 7) (shape 0 2 0 2))))
+  (test* "array-broadcast (error)" (test-error)
+         (array-broadcast ar (shape 0 3 0 5)))
+  (test* "array-for-each on a view" '(2 12 22)
+         (rlet1 r '()
+           (array-for-each (^x (push! r x))
+                           (array-view-slice ar 1 2 3))
+           (set! r (reverse r))))
+  (test* "array-every on a view" #t
+         (array-every (^x (< x 10)) (array-view-slice ar 0 0 1)))
+  (test* "share-array out of range" (test-error)
+         (share-array ar (shape 0 2) (^i (values (* i 3) 0))))
+  )
+
+;;----------------------------------------------------------------
+(test-section "array-iteration")
 ;;----------------------------------------------------------------
 (test-section "array-iteration")
 
@@ -2356,6 +2607,67 @@
      )))
 
 
+(let1 i 0
+  (for-each
+   (^t (let-optionals* t (ar (inv #f) (det 0))
+         (test* (format "array-inverse-f64-~D" (inc! i)) inv
+                (array-inverse ar)
+                array-approx-equal?)
+         (test* (format "determinant-f64-~D" (inc! i)) det
+                (determinant ar)
+                approx-equal?)))
+   '((#,(<f64array> (0 2 0 2) 1 2 3 4)
+      #,(<f64array> (0 2 0 2) -2.0 1.0 1.5 -0.5)
+      -2)
+     (#,(<f64array> (1 4 2 5) 1 5 2 1 1 7 0 -3 4)
+      #,(<f64array> (0 3 0 3) -25 26 -33 4 -4 5 3 -3 4)
+      -1)
+     (#,(<f32array> (0 3 0 3) 0 1 2 1 0 3 4 -3 8)
+      #,(<f32array> (0 3 0 3) -4.5 7 -1.5 -2 4 -1 1.5 -2 0.5)
+      -2)
+     (#,(<f64array> (0 2 0 2) 1 2 2 4) #f 0)
+     )))
+
+(test* "array-inverse (flonum class)" <f32array>
+       (class-of (array-inverse #,(<f32array> (0 2 0 2) 1 2 3 4))))
+
+(let ([a (tabulate-array (shape 0 70 0 130) (^[i j] (- (* i 3) j)))]
+      [b (tabulate-array (shape 0 130 0 20) (^[i j] (+ i (* j 2) -7)))])
+  (define (->f64 x)
+    (rlet1 r (make-f64array (array-shape x))
+      (array-map! r exact->inexact x)))
+  (test* "array-mul (f64, blocked)" (array-mul a b)
+         (array-mul (->f64 a) (->f64 b))
+         array-approx-equal?)
+  (test* "array-mul (f64, transposed view)"
+         (array-mul a b)
+         (array-mul (->f64 a)
+                    (array-view-transpose (->f64 (array-transpose b))))
+         array-approx-equal?))
+
+(test* "array-add-elements (f64 broadcast)"
+       #,(<f64array> (0 2 0 3) 11.0 22.0 33.0 14.0 25.0 36.0)
+       (array-add-elements #,(<f64array> (0 2 0 3) 1 2 3 4 5 6)
+                           #,(<f64array> (0 3) 10 20 30)))
+(test* "array-sub-elements (f32 column broadcast)"
+       #,(<f32array> (0 2 0 2) 0.0 1.0 -8.0 -7.0)
+       (array-sub-elements #,(<f32array> (0 2 0 2) 1 2 3 4)
+                           #,(<f32array> (0 2 0 1) 1 11)))
+(test* "array-mul-elements (generic broadcast)"
+       #,(<array> (0 2 0 2) 1 4 3 8)
+       (array-mul-elements #,(<array> (0 2 0 2) 1 2 3 4)
+                           #,(<array> (0 2) 1 2)))
+(test* "array-div-elements (f64 scalar)"
+       #,(<f64array> (0 2) 0.5 2.0)
+       (array-div-elements! 1 #,(<f64array> (0 2) 2 0.5)))
+(test* "array-div-elements (f64 by zero)"
+       #,(<f64array> (0 2) +inf.0 -inf.0)
+       (array-div-elements #,(<f64array> (0 2) 2 -0.5) 0))
+(test* "array-add-elements! on a view"
+       #,(<f64array> (0 2 0 2) 1.0 102.0 3.0 104.0)
+       (rlet1 a (f64array (shape 0 2 0 2) 1 2 3 4)
+         (array-add-elements! (array-view-slice a 1 1 2) 100)))
+
 ;;-------------------------------------------------------------------
 ;; NB: copy-port uses read-block! and write-block for block copy,
 ;;     so we test it here.
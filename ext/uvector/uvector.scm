@@ -171,8 +171,10 @@
           u8vector-range-check u8vector-ref u8vector-set! u8vector-sub
           u8vector-sub! u8vector-xor u8vector-xor! u8vector=? u8vector?
 
-          uvector-alias uvector-binary-search uvector-class-element-size
-          uvector-copy uvector-copy! uvector-ref uvector-set! uvector-size
+          uvector-alias uvector-argmax uvector-argmin uvector-binary-search
+          uvector-class-element-size uvector-copy uvector-copy!
+          uvector-fma uvector-fma! uvector-max uvector-min
+          uvector-ref uvector-set! uvector-size uvector-sum
           uvector-swap-bytes uvector-swap-bytes!
 
           vector->f16vector vector->f32vector vector->f64vector
@@ -249,6 +251,80 @@
      (return r)))
  )
 
+;; reductions and fused multiply-add
+(inline-stub
+ (define-cproc uvector-sum (v::<uvector>
+                            :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (return (Scm_UVectorSum v start end)))
+
+ (define-cproc uvector-min (v::<uvector>
+                            :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (return (Scm_UVectorMin v start end)))
+
+ (define-cproc uvector-max (v::<uvector>
+                            :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (return (Scm_UVectorMax v start end)))
+
+ (define-cproc uvector-argmin (v::<uvector>
+                               :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (return (Scm_UVectorArgMin v start end)))
+
+ (define-cproc uvector-argmax (v::<uvector>
+                               :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (return (Scm_UVectorArgMax v start end)))
+
+ (define-cproc uvector-fma (z::<uvector> x::<uvector> y)
+   (return (Scm_UVectorFMA z x y)))
+
+ (define-cproc uvector-fma! (z::<uvector> x::<uvector> y)
+   (return (Scm_UVectorFMAX z x y)))
+ )
+
+;; strided array engine; used internally by gauche.array (array.c)
+(inline-stub
+ (define-cproc %array-storage-index (offset::<fixnum> strides::<s32vector>
+                                     start::<s32vector> end::<s32vector>
+                                     index)
+   ::<fixnum>
+   (return (Scm_ArrayStorageIndex offset strides start end index)))
+
+ (define-cproc %array-storage-indices (dims::<s32vector> base::<fixnum>
+                                       strides::<s32vector>)
+   (return (Scm_ArrayStorageIndices dims base strides)))
+
+ (define-cproc %array-copy! (dims::<s32vector>
+                             dst dbase::<fixnum> dstrides::<s32vector>
+                             src sbase::<fixnum> sstrides::<s32vector>)
+   ::<boolean>
+   (return (Scm_ArrayCopy dims dst dbase dstrides src sbase sstrides)))
+
+ ;; A and B are either views or real numbers; for the latter, the base
+ ;; and strides are ignored and can be 0 and #f.
+ (define-cproc %array-arith! (op::<char> dims::<s32vector>
+                              dst dbase::<fixnum> dstrides::<s32vector>
+                              a abase::<fixnum> astrides::<s32vector>?
+                              b bbase::<fixnum> bstrides::<s32vector>?)
+   ::<boolean>
+   (return (Scm_ArrayArith op dims dst dbase dstrides
+                           a abase astrides b bbase bstrides)))
+
+ (define-cproc %array-matmul! (c a abase::<fixnum> astrides::<s32vector>
+                                 b bbase::<fixnum> bstrides::<s32vector>
+                                 n::<int> m::<int> p::<int>)
+   ::<boolean>
+   (return (Scm_ArrayMatMul c a abase astrides b bbase bstrides n m p)))
+
+ (define-cproc %array-inverse! (dst a abase::<fixnum> astrides::<s32vector>
+                                    n::<int>)
+   ::<boolean>
+   (return (Scm_ArrayInverse dst a abase astrides n)))
+
+ (define-cproc %array-determinant (a abase::<fixnum> astrides::<s32vector>
+                                     n::<int>)
+   ::<double>
+   (return (Scm_ArrayDeterminant a abase astrides n)))
+ )
+
 ;; allocation by class
 (inline-stub
  (define-cproc make-uvector (klass::<class> size::<fixnum>
@@ -305,12 +305,157 @@
 ;; Uvector opertaion generator
 ;;
 
+;; Joins lines of C code to be substituted at the indentation of
+;; a statement within a switch clause.
+(define (c-block . lines) (string-join lines "\n        "))
+
+(define (rule-tag rule) (string->symbol (getval rule 't)))
+
+(define (small-integer-tag? tag) (memq tag '(s8 u8 s16 u16 s32 u32)))
+
+;; Vector kernels.  Each kernel is generated for a few variants:
+;; (condition suffix vector-bytes), where vector-bytes is #f for
+;; the plain scalar loop.
+(define *kernel-variants*
+  '(("UVK_VECTOR_EXT"   "generic" "UVK_VBYTES")
+    ("!UVK_VECTOR_EXT"  "generic" #f)
+    ("UVK_X86_DISPATCH" "avx2"    "32")))
+
+(define (kernel-rules rule sfx vbytes)
+  (let* ([tag    (rule-tag rule)]
+         [t      (getval rule 't)]
+         [bits   (case tag
+                   [(s8 u8) 8] [(s16 u16 f16) 16] [(s32 u32 f32) 32] [else 64])]
+         [utype  #"uint~|bits|_t"]
+         [vtype  #"~|t|v_~|sfx|"]
+         [uvtype #"~|t|uv_~|sfx|"]
+         [ivtype #"~|t|iv_~|sfx|"]
+         [signed? (memq tag '(s8 s16 s32 s64))])
+    (define (vattr bytes)
+      (if vbytes #"__attribute__((vector_size(~|bytes|)))" ""))
+    ;; overflow flags; the sign bit is set when overflow occurs
+    (define (addovf uv)
+      (if signed?
+        (^[x y r] #"((~x ^ ~r) & (~y ^ ~r))")
+        (^[x y r] (if uv #"(~|uvtype|)(~r < ~x)" #"(~|utype|)-(~r < ~x)"))))
+    (define (subovf uv)
+      (if signed?
+        (^[x y r] #"((~x ^ ~y) & (~x ^ ~r))")
+        (^[x y r] (if uv #"(~|uvtype|)(~x < ~y)" #"(~|utype|)-(~x < ~y)"))))
+    `((sfx     ,sfx)
+      (attr    ,(if (equal? sfx "avx2") "UVK_AVX2_ATTR" ""))
+      (VATTR   ,(vattr vbytes))
+      ;; float reductions; see UVK_NACC
+      (V8      ,(if vbytes
+                  #" __attribute__((vector_size(UVK_NACC*sizeof(~(getval rule 'etype)))))"
+                  "[UVK_NACC]"))
+      (DACC    ,(if vbytes
+                  " __attribute__((vector_size(UVK_NACC*sizeof(double))))"
+                  "[UVK_NACC]"))
+      (FMA     ,(if (eq? tag 'f32) "fmaf" "fma"))
+      (L       ,(if vbytes #"(int)(~|vbytes|/sizeof(~(getval rule 'etype)))" "1"))
+      (utype   ,utype)
+      (itype   ,#"int~|bits|_t")
+      (MASKT   ,(if vbytes ivtype "int"))
+      (LANE    ,(if vbytes (^[v k] #"~|v|[~|k|]") (^[v k] (x->string v))))
+      (SEL     ,(if vbytes
+                  (^[k x y] #"(~|vtype|)(((~|ivtype|)~|x| & ~|k|) | ((~|ivtype|)~|y| & ~~~|k|))")
+                  (^[k x y] #"(~|k|? ~|x| : ~|y|)")))
+      (ACCUM   ,(let1 widen (if (eq? tag 'f32)
+                                  (^[x] #"__builtin_convertvector(~|x|, f32dacc_~|sfx|)")
+                                  x->string)
+                  (^[op]
+                    (cond [(not vbytes)
+                           (if (eq? op 'dot)
+                             (c-block "for (int k=0; k<UVK_NACC; k++) {"
+                                      "    p[k] = (double)x[k] * (double)y[k];"
+                                      "    acc[k] += p[k];"
+                                      "}")
+                             "for (int k=0; k<UVK_NACC; k++) acc[k] += (double)x[k];")]
+                          [(eq? op 'dot)
+                           (c-block #"p = ~(widen "x") * ~(widen "y");"
+                                    "acc += p;")]
+                          [else #"acc += ~(widen "x");"]))))
+      (SKIPNAN ,(if (memq tag '(f32 f64))
+                  (^[a i n] #"while (~i < ~|n|-1 && ~|a|[~|i|] != ~|a|[~|i|]) ~|i|++;")
+                  (^[a i n] "")))
+      (ADDOVF  ,(addovf vbytes))
+      (SUBOVF  ,(subovf vbytes))
+      (ADDOVF1 ,(addovf #f))
+      (SUBOVF1 ,(subovf #f)))))
+
+(define (generate-kernels)
+  (define (emit tmpl rules)
+    (for-each (cute substitute <> rules) tmpl))
+  (dolist [rule (make-rules)]
+    (let ([tag (rule-tag rule)]
+          [t   (getval rule 't)])
+      (unless (eq? tag 'f16)
+        (dolist [v *kernel-variants*]
+          (let1 rules (append (kernel-rules rule (cadr v) (caddr v)) rule)
+            (print "#if " (car v))
+            (emit *tmpl-kernel-types* rules)
+            (cond [(memq tag '(f32 f64)) (emit *tmpl-kernel-float* rules)]
+                  [(small-integer-tag? tag) (emit *tmpl-kernel-addsub* rules)])
+            (emit *tmpl-kernel-minmax* rules)
+            (print "#endif /*" (car v) "*/"))))
+      (when (small-integer-tag? tag)
+        (emit *tmpl-kernel-isum*
+              `((acctype ,(if (memq tag '(s8 s16 s32)) "int64_t" "uint64_t"))
+                ,@rule)))
+      (emit *tmpl-reduce*
+            `((SUM    ,(^[a n]
+                         (case tag
+                           [(f16) #"Scm_MakeFlonum(f16k_sum(~a, ~n))"]
+                           [(f32 f64)
+                            #"Scm_MakeFlonum(UVK_CALL(~|t|k_sum, (~a, ~n)))"]
+                           [(s8 s16 s32) #"Scm_MakeInteger64(~|t|k_sum(~a, ~n))"]
+                           [(u8 u16 u32) #"Scm_MakeIntegerU64(~|t|k_sum(~a, ~n))"]
+                           [else #"~|t|k_sum(~a, ~n)"])))
+              (SAME   ,(^[x y]
+                         (if (eq? tag 'f16)
+                           #"SCM_HALF_FLOAT_CMP(==, ~x, ~y)"
+                           #"(~x == ~y)")))
+              (MINMAX ,(^[a start n maxp]
+                         (if (eq? tag 'f16)
+                           #"f16k_minmax(~|a|+~|start|, ~n, ~maxp)"
+                           #"UVK_CALL(~|t|k_minmax, (~|a|+~|start|, ~n, ~maxp))")))
+              ,@rule)))))
+
 (define (generate-numop)
+  (define (kernel-subst rule opname)
+    (let* ([tag (rule-tag rule)]
+           [t   (getval rule 't)]
+           [T   (getval rule 'T)]
+           [op  #"UVK_~(string-upcase opname)"])
+      (define (elts v) #"SCM_~|T|VECTOR_ELEMENTS(~v)")
+      `((UVKERNEL
+         ,(^[i d s0 s1 size]
+            (cond [(memq tag '(f32 f64))
+                   (c-block #"if (uvk_applicable_p(~d, ~s0, ~s1)) {"
+                            #"    UVK_CALL(~|t|k_arith, (~op, ~(elts d), ~(elts s0), ~(elts s1), 0, ~size));"
+                            #"    ~i = ~size;"
+                            "}")]
+                  [(and (small-integer-tag? tag)
+                        (member opname '("add" "sub")))
+                   (c-block #"if (uvk_applicable_p(~d, ~s0, ~s1)) {"
+                            #"    ~i = (int)UVK_CALL(~|t|k_addsub, (~op, ~(elts d), ~(elts s0), ~(elts s1), ~size));"
+                            "}")]
+                  [else ""])))
+        (CONSTKERNEL
+         ,(^[d s0 v1 size]
+            (if (memq tag '(f32 f64))
+              (c-block "if (!oor) {"
+                       #"    UVK_CALL(~|t|k_arith, (~op, ~(elts d), ~(elts s0), NULL, (~(getval rule 'etype))~v1, ~size));"
+                       "    break;"
+                       "}")
+              ""))))))
   (for-each (^[opname Opname Sopname]
               (dolist [rule (make-rules)]
                 (for-each (cute substitute <> `((opname  ,opname)
                                                 (Opname  ,Opname)
                                                 (Sopname ,Sopname)
+                                                ,@(kernel-subst rule opname)
                                                 ,@rule))
                           *tmpl-numop*)))
             '("add" "sub" "mul")
@@ -320,6 +465,7 @@
     (for-each (cute substitute <> `((opname  "div")
                                     (Opname  "Div")
                                     (Sopname  "Div")
+                                    ,@(kernel-subst rule "div")
                                     ,@rule))
               *tmpl-numop*)))
 
@@ -355,7 +501,18 @@
         (case tag
           [(s64 u64) #"SCM_SET_INT64_ZERO(~r)"]
           [else #"~r = 0"]))
-      (for-each (cute substitute <> `((ZERO  ,ZERO) ,@rule))
+      (define (DOTKERNEL r x y size)
+        (case tag
+          [(f32 f64)
+           (let1 T (getval rule 'T)
+             (c-block #"if (Scm_ClassOf(~y) == SCM_CLASS_~|T|VECTOR) {"
+                      #"    ~r = UVK_CALL(~|tag|k_dot, (SCM_~|T|VECTOR_ELEMENTS(~x), SCM_~|T|VECTOR_ELEMENTS(~y), ~size));"
+                      "    break;"
+                      "}"))]
+          [else ""]))
+      (for-each (cute substitute <> `((ZERO  ,ZERO)
+                                      (DOTKERNEL ,DOTKERNEL)
+                                      ,@rule))
                 *tmpl-dotop*))))
 
 (define (generate-rangeop)
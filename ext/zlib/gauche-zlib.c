@@ -34,6 +34,7 @@
 #include "gauche-zlib.h"
 #include <gauche/exception.h>
 #include <gauche/class.h>
+#include <gauche/priv/systemP.h>
 #define CHUNK 4096
 
 #define DEFAULT_BUFFER_SIZE 4096
@@ -551,6 +552,526 @@ ScmObj Scm_InflateSync(ScmPort *port)
     return Scm_MakeIntegerU(strm->total_in - curr_in);
 }
 
+/*================================================================
+ * Zstreams
+ *
+ *  A zstream is a bare z_stream wrapped as a Scheme object, to deflate
+ *  or inflate data in memory without going through ports.  It can be fed
+ *  in pieces, and reused for another stream by zstream-reset!.
+ */
+
+static void zstream_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<%A %p>", Scm_ShortClassName(Scm_ClassOf(obj)), obj);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_DeflatingZStreamClass, zstream_print);
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_InflatingZStreamClass, zstream_print);
+
+/* zlib allocates its internal state by malloc, so we have to release it
+   if the zstream is garbage collected without being closed. */
+static void zstream_finalize(ScmObj obj, void *data)
+{
+    ScmZStream *zs = SCM_ZSTREAM(obj);
+    if (!zs->closedp) {
+        if (SCM_DEFLATING_ZSTREAM_P(obj)) deflateEnd(zs->strm);
+        else inflateEnd(zs->strm);
+        zs->closedp = TRUE;
+    }
+}
+
+static ScmZStream *make_zstream(ScmClass *klass)
+{
+    ScmZStream *zs = SCM_NEW(ScmZStream);
+    SCM_SET_CLASS(zs, klass);
+    zs->strm = SCM_NEW_ATOMIC2(z_streamp, sizeof(z_stream));
+    zs->strm->zalloc = NULL;
+    zs->strm->zfree = NULL;
+    zs->strm->opaque = NULL;
+    zs->strm->next_in = NULL;
+    zs->strm->avail_in = 0;
+    zs->endp = FALSE;
+    zs->closedp = FALSE;
+    zs->dict = SCM_FALSE;
+    zs->dict_adler = SCM_FALSE;
+    return zs;
+}
+
+static void zstream_set_deflate_dictionary(ScmZStream *zs)
+{
+    if (SCM_FALSEP(zs->dict)) return;
+    int r = deflateSetDictionary(zs->strm,
+                                 (unsigned char*)SCM_STRING_START(zs->dict),
+                                 SCM_STRING_SIZE(zs->dict));
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "deflateSetDictionary failed: %s", zs->strm->msg);
+    }
+    zs->dict_adler = Scm_MakeIntegerU(zs->strm->adler);
+}
+
+ScmObj Scm_MakeDeflatingZStream(int level, int window_bits, int memlevel,
+                                int strategy, ScmObj dict)
+{
+    if (!SCM_FALSEP(dict) && !SCM_STRINGP(dict)) {
+        Scm_Error("String required, but got %S", dict);
+    }
+    ScmZStream *zs = make_zstream(SCM_CLASS_DEFLATING_ZSTREAM);
+    int r = deflateInit2(zs->strm, level, Z_DEFLATED, window_bits,
+                         memlevel, strategy);
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "deflateInit2 error: %s", zs->strm->msg);
+    }
+    Scm_RegisterFinalizer(SCM_OBJ(zs), zstream_finalize, NULL);
+    zs->dict = dict;
+    zstream_set_deflate_dictionary(zs);
+    return SCM_OBJ(zs);
+}
+
+ScmObj Scm_MakeInflatingZStream(int window_bits, ScmObj dict)
+{
+    if (!SCM_FALSEP(dict) && !SCM_STRINGP(dict)) {
+        Scm_Error("String required, but got %S", dict);
+    }
+    ScmZStream *zs = make_zstream(SCM_CLASS_INFLATING_ZSTREAM);
+    int r = inflateInit2(zs->strm, window_bits);
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "inflateInit2 error: %s", zs->strm->msg);
+    }
+    Scm_RegisterFinalizer(SCM_OBJ(zs), zstream_finalize, NULL);
+    zs->dict = dict;
+    return SCM_OBJ(zs);
+}
+
+static void zstream_check(ScmZStream *zs)
+{
+    if (zs->closedp) Scm_Error("zstream already closed: %S", SCM_OBJ(zs));
+}
+
+/* Output buffer that grows as needed. */
+typedef struct zbuf_rec {
+    unsigned char *buf;
+    size_t size;
+    size_t len;
+} zbuf;
+
+static void zbuf_init(zbuf *b, size_t size)
+{
+    if (size < CHUNK) size = CHUNK;
+    b->buf = SCM_NEW_ATOMIC2(unsigned char*, size);
+    b->size = size;
+    b->len = 0;
+}
+
+/* Make sure we have some room, and let STRM write into it. */
+static void zbuf_prepare(zbuf *b, z_streamp strm)
+{
+    if (b->len == b->size) {
+        size_t nsize = b->size * 2;
+        unsigned char *nbuf = SCM_NEW_ATOMIC2(unsigned char*, nsize);
+        memcpy(nbuf, b->buf, b->len);
+        b->buf = nbuf;
+        b->size = nsize;
+    }
+    size_t room = b->size - b->len;
+    if (room > UINT_MAX) room = UINT_MAX;
+    strm->next_out = b->buf + b->len;
+    strm->avail_out = (uInt)room;
+}
+
+static void zbuf_commit(zbuf *b, z_streamp strm)
+{
+    b->len = strm->next_out - b->buf;
+}
+
+static ScmObj zbuf_result(zbuf *b)
+{
+    return Scm_MakeU8VectorFromArrayShared(b->len, b->buf);
+}
+
+/* zlib takes the input size in uInt.  We feed a huge input in pieces. */
+#define ZSTREAM_MAX_INPUT  (1UL<<30)
+
+ScmObj Scm_ZStreamDeflate(ScmZStream *zs, const unsigned char *data,
+                          size_t size, int flush)
+{
+    z_streamp strm = zs->strm;
+    zbuf out;
+
+    zstream_check(zs);
+    if (zs->endp) Scm_Error("zstream already finished: %S", SCM_OBJ(zs));
+    zbuf_init(&out, (flush == Z_NO_FLUSH)? size/4 : deflateBound(strm, size));
+
+    for (;;) {
+        size_t chunk = (size > ZSTREAM_MAX_INPUT)? ZSTREAM_MAX_INPUT : size;
+        int f = (chunk == size)? flush : Z_NO_FLUSH;
+        strm->next_in = (unsigned char*)data;
+        strm->avail_in = (uInt)chunk;
+        for (;;) {
+            zbuf_prepare(&out, strm);
+            int r = deflate(strm, f);
+            zbuf_commit(&out, strm);
+            if (r == Z_STREAM_END) { zs->endp = TRUE; break; }
+            if (r != Z_OK && r != Z_BUF_ERROR) {
+                Scm_ZlibError(r, "deflate error: %s", strm->msg);
+            }
+            /* We're done with this chunk when zlib stops filling the
+               whole output buffer.  For Z_FINISH we wait Z_STREAM_END. */
+            if (strm->avail_in == 0 && strm->avail_out != 0
+                && f != Z_FINISH) break;
+        }
+        data += chunk;
+        size -= chunk;
+        if (size == 0) break;
+    }
+    strm->next_in = NULL;
+    strm->next_out = NULL;
+    return zbuf_result(&out);
+}
+
+ScmObj Scm_ZStreamInflate(ScmZStream *zs, const unsigned char *data,
+                          size_t size)
+{
+    z_streamp strm = zs->strm;
+    zbuf out;
+
+    zstream_check(zs);
+    zbuf_init(&out, size*4);
+    while (!zs->endp) {
+        size_t chunk = (size > ZSTREAM_MAX_INPUT)? ZSTREAM_MAX_INPUT : size;
+        strm->next_in = (unsigned char*)data;
+        strm->avail_in = (uInt)chunk;
+        for (;;) {
+            zbuf_prepare(&out, strm);
+            int r = inflate(strm, Z_NO_FLUSH);
+            zbuf_commit(&out, strm);
+            if (r == Z_NEED_DICT) {
+                if (SCM_FALSEP(zs->dict)) {
+                    Scm_ZlibError(r, "dictionary required");
+                }
+                r = inflateSetDictionary(strm,
+                                         (unsigned char*)SCM_STRING_START(zs->dict),
+                                         SCM_STRING_SIZE(zs->dict));
+                if (r != Z_OK) {
+                    Scm_ZlibError(r, "inflateSetDictionary error: %s",
+                                  strm->msg);
+                }
+                zs->dict_adler = Scm_MakeIntegerU(strm->adler);
+                continue;
+            }
+            if (r == Z_STREAM_END) { zs->endp = TRUE; break; }
+            if (r == Z_BUF_ERROR) break; /* needs more input */
+            if (r != Z_OK) {
+                Scm_ZlibError(r, "inflate error: %s", strm->msg);
+            }
+            if (strm->avail_in == 0 && strm->avail_out != 0) break;
+        }
+        /* Whatever follows the end of the stream is ignored; the caller
+           can find out where it is by zstream-total-in. */
+        data += chunk;
+        size -= chunk;
+        if (size == 0) break;
+    }
+    strm->next_in = NULL;
+    strm->next_out = NULL;
+    return zbuf_result(&out);
+}
+
+void Scm_ZStreamReset(ScmZStream *zs)
+{
+    zstream_check(zs);
+    if (SCM_DEFLATING_ZSTREAM_P(zs)) {
+        int r = deflateReset(zs->strm);
+        if (r != Z_OK) Scm_ZlibError(r, "deflateReset error: %s", zs->strm->msg);
+        zstream_set_deflate_dictionary(zs);
+    } else {
+        int r = inflateReset(zs->strm);
+        if (r != Z_OK) Scm_ZlibError(r, "inflateReset error: %s", zs->strm->msg);
+    }
+    zs->endp = FALSE;
+}
+
+void Scm_ZStreamClose(ScmZStream *zs)
+{
+    if (zs->closedp) return;
+    Scm_UnregisterFinalizer(SCM_OBJ(zs));
+    zstream_finalize(SCM_OBJ(zs), NULL);
+}
+
+/*================================================================
+ * Parallel gzip
+ *
+ *  As pigz does, we cut the input into blocks and compress each block
+ *  independently into raw deflate data, using the last 32KB of the
+ *  preceding input as the dictionary.  Every block but the last ends
+ *  with a sync flush, so that it ends at a byte boundary and the blocks
+ *  can just be concatenated.  The output doesn't depend on the number
+ *  of threads.  The CRC of each block is combined with crc32_combine.
+ *
+ *  The workers don't touch Scheme objects; the output buffers are
+ *  allocated before the workers start.  The jobs are run by
+ *  Scm__RunParallelJobs.
+ */
+
+#define GZ_DICT_SIZE     32768
+#define GZ_MAX_THREADS   8
+#define GZ_BATCH_BLOCKS  (GZ_MAX_THREADS*4) /* # of blocks compressed at once */
+
+typedef struct GzParamsRec {
+    int level;
+    int memlevel;
+    int strategy;
+    size_t blocksize;
+} GzParams;
+
+typedef struct GzBlockRec {
+    const unsigned char *in;
+    size_t inlen;
+    size_t dictlen;             /* dictionary is in[-dictlen .. -1] */
+    int finalp;
+    unsigned char *out;
+    size_t outsize;             /* allocated size of out */
+    size_t outlen;              /* compressed size */
+    uLong crc;
+    int error;                  /* zlib error code, or Z_OK */
+} GzBlock;
+
+typedef struct GzJobRec {
+    const GzParams *params;
+    GzBlock *blocks;
+    int start;                  /* this job handles blocks start, */
+    int step;                   /*  start+step, start+2*step, ... */
+    int nblocks;
+} GzJob;
+
+static void gz_do_job(void *data)
+{
+    GzJob *j = (GzJob*)data;
+    z_stream strm;
+    int initialized = FALSE;
+
+    memset(&strm, 0, sizeof(strm));
+    for (int i=j->start; i<j->nblocks; i+=j->step) {
+        GzBlock *b = &j->blocks[i];
+        int r;
+        if (!initialized) {
+            r = deflateInit2(&strm, j->params->level, Z_DEFLATED, -15,
+                             j->params->memlevel, j->params->strategy);
+            if (r != Z_OK) { b->error = r; return; }
+            initialized = TRUE;
+        } else {
+            deflateReset(&strm);
+        }
+        b->crc = crc32(crc32(0L, Z_NULL, 0), b->in, (uInt)b->inlen);
+        if (b->dictlen > 0) {
+            r = deflateSetDictionary(&strm, b->in - b->dictlen,
+                                     (uInt)b->dictlen);
+            if (r != Z_OK) { b->error = r; break; }
+        }
+        strm.next_in = (unsigned char*)b->in;
+        strm.avail_in = (uInt)b->inlen;
+        strm.next_out = b->out;
+        strm.avail_out = (uInt)b->outsize;
+        r = deflate(&strm, b->finalp? Z_FINISH : Z_SYNC_FLUSH);
+        if (b->finalp? (r != Z_STREAM_END)
+            : (r != Z_OK || strm.avail_in != 0 || strm.avail_out == 0)) {
+            /* The output buffer is made large enough, so this shouldn't
+               happen. */
+            b->error = (r == Z_OK || r == Z_STREAM_END)? Z_STREAM_ERROR : r;
+            break;
+        }
+        b->outlen = strm.next_out - b->out;
+        b->error = Z_OK;
+    }
+    if (initialized) deflateEnd(&strm);
+}
+
+/* Where the compressed data goes: either a port or a zbuf. */
+typedef struct GzSinkRec {
+    ScmPort *port;
+    zbuf *buf;
+    uLong crc;
+    size_t total;               /* total input size */
+} GzSink;
+
+static void gz_write(GzSink *sink, const unsigned char *data, size_t len)
+{
+    if (sink->port) {
+        Scm_Putz((const char*)data, len, sink->port);
+    } else {
+        zbuf *b = sink->buf;
+        if (b->len + len > b->size) {
+            size_t nsize = b->size * 2;
+            while (nsize < b->len + len) nsize *= 2;
+            unsigned char *nbuf = SCM_NEW_ATOMIC2(unsigned char*, nsize);
+            memcpy(nbuf, b->buf, b->len);
+            b->buf = nbuf;
+            b->size = nsize;
+        }
+        memcpy(b->buf + b->len, data, len);
+        b->len += len;
+    }
+}
+
+static void gz_write_header(GzSink *sink)
+{
+    /* magic, CM=deflate, no flags, no mtime, no extra flags, OS=unix;
+       the same as what zlib writes. */
+    static const unsigned char header[10] = {
+        0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3
+    };
+    gz_write(sink, header, 10);
+}
+
+static void gz_write_trailer(GzSink *sink)
+{
+    unsigned char trailer[8];
+    for (int i=0; i<4; i++) {
+        trailer[i]   = (unsigned char)(sink->crc >> (i*8));
+        trailer[i+4] = (unsigned char)(sink->total >> (i*8));
+    }
+    gz_write(sink, trailer, 8);
+}
+
+/* Compress DATA[0..len) as a batch of blocks.  DICTLEN bytes before
+   DATA are the preceding input.  If FINALP, the last block finishes
+   the deflate stream. */
+static void gz_deflate_batch(const GzParams *params, GzSink *sink,
+                             const unsigned char *data, size_t len,
+                             size_t dictlen, int finalp)
+{
+    GzBlock blocks[GZ_BATCH_BLOCKS];
+    GzJob jobs[GZ_MAX_THREADS];
+    int nblocks = 0;
+    size_t pos = 0;
+    z_stream strm;
+
+    /* A stream with the same parameters as the workers', just to ask
+       deflateBound, which depends on them. */
+    memset(&strm, 0, sizeof(strm));
+    int r = deflateInit2(&strm, params->level, Z_DEFLATED, -15,
+                         params->memlevel, params->strategy);
+    if (r != Z_OK) Scm_ZlibError(r, "deflateInit2 failed in parallel gzip");
+
+    do {
+        SCM_ASSERT(nblocks < GZ_BATCH_BLOCKS);
+        GzBlock *b = &blocks[nblocks++];
+        size_t n = len - pos;
+        if (n > params->blocksize) n = params->blocksize;
+        b->in = data + pos;
+        b->inlen = n;
+        b->dictlen = (pos + dictlen > GZ_DICT_SIZE)? GZ_DICT_SIZE : pos + dictlen;
+        b->finalp = finalp && (pos + n == len);
+        /* The empty stored block of the sync flush, with the bits to
+           align it, takes 6 bytes at most; we have some more room. */
+        b->outsize = deflateBound(&strm, (uLong)n) + 16;
+        b->outlen = 0;
+        b->error = Z_OK;
+        pos += n;
+    } while (pos < len);
+    deflateEnd(&strm);
+
+    for (int i=0; i<nblocks; i++) {
+        blocks[i].out = SCM_NEW_ATOMIC2(unsigned char*, blocks[i].outsize);
+    }
+
+    int njobs = Scm__ParallelJobCount(GZ_MAX_THREADS);
+    if (njobs > nblocks) njobs = nblocks;
+    for (int i=0; i<njobs; i++) {
+        jobs[i].params = params;
+        jobs[i].blocks = blocks;
+        jobs[i].start = i;
+        jobs[i].step = njobs;
+        jobs[i].nblocks = nblocks;
+    }
+    Scm__RunParallelJobs(gz_do_job, jobs, sizeof(GzJob), njobs);
+
+    for (int i=0; i<nblocks; i++) {
+        GzBlock *b = &blocks[i];
+        if (b->error != Z_OK) {
+            Scm_ZlibError(b->error, "deflate error in parallel gzip");
+        }
+        gz_write(sink, b->out, b->outlen);
+        sink->crc = crc32_combine(sink->crc, b->crc, (z_off_t)b->inlen);
+        sink->total += b->inlen;
+    }
+}
+
+static void gz_check_params(GzParams *params)
+{
+    if (params->blocksize < GZ_DICT_SIZE) params->blocksize = GZ_DICT_SIZE;
+    if (params->blocksize > ZSTREAM_MAX_INPUT) {
+        params->blocksize = ZSTREAM_MAX_INPUT;
+    }
+}
+
+ScmObj Scm_ParallelGzip(const unsigned char *data, size_t size,
+                        int level, int memlevel, int strategy,
+                        size_t blocksize)
+{
+    GzParams params = { level, memlevel, strategy, blocksize };
+    zbuf out;
+    GzSink sink = { NULL, &out, crc32(0L, Z_NULL, 0), 0 };
+
+    gz_check_params(&params);
+    zbuf_init(&out, size/2 + 64);
+    gz_write_header(&sink);
+    size_t batch = params.blocksize * GZ_BATCH_BLOCKS;
+    size_t pos = 0;
+    do {
+        size_t n = (size - pos > batch)? batch : size - pos;
+        gz_deflate_batch(&params, &sink, data + pos, n,
+                         (pos > GZ_DICT_SIZE)? GZ_DICT_SIZE : pos,
+                         pos + n == size);
+        pos += n;
+    } while (pos < size);
+    gz_write_trailer(&sink);
+    return zbuf_result(&out);
+}
+
+void Scm_ParallelGzipPort(ScmPort *in, ScmPort *out,
+                          int level, int memlevel, int strategy,
+                          size_t blocksize)
+{
+    GzParams params = { level, memlevel, strategy, blocksize };
+    GzSink sink = { out, NULL, crc32(0L, Z_NULL, 0), 0 };
+
+    gz_check_params(&params);
+    size_t batch = params.blocksize * GZ_BATCH_BLOCKS;
+    /* The buffer keeps the dictionary for the next batch in front. */
+    unsigned char *buf = SCM_NEW_ATOMIC2(unsigned char*, GZ_DICT_SIZE + batch);
+    unsigned char *data = buf + GZ_DICT_SIZE;
+    size_t dictlen = 0;
+    int finished = FALSE;
+
+    gz_write_header(&sink);
+    while (!finished) {
+        size_t n = 0;
+        while (n < batch) {
+            size_t req = batch - n;
+            int r = Scm_Getz((char*)data + n, (req > INT_MAX)? INT_MAX : (int)req,
+                             in);
+            if (r <= 0) { finished = TRUE; break; }
+            n += r;
+        }
+        if (n == 0 && dictlen > 0) {
+            /* The previous batch happened to end at EOF.  Close the
+               deflate stream with an empty final block. */
+            static const unsigned char empty_final[2] = { 0x03, 0x00 };
+            gz_write(&sink, empty_final, 2);
+            break;
+        }
+        gz_deflate_batch(&params, &sink, data, n, dictlen, finished);
+        if (n >= GZ_DICT_SIZE) {
+            memcpy(buf, data + n - GZ_DICT_SIZE, GZ_DICT_SIZE);
+            dictlen = GZ_DICT_SIZE;
+        } else if (n > 0) {
+            /* Only happens at the end. */
+            dictlen = n;
+        }
+    }
+    gz_write_trailer(&sink);
+}
+
 /*
  * Module initialization function.
  */
@@ -563,6 +1084,10 @@ void Scm_Init_zlib(void)
                         mod, NULL, 0);
     Scm_InitStaticClass(&Scm_InflatingPortClass, "<inflating-port>",
                         mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_DeflatingZStreamClass, "<deflating-zstream>",
+                        mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_InflatingZStreamClass, "<inflating-zstream>",
+                        mod, NULL, 0);
 
     ScmClass *cond_meta = Scm_ClassOf(SCM_OBJ(SCM_CLASS_CONDITION));
     Scm_InitStaticClassWithMeta(SCM_CLASS_ZLIB_ERROR,
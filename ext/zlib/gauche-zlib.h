@@ -126,6 +126,45 @@ extern ScmObj Scm_MakeZlibError(ScmObj message, int error_code);
 extern void Scm_ZlibError(int error_code, const char *msg, ...);
 extern ScmObj Scm_InflateSync(ScmPort *port);
 
+/* Zstreams - deflating/inflating on memory */
+typedef struct ScmZStreamRec {
+    SCM_HEADER;
+    z_streamp strm;
+    int endp;                   /* reached Z_STREAM_END */
+    int closedp;                /* deflateEnd/inflateEnd is called */
+    ScmObj dict;                /* dictionary string or #f */
+    ScmObj dict_adler;
+} ScmZStream;
+
+SCM_CLASS_DECL(Scm_DeflatingZStreamClass);
+#define SCM_CLASS_DEFLATING_ZSTREAM  (&Scm_DeflatingZStreamClass)
+#define SCM_DEFLATING_ZSTREAM_P(obj) SCM_XTYPEP(obj, SCM_CLASS_DEFLATING_ZSTREAM)
+SCM_CLASS_DECL(Scm_InflatingZStreamClass);
+#define SCM_CLASS_INFLATING_ZSTREAM  (&Scm_InflatingZStreamClass)
+#define SCM_INFLATING_ZSTREAM_P(obj) SCM_XTYPEP(obj, SCM_CLASS_INFLATING_ZSTREAM)
+#define SCM_ZSTREAM(obj)             ((ScmZStream*)(obj))
+#define SCM_ZSTREAM_P(obj) \
+    (SCM_DEFLATING_ZSTREAM_P(obj) || SCM_INFLATING_ZSTREAM_P(obj))
+
+extern ScmObj Scm_MakeDeflatingZStream(int level, int window_bits,
+                                       int memlevel, int strategy,
+                                       ScmObj dict);
+extern ScmObj Scm_MakeInflatingZStream(int window_bits, ScmObj dict);
+extern ScmObj Scm_ZStreamDeflate(ScmZStream *zs, const unsigned char *data,
+                                 size_t size, int flush);
+extern ScmObj Scm_ZStreamInflate(ScmZStream *zs, const unsigned char *data,
+                                 size_t size);
+extern void   Scm_ZStreamReset(ScmZStream *zs);
+extern void   Scm_ZStreamClose(ScmZStream *zs);
+
+/* Parallel gzip */
+extern ScmObj Scm_ParallelGzip(const unsigned char *data, size_t size,
+                               int level, int memlevel, int strategy,
+                               size_t blocksize);
+extern void   Scm_ParallelGzipPort(ScmPort *in, ScmPort *out,
+                                   int level, int memlevel, int strategy,
+                                   size_t blocksize);
+
 extern void Scm_Init_zlib(void);
 
 /* Epilogue */
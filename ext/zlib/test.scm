@@ -59,6 +59,10 @@
 (test* "Z_TEXT"                 1 Z_TEXT)
 (test* "Z_ASCII"                1 Z_ASCII)
 (test* "Z_UNKNOWN"              2 Z_UNKNOWN)
+(test* "Z_NO_FLUSH"             0 Z_NO_FLUSH)
+(test* "Z_SYNC_FLUSH"           2 Z_SYNC_FLUSH)
+(test* "Z_FULL_FLUSH"           3 Z_FULL_FLUSH)
+(test* "Z_FINISH"               4 Z_FINISH)
 
 ;;------------------------------------------------------------------
 (test-section "zlib condition type")
@@ -357,4 +361,129 @@
               (v (inflate-sync in)))
          (list v (eof-object? (read-char in)))))
 
+;;------------------------------------------------------------------
+(test-section "zstreams")
+
+(define *zdata*
+  (string->u8vector
+   (with-output-to-string
+     (^[] (dotimes [i 20000] (format #t "~a:~a " i (modulo (* i i) 97)))))))
+
+(test* "deflate-u8vector / inflate-u8vector" #t
+       (equal? *zdata* (inflate-u8vector (deflate-u8vector *zdata*))))
+
+(test* "deflate-u8vector (string)" #u8(102 111 111 98 97 114)
+       (inflate-u8vector (deflate-u8vector "foobar" :compression-level 9)))
+
+(test* "inflate-u8vector compatibility" "foobar"
+       (u8vector->string
+        (inflate-u8vector #*"x\x9cK\xcb\xcfOJ,\x02\0\x08\xab\x02z")))
+
+(test* "inflate-u8vector (broken)" (test-error <zlib-data-error>)
+       (inflate-u8vector "abc"))
+
+(test* "inflate-u8vector (truncated)" (test-error)
+       (let1 v (deflate-u8vector *zdata*)
+         (inflate-u8vector (u8vector-copy v 0 (quotient (u8vector-length v) 2)))))
+
+;; feed in chunks
+(define (zstream-chunks zs proc data size)
+  (let loop ([i 0] [r '()])
+    (if (>= i (u8vector-length data))
+      (reverse r)
+      (let1 e (min (u8vector-length data) (+ i size))
+        (loop e (cons (proc zs (u8vector-copy data i e)) r))))))
+
+(let ([d (make-deflating-zstream :compression-level 6)])
+  (define (deflate-in-chunks data)
+    (let* ([cs (zstream-chunks d zstream-deflate data 1000)]
+           [c (apply u8vector-append
+                     `(,@cs ,(zstream-deflate d #u8() Z_FINISH)))])
+      (test* "zstream-end? (deflate)" #t (zstream-end? d))
+      c))
+  (define (inflate-in-chunks data)
+    (let* ([i (make-inflating-zstream)]
+           [r (apply u8vector-append (zstream-chunks i zstream-inflate data 77))])
+      (test* "zstream-end? (inflate)" #t (zstream-end? i))
+      (test* "zstream-total-in" (u8vector-length data) (zstream-total-in i))
+      (test* "zstream-total-out" (u8vector-length r) (zstream-total-out i))
+      (zstream-close i)
+      r))
+
+  (test* "zstream chunked" #t
+         (equal? *zdata* (inflate-in-chunks (deflate-in-chunks *zdata*))))
+  (test* "zstream-deflate after end" (test-error)
+         (zstream-deflate d "foo"))
+  (zstream-reset! d)
+  (test* "zstream reused after reset" #t
+         (equal? *zdata* (inflate-in-chunks (deflate-in-chunks *zdata*))))
+  (zstream-close d)
+  (test* "zstream closed" (test-error) (zstream-deflate d "foo")))
+
+(test* "zstream sync flush" "abc"
+       (let* ([d (make-deflating-zstream)]
+              [i (make-inflating-zstream)]
+              [c (zstream-deflate d "abc" Z_SYNC_FLUSH)])
+         (u8vector->string (zstream-inflate i c))))
+
+(test* "zstream with dictionary" '("abcabcabcxyz" #t)
+       (let* ([d (make-deflating-zstream :dictionary "abcxyz")]
+              [c (zstream-deflate d "abcabcabcxyz" Z_FINISH)]
+              [i (make-inflating-zstream :dictionary "abcxyz")]
+              [r (zstream-inflate i c)])
+         (list (u8vector->string r)
+               (eqv? (zstream-dictionary-adler32 d)
+                     (zstream-dictionary-adler32 i)))))
+
+(test* "zstream needs dictionary" (test-error <zlib-need-dict-error>)
+       (let1 d (make-deflating-zstream :dictionary "abcxyz")
+         (zstream-inflate (make-inflating-zstream)
+                          (zstream-deflate d "abcabcabcxyz" Z_FINISH))))
+
+(test* "zstream gzip format" "foobar"
+       (gzip-decode-string
+        (u8vector->string (deflate-u8vector "foobar" :window-bits (+ 15 16)))))
+
+;;------------------------------------------------------------------
+(test-section "parallel gzip")
+
+(define (pgz-test name data . opts)
+  (test* #"parallel-gzip-encode ~name" #t
+         (equal? (u8vector->string data)
+                 (gzip-decode-string
+                  (u8vector->string (apply parallel-gzip-encode data opts)))))
+  (test* #"parallel-gzip-encode-port ~name" #t
+         (equal? (u8vector->string data)
+                 (gzip-decode-string
+                  (call-with-output-string
+                    (^[out]
+                      (apply parallel-gzip-encode-port
+                             (open-input-uvector data) out opts)))))))
+
+(pgz-test "empty" #u8())
+(pgz-test "short" (string->u8vector "foobar"))
+(pgz-test "one block" *zdata*)
+(pgz-test "multi blocks" *zdata* :block-size 32768)
+(pgz-test "multi batches" (u8vector-append *zdata* *zdata* *zdata* *zdata*
+                                           *zdata* *zdata* *zdata* *zdata*)
+          :block-size 32768 :compression-level 1)
+;; Incompressible data is emitted as stored blocks, which are small
+;; when memory-level is small, so the output is much larger than the
+;; bound for the default parameters.
+(pgz-test "incompressible, memory-level 1"
+          (let1 s 1
+            (list->u8vector
+             (list-tabulate 100000
+                            (^_ (set! s (modulo (+ (* s 1103515245) 12345)
+                                                2147483648))
+                                (quotient s 8388608)))))
+          :block-size 32768 :memory-level 1)
+
+(test* "parallel-gzip-encode (string)" "foobar"
+       (gzip-decode-string (u8vector->string (parallel-gzip-encode "foobar"))))
+
+(test* "parallel-gzip-encode is deterministic" #t
+       (equal? (parallel-gzip-encode *zdata* :block-size 32768)
+               (parallel-gzip-encode *zdata* :block-size 32768)))
+
 (test-end)
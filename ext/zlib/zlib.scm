@@ -50,11 +50,18 @@
           zstream-dictionary-adler32
           gzip-encode-string gzip-decode-string
           inflate-sync
+          <deflating-zstream> <inflating-zstream>
+          make-deflating-zstream make-inflating-zstream
+          zstream-deflate zstream-inflate zstream-end?
+          zstream-reset! zstream-close
+          deflate-u8vector inflate-u8vector
+          parallel-gzip-encode parallel-gzip-encode-port
           Z_NO_COMPRESSION Z_BEST_SPEED
           Z_BEST_COMPRESSION Z_DEFAULT_COMPRESSION
           Z_FILTERED Z_HUFFMAN_ONLY
           Z_RLE Z_DEFAULT_STRATEGY
           Z_BINARY Z_ASCII Z_UNKNOWN
+          Z_NO_FLUSH Z_SYNC_FLUSH Z_FULL_FLUSH Z_FINISH
           ))
 (select-module rfc.zlib)
 
@@ -72,6 +79,21 @@
  (define-type <xflating-port> "ScmPort*" "inflating or deflating port"
    "SCM_XFLATING_PORT_P" "SCM_PORT")
 
+ (define-type <deflating-zstream> "ScmZStream*" "deflating zstream"
+   "SCM_DEFLATING_ZSTREAM_P" "SCM_ZSTREAM")
+ (define-type <inflating-zstream> "ScmZStream*" "inflating zstream"
+   "SCM_INFLATING_ZSTREAM_P" "SCM_ZSTREAM")
+ ;; proxy type, as <xflating-port>
+ (define-type <zstream> "ScmZStream*" "inflating or deflating zstream"
+   "SCM_ZSTREAM_P" "SCM_ZSTREAM")
+
+ ;; zstream-* accessors work on both ports and zstreams.
+ (define-cfn get_zstream (obj) ::z_streamp :static
+   (cond [(SCM_XFLATING_PORT_P obj) (return (SCM_PORT_ZSTREAM (SCM_PORT obj)))]
+         [(SCM_ZSTREAM_P obj) (return (-> (SCM_ZSTREAM obj) strm))]
+         [else (SCM_TYPE_ERROR obj "inflating/deflating port or zstream")
+               (return NULL)]))
+
  (define-cfn data_element (data::ScmObj
                            start::(const unsigned char**)
                            siz::int*)
@@ -86,6 +108,21 @@
          [else
           (Scm_Error "u8vector or string required, but got: %S" data)]))
 
+ ;; Same as data_element, but for the data that may exceed 2GB.
+ (define-cfn data_element_large (data::ScmObj
+                                 start::(const unsigned char**)
+                                 siz::size_t*)
+   ::void :static
+   (cond [(SCM_U8VECTORP data)
+          (set! (* start) (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR data))
+                (* siz)   (SCM_U8VECTOR_SIZE (SCM_U8VECTOR data)))]
+         [(SCM_STRINGP data)
+          (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+            (set! (* start) (cast (unsigned char*) (SCM_STRING_BODY_START b))
+                  (* siz)   (SCM_STRING_BODY_SIZE b)))]
+         [else
+          (Scm_Error "u8vector or string required, but got: %S" data)]))
+
  (define-cproc zlib-version ()
    (expr <top> (SCM_MAKE_STR (zlibVersion))))
 
@@ -102,6 +139,10 @@
  (define-enum-conditionally Z_TEXT)
  (define-enum Z_ASCII)
  (define-enum Z_UNKNOWN)
+ (define-enum Z_NO_FLUSH)
+ (define-enum Z_SYNC_FLUSH)
+ (define-enum Z_FULL_FLUSH)
+ (define-enum Z_FINISH)
 
  (define-cproc adler32 (data :optional (adler::<ulong> 1)) ::<ulong>
    (let* ([start::(const unsigned char*)]
@@ -135,11 +176,11 @@
    (return (Scm_MakeInflatingPort sink buffer-size window-bits dictionary
                                   (not (SCM_FALSEP owner?)))))
 
- (define-cproc zstream-total-in (port::<xflating-port>) ::<ulong>
-   (return (-> (SCM_PORT_ZSTREAM port) total-in)))
+ (define-cproc zstream-total-in (zs) ::<ulong>
+   (return (-> (get_zstream zs) total-in)))
 
- (define-cproc zstream-total-out (port::<xflating-port>) ::<ulong>
-   (return (-> (SCM_PORT_ZSTREAM port) total-out)))
+ (define-cproc zstream-total-out (zs) ::<ulong>
+   (return (-> (get_zstream zs) total-out)))
 
  (define-cproc zstream-params-set! (port::<deflating-port>
                                     :key (compression-level #f) (strategy #f))
@@ -164,16 +205,74 @@
    (set! (-> (SCM_PORT_ZLIB_INFO port) flush) Z_FULL_FLUSH)
    (Scm_Flush port))
 
- (define-cproc zstream-adler32 (port::<deflating-port>) ::<ulong>
-   (return (-> (SCM_PORT_ZSTREAM port) adler)))
+ (define-cproc zstream-adler32 (zs) ::<ulong>
+   (return (-> (get_zstream zs) adler)))
 
  (define-cproc zstream-data-type (port::<deflating-port>) ::<int>
    (return (-> (SCM_PORT_ZSTREAM port) data_type)))
 
- (define-cproc zstream-dictionary-adler32 (port::<xflating-port>)
-   (return (-> (SCM_PORT_ZLIB_INFO port) dict_adler)))
+ (define-cproc zstream-dictionary-adler32 (zs)
+   (if (SCM_ZSTREAM_P zs)
+     (return (-> (SCM_ZSTREAM zs) dict_adler))
+     (begin
+       (unless (SCM_XFLATING_PORT_P zs)
+         (SCM_TYPE_ERROR zs "inflating/deflating port or zstream"))
+       (return (-> (SCM_PORT_ZLIB_INFO (SCM_PORT zs)) dict_adler)))))
 
  (define-cproc inflate-sync (port::<inflating-port>) Scm_InflateSync)
+
+ (define-cproc %make-deflating-zstream (compression-level::<fixnum>
+                                        window-bits::<fixnum>
+                                        memory-level::<fixnum>
+                                        strategy::<fixnum>
+                                        dictionary)
+   (return (Scm_MakeDeflatingZStream compression-level window-bits
+                                     memory-level strategy dictionary)))
+
+ (define-cproc make-inflating-zstream (:key (window-bits::<fixnum> 15)
+                                            (dictionary #f))
+   (return (Scm_MakeInflatingZStream window-bits dictionary)))
+
+ (define-cproc zstream-deflate (zs::<deflating-zstream> data
+                                :optional (flush::<fixnum> 0)) ; Z_NO_FLUSH
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element_large data (& start) (& siz))
+     (return (Scm_ZStreamDeflate zs start siz flush))))
+
+ (define-cproc zstream-inflate (zs::<inflating-zstream> data)
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element_large data (& start) (& siz))
+     (return (Scm_ZStreamInflate zs start siz))))
+
+ (define-cproc zstream-end? (zs::<zstream>) ::<boolean>
+   (return (-> zs endp)))
+
+ (define-cproc zstream-reset! (zs::<zstream>) ::<void> Scm_ZStreamReset)
+
+ (define-cproc zstream-close (zs::<zstream>) ::<void> Scm_ZStreamClose)
+
+ (define-cproc %parallel-gzip-encode (data
+                                      compression-level::<fixnum>
+                                      memory-level::<fixnum>
+                                      strategy::<fixnum>
+                                      block-size::<fixnum>)
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element_large data (& start) (& siz))
+     (return (Scm_ParallelGzip start siz compression-level memory-level
+                               strategy block-size))))
+
+ (define-cproc %parallel-gzip-encode-port (in::<input-port>
+                                           out::<output-port>
+                                           compression-level::<fixnum>
+                                           memory-level::<fixnum>
+                                           strategy::<fixnum>
+                                           block-size::<fixnum>)
+   ::<void>
+   (Scm_ParallelGzipPort in out compression-level memory-level
+                         strategy block-size))
  )
  
 
@@ -214,3 +313,44 @@
                        (open-input-string str)
                        :window-bits (+ 15 16)
                        args)))
+
+;; zstreams
+(define (make-deflating-zstream :key (compression-level Z_DEFAULT_COMPRESSION)
+                                     (window-bits 15)
+                                     (memory-level 8)
+                                     (strategy Z_DEFAULT_STRATEGY)
+                                     (dictionary #f))
+  (%make-deflating-zstream compression-level window-bits memory-level
+                           strategy dictionary))
+
+(define (deflate-u8vector data . args)
+  (let* ([zs (apply make-deflating-zstream args)]
+         [r (zstream-deflate zs data Z_FINISH)])
+    (zstream-close zs)
+    r))
+
+(define (inflate-u8vector data . args)
+  (let* ([zs (apply make-inflating-zstream args)]
+         [r (zstream-inflate zs data)])
+    (unless (zstream-end? zs)
+      (zstream-close zs)
+      (error "inflate-u8vector: premature end of compressed data"))
+    (zstream-close zs)
+    r))
+
+;; parallel gzip
+(define (parallel-gzip-encode data
+                              :key (compression-level Z_DEFAULT_COMPRESSION)
+                                   (memory-level 8)
+                                   (strategy Z_DEFAULT_STRATEGY)
+                                   (block-size 131072))
+  (%parallel-gzip-encode data compression-level memory-level
+                         strategy block-size))
+
+(define (parallel-gzip-encode-port in out
+                                   :key (compression-level Z_DEFAULT_COMPRESSION)
+                                        (memory-level 8)
+                                        (strategy Z_DEFAULT_STRATEGY)
+                                        (block-size 131072))
+  (%parallel-gzip-encode-port in out compression-level memory-level
+                              strategy block-size))
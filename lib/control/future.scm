@@ -0,0 +1,72 @@
+;;;
+;;; control.future - futures
+;;;
+;;;   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module control.future
+  (use gauche.threads)
+  (use gauche.record)
+  (export future make-future future? future-done? future-get))
+(select-module control.future)
+
+;; A future runs the thunk in its own thread.  The thread's result is
+;; the list of values the thunk returns; if the thunk raises a condition,
+;; thread-join! reraises it wrapped in <uncaught-exception>, which we
+;; unwrap in future-get.
+
+(define-record-type <future> %make-future future?
+  (thread future-thread))
+
+;; API
+(define (make-future thunk)
+  (%make-future (thread-start! (make-thread (^[] (values->list (thunk)))))))
+
+;; API
+(define-syntax future
+  (syntax-rules ()
+    [(_ expr) (make-future (^[] expr))]))
+
+;; API
+(define (future-done? future)
+  (eq? (thread-state (future-thread future)) 'terminated))
+
+(define *timeout* (list 'timeout))      ; unique marker
+
+;; API
+;; Waits for the result and returns the values.  Can be called more
+;; than once.
+(define (future-get future :optional (timeout #f) (timeout-val #f))
+  (let1 r (guard (e [(uncaught-exception? e)
+                     (raise (uncaught-exception-reason e))])
+            (thread-join! (future-thread future) timeout *timeout*))
+    (if (eq? r *timeout*)
+      timeout-val
+      (apply values r))))
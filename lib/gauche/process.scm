@@ -200,7 +200,8 @@
                        (redirects '())
                        (wait   #f) (fork   #t)
                        (host   #f)    ;remote execution
-                       (sigmask #f) (directory #f) (detached #f))
+                       (sigmask #f) (directory #f) (environment #f)
+                       (detached #f))
     (let* ([redirs (%canon-redirects redirects input output error)]
            [argv (map x->string command)]
            [proc (make <process> :command (car argv))]
@@ -217,6 +218,7 @@
           (let1 pid (sys-fork-and-exec (car argv) argv
                                        :iomap iomap :directory dir
                                        :sigmask (%ensure-mask sigmask)
+                                       :environment environment
                                        :detached detached)
             (push! (ref proc 'processes) proc)
             (set!  (ref proc 'pid) pid)
@@ -233,6 +235,7 @@
           (sys-exec (car argv) argv
                     :iomap iomap :directory dir
                     :sigmask (%ensure-mask sigmask)
+                    :environment environment
                     :detached detached))))))
 
 (define (%canon-redirects redirects in out err)
@@ -519,7 +522,8 @@
 ;; would cover typical use case...
 (define (run-pipeline commands
                       :key (input #f) (output #f) (error #f)
-                      (wait #f) (sigmask #f) (directory #f) (detached #f))
+                      (wait #f) (sigmask #f) (directory #f) (environment #f)
+                      (detached #f))
   (when (null? commands)
     (error "At least one command is required to run-command-pipeline"))
   (and-let1 offending (any (^c (and (not (pair? c)) (list c))) commands)
@@ -530,7 +534,9 @@
          [cmds (map (^[cmdline in out]
                       `(,cmdline :input ,in :output ,out :error ,error
                                  :sigmask ,sigmask
-                                 :directory ,directory :detached ,detached))
+                                 :directory ,directory
+                                 :environment ,environment
+                                 :detached ,detached))
                     commands
                     (cons input (map car pipe-pairs))
                     (fold-right cons (list output) (map cdr pipe-pairs)))]
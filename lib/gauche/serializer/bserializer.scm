@@ -0,0 +1,80 @@
+;;;
+;;; bserializer.scm - binary serializer
+;;;
+;;;   Copyright (c) 2017  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; The encoder and the decoder are written in C (src/serial.c).
+;; This module provides the API, and <bserializer> to plug the binary
+;; format into the gauche.serializer framework.
+
+(define-module gauche.serializer.bserializer
+  (use gauche.serializer)
+  (export <bserializer>
+          write-serialized read-serialized
+          serialize deserialize))
+(select-module gauche.serializer.bserializer)
+
+(define %serialize
+  (with-module gauche.internal %serialize))
+(define %serialize-to-u8vector
+  (with-module gauche.internal %serialize-to-u8vector))
+(define %deserialize
+  (with-module gauche.internal %deserialize))
+(define %deserialize-u8vector
+  (with-module gauche.internal %deserialize-u8vector))
+
+;; Port API.  Each call writes or reads one self-contained datum,
+;; so that they can be used for a stream of objects.
+(define (write-serialized obj :optional (port (current-output-port)))
+  (%serialize obj port))
+
+(define (read-serialized :optional (port (current-input-port)))
+  (%deserialize port))
+
+;; u8vector API.  DESERIALIZE returns the object and the index of
+;; the byte after the datum, so that it can be called again to read
+;; the subsequent datum.
+(define (serialize obj) (%serialize-to-u8vector obj))
+
+(define (deserialize u8v :optional (start 0) (end -1))
+  (%deserialize-u8vector u8v start end))
+
+(define-class <bserializer> (<serializer>) ())
+
+(define-method write-to-serializer ((self <bserializer>) object)
+  (unless (eq? (direction-of self) :out)
+    (error "Output serializer required:" self))
+  (%serialize object (port-of self)))
+
+(define-method read-from-serializer ((self <bserializer>))
+  (unless (eq? (direction-of self) :in)
+    (error "Input serializer required:" self))
+  (%deserialize (port-of self)))
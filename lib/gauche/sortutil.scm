@@ -25,6 +25,7 @@
 
 (define %sort  (with-module gauche.internal %sort))
 (define %sort! (with-module gauche.internal %sort!))
+(define %sort-by! (with-module gauche.internal %sort-by!))
 
 (define-syntax define-less?
   (syntax-rules ()
@@ -144,7 +145,14 @@
 
 (define (stable-sort! seq :optional (cmp #f) (key identity))
   (define-less? less? cmp 'sort!)
-  (if (memq key `(,identity ,values))
+  (cond
+   [(and (not cmp) (or (pair? seq) (vector? seq)))
+    ;; The internal sort is stable.  With a key, we compute keys only
+    ;; once and let the internal routine permute seq along with them.
+    (if (memq key `(,identity ,values))
+      (%sort! seq)
+      (%sort-by! seq (if (vector? seq) (vector-map key seq) (map key seq))))]
+   [(memq key `(,identity ,values))
     (letrec ([step (^n (cond [(> n 2) (let* ([j (ash n -1)]
                                              [a (step j)]
                                              [k (- n j)]
@@ -175,7 +183,8 @@
                    [(null? p) vector]
                  (vector-set! vector i (car p))))]
             [(is-a? seq <sequence>) (%generic-sort! seq less?)]
-            [else (error "sequence required, but got:" seq)]))
+            [else (error "sequence required, but got:" seq)]))]
+   [else
     ;; Avoid making intermediate structure, for the point of stable-sort!
     ;; is to avoid allocation.
     (letrec ([kless? (^[a b] (less? (cdr a) (cdr b)))])
@@ -201,7 +210,7 @@
                  (vector-set! seq i (car (vector-ref seq i))))
                seq)]
             [(is-a? seq <sequence>) (%generic-sort! seq less? key)]
-            [else (error "sequence required, but got:" seq)]))))
+            [else (error "sequence required, but got:" seq)]))]))
 
 ;;; (sort sequence less?)
 ;;; sorts a vector or list non-destructively.  It does this by sorting a
@@ -214,17 +223,23 @@
 
 (define (stable-sort seq :optional (cmp #f) (key identity))
   (define-less? less? cmp 'sort)
-  (if (memq key `(,identity ,values))
+  (cond
+   [(and (not cmp) (or (pair? seq) (vector? seq)))
+    (if (memq key `(,identity ,values))
+      (%sort seq)
+      (stable-sort! (if (pair? seq) (list-copy seq) (vector-copy seq)) #f key))]
+   [(memq key `(,identity ,values))
     (cond [(null? seq) seq]
           [(pair? seq) (stable-sort! (list-copy seq) less?)]
           [(vector? seq) (list->vector (sort! (vector->list seq) less?))]
           [(is-a? seq <sequence>) (%generic-sort seq less?)]
-          [else (error "sequence required, but got:" seq)])
+          [else (error "sequence required, but got:" seq)])]
+   [else
     (cond [(null? seq) seq]
           [(pair? seq) (stable-sort! (list-copy seq) less? key)]
           [(vector? seq) (stable-sort! (vector-copy seq) less? key)]
           [(is-a? seq <sequence>) (%generic-sort seq less? key)]
-          [else (error "sequence required, but got:" seq)])))
+          [else (error "sequence required, but got:" seq)])]))
 
 ;; For the backward compatibility
 (define (sort-by seq key :optional (cmp #f)) (sort seq cmp key))
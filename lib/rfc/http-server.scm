@@ -0,0 +1,472 @@
+;;;
+;;; http-server.scm - HTTP/1.1 server
+;;;
+;;;   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; A small HTTP/1.1 server, meant to be embedded in applications.
+
+;; RFC7230 Hypertext Transfer Protocol (HTTP/1.1): Message Syntax and Routing
+;;  https://tools.ietf.org/html/rfc7230
+
+;; The request head is parsed by rfc.http-parser, which reads directly
+;; from the buffer of the socket port.  Connections are kept alive,
+;; and pipelined requests are served in order; we don't flush the
+;; output while the next request is already in the input buffer, so
+;; that the responses of a pipeline go out together.
+
+(define-module rfc.http-server
+  (use srfi-13)
+  (use rfc.822)
+  (use rfc.http-parser)
+  (use gauche.net)
+  (use gauche.selector)
+  (use gauche.record)
+  (use gauche.uvector)
+  (use gauche.vport)
+  (export <http-server> make-http-server
+          http-server-run! http-server-stop! http-server-port
+
+          <http-request> http-request?
+          http-request-method http-request-target http-request-version
+          http-request-headers http-request-body http-request-remote-address
+          http-request-path http-request-query http-request-header-ref
+          ))
+(select-module rfc.http-server)
+
+(autoload gauche.threads make-thread thread-start! thread-join! thread-state)
+(autoload control.thread-pool make-thread-pool add-job! terminate-all!)
+(autoload rfc.http http-status-code->description)
+
+;;==============================================================
+;; Request
+;;
+
+(define-record-type <http-request>
+    (%make-http-request method target version headers body remote-address)
+    http-request?
+  (method  http-request-method)         ; "GET", "POST", ...
+  (target  http-request-target)         ; request-target as is
+  (version http-request-version)        ; "HTTP/1.1" or "HTTP/1.0"
+  (headers http-request-headers)        ; ((name value) ...), names downcased
+  (body    http-request-body)           ; u8vector or #f
+  (remote-address http-request-remote-address)) ; <sockaddr>
+
+(define (http-request-path req)
+  (let1 t (http-request-target req)
+    (if-let1 i (string-index t #\?)
+      (substring t 0 i)
+      t)))
+
+(define (http-request-query req)
+  (let1 t (http-request-target req)
+    (and-let* ([i (string-index t #\?)])
+      (substring t (+ i 1) (string-length t)))))
+
+(define (http-request-header-ref req name :optional (default #f))
+  (rfc822-header-ref (http-request-headers req) name default))
+
+;;==============================================================
+;; Server
+;;
+
+(define-class <http-server> ()
+  ((handler     :init-keyword :handler)
+   (host        :init-keyword :host :init-value #f)
+   (port        :init-keyword :port :init-value 8080)
+   ;; How to serve connections: thread, pool or event-loop
+   (model       :init-keyword :model :init-value 'thread)
+   (num-threads :init-keyword :num-threads :init-value 8) ; for pool
+   ;; Seconds to wait for the next request on an idle connection.
+   (keep-alive-timeout :init-keyword :keep-alive-timeout :init-value 5)
+   ;; Max # of requests on one connection, or #f for unlimited.
+   (max-requests :init-keyword :max-requests :init-value 100)
+   (max-body-size   :init-keyword :max-body-size   :init-value 1048576)
+   (max-line-size   :init-keyword :max-line-size   :init-value 8190)
+   (max-header-size :init-keyword :max-header-size :init-value 65536)
+   (max-headers     :init-keyword :max-headers     :init-value 100)
+   ;; Called with a condition raised by the handler.
+   (error-handler :init-keyword :error-handler :init-value report-error)
+   ;; private
+   (sockets     :init-value '())        ; listening sockets
+   (stop-in     :init-value #f)         ; readable once stopped
+   (stop-out    :init-value #f)
+   (stopped     :init-value #f)))
+
+(define-method initialize ((server <http-server>) initargs)
+  (next-method)
+  (unless (memq (~ server'model) '(thread pool event-loop))
+    (error "model must be one of thread, pool or event-loop, but got:"
+           (~ server'model)))
+  (set! (~ server'sockets)
+        (make-server-sockets (~ server'host) (~ server'port)
+                             :reuse-addr? #t))
+  (receive (in out) (sys-pipe)
+    (set! (~ server'stop-in) in)
+    (set! (~ server'stop-out) out)))
+
+(define (make-http-server handler . args)
+  (apply make <http-server> :handler handler args))
+
+;; The actual port number, useful when the server is created with port 0.
+(define (http-server-port server)
+  (sockaddr-port (socket-address (car (~ server'sockets)))))
+
+;; Stops accepting connections.  Connections being served are closed
+;; after the current request.  Can be called from any thread, including
+;; the handler.
+(define (http-server-stop! server)
+  (unless (~ server'stopped)
+    (set! (~ server'stopped) #t)
+    ;; We never read from the pipe, so once written, select(2) on it
+    ;; always returns immediately.
+    (write-byte 0 (~ server'stop-out))
+    (flush (~ server'stop-out))))
+
+(define (http-server-run! server)
+  (case (~ server'model)
+    [(thread)
+     ;; We keep the threads to wait for the requests being served.
+     (let1 threads '()
+       (accept-loop server
+                    (^[conn]
+                      (set! threads
+                            (cons (thread-start!
+                                   (make-thread
+                                    (cut serve-connection server conn)))
+                                  (remove (^t (eq? (thread-state t)
+                                                   'terminated))
+                                          threads)))))
+       (for-each thread-join! threads))]
+    [(pool)
+     (let1 pool (make-thread-pool (~ server'num-threads))
+       (unwind-protect
+           (accept-loop server
+                        (^[conn] (add-job! pool
+                                           (cut serve-connection server conn))))
+         (terminate-all! pool)))]
+    [(event-loop) (event-loop server)])
+  (for-each socket-close (~ server'sockets)))
+
+(define (accept-loop server dispatch)
+  (let ([sel (make <selector>)]
+        [done #f])
+    (dolist [s (~ server'sockets)]
+      (selector-add! sel (socket-fd s)
+                     (^[fd flag] (dispatch (socket-accept s)))
+                     '(r)))
+    (selector-add! sel (~ server'stop-in) (^[fd flag] (set! done #t)) '(r))
+    (until done (selector-select sel))))
+
+;;--------------------------------------------------------------
+;; Connection
+;;
+
+(define (connection-error? e)
+  (or (<system-error> e) (<io-error> e)))
+
+;; Thread and pool models.  Serves requests on CONN until either
+;; side closes the connection.
+(define (serve-connection server conn)
+  (let ([in  (socket-input-port conn :buffering :modest)]
+        [out (socket-output-port conn :buffering :full)])
+    (guard (e [(connection-error? e) #f]
+              [else ((~ server'error-handler) e)])
+      (let loop ([n 1])
+        (when (and (wait-for-request server conn in out)
+                   (serve-request server conn in out n))
+          (loop (+ n 1))))
+      (flush out))
+    (socket-close conn)))
+
+;; Returns #t if a request is (likely) available.  We only flush the
+;; output when we have to wait, so the responses to pipelined requests
+;; are sent together.
+(define (wait-for-request server conn in out)
+  (or (byte-ready? in)
+      (begin
+        (flush out)
+        (let1 rfds (make <sys-fdset>)
+          (set! (sys-fdset-ref rfds (socket-fd conn)) #t)
+          (set! (sys-fdset-ref rfds (~ server'stop-in)) #t)
+          (receive (n rfds . _)
+              (sys-select! rfds #f #f
+                           (* (~ server'keep-alive-timeout) 1000000))
+            (and (> n 0)
+                 (not (~ server'stopped))
+                 (sys-fdset-ref rfds (socket-fd conn))))))))
+
+;; Event-loop model.  A single thread serves all connections, reading
+;; requests of a connection only when its socket becomes readable.
+;; Note that a client that sends a partial request blocks the loop
+;; until the rest arrives; use other models for untrusted clients.
+(define-class <connection> ()
+  ((socket :init-keyword :socket)
+   (in     :init-keyword :in)
+   (out    :init-keyword :out)
+   (count  :init-value 0)               ; # of requests served
+   (idle-since :init-value 0)))
+
+(define (event-loop server)
+  (define sel (make <selector>))
+  (define conns (make-hash-table 'eqv?)) ; fd -> <connection>
+  (define done #f)
+
+  (define (close-connection c)
+    (let1 fd (socket-fd (~ c'socket))
+      (selector-delete! sel fd #f #f)
+      (hash-table-delete! conns fd))
+    (guard (e [(connection-error? e) #f])
+      (flush (~ c'out)))
+    (socket-close (~ c'socket)))
+
+  (define (serve fd flag)
+    (let1 c (hash-table-get conns fd)
+      (if (guard (e [(connection-error? e) #f]
+                    [else ((~ server'error-handler) e) #f])
+            (let loop ()
+              (inc! (~ c'count))
+              (and (serve-request server (~ c'socket) (~ c'in) (~ c'out)
+                                  (~ c'count))
+                   (if (byte-ready? (~ c'in))
+                     (loop)
+                     (begin (flush (~ c'out)) #t)))))
+        (set! (~ c'idle-since) (sys-time))
+        (close-connection c))))
+
+  (define (accept s)
+    (^[fd flag]
+      (let1 conn (socket-accept s)
+        (hash-table-put! conns (socket-fd conn)
+                         (rlet1 c (make <connection>
+                                    :socket conn
+                                    :in (socket-input-port conn
+                                                           :buffering :modest)
+                                    :out (socket-output-port conn
+                                                             :buffering :full))
+                           (set! (~ c'idle-since) (sys-time))))
+        (selector-add! sel (socket-fd conn) serve '(r)))))
+
+  (define (close-idle-connections)
+    (let1 limit (- (sys-time) (~ server'keep-alive-timeout))
+      (dolist [c (hash-table-values conns)]
+        (when (< (~ c'idle-since) limit)
+          (close-connection c)))))
+
+  (dolist [s (~ server'sockets)]
+    (selector-add! sel (socket-fd s) (accept s) '(r)))
+  (selector-add! sel (~ server'stop-in) (^[fd flag] (set! done #t)) '(r))
+  (until done
+    (selector-select sel 1000000)
+    (close-idle-connections))
+  (for-each close-connection (hash-table-values conns)))
+
+;;--------------------------------------------------------------
+;; Request processing
+;;
+
+;; Reads and serves one request.  N is the number of the request on
+;; the connection.  Returns #t if the connection can be kept.
+(define (serve-request server conn in out n)
+  (guard (e [(and (<http-parse-error> e) (~ e'status))
+             (send-response out "HTTP/1.1" "GET" (~ e'status)
+                            '(("content-length" "0")) #f #f)])
+    (receive (method target version headers)
+        (http-read-request-head in
+                                :max-line-size (~ server'max-line-size)
+                                :max-header-size (~ server'max-header-size)
+                                :max-headers (~ server'max-headers))
+      (and (string? method)
+           (let* ([body (read-body server in out version headers)]
+                  [req (%make-http-request method target version headers
+                                           body (socket-address conn))])
+             (receive (status rheaders rbody) (call-handler server req)
+               (send-response out version method status rheaders rbody
+                              (keep-alive? server version headers n))))))))
+
+(define (call-handler server req)
+  (guard (e [else ((~ server'error-handler) e)
+                  (values 500 '() #f)])
+    (receive (status . rest) ((~ server'handler) req)
+      (let-optionals* rest ([headers '()] [body #f])
+        (values status headers body)))))
+
+(define (connection-tokens headers)
+  (if-let1 v (rfc822-header-ref headers "connection")
+    (string-tokenize (string-downcase v) #[a-z0-9-])
+    '()))
+
+(define (keep-alive? server version headers n)
+  (and (not (~ server'stopped))
+       (or (not (~ server'max-requests))
+           (< n (~ server'max-requests)))
+       (if (equal? version "HTTP/1.0")
+         (member "keep-alive" (connection-tokens headers))
+         (not (member "close" (connection-tokens headers))))
+       #t))
+
+;; Returns the request body as u8vector, or #f if the request doesn't
+;; have one.  Errors are reported as <http-parse-error> with status.
+(define (read-body server in out version headers)
+  (define (bad status msg . args)
+    (apply error <http-parse-error> :status status msg args))
+  (define (continue)
+    (when (and (equal? version "HTTP/1.1")
+               (equal? (rfc822-header-ref headers "expect") "100-continue"))
+      (display "HTTP/1.1 100 Continue\r\n\r\n" out)
+      (flush out)))
+  (let ([te (rfc822-header-ref headers "transfer-encoding")]
+        [cl (rfc822-header-ref headers "content-length")])
+    (cond
+     [te
+      (unless (string-ci=? te "chunked")
+        (bad 501 "unsupported transfer coding:" te))
+      (continue)
+      (read-chunked-body server in bad)]
+     [cl
+      (let1 size (and (#/^\d+$/ cl) (string->number cl))
+        (cond [(not size) (bad 400 "bad content-length:" cl)]
+              [(> size (~ server'max-body-size))
+               (bad 413 "request body too large:" size)]
+              [(zero? size) #f]
+              [else (continue) (read-exactly in size bad)]))]
+     [else #f])))
+
+(define (read-exactly in size bad)
+  (let1 v (make-u8vector size)
+    (let loop ([start 0])
+      (if (= start size)
+        v
+        (let1 n (read-uvector! v in start)
+          (when (eof-object? n)
+            (bad 400 "request body ended prematurely"))
+          (loop (+ start n)))))))
+
+;; NB: chunk extensions and trailer fields are ignored.  The chunk-size
+;; lines and the trailer are subject to the same limits as the header.
+(define (read-chunked-body server in bad)
+  (define (read-crlf)
+    (case (read-byte in)
+      [(13) (unless (eqv? (read-byte in) 10) (bad 400 "bad chunk terminator"))]
+      [(10)]
+      [else (bad 400 "bad chunk terminator")]))
+  (let loop ([chunks '()] [total 0])
+    (let1 size (http-read-chunk-size in
+                                     :max-line-size (~ server'max-line-size))
+      (cond [(zero? size)
+             (http-read-trailer in
+                                :max-line-size (~ server'max-line-size)
+                                :max-header-size (~ server'max-header-size)
+                                :max-headers (~ server'max-headers))
+             (apply u8vector-append (reverse chunks))]
+            [(> (+ total size) (~ server'max-body-size))
+             (bad 413 "request body too large")]
+            [else
+             (let1 chunk (read-exactly in size bad)
+               (read-crlf)
+               (loop (cons chunk chunks) (+ total size)))]))))
+
+;;--------------------------------------------------------------
+;; Response
+;;
+
+;; Date header value.  It only changes once a second.
+(define *date-cache* (cons 0 ""))
+
+(define (http-date)
+  (let ([now (sys-time)]
+        [cache *date-cache*])
+    (if (= (car cache) now)
+      (cdr cache)
+      (rlet1 s (sys-strftime "%a, %d %b %Y %H:%M:%S GMT" (sys-gmtime now))
+        (set! *date-cache* (cons now s))))))
+
+(define (write-headers out headers)
+  (dolist [h headers]
+    (display (car h) out)
+    (display ": " out)
+    (display (cadr h) out)
+    (display "\r\n" out)))
+
+;; BODY may be a string, a u8vector, #f, or a procedure that takes
+;; an output port and writes the body to it.  VERSION and METHOD are
+;; of the request.  Returns #t if the connection can be kept.
+(define (send-response out version method status headers body keep?)
+  (let* ([no-body? (or (< status 200) (= status 204) (= status 304))]
+         [head? (equal? method "HEAD")]
+         [length (cond [no-body? #f]
+                       [(rfc822-header-ref headers "content-length")]
+                       [(string? body) (string-size body)]
+                       [(u8vector? body) (u8vector-length body)]
+                       [(not body) 0]
+                       [else #f])]
+         [chunked? (and (procedure? body) (not length) (not no-body?)
+                        (not head?) keep? (equal? version "HTTP/1.1"))]
+         [keep? (and keep?
+                     (or length no-body? head? chunked?)
+                     (not (member "close" (connection-tokens headers))))])
+    (display "HTTP/1.1 " out)
+    (display status out)
+    (display " " out)
+    (display (or (http-status-code->description status) "") out)
+    (display "\r\n" out)
+    (write-headers out headers)
+    (unless (rfc822-header-ref headers "date")
+      (write-headers out `(("date" ,(http-date)))))
+    (when (and length (not (rfc822-header-ref headers "content-length")))
+      (write-headers out `(("content-length" ,length))))
+    (when chunked?
+      (write-headers out '(("transfer-encoding" "chunked"))))
+    (cond [(not keep?)
+           (write-headers out '(("connection" "close")))]
+          [(equal? version "HTTP/1.0")
+           (write-headers out '(("connection" "keep-alive")))])
+    (display "\r\n" out)
+    (unless (or no-body? head?)
+      (cond [(string? body) (display body out)]
+            [(u8vector? body) (write-uvector body out)]
+            [(not body)]
+            [chunked?
+             (let1 p (make <buffered-output-port>
+                       :flush (^[buf complete?]
+                                (write-chunk buf out)
+                                (u8vector-length buf)))
+               (body p)
+               (close-output-port p)
+               (display "0\r\n\r\n" out))]
+            [else (body out)]))
+    keep?))
+
+(define (write-chunk buf out)
+  (unless (zero? (u8vector-length buf))
+    (display (number->string (u8vector-length buf) 16) out)
+    (display "\r\n" out)
+    (write-uvector buf out)
+    (display "\r\n" out)))
@@ -54,10 +54,13 @@
   (use gauche.charconv)
   (use gauche.sequence)
   (use gauche.uvector)
+  (use gauche.threads)
   (use util.match)
   (use text.tree)
   (export <http-error>
           http-user-agent make-http-connection reset-http-connection
+          <http-connection-pool> make-http-connection-pool
+          http-connection-pool http-connection-pool-clear!
           http-compose-query http-compose-form-data
           http-status-code->description
 
@@ -68,6 +71,7 @@
           http-file-sender http-multipart-sender
 
           http-get http-head http-post http-put http-delete
+          http-request-async
           http-default-auth-handler
           http-default-redirect-handler
 
@@ -90,6 +94,7 @@
           process-wait process-kill)
 
 (autoload file.util file-size find-file-in-paths null-device)
+(autoload control.future make-future)
 
 ;;==============================================================
 ;; Conditions
@@ -97,6 +102,13 @@
 
 (define-condition-type <http-error> <error> #f)
 
+;; Internal.  <http-no-reply> is raised when the server closes the
+;; connection without sending anything.  If it happens (or a system error
+;; occurs) on a reused connection, it is converted to <http-stale-connection>
+;; so that we retry the request with a new connection.
+(define-condition-type <http-no-reply> <http-error> #f)
+(define-condition-type <http-stale-connection> <http-error> #f)
+
 ;;==============================================================
 ;; Global parameters
 ;;
@@ -139,7 +151,8 @@
 ;; optionally a port number by the format of "server:port"), or
 ;; an <http-connection> object.  Using a server name is suitable
 ;; for easy one-shot http access; the connection and related states
-;; are discarded once the procedure returns.
+;; are discarded once the procedure returns, except that the socket
+;; is kept in (http-connection-pool) for reuse if the server allows.
 ;; On the other hand, a connection object can keep the states such
 ;; as persistent connection and authentication tokens, suitable for
 ;; a series of communications to a server.
@@ -251,6 +264,24 @@
                          [else => identity])))
   (define no-body-replies '("204" "304"))
 
+  ;; Whether we can send another request over the same connection after
+  ;; reading the reply.  The reply must have a definite end, and the
+  ;; server must not be going to close the connection.
+  (define (reusable-reply? method code version headers)
+    (let1 tokens (if-let1 v (rfc822-header-ref headers "connection")
+                   (map (^t (string-downcase (string-trim-both t)))
+                        (string-split v #\,))
+                   '())
+      (and (if (member version '("1.1" "2.0"))
+             (not (member "close" tokens))
+             (member "keep-alive" tokens))
+           (or (eq? method 'HEAD)
+               (member code no-body-replies)
+               (equal? (rfc822-header-ref headers "transfer-encoding")
+                       "chunked")
+               (rfc822-header-ref headers "content-length"))
+           #t)))
+
   (define (get-body iport method code headers receiver)
     (and (not (eq? method 'HEAD))
          (not (member code no-body-replies))
@@ -278,25 +309,46 @@
   ;;   (reply <code> <headers> <body>)
   ;;   (redirect-to <method> <location>)
   (define (request-response in out method uri host sender)
-    (send-request out method uri sender (req-headers host) enc)
-    (receive (code rep-headers) (receive-header in)
-      (if-let1 consider-redirect (and (string-prefix? "3" code) redirector)
-        ;; we retrieve body as string, not using caller-provided receiver
-        (let* ([body (get-body in method code rep-headers
-                               (http-string-receiver))]
-               [verdict (consider-redirect method code rep-headers body)])
-          ;; consider-redirect returns either #f (don't redirect) or
-          ;; (METHOD . LOCATION).
-          (if verdict
-            `(redirect-to ,(car verdict) ,(cdr verdict))
-            (let1 hdrs (redirect-headers body rep-headers) ;giving up
-              `(reply ,code ,hdrs
-                      ,(and body
-                            (receive-body (open-input-string body) code
-                                          hdrs receiver))))))
-        ;; no redirection
-        `(reply ,code ,rep-headers
-                ,(get-body in method code rep-headers receiver)))))
+    (receive (code rep-headers version)
+        (if (and (~ conn'reused) (idempotent-method? method))
+          ;; The server may have closed the idle connection.  If we get
+          ;; nothing back, with-connection retries with a new one.
+          ;; We can't tell whether the server has processed the request,
+          ;; so we do so only if it's safe to repeat the request.
+          (guard (e [(or (<system-error> e) (<http-no-reply> e))
+                     (error <http-stale-connection> (condition-message e))])
+            (send-request out method uri sender (req-headers host) enc)
+            (receive-header in))
+          (begin
+            (send-request out method uri sender (req-headers host) enc)
+            (receive-header in)))
+      (begin0
+        (request-response-1 in method code rep-headers)
+        ;; We get here only when the entire reply is read.  Leftover
+        ;; input means the receiver didn't consume the body, or the
+        ;; server has closed the connection.
+        (set! (~ conn'reusable)
+              (and (reusable-reply? method code version rep-headers)
+                   (or (~ conn'secure) (not (byte-ready? in))))))))
+
+  (define (request-response-1 in method code rep-headers)
+    (if-let1 consider-redirect (and (string-prefix? "3" code) redirector)
+      ;; we retrieve body as string, not using caller-provided receiver
+      (let* ([body (get-body in method code rep-headers
+                             (http-string-receiver))]
+             [verdict (consider-redirect method code rep-headers body)])
+        ;; consider-redirect returns either #f (don't redirect) or
+        ;; (METHOD . LOCATION).
+        (if verdict
+          `(redirect-to ,(car verdict) ,(cdr verdict))
+          (let1 hdrs (redirect-headers body rep-headers) ;giving up
+            `(reply ,code ,hdrs
+                    ,(and body
+                          (receive-body (open-input-string body) code
+                                        hdrs receiver))))))
+      ;; no redirection
+      `(reply ,code ,rep-headers
+              ,(get-body in method code rep-headers receiver))))
 
   ;; main loop
   (let loop ([history '()]
@@ -463,6 +515,13 @@
 (define (http-delete server request-uri . options)
   (apply %http-request-adaptor 'DELETE server request-uri #f options))
 
+;; Runs http-request in a separate thread and returns a future
+;; (see control.future).  The future yields the same three values as
+;; http-request.  Concurrent requests to the same server share the
+;; idle connections through (http-connection-pool).
+(define (http-request-async method server request-uri . options)
+  (make-future (^[] (apply http-request method server request-uri options))))
+
 ;; Adaptor to the new API.  Converts :sink and :flusher arguments,
 ;; which are superseded by :receiver arguments.
 (define (%http-request-adaptor method server request-uri body
@@ -508,6 +567,10 @@
    (proxy         :init-keyword :proxy)
    (extra-headers :init-keyword :extra-headers)
    (secure        :init-keyword :secure) ; either #f, tls or stunnel
+   (reused   :init-value #f)            ; #t if the current socket has been
+                                        ; used by a previous request.
+   (reusable :init-value #f)            ; set #t after reading a reply if
+                                        ; the socket can be used again.
    ))
 
 (define (make-http-connection server :key
@@ -546,6 +609,98 @@
       (set! (~ conn'secure) (and (equal? proto "https") 'tls))))
   conn)
 
+;;==============================================================
+;; Connection pool
+;;
+
+;; A pool keeps idle sockets of finished requests, keyed by the server,
+;; the proxy and the secure type, so that the next request to the same
+;; server can skip the connection setup (and TLS handshake).  It is
+;; used by requests via non-persistent connections, including the ones
+;; created implicitly when a server name is passed to the APIs.
+;; Sockets of the stunnel agent aren't pooled.
+
+(define-class <http-connection-pool> ()
+  ((idle-timeout :init-keyword :idle-timeout) ; seconds
+   (max-idle     :init-keyword :max-idle)     ; max # of idle sockets per key
+   (table        :init-form (make-hash-table 'equal?))
+                                        ; key -> ((socket agent time) ...)
+   (lock         :init-form (make-mutex))))
+
+(define (make-http-connection-pool :key (idle-timeout 30) (max-idle 8))
+  (make <http-connection-pool> :idle-timeout idle-timeout :max-idle max-idle))
+
+;; The pool used by the APIs.  #f disables pooling.
+(define http-connection-pool (make-parameter (make-http-connection-pool)))
+
+(define (http-connection-pool-clear! :optional (pool (http-connection-pool)))
+  (when pool
+    (for-each close-pooled-entry
+              (with-locking-mutex (~ pool'lock)
+                (^[] (begin0 (append-map cdr (hash-table->alist (~ pool'table)))
+                             (hash-table-clear! (~ pool'table))))))))
+
+(define (pool-key conn)
+  (and (memq (~ conn'secure) '(#f tls))
+       (list (~ conn'server) (~ conn'proxy) (~ conn'secure))))
+
+(define (close-pooled-entry entry)
+  (match-let1 (socket agent _) entry
+    (when agent
+      (guard (e [else #f]) (tls-close agent))
+      (tls-destroy agent))
+    (guard (e [(<system-error> e) #f]) (socket-shutdown socket))
+    (socket-close socket)))
+
+;; An idle socket becomes readable only if the server has closed it
+;; (or sent something unexpected); either way it can't be used.
+(define (idle-socket-alive? socket)
+  (cond-expand
+   [gauche.sys.select
+    (receive (n . _) (sys-select (sys-fdset (socket-fd socket)) #f #f 0)
+      (eqv? n 0))]
+   [else #t]))
+
+;; Takes an idle socket for CONN from the pool.  Returns #t on success.
+(define (checkout-connection! conn)
+  (and-let* ([pool (http-connection-pool)]
+             [key (pool-key conn)])
+    (let loop ()
+      (match (with-locking-mutex (~ pool'lock)
+               (^[] (match (hash-table-get (~ pool'table) key '())
+                      [() #f]
+                      [(e . es) (hash-table-put! (~ pool'table) key es) e])))
+        [#f #f]
+        [(and (socket agent time) entry)
+         (if (and (< (- (sys-time) time) (~ pool'idle-timeout))
+                  (guard (e [(<system-error> e) #f])
+                    (idle-socket-alive? socket)))
+           (begin (set! (~ conn'socket) socket)
+                  (set! (~ conn'secure-agent) agent)
+                  #t)
+           (begin (close-pooled-entry entry)
+                  (loop)))]))))
+
+;; Returns the socket of CONN to the pool, or closes it if we can't.
+(define (checkin-connection! conn)
+  (if-let1 key (and (http-connection-pool) (pool-key conn))
+    (let* ([pool (http-connection-pool)]
+           [entry (list (~ conn'socket) (~ conn'secure-agent) (sys-time))]
+           [dropped
+            (with-locking-mutex (~ pool'lock)
+              (^[] (let1 es (cons entry
+                                  (hash-table-get (~ pool'table) key '()))
+                     (if (> (length es) (~ pool'max-idle))
+                       (receive (keep drop) (split-at es (~ pool'max-idle))
+                         (hash-table-put! (~ pool'table) key keep)
+                         drop)
+                       (begin (hash-table-put! (~ pool'table) key es)
+                              '())))))])
+      (set! (~ conn'socket) #f)
+      (set! (~ conn'secure-agent) #f)
+      (for-each close-pooled-entry dropped))
+    (reset-http-connection conn)))
+
 ;;==============================================================
 ;; query and request body composition
 ;;
@@ -735,20 +890,41 @@
     (socket-close (~ conn'socket))
     (set! (~ conn'socket) #f)))
 
+;; RFC7231 section 4.2.2.  The request of these methods can be
+;; resent when we aren't sure if the server got it.
+(define (idempotent-method? method)
+  (memq method '(GET HEAD OPTIONS TRACE PUT DELETE)))
+
 (define (with-connection conn proc)
-  (unwind-protect
-      (begin
-        (unless (~ conn'persistent)
-          (unless (~ conn'socket) (start-socket-connection conn))
-          (when (~ conn'secure) (start-secure-agent conn)))
+  ;; A persistent connection keeps its socket between requests.  Otherwise
+  ;; we try to borrow an idle socket from the connection pool, and return
+  ;; it to the pool after the request if the server allows.
+  (define (connect! fresh?)
+    (set! (~ conn'reusable) #f)
+    (cond [(and (not fresh?) (~ conn'socket)) (set! (~ conn'reused) #t)]
+          [(and (not fresh?) (checkout-connection! conn))
+           (set! (~ conn'reused) #t)]
+          [else
+           (set! (~ conn'reused) #f)
+           (start-socket-connection conn)
+           (when (~ conn'secure) (start-secure-agent conn))]))
+  (define (release!)
+    (cond [(not (~ conn'reusable)) (reset-http-connection conn)]
+          [(~ conn'persistent)]
+          [else (checkin-connection! conn)]))
+  (define (run fresh?)
+    (connect! fresh?)
+    (unwind-protect
         (apply proc (if (~ conn'secure)
                       `(,(secure-agent-input-port conn)
                         ,(secure-agent-output-port conn))
                       `(,(socket-input-port (~ conn'socket))
-                        ,(socket-output-port (~ conn'socket))))))
-    (unless (~ conn'persistent)
-      (when (~ conn'secure) (shutdown-secure-agent conn))
-      (shutdown-socket-connection conn))))
+                        ,(socket-output-port (~ conn'socket)))))
+      (release!)))
+  ;; The server may close an idle connection at any time, so we retry
+  ;; once if a reused connection turns out to be dead.
+  (guard (e [(<http-stale-connection> e) (run #t)])
+    (run #f)))
 
 ;; canonicalize uri for the sake of redirection.
 ;; URI is a request-uri given to the API, or the redirect location specified
@@ -810,14 +986,17 @@
   (flush out))
 
 ;; receive
+;; Returns status code, headers and http version (e.g. "1.1").
 (define (receive-header remote)
-  (receive (code reason) (parse-status-line (read-line remote))
-    (values code (rfc822-header->list remote))))
+  (receive (code reason version) (parse-status-line (read-line remote))
+    (values code (rfc822-header->list remote) version)))
 
 (define (parse-status-line line)
   (cond [(eof-object? line)
-         (error <http-error> "http reply contains no data")]
-        [(#/\w+\s+(\d\d\d)\s+(.*)/ line) => (^m (values (m 1) (m 2)))]
+         (error <http-no-reply> "http reply contains no data")]
+        [(#/\w+\s+(\d\d\d)\s+(.*)/ line)
+         => (^m (values (m 1) (m 2)
+                        (rxmatch->string #/^HTTP\/(\d+\.\d+)/ line 1)))]
         [else (error <http-error> "bad reply from server" line)]))
 
 (define (receive-body remote code headers receiver)
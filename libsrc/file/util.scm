@@ -44,6 +44,7 @@
   (use util.match)
   (use gauche.parameter)
   (export current-directory directory-list directory-list2 directory-fold
+          directory-generator
           home-directory temporary-directory
           make-directory* create-directory* remove-directory* delete-directory*
           copy-directory*
@@ -71,6 +72,10 @@
           ))
 (select-module file.util)
 
+(autoload gauche.threads make-thread thread-start! thread-join!
+          make-mutex with-locking-mutex)
+(autoload data.queue make-mtqueue enqueue! dequeue/wait!)
+
 ;; Common util.  Returns #f if PATH does not exist.
 
 (define (safe-stat path follow-link?)
@@ -163,24 +168,149 @@
 
 ;; directory-fold DIR PROC KNIL &keyword LISTER FOLDER FOLLOW-LINK?
 (define (directory-fold dir proc knil
-                        :key (lister (lambda (path knil)
-                                       (values (directory-list path
-                                                               :add-path? #t
-                                                               :children? #t)
-                                               knil)))
-                             (folder fold)
+                        :key (lister #f)
+                             (folder #f)
                              (follow-link? #t))
   (define (selector e)
     (and (file-exists? e)
          (eq? (slot-ref (%stat e follow-link?) 'type) 'directory)))
+  (define (default-lister path knil)
+    (values (directory-list path :add-path? #t :children? #t) knil))
   (define (rec path knil)
     (if (selector path)
       ;; [TODO]: For the backward compatibiliy, we allow LISTER to return
       ;; only a single value.  Should be removed, probably in 0.9.
-      (receive res (lister path knil)
-        (folder rec (get-optional (cdr res) knil) (car res)))
+      (receive res ((or lister default-lister) path knil)
+        ((or folder fold) rec (get-optional (cdr res) knil) (car res)))
+      (proc path knil)))
+  ;; With the default lister and folder, we know the entries are
+  ;; the children of the directory, so we can use the file types
+  ;; in the directory entries instead of calling stat on each.
+  (define (rec/types path dir? knil)
+    (if dir?
+      (fold (^[e knil] (rec/types (car e) (eq? (cdr e) 'directory) knil))
+            knil (%directory-entries path follow-link?))
       (proc path knil)))
-  (rec dir knil))
+  (if (or lister folder)
+    (rec dir knil)
+    (rec/types dir (selector dir) knil)))
+
+;; Internal.  Returns a list of (path . type) of the children of DIR,
+;; sorted by name.  Type is a symbol as the type slot of <sys-stat>;
+;; if FOLLOW-LINK? is true, it's the type of the file a symlink points
+;; to, except that a dangling symlink is reported as symlink.
+;; Most filesystems record the file type in the directory entry,
+;; so we call stat only for symlinks we follow, or when the type is
+;; unknown.  It makes a big difference on a large tree.
+(define %readdir-with-types
+  (with-module gauche.internal %sys-readdir-with-types))
+
+(define (%directory-entries dir follow-link?)
+  (define (entry name type)
+    (let1 path (build-path dir name)
+      (cons path
+            (case type
+              [(#f) (and-let* ([s (safe-stat path follow-link?)])
+                      (slot-ref s 'type))]
+              [(symlink) (or (and follow-link?
+                                  (and-let* ([s (safe-stat path #t)])
+                                    (slot-ref s 'type)))
+                             'symlink)]
+              [else type]))))
+  ($ map (^p (entry (car p) (cdr p)))
+     $ sort (remove (^p (member (car p) '("." ".."))) (%readdir-with-types dir))
+            string<? car))
+
+;; API
+;; Returns a generator that yields the pathnames of all the entries under
+;; DIR, recursively.  If WITH-TYPE? is true, it yields (path . type)
+;; instead.  DESCEND?, if given, is called with the pathname of each
+;; directory, and the directory isn't walked into if it returns #f.
+;; If NUM-THREADS is positive and threads are available, directories
+;; are read concurrently by that many threads and the order of entries
+;; is unspecified; otherwise, entries come in the same order as
+;; directory-fold visits them.
+(define (directory-generator dir :key (follow-link? #t)
+                                      (with-type? #f)
+                                      (descend? #f)
+                                      (num-threads 0))
+  (define (output e) (if with-type? e (car e)))
+  (define (descend-into? e)
+    (and (eq? (cdr e) 'directory)
+         (or (not descend?) (descend? (car e)))))
+  (if (and (> num-threads 0)
+           (cond-expand [gauche.sys.threads #t] [else #f]))
+    (%directory-generator/threads dir follow-link? descend-into? output
+                                  num-threads)
+    (%directory-generator dir follow-link? descend-into? output)))
+
+;; Depth-first walk.  STACK holds the remaining entries of each level.
+(define (%directory-generator dir follow-link? descend-into? output)
+  (define stack #f)
+  (define (gen)
+    (cond [(not stack)
+           (set! stack (list (%directory-entries dir follow-link?)))
+           (gen)]
+          [(null? stack) (eof-object)]
+          [(null? (car stack)) (pop! stack) (gen)]
+          [else
+           (let1 e (caar stack)
+             (set-car! stack (cdar stack))
+             (when (descend-into? e)
+               (push! stack (%directory-entries (car e) follow-link?)))
+             (output e))]))
+  gen)
+
+;; Worker threads take directories from WORK queue, and put the list
+;; of their entries to RESULTS queue, and the subdirectories back to WORK.
+;; PENDING counts the directories queued or being read; when it gets
+;; to zero we're done.  An error in a worker is passed to the consumer
+;; through RESULTS in a box, for the raised object can be anything, and
+;; reraised there.
+;; NB: The workers run ahead of the consumer and buffer the results,
+;; so that they finish even if the consumer abandons the generator.
+(define (%directory-generator/threads dir follow-link? descend-into? output
+                                      num-threads)
+  (define work (make-mtqueue))
+  (define results (make-mtqueue))
+  (define lock (make-mutex))
+  (define pending 1)
+  (define (worker)
+    (let1 d (dequeue/wait! work)
+      (unless (eof-object? d)
+        (let* ([es (guard (e [else (enqueue! results (box e)) '()])
+                     (%directory-entries d follow-link?))]
+               [subdirs (guard (e [else (enqueue! results (box e)) '()])
+                          (filter-map (^e (and (descend-into? e) (car e)))
+                                      es))])
+          ;; The entries must be in RESULTS before we decrement PENDING;
+          ;; once it gets to zero, another worker may put the end marker.
+          (unless (null? es) (enqueue! results es))
+          (let1 done? (with-locking-mutex lock
+                        (^[] (inc! pending (- (length subdirs) 1))
+                             (zero? pending)))
+            (unless (null? subdirs) (apply enqueue! work subdirs))
+            (when done?
+              (enqueue! results (eof-object))
+              (dotimes [num-threads] (enqueue! work (eof-object))))))
+        (worker))))
+  (define threads
+    (begin (enqueue! work dir)
+           (map (^_ (thread-start! (make-thread worker))) (iota num-threads))))
+  (define buf '())
+  (define finished #f)
+  (define (gen)
+    (cond [(pair? buf) (output (pop! buf))]
+          [finished (eof-object)]
+          [else
+           (let1 r (dequeue/wait! results)
+             (cond [(eof-object? r)
+                    (set! finished #t)
+                    (for-each thread-join! threads)
+                    (eof-object)]
+                   [(box? r) (raise (unbox r))]
+                   [else (set! buf r) (gen)]))]))
+  gen)
 
 ;; mkdir -p
 (define (make-directory* dir :optional (mode #o755))
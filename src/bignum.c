@@ -78,6 +78,7 @@ char *alloca ();
 #include <stdlib.h>
 #include <math.h>
 #include <limits.h>
+#include <ctype.h>
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/priv/arith.h"
@@ -95,6 +96,7 @@ static ScmBignum *bignum_lshift(ScmBignum *br, const ScmBignum *bx, int amount);
 static int bignum_safe_size_for_add(const ScmBignum *x, const ScmBignum *y);
 static ScmBignum *bignum_add_int(ScmBignum *br, const ScmBignum *bx, const ScmBignum *by);
 static ScmBignum *bignum_2scmpl(ScmBignum *br);
+static u_long bignum_sdiv(ScmBignum *dividend, u_long divisor);
 
 /*---------------------------------------------------------------------
  * Constructor
@@ -807,10 +809,396 @@ static ScmBignum *bignum_lshift(ScmBignum *br, const ScmBignum *bx, int amount)
     return br;
 }
 
+/*-----------------------------------------------------------------------
+ * Word vector primitives
+ *
+ *   The subquadratic algorithms work on raw arrays of words, least
+ *   significant word first, with explicit lengths.  They deal with
+ *   magnitudes only.
+ */
+
+/* Algorithm thresholds, in words.  They're variables so that the
+   benchmark (tools/bench-bignum.scm) can move them around to find
+   the crossover points.  See Scm__BignumAlgorithmThreshold(). */
+static int karatsuba_threshold = 40;    /* schoolbook -> Karatsuba */
+static int toom3_threshold     = 1500;  /* Karatsuba -> Toom-3 */
+static int bz_threshold        = 60;    /* Burnikel-Ziegler base case */
+static int dc_conv_threshold   = 40;    /* radix conversion */
+
+/* r[0..n) = x[0..n) + y[0..n).  Returns carry.  R may be X or Y. */
+static u_long wv_add_n(u_long *r, const u_long *x, const u_long *y, int n)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long xi = x[i], yi = y[i];
+        UADD(r[i], c, xi, yi);
+    }
+    return c;
+}
+
+/* r[0..n) = x[0..n) - y[0..n).  Returns borrow.  R may be X or Y. */
+static u_long wv_sub_n(u_long *r, const u_long *x, const u_long *y, int n)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long xi = x[i], yi = y[i];
+        USUB(r[i], c, xi, yi);
+    }
+    return c;
+}
+
+/* r[0..n) += c.  Returns carry. */
+static u_long wv_add_1(u_long *r, int n, u_long c)
+{
+    for (int i=0; c && i<n; i++) {
+        u_long ri = r[i];
+        UADD(r[i], c, ri, 0);
+    }
+    return c;
+}
+
+/* r[0..n) -= c.  Returns borrow. */
+static u_long wv_sub_1(u_long *r, int n, u_long c)
+{
+    for (int i=0; c && i<n; i++) {
+        u_long ri = r[i];
+        USUB(r[i], c, ri, 0);
+    }
+    return c;
+}
+
+/* r[0..xn) = x[0..xn) + y[0..yn), xn >= yn.  Returns carry. */
+static u_long wv_add(u_long *r, const u_long *x, int xn,
+                     const u_long *y, int yn)
+{
+    u_long c = wv_add_n(r, x, y, yn);
+    if (r != x) {
+        for (int i=yn; i<xn; i++) r[i] = x[i];
+    }
+    return wv_add_1(r+yn, xn-yn, c);
+}
+
+/* r[0..xn) = x[0..xn) - y[0..yn), xn >= yn.  Returns borrow. */
+static u_long wv_sub(u_long *r, const u_long *x, int xn,
+                     const u_long *y, int yn)
+{
+    u_long c = wv_sub_n(r, x, y, yn);
+    if (r != x) {
+        for (int i=yn; i<xn; i++) r[i] = x[i];
+    }
+    return wv_sub_1(r+yn, xn-yn, c);
+}
+
+static int wv_cmp(const u_long *x, const u_long *y, int n)
+{
+    for (int i=n-1; i>=0; i--) {
+        if (x[i] < y[i]) return -1;
+        if (x[i] > y[i]) return 1;
+    }
+    return 0;
+}
+
+/* r[0..xn) = |x[0..xn) - y[0..yn)|, xn >= yn.  Returns TRUE if x < y. */
+static int wv_absdiff(u_long *r, const u_long *x, int xn,
+                      const u_long *y, int yn)
+{
+    int c = 0;
+    for (int i=xn-1; i>=yn; i--) {
+        if (x[i]) { c = 1; break; }
+    }
+    if (c == 0) c = wv_cmp(x, y, yn);
+    if (c >= 0) {
+        wv_sub(r, x, xn, y, yn);
+        return FALSE;
+    } else {
+        wv_sub_n(r, y, x, yn);
+        for (int i=yn; i<xn; i++) r[i] = 0;
+        return TRUE;
+    }
+}
+
+/* r[0..n) = x[0..n) * y + c.  Returns the high word. */
+static u_long wv_mul_1(u_long *r, const u_long *x, int n, u_long y, u_long c)
+{
+    for (int i=0; i<n; i++) {
+        u_long hi, lo;
+        UMUL(hi, lo, x[i], y);
+        lo += c;
+        hi += (lo < c);
+        r[i] = lo;
+        c = hi;
+    }
+    return c;
+}
+
+/* r[0..n) += x[0..n) * y.  Returns the carry word. */
+static u_long wv_addmul_1(u_long *r, const u_long *x, int n, u_long y)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long hi, lo;
+        UMUL(hi, lo, x[i], y);
+        lo += c;
+        hi += (lo < c);
+        u_long r0 = r[i];
+        lo += r0;
+        hi += (lo < r0);
+        r[i] = lo;
+        c = hi;
+    }
+    return c;
+}
+
+/* r[0..n) -= x[0..n) * y.  Returns the borrow word. */
+static u_long wv_submul_1(u_long *r, const u_long *x, int n, u_long y)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long hi, lo;
+        UMUL(hi, lo, x[i], y);
+        lo += c;
+        hi += (lo < c);
+        u_long r0 = r[i];
+        r[i] = r0 - lo;
+        c = hi + (lo > r0);
+    }
+    return c;
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  R must not overlap X nor Y. */
+static void wv_mul_basecase(u_long *r, const u_long *x, int xn,
+                            const u_long *y, int yn)
+{
+    r[xn] = wv_mul_1(r, x, xn, y[0], 0);
+    for (int j=1; j<yn; j++) {
+        r[xn+j] = wv_addmul_1(r+j, x, xn, y[j]);
+    }
+}
+
 /*-----------------------------------------------------------------------
  * Multiplication
  */
 
+/* Karatsuba multiplication.  r[0..2n) = x[0..n) * y[0..n).
+
+   With x = x1*B^h + x0 and y = y1*B^h + y0,
+     x*y = x1y1*B^2h + (x1y1 + x0y0 - (x1-x0)(y1-y0))*B^h + x0y0
+   We use the subtractive form so that the middle product fits in hh
+   words.  TMP must have kara_scratch_size(n, kth) words.
+   KTH is the threshold, passed around so that the recursion depth
+   agrees with the scratch size even if the global one is changed. */
+static int kara_scratch_size(int n, int kth)
+{
+    int s = 0;
+    while (n >= kth) {
+        int hh = n - n/2;
+        s += 6*hh + 1;
+        n = hh;
+    }
+    return s;
+}
+
+static void wv_mul_kara(u_long *r, const u_long *x, const u_long *y, int n,
+                        u_long *tmp, int kth)
+{
+    if (n < kth) {
+        wv_mul_basecase(r, x, n, y, n);
+        return;
+    }
+
+    int h = n/2, hh = n - h;
+    u_long *dx = tmp, *dy = tmp + hh, *p = tmp + 2*hh, *m = tmp + 4*hh;
+    u_long *next = m + 2*hh + 1;
+
+    int sx = wv_absdiff(dx, x+h, hh, x, h);
+    int sy = wv_absdiff(dy, y+h, hh, y, h);
+    wv_mul_kara(p, dx, dy, hh, next, kth);
+    wv_mul_kara(r, x, y, h, next, kth);
+    wv_mul_kara(r+2*h, x+h, y+h, hh, next, kth);
+
+    m[2*hh] = wv_add(m, r+2*h, 2*hh, r, 2*h);
+    if (sx == sy) {
+        wv_sub(m, m, 2*hh+1, p, 2*hh);
+    } else {
+        wv_add(m, m, 2*hh+1, p, 2*hh);
+    }
+    wv_add(r+h, r+h, 2*n-h, m, 2*hh+1);
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn), xn >= yn.  R must not overlap
+   X nor Y.  Unbalanced operands are multiplied in yn-word chunks. */
+static void wv_mul(u_long *r, const u_long *x, int xn,
+                   const u_long *y, int yn)
+{
+    int kth = karatsuba_threshold;
+
+    if (yn < kth) {
+        wv_mul_basecase(r, x, xn, y, yn);
+        return;
+    }
+    int ssize = kara_scratch_size(yn, kth);
+    if (xn == yn) {
+        u_long *tmp = SCM_NEW_ATOMIC2(u_long*, ssize * sizeof(u_long));
+        wv_mul_kara(r, x, y, yn, tmp, kth);
+        return;
+    }
+
+    u_long *prod = SCM_NEW_ATOMIC2(u_long*, (2*yn + ssize) * sizeof(u_long));
+    u_long *tmp = prod + 2*yn;
+    for (int i=0; i<xn+yn; i++) r[i] = 0;
+    for (int off=0; off<xn; off+=yn) {
+        int c = min(yn, xn-off);
+        if (c == yn) wv_mul_kara(prod, x+off, y, yn, tmp, kth);
+        else         wv_mul(prod, y, yn, x+off, c);
+        wv_add(r+off, r+off, xn+yn-off, prod, yn+c);
+    }
+}
+
+/* Drops leading zero words, keeping at least one word.  Not a
+   normalization; the result is still a bignum. */
+static ScmBignum *bignum_trim(ScmBignum *b)
+{
+    while (b->size > 1 && b->values[b->size-1] == 0) b->size--;
+    return b;
+}
+
+/* Returns a nonnegative bignum of words [start, start+len) of B. */
+static ScmBignum *bignum_slice(const ScmBignum *b, int start, int len)
+{
+    int end = min((int)b->size, start+len);
+    ScmBignum *r = make_bignum(max(end-start, 1));
+    for (int i=start; i<end; i++) r->values[i-start] = b->values[i];
+    return bignum_trim(r);
+}
+
+static ScmBignum *bignum_mul_int(const ScmBignum *bx, const ScmBignum *by);
+static ScmBignum *bignum_toom_mul(const ScmBignum *bx, const ScmBignum *by);
+
+/* Helpers for Toom-3 interpolation.  The divisions are exact. */
+static ScmBignum *toom_twice(const ScmBignum *x)
+{
+    ScmBignum *r = make_bignum(x->size+1);
+    return bignum_trim(bignum_lshift(r, x, 1));
+}
+
+static ScmBignum *toom_half(const ScmBignum *x)
+{
+    ScmBignum *r = SCM_BIGNUM(Scm_BignumCopy(x));
+    return bignum_trim(bignum_rshift(r, r, 1));
+}
+
+static ScmBignum *toom_third(const ScmBignum *x)
+{
+    ScmBignum *r = SCM_BIGNUM(Scm_BignumCopy(x));
+    bignum_sdiv(r, 3);
+    return bignum_trim(r);
+}
+
+/* Toom-3 multiplication.  Returns |bx| * |by|.
+
+   Operands are split into three k-word pieces, and the products
+   at points 0, 1, -1, -2 and infinity are interpolated with Bodrato's
+   sequence.  This one works on (temporary) bignums, since the
+   intermediate values can be negative, and it's only used for large
+   operands where the allocation cost doesn't matter. */
+static ScmBignum *bignum_mul_toom3(const ScmBignum *bx, const ScmBignum *by)
+{
+    int k = (max(bx->size, by->size) + 2) / 3;
+    ScmBignum *x0 = bignum_slice(bx, 0, k);
+    ScmBignum *x1 = bignum_slice(bx, k, k);
+    ScmBignum *x2 = bignum_slice(bx, 2*k, k);
+    ScmBignum *y0 = bignum_slice(by, 0, k);
+    ScmBignum *y1 = bignum_slice(by, k, k);
+    ScmBignum *y2 = bignum_slice(by, 2*k, k);
+    ScmBignum *r0, *r1, *rm1, *rm2, *rinf, *r2, *r3;
+
+#define ADD(x, y)  bignum_trim(bignum_add(x, y))
+#define SUB(x, y)  bignum_trim(bignum_sub(x, y))
+#define MUL(x, y)  bignum_toom_mul(x, y)
+#define TWICE(x)   toom_twice(x)
+#define HALF(x)    toom_half(x)
+#define THIRD(x)   toom_third(x)
+
+    /* evaluation */
+    ScmBignum *p0  = ADD(x0, x2);
+    ScmBignum *p1  = ADD(p0, x1);
+    ScmBignum *pm1 = SUB(p0, x1);
+    ScmBignum *pm2 = SUB(TWICE(ADD(pm1, x2)), x0);
+    ScmBignum *q0  = ADD(y0, y2);
+    ScmBignum *q1  = ADD(q0, y1);
+    ScmBignum *qm1 = SUB(q0, y1);
+    ScmBignum *qm2 = SUB(TWICE(ADD(qm1, y2)), y0);
+
+    /* pointwise multiplication */
+    r0   = MUL(x0, y0);
+    r1   = MUL(p1, q1);
+    rm1  = MUL(pm1, qm1);
+    rm2  = MUL(pm2, qm2);
+    rinf = MUL(x2, y2);
+
+    /* interpolation */
+    r3 = THIRD(SUB(rm2, r1));
+    r1 = HALF(SUB(r1, rm1));
+    r2 = SUB(rm1, r0);
+    r3 = ADD(HALF(SUB(r2, r3)), TWICE(rinf));
+    r2 = SUB(ADD(r2, r1), rinf);
+    r1 = SUB(r1, r3);
+
+#undef ADD
+#undef SUB
+#undef MUL
+#undef TWICE
+#undef HALF
+#undef THIRD
+
+    /* recomposition.  All coefficients are nonnegative here. */
+    int rsize = bx->size + by->size;
+    ScmBignum *br = make_bignum(rsize);
+    ScmBignum *coeffs[5] = { r0, r1, r2, r3, rinf };
+    for (int i=0; i<5; i++) {
+        int off = i*k;
+        if (off >= rsize) break;
+        int n = min((int)coeffs[i]->size, rsize - off);
+        wv_add(br->values+off, br->values+off, rsize-off, coeffs[i]->values, n);
+    }
+    return br;
+}
+
+/* Multiplies possibly signed toom-3 intermediate values. */
+static ScmBignum *bignum_toom_mul(const ScmBignum *bx, const ScmBignum *by)
+{
+    ScmBignum *br = bignum_trim(bignum_mul_int(bx, by));
+    br->sign = bx->sign * by->sign;
+    return br;
+}
+
+/* Returns |bx| * |by|, not normalized.  Chooses the algorithm. */
+static ScmBignum *bignum_mul_int(const ScmBignum *bx, const ScmBignum *by)
+{
+    if (bx->size < by->size) {
+        const ScmBignum *t = bx; bx = by; by = t;
+    }
+    int xn = bx->size, yn = by->size;
+    if (yn == 0) return make_bignum(1);
+
+    if (yn >= toom3_threshold && xn < 2*yn) {
+        return bignum_mul_toom3(bx, by);
+    }
+    ScmBignum *br = make_bignum(xn + yn);
+    if (yn >= toom3_threshold) {
+        /* Unbalanced; multiply by yn-word chunks of bx. */
+        for (int off=0; off<xn; off+=yn) {
+            ScmBignum *chunk = bignum_slice(bx, off, yn);
+            ScmBignum *p = bignum_mul_int(chunk, by);
+            wv_add(br->values+off, br->values+off, xn+yn-off,
+                   p->values, min((int)p->size, xn+yn-off));
+        }
+    } else {
+        wv_mul(br->values, bx->values, xn, by->values, yn);
+    }
+    return br;
+}
+
 /* br += bx * (y << off*WORD_BITS).   br must have enough size. */
 static ScmBignum *bignum_mul_word(ScmBignum *br, const ScmBignum *bx,
                                   u_long y, int off)
@@ -841,10 +1229,7 @@ static ScmBignum *bignum_mul_word(ScmBignum *br, const ScmBignum *bx,
 /* returns bx * by.  not normalized */
 static ScmBignum *bignum_mul(const ScmBignum *bx, const ScmBignum *by)
 {
-    ScmBignum *br = make_bignum(bx->size + by->size);
-    for (u_int i=0; i<by->size; i++) {
-        bignum_mul_word(br, bx, by->values[i], i);
-    }
+    ScmBignum *br = bignum_mul_int(bx, by);
     br->sign = bx->sign * by->sign;
     return br;
 }
@@ -896,106 +1281,212 @@ static inline int div_normalization_factor(u_long w)
     return 0;                   /* dummy */
 }
 
-/* General case of division.  We use each half word as a digit.
-   Assumes digitsof(dividend) >= digitsof(divisor) > 1.
+/* [nh, nl] / d, where d is normalized (MSB is set) and nh < d.
+   Returns the quotient and sets the remainder to *r.  Each half word
+   of the quotient is estimated and corrected, as in Knuth's algorithm D
+   with two-digit divisor. */
+static inline u_long div_2by1(u_long *r, u_long nh, u_long nl, u_long d)
+{
+    u_long d1 = HI(d), d0 = LO(d);
+    u_long q1, q0, r1, r0, m;
+
+    q1 = nh / d1;
+    r1 = nh - q1*d1;
+    m = q1 * d0;
+    r1 = (r1 << HALF_BITS) | HI(nl);
+    if (r1 < m) {
+        q1--; r1 += d;
+        if (r1 >= d && r1 < m) { q1--; r1 += d; }
+    }
+    r1 -= m;
+
+    q0 = r1 / d1;
+    r0 = r1 - q0*d1;
+    m = q0 * d0;
+    r0 = (r0 << HALF_BITS) | LO(nl);
+    if (r0 < m) {
+        q0--; r0 += d;
+        if (r0 >= d && r0 < m) { q0--; r0 += d; }
+    }
+    r0 -= m;
+
+    *r = r0;
+    return (q1 << HALF_BITS) | q0;
+}
+
+/* Knuth's algorithm D on words.
+   Divides a[0..an) by d[0..dn), where dn >= 2, an >= dn and d is
+   normalized.  The quotient goes to q[0..an-dn), except its most
+   significant word (0 or 1) which is returned.  The remainder is
+   left in a[0..dn). */
+static u_long wv_divrem_basecase(u_long *q, u_long *a, int an,
+                                 const u_long *d, int dn)
+{
+    u_long d1 = d[dn-1], d0 = d[dn-2];
+    u_long qtop = 0;
+
+    if (wv_cmp(a+an-dn, d, dn) >= 0) {
+        wv_sub_n(a+an-dn, a+an-dn, d, dn);
+        qtop = 1;
+    }
+
+    for (int j=an-dn-1; j>=0; j--) {
+        u_long ah = a[j+dn], al = a[j+dn-1], qhat, rhat;
+        int check = TRUE;
+
+        if (ah == d1) {
+            /* qhat would overflow; start from B-1. */
+            qhat = SCM_ULONG_MAX;
+            rhat = al + d1;
+            if (rhat < d1) check = FALSE;   /* rhat >= B */
+        } else {
+            qhat = div_2by1(&rhat, ah, al, d1);
+        }
+        while (check) {
+            u_long ph, pl;
+            UMUL(ph, pl, qhat, d0);
+            if (ph < rhat || (ph == rhat && pl <= a[j+dn-2])) break;
+            qhat--;
+            rhat += d1;
+            if (rhat < d1) break;           /* rhat >= B */
+        }
+
+        u_long borrow = wv_submul_1(a+j, d, dn, qhat);
+        if (ah < borrow) {
+            /* qhat was one too large.  This is rare. */
+            qhat--;
+            wv_add_n(a+j, a+j, d, dn);
+        }
+        a[j+dn] = 0;
+        q[j] = qhat;
+    }
+    return qtop;
+}
+
+/* Burnikel-Ziegler recursive division.
+
+   div_2n1n divides a[0..2n) by b[0..n), where b is normalized and
+   the upper half of a is less than b.  The quotient (n words) goes
+   to q, and the remainder is left in a[0..n).  It is split into two
+   3h/2h divisions, each of which does one h/h division recursively and
+   one h*h multiplication.
+
+   TMP must have n + kara_scratch_size(n) words.
+   Ref: Burnikel, Ziegler: Fast Recursive Division, MPI-I-98-1-022, 1998. */
+static void div_3h2h(u_long *q, u_long *a, const u_long *b, int h,
+                     u_long *tmp, int kth);
+
+static void div_2n1n(u_long *q, u_long *a, const u_long *b, int n,
+                     u_long *tmp, int kth)
+{
+    if (n % 2 || n < bz_threshold) {
+        wv_divrem_basecase(q, a, 2*n, b, n);
+        return;
+    }
+    int h = n/2;
+    div_3h2h(q+h, a+h, b, h, tmp, kth);
+    div_3h2h(q, a, b, h, tmp, kth);
+}
+
+/* Divides a[0..3h) by b[0..2h), with a < b*B^h.  The quotient goes
+   to q[0..h) and the remainder to a[0..2h). */
+static void div_3h2h(u_long *q, u_long *a, const u_long *b, int h,
+                     u_long *tmp, int kth)
+{
+    const u_long *b1 = b+h, *b2 = b;
+
+    if (wv_cmp(a+2*h, b1, h) < 0) {
+        div_2n1n(q, a+h, b1, h, tmp, kth);
+    } else {
+        /* The quotient is B^h-1, and the partial remainder is
+           [a1,a2] - (B^h-1)*b1 = [a1,a2] - b1*B^h + b1. */
+        for (int i=0; i<h; i++) q[i] = SCM_ULONG_MAX;
+        wv_sub_n(a+2*h, a+2*h, b1, h);
+        u_long c = wv_add_n(a+h, a+h, b1, h);
+        wv_add_1(a+2*h, h, c);
+    }
+
+    /* Subtract q*b2.  The result may be negative; then q is at most
+       2 too large. */
+    u_long *d = tmp;
+    wv_mul_kara(d, q, b2, h, tmp+2*h, kth);
+    u_long borrow = wv_sub(a, a, 3*h, d, 2*h);
+    while (borrow) {
+        wv_sub_1(q, h, 1);
+        if (wv_add(a, a, 3*h, b, 2*h)) borrow = 0;
+    }
+}
+
+/* Divides u[0..un) by v[0..vn), where v is normalized and the top word
+   of u has the MSB clear.  The divisor is padded to
+   a block size n that splits evenly down to the base case, and the
+   dividend is divided block by block.  The quotient goes to q[0..qn)
+   and the remainder to u[0..vn). */
+static void wv_divrem_bz(u_long *q, int qn, u_long *u, int un,
+                         const u_long *v, int vn)
+{
+    int kth = karatsuba_threshold;
+    int m = 1;
+    while (vn / m >= bz_threshold) m <<= 1;
+    int n = ((vn + m - 1) / m) * m;
+    int pad = n - vn;
+    int t = (un + pad + n - 1) / n;
+    if (t < 2) t = 2;
+
+    u_long *w = SCM_NEW_ATOMIC2(u_long*, (t*n + n) * sizeof(u_long));
+    u_long *vv = w + t*n;
+    memset(w, 0, (t*n + n) * sizeof(u_long));
+    for (int i=0; i<un; i++) w[i+pad] = u[i];
+    for (int i=0; i<vn; i++) vv[i+pad] = v[i];
+
+    u_long *qq = SCM_NEW_ATOMIC2(u_long*, ((t-1)*n) * sizeof(u_long));
+    u_long *tmp = SCM_NEW_ATOMIC2(u_long*,
+                                  (n + kara_scratch_size(n, kth))
+                                  * sizeof(u_long));
+    for (int i=t-2; i>=0; i--) {
+        div_2n1n(qq + i*n, w + i*n, vv, n, tmp, kth);
+    }
+
+    for (int i=0; i<qn && i<(t-1)*n; i++) q[i] = qq[i];
+    for (int i=0; i<vn; i++) u[i] = w[i+pad];
+}
+
+/* General case of division.
+   Assumes dividend->size >= divisor->size.
    Assumes enough digits are allocated to quotient.
    Remainder is returned (not normalized) */
 static ScmBignum *bignum_gdiv(const ScmBignum *dividend,
                               const ScmBignum *divisor,
                               ScmBignum *quotient)
 {
-    int d = div_normalization_factor(divisor->values[divisor->size-1]);
-    int n, m;
-    u_long vv, uj, uj2, cy;
-
-#define DIGIT(num, n) (((n)%2)? HI((num)->values[(n)/2]) : LO((num)->values[(n)/2]))
-#define DIGIT2(num, n) \
-    (((n)%2)?  \
-     ((LO((num)->values[(n)/2+1])<<HALF_BITS)|HI((num)->values[(n)/2])): \
-     (num)->values[(n)/2])
-#define SETDIGIT(num, n, v) \
-    (((n)%2)? \
-     (num->values[(n)/2] = (num->values[(n)/2] & LOMASK)|((v) << HALF_BITS)) :\
-     (num->values[(n)/2] = (num->values[(n)/2] & HIMASK)|((v) & LOMASK)))
-#define SETDIGIT2(num, n, v)                                             \
-    (((n)%2)?                                                            \
-     ((num->values[(n)/2] = LO(num->values[(n)/2])|((v)<<HALF_BITS)),    \
-      (num->values[(n)/2+1] = (num->values[(n)/2+1] & HIMASK)|HI(v))) : \
-     (num->values[(n)/2] = (v)))
+    int s = div_normalization_factor(divisor->values[divisor->size-1]);
+    int an = dividend->size, dn = divisor->size;
 
     /* normalize */
-    ScmBignum *u, *v;
-    u = make_bignum(dividend->size + 1); /* will be returned as a remainder */
-    ALLOC_TEMP_BIGNUM(v, divisor->size);
-    if (d >= HALF_BITS) {
-        d -= HALF_BITS;
-        n = divisor->size*2 - 1;
-        m = dividend->size*2 - n;
-    } else {
-        n = divisor->size*2;
-        m = dividend->size*2 - n;
-    }
-    bignum_lshift(u, dividend, d);
-    bignum_lshift(v, divisor, d);
-    u_long vn_1 = DIGIT(v, n-1);
-    u_long vn_2 = DIGIT(v, n-2);
-#undef DIV_DEBUG
-#ifdef DIV_DEBUG
-    Scm_Printf(SCM_CUROUT, "shift=%d, n=%d, m=%d\n", d, n, m);
-    Scm_Printf(SCM_CUROUT, "u="); Scm_DumpBignum(u, SCM_CUROUT);
-    Scm_Printf(SCM_CUROUT, "\nv="); Scm_DumpBignum(v, SCM_CUROUT);
-    Scm_Printf(SCM_CUROUT, "\nvn_1=%08lx, vn_2=%08lx\n", vn_1, vn_2);
-#endif
-
-    for (int j = m; j >= 0; j--) {
-        u_long uu = (DIGIT(u, j+n) << HALF_BITS) + DIGIT(u, j+n-1);
-        u_long qq = uu/vn_1;
-        u_long rr = uu%vn_1;
-#ifdef DIV_DEBUG
-        Scm_Printf(SCM_CUROUT, "loop on j=%d, uu=%08lx, qq=%08lx, rr=%08lx\n",
-                   j, uu, qq, rr);
-#endif
-        while (qq >= HALF_WORD) { qq--; rr += vn_1; }
-        while ((qq*vn_2 > (rr<<HALF_BITS)+DIGIT(u, j+n-2)) && (rr < HALF_WORD)) {
-            qq--; rr += vn_1;
+    ScmBignum *u = make_bignum(an + 1); /* will be returned as a remainder */
+    ScmBignum *v = make_bignum(dn);
+    bignum_lshift(u, dividend, s);
+    bignum_lshift(v, divisor, s);
+
+    for (u_int i=0; i<quotient->size; i++) quotient->values[i] = 0;
+    if (dn == 1) {
+        u_long r = u->values[an];
+        for (int j=an-1; j>=0; j--) {
+            quotient->values[j] = div_2by1(&r, r, u->values[j], v->values[0]);
         }
-#ifdef DIV_DEBUG
-        Scm_Printf(SCM_CUROUT, "estimate uu=%08lx, qq=%08lx, rr=%08lx\n",
-                   uu, qq, rr);
-#endif
-        cy = 0;
-        for (int k = 0; k < n; k++) {
-            vv = qq * DIGIT(v, k);
-            uj = DIGIT2(u, j+k);
-            uj2 = uj - vv - cy;
-            cy =  (uj2 > uj)? HALF_WORD : 0;
-            SETDIGIT2(u, j+k, uj2);
-        }
-#ifdef DIV_DEBUG
-        Scm_Printf(SCM_CUROUT, "subtract cy = %d, ", cy);
-        Scm_Printf(SCM_CUROUT, "u="); Scm_DumpBignum(u, SCM_CUROUT);
-        Scm_Printf(SCM_CUROUT, "\n");
-#endif
-        if (cy) {
-            qq--;
-            cy = 0;
-            for (int k = 0; k < n; k++) {
-                vv = DIGIT(v, k);
-                uj = DIGIT(u, j+k) + vv + cy;
-                cy = (uj >= HALF_WORD)? 1 : 0;
-                SETDIGIT(u, j+k, uj);
-            }
-            uj = DIGIT(u, j+n) + cy;
-            SETDIGIT(u, j+n, uj);
-        }
-        SETDIGIT(quotient, j, qq);
+        u->values[0] = r;
+    } else if (dn/8 >= bz_threshold && (an - dn)/8 >= bz_threshold) {
+        /* Burnikel-Ziegler pays off only when the divisor is several times
+           larger than its base case, for the multiplications in it need
+           to be in the Karatsuba range. */
+        wv_divrem_bz(quotient->values, quotient->size,
+                     u->values, an+1, v->values, dn);
+    } else {
+        wv_divrem_basecase(quotient->values, u->values, an+1, v->values, dn);
     }
-    bignum_rshift(u, u, d);
-#ifdef DIV_DEBUG
-    Scm_Printf(SCM_CUROUT, "quot q="); Scm_DumpBignum(quotient, SCM_CUROUT);
-    Scm_Printf(SCM_CUROUT, "\nrem  u="); Scm_DumpBignum(u, SCM_CUROUT);
-    Scm_Printf(SCM_CUROUT, "\n");
-#endif
+
+    u->size = dn;
+    bignum_rshift(u, u, s);
     return u;
 }
 
@@ -1277,24 +1768,184 @@ int Scm_BignumLogCount(const ScmBignum *b)
  * Printing
  */
 
+/* Radix conversion of large numbers is done by divide-and-conquer:
+   we split the number by radix^(e*2^i), where radix^e is the largest
+   power of radix that fits in a half word.  The powers are computed
+   by repeated squaring. */
+
+#define RADIX_POWERS_MAX  32
+
+typedef struct radix_powers_rec {
+    int radix;
+    int e;                      /* digits per base chunk */
+    u_long base;                /* radix^e */
+    int npows;
+    ScmBignum *pows[RADIX_POWERS_MAX]; /* radix^(e*2^i) */
+} radix_powers;
+
+static void radix_powers_init(radix_powers *rp, int radix)
+{
+    rp->radix = radix;
+    rp->e = 0;
+    rp->base = 1;
+    while (rp->base * radix < HALF_WORD) {
+        rp->base *= radix;
+        rp->e++;
+    }
+    rp->pows[0] = make_bignum(1);
+    rp->pows[0]->values[0] = rp->base;
+    rp->npows = 1;
+}
+
+/* Returns radix^(e*2^i), computing it if necessary. */
+static ScmBignum *radix_power(radix_powers *rp, int i)
+{
+    SCM_ASSERT(i < RADIX_POWERS_MAX);
+    while (rp->npows <= i) {
+        ScmBignum *p = rp->pows[rp->npows-1];
+        rp->pows[rp->npows++] = bignum_trim(bignum_mul_int(p, p));
+    }
+    return rp->pows[i];
+}
+
+/* Returns the largest i such that radix^(e*2^i) has no more than
+   MAXSIZE words, or 0. */
+static int radix_power_index(radix_powers *rp, int maxsize)
+{
+    int i = 0;
+    for (;;) {
+        /* Avoid computing a power that is obviously too large. */
+        if ((int)radix_power(rp, i)->size*2 - 1 > maxsize) break;
+        if ((int)radix_power(rp, i+1)->size > maxsize) break;
+        i++;
+    }
+    return i;
+}
+
+/* Writes digits of nonnegative B, ending at END (exclusive).  If PAD is
+   positive, writes exactly PAD digits with leading zeros.  Returns the
+   beginning of the digits.  B is destroyed. */
+static char *bignum_to_digits(ScmBignum *b, radix_powers *rp, int pad,
+                              char *end, const char *tab)
+{
+    bignum_trim(b);
+    if ((int)b->size >= dc_conv_threshold) {
+        int i = radix_power_index(rp, (b->size+1)/2);
+        ScmBignum *p = radix_power(rp, i);
+        if (b->size >= p->size && Scm_BignumAbsCmp(b, p) >= 0) {
+            int plen = rp->e << i;
+            ScmBignum *q = make_bignum(b->size - p->size + 1);
+            ScmBignum *r = bignum_gdiv(b, p, q);
+            bignum_to_digits(r, rp, plen, end, tab);
+            return bignum_to_digits(q, rp, (pad > 0)? pad - plen : 0,
+                                    end - plen, tab);
+        }
+    }
+
+    /* Base case.  Each bignum_sdiv extracts e digits. */
+    char *s = end;
+    while (b->size > 1 || b->values[0] != 0) {
+        u_long rem = bignum_sdiv(b, rp->base);
+        bignum_trim(b);
+        int last = (b->size == 1 && b->values[0] == 0);
+        for (int k=0; k<rp->e; k++) {
+            if (last && rem == 0) break;
+            *--s = tab[rem % rp->radix];
+            rem /= rp->radix;
+        }
+    }
+    if (pad > 0) {
+        while (s > end - pad) *--s = '0';
+    }
+    return s;
+}
+
+/* Radix is 2^k; just take bits. */
+static char *bignum_to_digits_pow2(const ScmBignum *b, int radix,
+                                   char *end, const char *tab)
+{
+    int k = Scm__HighestBitNumber(radix);
+    int nbits = b->size * WORD_BITS;
+    char *s = end;
+    for (int bit=0; bit<nbits; bit+=k) {
+        int w = bit / WORD_BITS, o = bit % WORD_BITS;
+        u_long d = b->values[w] >> o;
+        if (o + k > WORD_BITS && w+1 < (int)b->size) {
+            d |= b->values[w+1] << (WORD_BITS - o);
+        }
+        *--s = tab[d & (radix-1)];
+    }
+    while (s < end-1 && *s == '0') s++;
+    return s;
+}
+
 ScmObj Scm_BignumToString(const ScmBignum *b, int radix, int use_upper)
 {
     static const char ltab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
     static const char utab[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     const char *tab = use_upper? utab : ltab;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
     if (radix < 2 || radix > 36)
         Scm_Error("radix out of range: %d", radix);
-    ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(b));
-    for (;q->size > 0;) {
-        long rem = bignum_sdiv(q, radix);
-        SCM_ASSERT(rem >= 0 && rem < radix);
-        SCM_APPEND1(h, t, SCM_MAKE_CHAR(tab[rem]));
-        for (; q->values[q->size-1] == 0 && q->size > 0; q->size--)
-            ;
+
+    /* Enough room for WORD_BITS digits per word, plus sign. */
+    int bufsize = b->size * WORD_BITS + 2;
+    char *buf = SCM_NEW_ATOMIC2(char*, bufsize + 1);
+    char *end = buf + bufsize, *s;
+    *end = '\0';
+
+    if ((radix & (radix-1)) == 0) {
+        s = bignum_to_digits_pow2(b, radix, end, tab);
+    } else {
+        radix_powers rp;
+        radix_powers_init(&rp, radix);
+        s = bignum_to_digits(SCM_BIGNUM(Scm_BignumCopy(b)), &rp, 0, end, tab);
     }
-    if (q->sign < 0) SCM_APPEND1(h, t, SCM_MAKE_CHAR('-'));
-    return Scm_ListToString(Scm_ReverseX(h));
+    if (s == end) *--s = '0';
+    if (b->sign < 0) *--s = '-';
+    return Scm_MakeString(s, (int)(end - s), (int)(end - s), 0);
+}
+
+/* Reads LEN digits in DIGITS as an unsigned integer of RADIX.  The digits
+   must be valid in RADIX.  Returns a normalized integer.  This is
+   a divide-and-conquer counterpart of accumulating digits with
+   Scm_BignumAccMultAddUI, used for long digit sequences. */
+static ScmBignum *digits_to_bignum(const char *digits, int len,
+                                   radix_powers *rp)
+{
+    if (len > 2 * rp->e * dc_conv_threshold) {
+        /* Split so that the lower part has e*2^i digits. */
+        int i = 0;
+        while ((rp->e << (i+1)) < len) i++;
+        int plen = rp->e << i;
+        ScmBignum *hi = digits_to_bignum(digits, len - plen, rp);
+        ScmBignum *lo = digits_to_bignum(digits + len - plen, plen, rp);
+        ScmBignum *r = bignum_mul_int(hi, radix_power(rp, i));
+        wv_add(r->values, r->values, r->size, lo->values,
+               min(lo->size, r->size));
+        return bignum_trim(r);
+    }
+
+    ScmBignum *b = make_bignum(len / rp->e + 2);
+    int n = 0;                  /* # of words in use */
+    while (len > 0) {
+        int k = (len % rp->e)? len % rp->e : rp->e;
+        u_long chunk = 0, mult = 1;
+        for (int j=0; j<k; j++, digits++, len--) {
+            int c = tolower(*digits);
+            chunk = chunk * rp->radix + (isdigit(c)? c - '0' : c - 'a' + 10);
+            mult *= rp->radix;
+        }
+        u_long hi = wv_mul_1(b->values, b->values, n, mult, chunk);
+        if (hi) b->values[n++] = hi;
+    }
+    return bignum_trim(b);
+}
+
+ScmObj Scm_BignumFromDigits(const char *digits, int len, int radix)
+{
+    radix_powers rp;
+    radix_powers_init(&rp, radix);
+    return Scm_NormalizeBignum(digits_to_bignum(digits, len, &rp));
 }
 
 int Scm_DumpBignum(const ScmBignum *b, ScmPort *out)
@@ -1349,3 +2000,24 @@ ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc, u_long coef, u_long c)
         return rr;
     }
 }
+
+/* Gets/sets the algorithm thresholds, for benchmarking and tuning.
+   NAME is one of "karatsuba", "toom3", "bz" and "dc-conv".  If VALUE is
+   positive, it is set as the new threshold.  Returns the previous value,
+   or -1 if NAME is unknown. */
+int Scm__BignumAlgorithmThreshold(const char *name, int value)
+{
+    int *var;
+    if (strcmp(name, "karatsuba") == 0)    var = &karatsuba_threshold;
+    else if (strcmp(name, "toom3") == 0)   var = &toom3_threshold;
+    else if (strcmp(name, "bz") == 0)      var = &bz_threshold;
+    else if (strcmp(name, "dc-conv") == 0) var = &dc_conv_threshold;
+    else return -1;
+
+    int prev = *var;
+    if (value > 0) {
+        /* The base cases need at least a few words. */
+        *var = max(value, 3);
+    }
+    return prev;
+}
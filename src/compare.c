@@ -32,9 +32,11 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/class.h"
+#include "gauche/priv/systemP.h"
 
 /*
  * Comparator
@@ -242,81 +244,269 @@ int Scm_Compare(ScmObj x, ScmObj y)
  *
  * Some notes:
  *  - We can't use libc's qsort, since it doesn't pass closure to cmpfn.
- *  - The naive Quicksort behaves too badly in the worst case.
  *  - The comparison operation is far more costly than exchange.
+ *  - Real data is often partially ordered (appended logs, a sorted
+ *    list with a few new items, reversed input.)
  *
- * The current implementation is hybrid of Quicksort and Heapsort.  First
- * the algorithm proceeds by Quicksort, but when it detects the recursion
- * is too deep, it switches to Heapsort.  See Knuth, The Art of Computer
- * Programming Second Edition, Section 5.2.2, p.122.
+ * The current implementation is a natural merge sort along the line of
+ * Tim Peters' listsort (aka Timsort).  We scan the input for maximal
+ * ascending or strictly descending runs (the latter is reversed in place),
+ * extend short runs to MIN_RUN elements by binary insertion, and keep
+ * the runs on a stack, merging adjacent ones so that their lengths
+ * stay balanced.  Before merging two runs we binary-search the part
+ * of each run that is already in place, so concatenation of sorted
+ * sequences costs only O(log n) comparisons to merge.
+ *
+ * It is stable, requires at most n*log2(n) comparisons, and n-1
+ * comparisons for already sorted (or reverse-sorted) input.  The
+ * work area is n/2 words.
+ *
+ * When cmpfn is #f and all the elements are fixnums, flonums or strings,
+ * we bypass the type dispatch of Scm_Compare.  Such comparisons neither
+ * allocate nor call back Scheme, so for large arrays we can also sort
+ * chunks in separate threads and merge them.
+ *
+ * The sort routines optionally carry a satellite array (vals), whose
+ * elements are moved along with the keys.  It is used for sort-by,
+ * where the keys are computed once beforehand.
  */
 
-/* Heap sort */
-static inline void shift_up(ScmObj *elts, int root, int nelts,
-                            int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)
+typedef int (*sort_cmp_proc)(ScmObj, ScmObj, ScmObj);
+
+typedef struct sort_ctx_rec {
+    sort_cmp_proc cmp;
+    ScmObj data;                /* passed to cmp */
+    ScmObj *keys;               /* the array to be sorted */
+    ScmObj *vals;               /* satellite array, or NULL */
+    ScmObj *tkeys;              /* work area */
+    ScmObj *tvals;              /* work area for vals, or NULL */
+} sort_ctx;
+
+#define SORT_LESS(c, x, y)  ((c)->cmp((x), (y), (c)->data) < 0)
+
+#define MIN_MERGE      64       /* arrays shorter than this isn't merged */
+#define MAX_RUN_STACK  64       /* enough for 2^32 elements */
+
+/* Returns the minimum run length for n elements, so that n/minrun is
+   close to, but no more than, a power of 2. */
+static int sort_min_run(int n)
 {
-    int l = root+1, maxchild;
-    while (l*2 <= nelts) {
-        if (l*2 == nelts) {
-            maxchild = nelts-1;
-        } else if (cmp(elts[l*2-1], elts[l*2], data) < 0) {
-            maxchild = l*2;
-        } else {
-            maxchild = l*2-1;
+    int r = 0;
+    while (n >= MIN_MERGE) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+static void sort_reverse(sort_ctx *c, int lo, int hi)
+{
+    ScmObj *k = c->keys, *v = c->vals;
+    for (hi--; lo < hi; lo++, hi--) {
+        ScmObj t = k[lo]; k[lo] = k[hi]; k[hi] = t;
+        if (v) { t = v[lo]; v[lo] = v[hi]; v[hi] = t; }
+    }
+}
+
+/* Sort [lo, hi), assuming [lo, start) is already sorted. */
+static void sort_binary_insertion(sort_ctx *c, int lo, int hi, int start)
+{
+    ScmObj *k = c->keys, *v = c->vals;
+    for (int i = start; i < hi; i++) {
+        ScmObj pivot = k[i];
+        int l = lo, r = i;
+        while (l < r) {
+            int m = l + (r - l)/2;
+            if (SORT_LESS(c, pivot, k[m])) r = m;
+            else l = m + 1;
         }
-        if (cmp(elts[l-1], elts[maxchild], data) < 0) {
-            ScmObj tmp = elts[maxchild];
-            elts[maxchild] = elts[l-1];
-            elts[l-1] = tmp;
-            l = maxchild+1;
-        } else {
-            break;
+        if (l < i) {
+            memmove(k+l+1, k+l, (i-l)*sizeof(ScmObj));
+            k[l] = pivot;
+            if (v) {
+                ScmObj pv = v[i];
+                memmove(v+l+1, v+l, (i-l)*sizeof(ScmObj));
+                v[l] = pv;
+            }
         }
     }
 }
 
-static void sort_h(ScmObj *elts, int nelts,
-                   int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)
+/* Returns the length of the run beginning at lo, making it ascending. */
+static int sort_count_run(sort_ctx *c, int lo, int hi)
 {
-    for (int l=nelts/2-1; l>=0; l--) {
-        shift_up(elts, l, nelts, cmp, data);
+    ScmObj *k = c->keys;
+    int r = lo + 1;
+    if (r == hi) return 1;
+    if (SORT_LESS(c, k[r], k[lo])) {
+        /* strictly descending; the strictness is required for stability */
+        for (r++; r < hi && SORT_LESS(c, k[r], k[r-1]); r++)
+            ;
+        sort_reverse(c, lo, r);
+    } else {
+        for (r++; r < hi && !SORT_LESS(c, k[r], k[r-1]); r++)
+            ;
     }
-    for (int r=nelts-1; r>=1; r--) {
-        ScmObj tmp = elts[r];
-        elts[r] = elts[0];
-        elts[0] = tmp;
-        shift_up(elts, 0, r, cmp, data);
+    return r - lo;
+}
+
+/* Returns the first index i in [lo, hi) such that key < k[i]. */
+static int sort_upper_bound(sort_ctx *c, ScmObj key, int lo, int hi)
+{
+    ScmObj *k = c->keys;
+    while (lo < hi) {
+        int m = lo + (hi - lo)/2;
+        if (SORT_LESS(c, key, k[m])) hi = m;
+        else lo = m + 1;
     }
+    return lo;
 }
 
-/* Quick sort */
-static void sort_q(ScmObj *elts, int lo, int hi, int depth, int limit,
-                   int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)
+/* Returns the first index i in [lo, hi) such that !(k[i] < key). */
+static int sort_lower_bound(sort_ctx *c, ScmObj key, int lo, int hi)
 {
+    ScmObj *k = c->keys;
     while (lo < hi) {
-        if (depth >= limit) {
-            sort_h(elts+lo, (hi-lo+1), cmp, data);
-            break;
+        int m = lo + (hi - lo)/2;
+        if (SORT_LESS(c, k[m], key)) lo = m + 1;
+        else hi = m;
+    }
+    return lo;
+}
+
+/* Merge [lo, lo+na) and [lo+na, lo+na+nb), copying the first run to
+   the work area at tbase. */
+static void sort_merge_lo(sort_ctx *c, int lo, int na, int nb, int tbase)
+{
+    ScmObj *k = c->keys, *v = c->vals;
+    ScmObj *tk = c->tkeys + tbase, *tv = v? c->tvals + tbase : NULL;
+    int i = 0, j = lo + na, d = lo, jend = lo + na + nb;
+
+    memcpy(tk, k+lo, na*sizeof(ScmObj));
+    if (v) memcpy(tv, v+lo, na*sizeof(ScmObj));
+    while (i < na && j < jend) {
+        if (SORT_LESS(c, k[j], tk[i])) {
+            k[d] = k[j];
+            if (v) v[d] = v[j];
+            j++;
+        } else {
+            k[d] = tk[i];
+            if (v) v[d] = tv[i];
+            i++;
+        }
+        d++;
+    }
+    memcpy(k+d, tk+i, (na-i)*sizeof(ScmObj));
+    if (v) memcpy(v+d, tv+i, (na-i)*sizeof(ScmObj));
+}
+
+/* Likewise, but copies the second run and merges from the end. */
+static void sort_merge_hi(sort_ctx *c, int lo, int na, int nb, int tbase)
+{
+    ScmObj *k = c->keys, *v = c->vals;
+    ScmObj *tk = c->tkeys + tbase, *tv = v? c->tvals + tbase : NULL;
+    int i = lo + na - 1, j = nb - 1, d = lo + na + nb - 1;
+
+    memcpy(tk, k+lo+na, nb*sizeof(ScmObj));
+    if (v) memcpy(tv, v+lo+na, nb*sizeof(ScmObj));
+    while (i >= lo && j >= 0) {
+        if (SORT_LESS(c, tk[j], k[i])) {
+            k[d] = k[i];
+            if (v) v[d] = v[i];
+            i--;
         } else {
-            int l = lo, r = hi;
-            ScmObj pivot = elts[lo];
-            while (l <= r) {
-                while (l <= r && cmp(elts[l], pivot, data) < 0) l++;
-                while (l <= r && cmp(pivot, elts[r], data) < 0) r--;
-                if (l > r) break;
-                ScmObj tmp = elts[l]; elts[l] = elts[r]; elts[r] = tmp;
-                l++;
-                r--;
+            k[d] = tk[j];
+            if (v) v[d] = tv[j];
+            j--;
+        }
+        d--;
+    }
+    memcpy(k+lo, tk, (j+1)*sizeof(ScmObj));
+    if (v) memcpy(v+lo, tv, (j+1)*sizeof(ScmObj));
+}
+
+/* Merge two adjacent sorted runs [lo, lo+na) and [lo+na, lo+na+nb).
+   The work area from tbase must have min(na, nb) words. */
+static void sort_merge(sort_ctx *c, int lo, int na, int nb, int tbase)
+{
+    ScmObj *k = c->keys;
+    /* Elements of the first run that are not greater than the head of
+       the second run are already in place. */
+    int skip = sort_upper_bound(c, k[lo+na], lo, lo+na) - lo;
+    lo += skip;
+    na -= skip;
+    if (na == 0) return;
+    /* Likewise, elements of the second run that are not less than the
+       last of the first run are already in place. */
+    nb = sort_lower_bound(c, k[lo+na-1], lo+na, lo+na+nb) - (lo+na);
+    if (nb == 0) return;
+
+    if (na <= nb) sort_merge_lo(c, lo, na, nb, tbase);
+    else          sort_merge_hi(c, lo, na, nb, tbase);
+}
+
+/* Sort [lo, lo+n).  The work area from lo must have n/2 words. */
+static void sort_run(sort_ctx *c, int lo, int n)
+{
+    int base[MAX_RUN_STACK], len[MAX_RUN_STACK], sp = 0;
+    int hi = lo + n, tbase = lo;
+
+    if (n < 2) return;
+    if (n < MIN_MERGE) {
+        int r = sort_count_run(c, lo, hi);
+        sort_binary_insertion(c, lo, hi, lo + r);
+        return;
+    }
+
+    int minrun = sort_min_run(n);
+    while (lo < hi) {
+        int r = sort_count_run(c, lo, hi);
+        if (r < minrun) {
+            int force = (hi - lo < minrun)? hi - lo : minrun;
+            sort_binary_insertion(c, lo, lo + force, lo + r);
+            r = force;
+        }
+        base[sp] = lo;
+        len[sp] = r;
+        sp++;
+        lo += r;
+
+        /* Restore the invariants
+             len[i-2] > len[i-1] + len[i] and len[i-1] > len[i]. */
+        while (sp > 1) {
+            int m = sp - 2;
+            if ((m > 0 && len[m-1] <= len[m] + len[m+1])
+                || (m > 1 && len[m-2] <= len[m-1] + len[m])) {
+                if (len[m-1] < len[m+1]) m--;
+            } else if (len[m] > len[m+1]) {
+                break;
+            }
+            sort_merge(c, base[m], len[m], len[m+1], tbase);
+            len[m] += len[m+1];
+            if (m == sp - 3) {
+                base[m+1] = base[m+2];
+                len[m+1] = len[m+2];
             }
-            if (lo < r) sort_q(elts, lo, r, depth+1, limit, cmp, data);
-            /* tail call to
-               sort_q(elts, l, hi, depth+1, limit, cmp, data); */
-            lo = l;
-            depth++;
+            sp--;
         }
     }
+    while (sp > 1) {
+        int m = sp - 2;
+        if (m > 0 && len[m-1] < len[m+1]) m--;
+        sort_merge(c, base[m], len[m], len[m+1], tbase);
+        len[m] += len[m+1];
+        if (m == sp - 3) {
+            base[m+1] = base[m+2];
+            len[m+1] = len[m+2];
+        }
+        sp--;
+    }
 }
 
+/*
+ * Comparison procedures
+ */
+
 static int cmp_scm(ScmObj x, ScmObj y, ScmObj fn)
 {
     ScmObj r = Scm_ApplyRec(fn, SCM_LIST2(x, y));
@@ -331,17 +521,167 @@ static int cmp_int(ScmObj x, ScmObj y, ScmObj dummy)
     return Scm_Compare(x, y);
 }
 
-void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn)
+static int cmp_fixnum(ScmObj x, ScmObj y, ScmObj dummy)
+{
+    ScmSmallInt a = SCM_INT_VALUE(x), b = SCM_INT_VALUE(y);
+    return (a < b)? -1 : (a > b)? 1 : 0;
+}
+
+static int cmp_flonum(ScmObj x, ScmObj y, ScmObj dummy)
+{
+    double a = SCM_FLONUM_VALUE(x), b = SCM_FLONUM_VALUE(y);
+    return (a < b)? -1 : (a > b)? 1 : 0;
+}
+
+static int cmp_string(ScmObj x, ScmObj y, ScmObj dummy)
+{
+    return Scm_StringCmp(SCM_STRING(x), SCM_STRING(y));
+}
+
+/* Pick a comparison procedure that agrees with Scm_Compare on
+   the given keys.  */
+static sort_cmp_proc default_cmp(ScmObj *keys, int nelts)
+{
+    int i;
+    if (SCM_INTP(keys[0])) {
+        for (i=1; i<nelts; i++) if (!SCM_INTP(keys[i])) break;
+        if (i == nelts) return cmp_fixnum;
+    } else if (SCM_FLONUMP(keys[0])) {
+        for (i=0; i<nelts; i++) {
+            if (!SCM_FLONUMP(keys[i])) break;
+            double d = SCM_FLONUM_VALUE(keys[i]);
+            if (d != d) break;  /* NaN */
+        }
+        if (i == nelts) return cmp_flonum;
+    } else if (SCM_STRINGP(keys[0])) {
+        for (i=1; i<nelts; i++) if (!SCM_STRINGP(keys[i])) break;
+        if (i == nelts) return cmp_string;
+    }
+    return cmp_int;
+}
+
+/*
+ * Parallel sort
+ *
+ *  The array is split into chunks, each of which is sorted by its own
+ *  thread.  Then adjacent chunks are merged in parallel, halving the
+ *  number of chunks at each round.  Since every step is stable, the
+ *  result is the same as the sequential sort.
+ *
+ *  This is only used with the comparison procedures that don't touch
+ *  the VM.  The jobs are run by Scm__RunParallelJobs.
+ */
+
+/* Arrays shorter than this are sorted sequentially.  0 disables parallel
+   sort. */
+static int sort_parallel_threshold = 65536;
+
+#define SORT_MAX_THREADS 8
+
+typedef struct sort_job_rec {
+    sort_ctx *ctx;
+    int lo;
+    int na;                     /* sort_run: length; merge: 1st run */
+    int nb;                     /* merge: 2nd run; -1 for sort_run */
+} sort_job;
+
+static void sort_do_job(void *data)
+{
+    sort_job *j = (sort_job*)data;
+    if (j->nb < 0) sort_run(j->ctx, j->lo, j->na);
+    else sort_merge(j->ctx, j->lo, j->na, j->nb, j->lo);
+}
+
+/* Returns the number of chunks to split an array of nelts into,
+   or 1 if we should sort sequentially. */
+static int sort_parallel_chunks(int nelts)
+{
+    if (sort_parallel_threshold <= 0 || nelts < sort_parallel_threshold)
+        return 1;
+    int nthreads = Scm__ParallelJobCount(SORT_MAX_THREADS);
+    int nchunks = 1;
+    while (nchunks*2 <= nthreads) nchunks *= 2;
+    return nchunks;
+}
+
+static void sort_parallel(sort_ctx *c, int nelts, int nchunks)
+{
+    sort_job jobs[SORT_MAX_THREADS];
+    int bound[SORT_MAX_THREADS+1];
+
+    for (int i=0; i<=nchunks; i++) {
+        bound[i] = (int)(((long)nelts * i) / nchunks);
+    }
+    for (int i=0; i<nchunks; i++) {
+        jobs[i].ctx = c;
+        jobs[i].lo = bound[i];
+        jobs[i].na = bound[i+1] - bound[i];
+        jobs[i].nb = -1;
+    }
+    Scm__RunParallelJobs(sort_do_job, jobs, sizeof(sort_job), nchunks);
+
+    for (int step=1; step<nchunks; step*=2) {
+        int njobs = 0;
+        for (int i=0; i+step<nchunks; i+=step*2) {
+            int mid = bound[i+step];
+            int end = bound[(i+step*2 < nchunks)? i+step*2 : nchunks];
+            jobs[njobs].ctx = c;
+            jobs[njobs].lo = bound[i];
+            jobs[njobs].na = mid - bound[i];
+            jobs[njobs].nb = end - mid;
+            njobs++;
+        }
+        Scm__RunParallelJobs(sort_do_job, jobs, sizeof(sort_job), njobs);
+    }
+}
+
+/* Common driver.  If vals isn't NULL, it is permuted along with keys. */
+static void sort_array_int(ScmObj *keys, ScmObj *vals, int nelts,
+                           ScmObj cmpfn)
 {
-    int limit, i;
+    sort_ctx ctx;
+    int nchunks = 1;
+
     if (nelts <= 1) return;
-    /* approximate 2*log2(nelts) */
-    for (i=nelts,limit=1; i > 0; limit++) {i>>=1;}
+    ctx.keys = keys;
+    ctx.vals = vals;
     if (SCM_PROCEDUREP(cmpfn)) {
-        sort_q(elts, 0, nelts-1, 0, limit, cmp_scm, cmpfn);
+        ctx.cmp = cmp_scm;
+        ctx.data = cmpfn;
     } else {
-        sort_q(elts, 0, nelts-1, 0, limit, cmp_int, NULL);
+        ctx.cmp = default_cmp(keys, nelts);
+        ctx.data = SCM_FALSE;
+        if (ctx.cmp != cmp_int) nchunks = sort_parallel_chunks(nelts);
     }
+
+    /* In the parallel sort, each chunk uses the work area at the same
+       offset as itself, so we need nelts words. */
+    int worklen = (nchunks > 1)? nelts : nelts/2 + 1;
+    ctx.tkeys = SCM_NEW_ARRAY(ScmObj, worklen);
+    ctx.tvals = vals? SCM_NEW_ARRAY(ScmObj, worklen) : NULL;
+
+    if (nchunks > 1) sort_parallel(&ctx, nelts, nchunks);
+    else sort_run(&ctx, 0, nelts);
+}
+
+void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn)
+{
+    sort_array_int(elts, NULL, nelts, cmpfn);
+}
+
+/* Sort keys, and permute elts in the same way.  Used for sort-by. */
+void Scm_SortArrayWithKeys(ScmObj *keys, ScmObj *elts, int nelts,
+                           ScmObj cmpfn)
+{
+    sort_array_int(keys, elts, nelts, cmpfn);
+}
+
+/* For tuning.  Returns the previous value. */
+int Scm__SortParallelThreshold(int value)
+{
+    int prev = sort_parallel_threshold;
+    if (value >= 0) sort_parallel_threshold = value;
+    return prev;
 }
 
 /*
@@ -272,6 +272,267 @@ void Scm_GCSentinel(void *obj, const char *name)
 }
 
 
+/*=============================================================
+ * GC event log
+ *
+ *  When enabled, collections, heap expansions and finalizer runs are
+ *  recorded in a ring buffer, so that Scheme code can watch GC pauses.
+ *  GC calls the hooks with the allocation lock held (and during a
+ *  collection, with the world stopped), so they must not allocate nor
+ *  call GC API that takes the lock.  The ring buffer is allocated
+ *  beforehand; everyone else touches it with the allocation lock held,
+ *  via GC_call_with_alloc_lock.
+ */
+
+enum {
+    GCLOG_COLLECTION,
+    GCLOG_HEAP_RESIZE,
+    GCLOG_FINALIZERS
+};
+
+typedef struct gclog_event_rec {
+    int kind;
+    ScmVM *vm;                  /* the thread that caused the event */
+    double time;                /* monotonic clock, in seconds */
+    double duration;            /* COLLECTION, FINALIZERS */
+    double pause;               /* COLLECTION: world-stopped time */
+    u_long gcno;
+    u_long heapsize;
+    u_long allocated;           /* bytes allocated since the last GC */
+    u_long reclaimed;           /* COLLECTION: bytes reclaimed
+                                   FINALIZERS: # of finalizers run */
+} gclog_event;
+
+static struct {
+    gclog_event *buf;           /* ring buffer, or NULL if disabled */
+    u_long size;
+    u_long count;               /* total # of events ever recorded */
+    gclog_event cur;            /* collection in progress */
+    double stop_start;
+} gclog = { NULL, 0, 0 };
+
+static double gclog_now(void)
+{
+    u_long sec, nsec;
+    if (Scm_ClockGetTimeMonotonic(&sec, &nsec)) {
+        return (double)sec + (double)nsec/1.0e9;
+    } else {
+        u_long usec;
+        Scm_GetTimeOfDay(&sec, &usec);
+        return (double)sec + (double)usec/1.0e6;
+    }
+}
+
+/* Called with the allocation lock held. */
+static void gclog_stats(struct GC_prof_stats_s *stats)
+{
+#if defined(GC_THREADS)
+    GC_get_prof_stats_unsafe(stats, sizeof(*stats));
+#else
+    GC_get_prof_stats(stats, sizeof(*stats));
+#endif
+}
+
+static void gclog_push(gclog_event *ev)
+{
+    if (gclog.buf == NULL) return;
+    gclog.buf[gclog.count % gclog.size] = *ev;
+    gclog.count++;
+}
+
+static void GC_CALLBACK gclog_collection_hook(GC_EventType type)
+{
+    struct GC_prof_stats_s stats;
+
+    switch (type) {
+    case GC_EVENT_START:
+        gclog_stats(&stats);
+        gclog.cur.kind = GCLOG_COLLECTION;
+        gclog.cur.vm = Scm_VM();
+        gclog.cur.time = gclog_now();
+        gclog.cur.pause = 0.0;
+        gclog.cur.allocated = stats.bytes_allocd_since_gc;
+        break;
+    case GC_EVENT_PRE_STOP_WORLD:
+        gclog.stop_start = gclog_now();
+        break;
+    case GC_EVENT_POST_START_WORLD:
+        gclog.cur.pause += gclog_now() - gclog.stop_start;
+        break;
+    case GC_EVENT_END:
+        gclog_stats(&stats);
+        gclog.cur.duration = gclog_now() - gclog.cur.time;
+        /* Without threads, the world isn't explicitly stopped; the
+           whole collection is the pause. */
+        if (gclog.cur.pause == 0.0) gclog.cur.pause = gclog.cur.duration;
+        gclog.cur.gcno = stats.gc_no;
+        gclog.cur.heapsize = stats.heapsize_full - stats.unmapped_bytes;
+        /* Only counts what is swept eagerly; the rest is reclaimed
+           lazily as the allocation proceeds. */
+        gclog.cur.reclaimed = stats.bytes_reclaimed_since_gc;
+        gclog_push(&gclog.cur);
+        break;
+    default:
+        break;
+    }
+}
+
+static void GC_CALLBACK gclog_heap_resize_hook(GC_word new_size)
+{
+    struct GC_prof_stats_s stats;
+    gclog_event ev;
+
+    gclog_stats(&stats);
+    ev.kind = GCLOG_HEAP_RESIZE;
+    ev.vm = Scm_VM();
+    ev.time = gclog_now();
+    ev.duration = ev.pause = 0.0;
+    ev.gcno = stats.gc_no;
+    ev.heapsize = new_size;
+    ev.allocated = stats.bytes_allocd_since_gc;
+    ev.reclaimed = 0;
+    gclog_push(&ev);
+}
+
+static void *gclog_push_locked(void *data)
+{
+    gclog_push((gclog_event*)data);
+    return NULL;
+}
+
+static void gclog_finalizers(ScmVM *vm, double start, int count)
+{
+    gclog_event ev;
+    ev.kind = GCLOG_FINALIZERS;
+    ev.vm = vm;
+    ev.time = start;
+    ev.duration = gclog_now() - start;
+    ev.pause = 0.0;
+    ev.gcno = GC_get_gc_no();
+    ev.heapsize = 0;
+    ev.allocated = 0;
+    ev.reclaimed = count;
+    GC_call_with_alloc_lock(gclog_push_locked, &ev);
+}
+
+struct gclog_swap {
+    gclog_event *buf;
+    u_long size;
+};
+
+static void *gclog_swap_locked(void *data)
+{
+    struct gclog_swap *sw = (struct gclog_swap*)data;
+    gclog.buf = sw->buf;
+    gclog.size = sw->size;
+    gclog.count = 0;
+    return NULL;
+}
+
+/* Start recording GC events, keeping the last SIZE events.
+   If SIZE is 0, stop recording. */
+void Scm_GCEventLogSetup(u_long size)
+{
+    struct gclog_swap sw;
+    if (size > 0) {
+        sw.buf = SCM_NEW_ARRAY(gclog_event, size);
+        sw.size = size;
+        GC_call_with_alloc_lock(gclog_swap_locked, &sw);
+        GC_set_on_collection_event(gclog_collection_hook);
+        GC_set_on_heap_resize(gclog_heap_resize_hook);
+    } else {
+        GC_set_on_collection_event(NULL);
+        GC_set_on_heap_resize(NULL);
+        sw.buf = NULL;
+        sw.size = 0;
+        GC_call_with_alloc_lock(gclog_swap_locked, &sw);
+    }
+}
+
+struct gclog_snapshot {
+    gclog_event *events;
+    u_long size;                /* IN: capacity of events, OUT: # of events */
+    int clear;
+};
+
+static void *gclog_snapshot_locked(void *data)
+{
+    struct gclog_snapshot *snap = (struct gclog_snapshot*)data;
+    u_long n = (gclog.count < gclog.size)? gclog.count : gclog.size;
+    if (n > snap->size) n = snap->size;
+    for (u_long i = 0; i < n; i++) {
+        snap->events[i] = gclog.buf[(gclog.count - n + i) % gclog.size];
+    }
+    snap->size = n;
+    if (snap->clear) gclog.count = 0;
+    return NULL;
+}
+
+static ScmObj gclog_event_to_list(gclog_event *ev)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    static ScmObj kinds[3] = { NULL };
+    if (kinds[0] == NULL) {
+        kinds[GCLOG_COLLECTION]  = SCM_INTERN("collection");
+        kinds[GCLOG_HEAP_RESIZE] = SCM_INTERN("heap-resize");
+        kinds[GCLOG_FINALIZERS]  = SCM_INTERN("finalizers");
+    }
+#define ADD(key, val)                                   \
+    do {                                                \
+        SCM_APPEND1(h, t, SCM_MAKE_KEYWORD(key));       \
+        SCM_APPEND1(h, t, val);                         \
+    } while (0)
+
+    SCM_APPEND1(h, t, kinds[ev->kind]);
+    ADD("gc-no", Scm_MakeIntegerU(ev->gcno));
+    ADD("time", Scm_MakeFlonum(ev->time));
+    ADD("thread", ev->vm? SCM_OBJ(ev->vm) : SCM_FALSE);
+    switch (ev->kind) {
+    case GCLOG_COLLECTION:
+        ADD("duration", Scm_MakeFlonum(ev->duration));
+        ADD("pause", Scm_MakeFlonum(ev->pause));
+        ADD("heap-size", Scm_MakeIntegerU(ev->heapsize));
+        ADD("allocated", Scm_MakeIntegerU(ev->allocated));
+        ADD("reclaimed", Scm_MakeIntegerU(ev->reclaimed));
+        break;
+    case GCLOG_HEAP_RESIZE:
+        ADD("heap-size", Scm_MakeIntegerU(ev->heapsize));
+        ADD("allocated", Scm_MakeIntegerU(ev->allocated));
+        break;
+    case GCLOG_FINALIZERS:
+        ADD("duration", Scm_MakeFlonum(ev->duration));
+        ADD("count", Scm_MakeIntegerU(ev->reclaimed));
+        break;
+    }
+#undef ADD
+    return h;
+}
+
+/* Returns the recorded events, oldest first.  If CLEAR is true,
+   the log is emptied. */
+ScmObj Scm_GCEventLog(int clear)
+{
+    struct gclog_snapshot snap;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+
+    snap.size = gclog.size;     /* may be stale; checked again in lock */
+    if (snap.size == 0) return SCM_NIL;
+    snap.events = SCM_NEW_ARRAY(gclog_event, snap.size);
+    snap.clear = clear;
+    GC_call_with_alloc_lock(gclog_snapshot_locked, &snap);
+    for (u_long i = 0; i < snap.size; i++) {
+        SCM_APPEND1(h, t, gclog_event_to_list(&snap.events[i]));
+    }
+    return h;
+}
+
+/* Total number of events recorded since the log is started or cleared,
+   including the ones that have been overwritten. */
+u_long Scm_GCEventLogCount(void)
+{
+    return gclog.count;
+}
+
 /*=============================================================
  * Finalization.  Scheme finalizers are added as NO_ORDER.
  */
@@ -302,7 +563,13 @@ void finalizable(void)
 /* Called from VM loop.  Queue is not empty. */
 ScmObj Scm_VMFinalizerRun(ScmVM *vm)
 {
-    GC_invoke_finalizers();
+    if (gclog.buf) {
+        double start = gclog_now();
+        int count = GC_invoke_finalizers();
+        gclog_finalizers(vm, start, count);
+    } else {
+        GC_invoke_finalizers();
+    }
     vm->finalizerPending = FALSE;
     return SCM_UNDEFINED;
 }
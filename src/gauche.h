@@ -1220,6 +1220,12 @@ typedef enum {
 
 #include <gauche/reader.h>
 
+/*---------------------------------------------------------
+ * SERIALIZE
+ */
+
+#include <gauche/serial.h>
+
 /*--------------------------------------------------------
  * HASHTABLE
  */
@@ -1927,6 +1933,9 @@ SCM_EXTERN void Scm_PrintStaticRoots(void);
 SCM_EXTERN void Scm_RegisterDL(void *data_start, void *data_end,
                                void *bss_start, void *bss_end);
 SCM_EXTERN void Scm_GCSentinel(void *obj, const char *name);
+SCM_EXTERN void Scm_GCEventLogSetup(u_long size);
+SCM_EXTERN ScmObj Scm_GCEventLog(int clear);
+SCM_EXTERN u_long Scm_GCEventLogCount(void);
 
 SCM_EXTERN ScmObj Scm_GetFeatures(void);
 SCM_EXTERN void   Scm_AddFeature(const char *feature, const char *mod);
@@ -102,9 +102,14 @@ SCM_EXTERN ScmObj Scm_ComparatorHashFunction(ScmComparator *);
 /* Other genreic utilities */
 SCM_EXTERN int    Scm_Compare(ScmObj x, ScmObj y);
 SCM_EXTERN void   Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn);
+SCM_EXTERN void   Scm_SortArrayWithKeys(ScmObj *keys, ScmObj *elts,
+                                        int nelts, ScmObj cmpfn);
 SCM_EXTERN ScmObj Scm_SortList(ScmObj objs, ScmObj fn);
 SCM_EXTERN ScmObj Scm_SortListX(ScmObj objs, ScmObj fn);
 
+/* For tuning */
+SCM_EXTERN int    Scm__SortParallelThreshold(int value);
+
 
 SCM_DECL_END
 
@@ -62,6 +62,11 @@ typedef struct ScmSyntaxRuleBranchRec {
     ScmObj templat;             /* template to be expanded */
     int numPvars;               /* # of pattern variables */
     int maxLevel;               /* maximum # of nested subpatterns */
+    int minLength;              /* minimum # of elements pattern accepts */
+    int maxLength;              /* maximum # of elements, or -1 if the
+                                   pattern has ellipsis or dotted tail */
+    ScmObj tvars;               /* vector of free identifiers in the
+                                   template, indexed by TVREF */
 } ScmSyntaxRuleBranch;
 
 typedef struct ScmSyntaxRules {
@@ -92,13 +97,26 @@ SCM_EXTERN ScmObj Scm_CompileSyntaxRules(ScmObj name, ScmObj src,
  * Pattern variable reference object
  */
 #define SCM_PVREF_TAG              0x13
-#define SCM_PVREF_P(obj)           ((SCM_WORD(obj)&0xff) == SCM_PVREF_TAG)
+#define SCM_PVREF_P(obj)           ((SCM_WORD(obj)&0xffff) == SCM_PVREF_TAG)
 #define SCM_PVREF_LEVEL(obj)       ((SCM_WORD(obj)>>24) & 0xff)
 #define SCM_PVREF_COUNT(obj)       ((SCM_WORD(obj)>>16) & 0xff)
 
 #define SCM_MAKE_PVREF(level, count)  \
     SCM_OBJ((SCM_WORD(level)<<24) | (SCM_WORD(count)<<16) | SCM_PVREF_TAG)
 
+/*
+ * Template variable reference object
+ *   Shares the pattern variable tag, distinguished by the second byte.
+ *   Free symbols and identifiers in a template are replaced by this,
+ *   so that the expander can look up its renamed identifier by index.
+ */
+#define SCM_TVREF_TAG              0x113
+#define SCM_TVREF_P(obj)           ((SCM_WORD(obj)&0xffff) == SCM_TVREF_TAG)
+#define SCM_TVREF_INDEX(obj)       ((SCM_WORD(obj)>>16) & 0xffff)
+
+#define SCM_MAKE_TVREF(index) \
+    SCM_OBJ((SCM_WORD(index)<<16) | SCM_TVREF_TAG)
+
 
 /*
  * Hygienic macro utilities
@@ -42,6 +42,12 @@
 
 SCM_EXTERN void Scm__InstallCodingAwarePortHook(ScmPort *(*)(ScmPort*, const char*));
 
+/* Direct access to the buffered input; see port.c */
+SCM_EXTERN int  Scm__PortInputBuffer(ScmPort *port,
+                                     const char **start, const char **end);
+SCM_EXTERN void Scm__PortInputConsumed(ScmPort *port,
+                                       size_t nbytes, u_long nlines);
+
 /* Windows-specific initialization */
 #if defined(GAUCHE_WINDOWS)
 void Scm__SetupPortsForWindows(int has_console);
@@ -0,0 +1,48 @@
+/*
+ * gauche/priv/systemP.h - System private API
+ *
+ *   Copyright (c) 2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_SYSTEMP_H
+#define GAUCHE_PRIV_SYSTEMP_H
+
+/* Fork-join of C functions; see system.c */
+SCM_EXTERN int  Scm__ParallelJobCount(int max);
+SCM_EXTERN void Scm__RunParallelJobs(void (*fn)(void*), void *jobs,
+                                     size_t stride, int njobs);
+
+/* fork(), or FORKFN(DATA) that forks in some other way, with GC told
+   about it; see system.c */
+#if !defined(GAUCHE_WINDOWS)
+SCM_EXTERN pid_t Scm__ForkWith(pid_t (*forkfn)(void*), void *data);
+#endif /*!defined(GAUCHE_WINDOWS)*/
+
+#endif /*GAUCHE_PRIV_SYSTEMP_H*/
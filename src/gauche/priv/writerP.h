@@ -75,6 +75,7 @@ struct ScmWriteStateRec {
                                          for recursive call */
     int sharedCounter;          /* counter to emit #n= and #n# */
     int currentLevel;
+    struct ScmWriteWalkTableRec *walkTable; /* used in walk pass */
 };
 
 SCM_CLASS_DECL(Scm_WriteStateClass);
@@ -0,0 +1,55 @@
+/*
+ * serial.h - Binary serialization API
+ *
+ *   Copyright (c) 2017  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* This file is included from gauche.h */
+
+#ifndef GAUCHE_SERIAL_H
+#define GAUCHE_SERIAL_H
+
+/* Binary serialization.
+ *   Encodes a Scheme object into a compact byte sequence that can be
+ *   decoded much faster than the textual representation.  Shared and
+ *   circular structures are preserved.  See serial.c for the format.
+ */
+
+/* Format version.  Bump this when the encoding changes incompatibly. */
+#define SCM_SERIAL_VERSION   1
+
+SCM_EXTERN void   Scm_Serialize(ScmObj obj, ScmObj port);
+SCM_EXTERN ScmObj Scm_SerializeToUVector(ScmObj obj);
+SCM_EXTERN ScmObj Scm_Deserialize(ScmObj port);
+SCM_EXTERN ScmObj Scm_DeserializeFromBytes(const char *buf,
+                                           ScmSmallInt size,
+                                           ScmSmallInt *consumed);
+
+#endif  /*GAUCHE_SERIAL_H*/
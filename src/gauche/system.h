@@ -81,6 +81,7 @@ SCM_EXTERN ScmObj Scm_OffsetToInteger(off_t o);
  */
 
 SCM_EXTERN ScmObj Scm_ReadDirectory(ScmString *pathname);
+SCM_EXTERN ScmObj Scm_ReadDirectoryWithTypes(ScmString *pathname);
 SCM_EXTERN ScmObj Scm_GetCwd(void);
 
 #define SCM_PATH_ABSOLUTE       (1L<<0)
@@ -244,6 +245,9 @@ enum {
 SCM_EXTERN ScmObj Scm_SysExec(ScmString *file, ScmObj args,
                               ScmObj iomap, ScmSysSigset *mask,
                               ScmString *dir, int flags);
+SCM_EXTERN ScmObj Scm_SysExecWithEnv(ScmString *file, ScmObj args,
+                                     ScmObj iomap, ScmSysSigset *mask,
+                                     ScmString *dir, ScmObj env, int flags);
 SCM_EXTERN int   *Scm_SysPrepareFdMap(ScmObj iomap);
 SCM_EXTERN void   Scm_SysSwapFds(int *fds);
 
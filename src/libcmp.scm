@@ -505,3 +505,38 @@
         [else (SCM_TYPE_ERROR seq "proper list or vector")
               (return SCM_UNDEFINED)]))
 
+;; Destructively sorts SEQ (a list or a vector) by precomputed KEYS,
+;; a list or a vector of the same length, using the default compare.
+;; This is stable.  If KEYS is a vector, it is sorted as well.
+(define-cproc %sort-by! (seq keys)
+  (let* ([klen::int 0]
+         [ks::ScmObj* NULL])
+    (if (SCM_VECTORP keys)
+      (begin (set! klen (SCM_VECTOR_SIZE keys))
+             (set! ks (SCM_VECTOR_ELEMENTS keys)))
+      (set! ks (Scm_ListToArray keys (& klen) NULL TRUE)))
+    (cond [(SCM_VECTORP seq)
+           (unless (== (SCM_VECTOR_SIZE seq) klen)
+             (Scm_Error "sequence and keys length mismatch: %S vs %S"
+                        seq keys))
+           (Scm_SortArrayWithKeys ks (SCM_VECTOR_ELEMENTS seq) klen '#f)
+           (return seq)]
+          [else
+           (let* ([len::int 0]
+                  [elts::ScmObj* (Scm_ListToArray seq (& len) NULL TRUE)])
+             (unless (== len klen)
+               (Scm_Error "sequence and keys length mismatch: %S vs %S"
+                          seq keys))
+             (Scm_SortArrayWithKeys ks elts len '#f)
+             (let* ([cp seq] [i::int 0])
+               (for [() (< i len) (post++ i)]
+                 (SCM_SET_CAR cp (aref elts i))
+                 (set! cp (SCM_CDR cp))))
+             (return seq))])))
+
+;; Arrays at least this long are sorted in parallel when possible.
+;; 0 disables parallel sort.  Returns the previous value.  For tuning.
+(define-cproc %sort-parallel-threshold (:optional (value::<fixnum> -1))
+  ::<int>
+  (return (Scm__SortParallelThreshold value)))
+
@@ -513,6 +513,18 @@
 ;; API
 (define-cproc gc () (call <void> GC_gcollect))
 
+;; Number of threads that run the mark phase, including the one
+;; that triggered GC.
+(define-cfn gc_markers () ::int :static
+  (.if "defined(GAUCHE_GC_PARALLEL_MARK)"
+       (return (+ (GC_get_parallel) 1))
+       (return 1)))
+
+(define-cfn gc_thread_local_alloc_p () ::int :static
+  (.if "defined(GAUCHE_GC_THREAD_LOCAL_ALLOC)"
+       (return TRUE)
+       (return FALSE)))
+
 ;; API
 (define-cproc gc-stat ()
   (return
@@ -524,7 +536,25 @@
     (list ':bytes-since-gc
           (Scm_MakeIntegerFromUI (cast u_long (GC_get_bytes_since_gc))))
     (list ':total-bytes
-          (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes)))))))
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes))))
+    (list ':gc-count
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_gc_no))))
+    (list ':free-space-divisor
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_free_space_divisor))))
+    (list ':markers (SCM_MAKE_INT (gc_markers)))
+    (list ':thread-local-alloc (SCM_MAKE_BOOL (gc_thread_local_alloc_p))))))
+
+;; API
+;; GC event log.  Events are recorded in a ring buffer of the given size.
+(define-cproc gc-event-log-start! (:optional (size::<fixnum> 256)) ::<void>
+  (when (<= size 0) (Scm_Error "size must be a positive integer, but got %d" size))
+  (Scm_GCEventLogSetup size))
+
+(define-cproc gc-event-log-stop! () ::<void> (Scm_GCEventLogSetup 0))
+
+(define-cproc gc-event-log (:optional (clear::<boolean> #f)) Scm_GCEventLog)
+
+(define-cproc gc-event-count () ::<ulong> Scm_GCEventLogCount)
 
 (select-module gauche.internal)
 ;; for diagnostics
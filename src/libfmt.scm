@@ -387,13 +387,16 @@
   (char-formatter (if (has-@? flags) write display)))
 
 ;; ~D, ~B, ~O, ~X, ~nR
+;; format-num-simple is also called from the inlined format (see below).
+(define (format-num-simple arg radix upcase port)
+  (if (exact? arg)
+    (display (number->string arg radix upcase) port)
+    (display arg port)))
+
 (define (make-format-num fmtstr params flags radix upcase)
   (if (and (null? params) (no-flag? flags))
     (^[argptr port ctrl]
-      (let1 arg (fr-next-arg! fmtstr argptr)
-        (if (exact? arg)
-          (display (number->string arg radix upcase) port)
-          (display arg port))))
+      (format-num-simple (fr-next-arg! fmtstr argptr) radix upcase port))
     ($ with-format-params ([mincol 0]
                            [padchar #\space]
                            [comma #\,]
@@ -519,6 +522,51 @@
         (unless (fr-args-used? argptr)
           (errorf "Too many arguments given to format string ~s" fmtstr))))))
 
+;; Formatter cache
+;;  Compiled formatters are cached per format string, so that the same
+;;  format string isn't parsed over and over.  Only immutable strings,
+;;  e.g. literals, are cached, since a mutable string can be altered
+;;  after compilation.  The table is keyed weakly, but the formatter
+;;  refers back to its format string, so the entries are never
+;;  collected on their own; we start over when the table gets too large.
+(inline-stub
+ (declcode
+  "#define FORMATTER_CACHE_MAX 4096"
+  "static ScmObj formatter_cache = SCM_FALSE;"
+  "static ScmInternalMutex formatter_cache_mutex;")
+
+ (define-cproc %formatter-cache-ref (fmtstr::<string>)
+   (unless (SCM_STRING_IMMUTABLE_P fmtstr) (return SCM_FALSE))
+   (let* ([r SCM_FALSE])
+     (SCM_INTERNAL_MUTEX_LOCK formatter_cache_mutex)
+     (set! r (Scm_WeakHashTableRef (SCM_WEAK_HASH_TABLE formatter_cache)
+                                   (SCM_OBJ fmtstr) SCM_FALSE))
+     (SCM_INTERNAL_MUTEX_UNLOCK formatter_cache_mutex)
+     (return r)))
+
+ (define-cproc %formatter-cache-set! (fmtstr::<string> formatter) ::<void>
+   (unless (SCM_STRING_IMMUTABLE_P fmtstr) (return))
+   (SCM_INTERNAL_MUTEX_LOCK formatter_cache_mutex)
+   (when (>= (Scm_HashCoreNumEntries
+              (SCM_WEAK_HASH_TABLE_CORE formatter_cache))
+             FORMATTER_CACHE_MAX)
+     (set! formatter_cache
+           (Scm_MakeWeakHashTableSimple SCM_HASH_EQ SCM_WEAK_KEY 0 SCM_FALSE)))
+   (Scm_WeakHashTableSet (SCM_WEAK_HASH_TABLE formatter_cache)
+                         (SCM_OBJ fmtstr) formatter 0)
+   (SCM_INTERNAL_MUTEX_UNLOCK formatter_cache_mutex))
+
+ (initcode
+  (set! formatter_cache
+        (Scm_MakeWeakHashTableSimple SCM_HASH_EQ SCM_WEAK_KEY 0 SCM_FALSE))
+  (SCM_INTERNAL_MUTEX_INIT formatter_cache_mutex))
+ )
+
+(define (formatter-compile/cache fmtstr)
+  (or (%formatter-cache-ref fmtstr)
+      (rlet1 formatter (formatter-compile fmtstr)
+        (%formatter-cache-set! fmtstr formatter))))
+
 (define (call-formatter shared? locking? formatter port ctrl args)
   (cond [((with-module gauche.internal %port-write-state) port)
          ;; We're in middle of shared writing.
@@ -532,7 +580,7 @@
         [else (formatter args port ctrl)]))
 
 (define (format-2 shared? out control fmtstr args)
-  (let1 formatter (formatter-compile fmtstr)
+  (let1 formatter (formatter-compile/cache fmtstr)
     (case out
       [(#t)
        (call-formatter shared? #t formatter (current-output-port) control args)]
@@ -566,3 +614,71 @@
 ;; API
 (define-in-module gauche (format . args) (format-1 #f args))
 (define-in-module gauche (format/ss . args) (format-1 #t args))
+
+;; Compile-time specialization
+;;  A call of format with a literal format string and #f or #t (or no)
+;;  destination, e.g. (format #t "x=~a y=~s~%" x y), is expanded into
+;;  a sequence of display/write, as far as the format string consists
+;;  of ~a, ~s and parameterless ~d, ~b, ~o, ~x directives and the number
+;;  of arguments matches.  Otherwise, the form is left as is and handled
+;;  at runtime.
+;;  This is an er-macro transformer.  It is attached to format as an
+;;  inliner in libomega.scm, for it requires the compiler.
+(define (format-inliner form rename id=?)
+  (define (simple-directive? node)
+    (match node
+      [(? string?) #t]
+      [((or 'A 'S 'D 'B 'O 'X 'x) ()) #t]
+      [_ #f]))
+  (define (gen node arg port)
+    (match node
+      [(? string?) `(,(rename 'display) ,node ,port)]
+      [('A ()) `(,(rename 'display) ,arg ,port)]
+      [('S ()) `(,(rename 'write) ,arg ,port)]
+      [(d ())
+       (receive (radix upcase) (case d
+                                 [(D) (values 10 #f)]
+                                 [(B) (values 2 #f)]
+                                 [(O) (values 8 #f)]
+                                 [(X) (values 16 #t)]
+                                 [(x) (values 16 #f)])
+         `(,(rename 'format-num-simple) ,arg ,radix ,upcase ,port))]))
+  (define (expand dest fmtstr args)
+    (and-let* ([tree (guard (e [else #f])
+                       (formatter-parse (formatter-lex fmtstr)))]
+               [nodes (match tree
+                        [('Seq . nodes) nodes]
+                        [node (list node)])]
+               [ (every simple-directive? nodes) ]
+               [ (= (count pair? nodes) (length args)) ])
+      (let* ([tmps (map (^i (rename (string->symbol
+                                     (string-append "arg"
+                                                    (number->string i)))))
+                        (iota (length args)))]
+             [port (rename 'port)]
+             [body (let loop ([nodes nodes] [tmps tmps] [r '()])
+                     (cond [(null? nodes) (reverse! r)]
+                           [(string? (car nodes))
+                            (loop (cdr nodes) tmps
+                                  (cons (gen (car nodes) #f port) r))]
+                           [else
+                            (loop (cdr nodes) (cdr tmps)
+                                  (cons (gen (car nodes) (car tmps) port)
+                                        r))]))])
+        ;; Arguments are evaluated before any output, as in the runtime.
+        (if dest
+          `(,(rename 'let) ,(map list tmps args)
+            (,(rename 'call-formatter) #f #t
+             (,(rename 'lambda) (,(rename 'args) ,port ,(rename 'ctrl))
+              ,@body)
+             (,(rename 'current-output-port)) #f (,(rename 'quote) ())))
+          `(,(rename 'let) (,@(map list tmps args)
+                            [,port (,(rename 'open-output-string))])
+            ,@body
+            (,(rename 'get-output-string) ,port))))))
+  (or (match (cdr form)
+        [((? string? fmtstr) . args) (expand #f fmtstr args)]
+        [((? boolean? dest) (? string? fmtstr) . args)
+         (expand dest fmtstr args)]
+        [_ #f])
+      form))
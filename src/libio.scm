@@ -755,46 +755,6 @@
 
 (define-cproc flush-all-ports () ::<void> (Scm_FlushAllPorts FALSE))
 
-;;
-;; Internal recusive writer
-;;
-(select-module gauche.internal)
-
-(define-cproc write-need-recurse? (obj) ::<boolean>
-  (return (not (or (not (SCM_PTRP obj))
-                   (SCM_NUMBERP obj)
-                   (SCM_KEYWORDP obj)
-                   (and (SCM_SYMBOLP obj) (SCM_SYMBOL_INTERNED obj)) 
-                   (and (SCM_STRINGP obj) (== (SCM_STRING_SIZE obj) 0))
-                   (and (SCM_VECTORP obj) (== (SCM_VECTOR_SIZE obj) 0))))))
-
-(define (write-walk obj port)
-  (if-let1 s (%port-write-state port)
-    (%write-walk-rec obj port (~ s shared-table))))
-
-(define (%write-walk-rec obj port tab)
-  (when (write-need-recurse? obj)
-    (if (hash-table-exists? tab obj)
-      (hash-table-update! tab obj (cut + <> 1))   ; seen more than once
-      (begin
-        (hash-table-put! tab obj 1) ; seen once
-        (cond
-         [(symbol? obj)] ; uninterned symbols
-         [(string? obj)]
-         [(pair? obj)
-          (%write-walk-rec (car obj) port tab)
-          (%write-walk-rec (cdr obj) port tab)]
-         [(vector? obj)
-          (dotimes [i (vector-length obj)]
-            (%write-walk-rec (vector-ref obj i) port tab))]
-         [else ; generic objects.  we go walk pass via write-object
-          (write-object obj port)])
-        ;; If circular-only, we don't count non-circular objects.
-        (unless (%port-writing-shared? port)
-          (when (eqv? (hash-table-get tab obj #f) 1)
-            (hash-table-delete! tab obj)))
-        ))))
-
 (select-module gauche.internal)
 
 ;; srfi-38
@@ -903,6 +863,32 @@
           :radix  radix
           :pretty pretty)))))
 
+;;;
+;;; Binary serialization
+;;;   The public API is in gauche.serializer.bserializer.
+;;;
+
+(select-module gauche.internal)
+(inline-stub
+ (define-cproc %serialize (obj port::<output-port>) ::<void>
+   (Scm_Serialize obj (SCM_OBJ port)))
+ (define-cproc %serialize-to-u8vector (obj) Scm_SerializeToUVector)
+ (define-cproc %deserialize (port::<input-port>)
+   (return (Scm_Deserialize (SCM_OBJ port))))
+ ;; Returns the deserialized object and the index right after the datum.
+ (define-cproc %deserialize-u8vector (v::<u8vector>
+                                      :optional (start::<fixnum> 0)
+                                                (end::<fixnum> -1))
+   ::(<top> <top>)
+   (let* ([len::ScmSmallInt (SCM_UVECTOR_SIZE v)]
+          [consumed::ScmSmallInt 0])
+     (SCM_CHECK_START_END start end len)
+     (let* ([r (Scm_DeserializeFromBytes
+                (+ (cast (const char*) (SCM_UVECTOR_ELEMENTS v)) start)
+                (- end start) (& consumed))])
+       (return r (SCM_MAKE_INT (+ start consumed))))))
+ )
+
 ;;;
 ;;; With-something
 ;;;
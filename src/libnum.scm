@@ -861,3 +861,16 @@
 
 
 
+
+;; Bignum algorithm thresholds, for benchmarking and tuning.
+;; NAME is one of karatsuba, toom3, bz and dc-conv.  Returns the previous
+;; value.  See src/bignum.c.
+(select-module gauche.internal)
+(define-cproc %bignum-algorithm-threshold (name::<symbol>
+                                           :optional (value::<fixnum> 0))
+  ::<int>
+  (let* ([r::int (Scm__BignumAlgorithmThreshold
+                  (Scm_GetStringConst (SCM_SYMBOL_NAME name)) value)])
+    (when (< r 0)
+      (Scm_Error "unknown bignum algorithm name: %S" name))
+    (return r)))
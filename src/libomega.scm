@@ -74,6 +74,17 @@
               (car src-info) (cadr src-info) expr)
       (format port "    While compiling: ~,,,,90:s\n" expr))))
 
+;; Attach the compile-time specializer of format (see libfmt.scm).
+;; This is here instead of libfmt.scm, for the compiler needs to be
+;; initialized to create a macro transformer.
+(let1 xformer ((with-module gauche.internal %make-er-transformer/toplevel)
+               (with-module gauche.format format-inliner)
+               (find-module 'gauche.format)
+               'format)
+  (set! ((with-module gauche.internal %procedure-inliner) format) xformer)
+  ((with-module gauche.internal %mark-binding-inlinable!)
+   (find-module 'gauche) 'format))
+
 ;; Built-in comparators.  These are here instead of libcmp.scm, for
 ;; hash functions need to be defined before this.
 ;; NB: These are in srfi-114 but not in srfi-128.  We provide them
@@ -37,7 +37,8 @@
 (select-module gauche)
 (inline-stub
  (declcode
-  (.include <stdlib.h> <locale.h> <math.h> <sys/types.h> <sys/stat.h>)
+  (.include <stdlib.h> <locale.h> <math.h> <sys/types.h> <sys/stat.h>
+            <gauche/priv/systemP.h>)
   (.cond ["TIME_WITH_SYS_TIME" (.include <sys/time.h> <time.h>)]
          ["HAVE_SYS_TIME_H"    (.include <sys/time.h>)]
          [else                 (.include <time.h>)])
@@ -60,6 +61,14 @@
 (select-module gauche)
 (define-cproc sys-readdir (pathname::<string>) Scm_ReadDirectory)
 
+;; Returns a list of (name . type), where type is the file type symbol
+;; as in the type slot of <sys-stat>, taken from the directory entry,
+;; or #f if it isn't available.  Used by file.util.
+(select-module gauche.internal)
+(define-cproc %sys-readdir-with-types (pathname::<string>)
+  Scm_ReadDirectoryWithTypes)
+(select-module gauche)
+
 ;; Bonus
 
 (define-cproc sys-normalize-pathname (pathname::<string>
@@ -889,10 +898,11 @@
 ;; NB: we force GC just before fork().  It appears necessary on some
 ;; platform to synchronize the page dirty bit information, so that incremental
 ;; GC can work properly.
+;; Scm__ForkWith tells GC about the fork; see system.c.
 (define-cproc sys-fork () ::<int>
   (let* ([pid::pid_t])
     (GC_gcollect)
-    (SCM_SYSCALL pid (fork))
+    (SCM_SYSCALL pid (Scm__ForkWith NULL NULL))
     (when (< pid 0) (Scm_SysError "fork failed"))
     (return pid)))
 
@@ -920,20 +930,24 @@
                         args::<list>
                         :key (iomap ()) (sigmask::<sys-sigset>? #f)
                         (directory::<string>? #f)
+                        (environment #f)
                         (detached::<boolean> #f))
   ::<void>
   (let* ([flags::u_int (?: detached SCM_EXEC_DETACHED 0)])
-    (Scm_SysExec command args iomap sigmask directory flags)))
+    (Scm_SysExecWithEnv command args iomap sigmask directory environment
+                        flags)))
 
 (define-cproc sys-fork-and-exec (command::<string>
                                  args::<list>
                                  :key (iomap ()) (sigmask::<sys-sigset>? #f)
                                  (directory::<string>? #f)
+                                 (environment #f)
                                  (detached::<boolean> #f))
   (let* ([flags::u_int SCM_EXEC_WITH_FORK])
     (when detached
       (set! flags (logior flags SCM_EXEC_DETACHED)))
-    (return (Scm_SysExec command args iomap sigmask directory flags))))
+    (return (Scm_SysExecWithEnv command args iomap sigmask directory
+                                environment flags))))
 
 (define-cproc sys-getcwd () Scm_GetCwd)
 (define-cproc sys-getegid () ::<int> getegid)
@@ -167,6 +167,7 @@ static void synrule_print(ScmObj obj, ScmPort *port, ScmWriteContext *mode)
                    i, r->rules[i].numPvars, r->rules[i].maxLevel);
         Scm_Printf(port, "   pattern  = %S\n", r->rules[i].pattern);
         Scm_Printf(port, "   template = %S\n", r->rules[i].template);
+        Scm_Printf(port, "   tvars    = %S\n", r->rules[i].tvars);
     }
     Scm_Printf(port, ">");
 }
@@ -286,7 +287,10 @@ typedef struct {
     ScmObj ellipsis;            /* symbol/identifier/keyword for ellipsis
                                    SCM_TRUE means default (...)
                                    SCM_FALSE means disabled */
+    ScmObj tvars;               /* list of (var . tvref) of free variables
+                                   in the template */
     int pvcnt;                  /* counter of pattern variables */
+    int tvcnt;                  /* counter of template variables */
     int maxlev;                 /* maximum level */
     ScmModule *mod;             /* module where this macro is defined */
     ScmObj env;                 /* compiler env of this macro definition */
@@ -299,6 +303,11 @@ typedef struct {
 #define PVREF_LEVEL_MAX 0xff
 #define PVREF_COUNT_MAX 0xff
 
+#define TVREF_P(tvref)         SCM_TVREF_P(tvref)
+#define TVREF_INDEX(tvref)     (int)SCM_TVREF_INDEX(tvref)
+
+#define TVREF_INDEX_MAX 0xffff
+
 /* add pattern variable pvar.  called when compiling a pattern */
 static inline ScmObj add_pvar(PatternContext *ctx,
                               ScmSyntaxPattern *pat,
@@ -337,6 +346,21 @@ static inline ScmObj pvar_to_pvref(PatternContext *ctx,
     return pvref;
 }
 
+/* returns tvref corresponds to the free variable var in the template.
+   the same (eq?) variable gets the same tvref. */
+static inline ScmObj add_tvar(PatternContext *ctx, ScmObj var)
+{
+    ScmObj q = Scm_Assq(var, ctx->tvars);
+    if (SCM_PAIRP(q)) return SCM_CDR(q);
+    if (ctx->tvcnt > TVREF_INDEX_MAX) {
+        Scm_Error("Too many identifiers in the template of the macro definition of %S", ctx->name);
+    }
+    ScmObj tvref = SCM_MAKE_TVREF(ctx->tvcnt);
+    ctx->tvcnt++;
+    ctx->tvars = Scm_Acons(var, tvref, ctx->tvars);
+    return tvref;
+}
+
 static inline ScmObj pvref_to_pvar(PatternContext *ctx, ScmObj pvref)
 {
     int count = PVREF_COUNT(pvref);
@@ -521,7 +545,7 @@ static ScmObj compile_rule1(ScmObj form,
             if (patternp)
                 return rename_variable(form, &ctx->renames, ctx->mod, ctx->env);
             else        
-                return form;  /* template renaming is done in expansion time */
+                return add_tvar(ctx, form); /* renamed in expansion time */
         }
         if (patternp && Scm__ERCompare(form, SCM_SYM_UNDERBAR,
                                        ctx->mod, ctx->env)) { 
@@ -532,7 +556,7 @@ static ScmObj compile_rule1(ScmObj form,
         } else {
             ScmObj pvref = pvar_to_pvref(ctx, spat, form);
             if (pvref == form) {
-                return form;
+                return add_tvar(ctx, form);
             } else {
                 spat->vars = Scm_Cons(pvref, spat->vars);
                 return pvref;
@@ -542,6 +566,36 @@ static ScmObj compile_rule1(ScmObj form,
     return form;
 }
 
+/* Calculate the range of the number of elements a compiled pattern
+   can match, so that the expander can skip the rules that can't
+   possibly match without running the matcher. */
+static void pattern_length_range(ScmObj pattern, int *minlen, int *maxlen)
+{
+    int n = 0;
+    for (; SCM_PAIRP(pattern); pattern = SCM_CDR(pattern)) {
+        ScmObj elt = SCM_CAR(pattern);
+        if (SCM_SYNTAX_PATTERN_P(elt)) {
+            *minlen = n + SCM_SYNTAX_PATTERN(elt)->numFollowingItems;
+            *maxlen = -1;
+            return;
+        }
+        n++;
+    }
+    *minlen = n;
+    *maxlen = SCM_NULLP(pattern)? n : -1;
+}
+
+/* Convert (var . tvref) alist into a vector indexed by tvref. */
+static ScmObj tvars_to_vector(ScmObj tvars, int tvcnt)
+{
+    ScmObj v = Scm_MakeVector(tvcnt, SCM_FALSE);
+    ScmObj cp;
+    SCM_FOR_EACH(cp, tvars) {
+        SCM_VECTOR_ELEMENT(v, TVREF_INDEX(SCM_CDAR(cp))) = SCM_CAAR(cp);
+    }
+    return v;
+}
+
 /* compile rules into ScmSyntaxRules structure
    NB: We use ScmSyntaxPattern for the toplevel node of pattern and template;
    they are just a placeholders and they don't represent repetition. */
@@ -592,7 +646,9 @@ static ScmSyntaxRules *compile_rules(ScmObj name,
         ScmSyntaxPattern *pat  = make_syntax_pattern(0, 0);
         ScmSyntaxPattern *tmpl = make_syntax_pattern(0, 0);
         ctx.pvars = SCM_NIL;
+        ctx.tvars = SCM_NIL;
         ctx.pvcnt = 0;
+        ctx.tvcnt = 0;
         ctx.maxlev = 0;
 
         ctx.form = SCM_CAR(rule);
@@ -606,6 +662,10 @@ static ScmSyntaxRules *compile_rules(ScmObj name,
         sr->rules[i].template = SCM_OBJ(tmpl->pattern);
         sr->rules[i].numPvars = ctx.pvcnt;
         sr->rules[i].maxLevel = ctx.maxlev;
+        sr->rules[i].tvars    = tvars_to_vector(ctx.tvars, ctx.tvcnt);
+        pattern_length_range(pat->pattern,
+                             &sr->rules[i].minLength,
+                             &sr->rules[i].maxLength);
         if (ctx.pvcnt > sr->maxNumPvars) sr->maxNumPvars = ctx.pvcnt;
     }
     return sr;
@@ -646,6 +706,9 @@ typedef struct {
     ScmObj root;                /* root of the tree */
 } MatchVar;
 
+/* Match vectors up to this size are allocated on the stack. */
+#define DEFAULT_NUM_PVARS  32
+
 static MatchVar *alloc_matchvec(int numPvars)
 {
     return SCM_NEW_ARRAY(MatchVar, numPvars);
@@ -774,20 +837,28 @@ static inline int match_subpattern(ScmObj form, ScmSyntaxPattern *pat,
                                    ScmObj rest, ScmObj mod, ScmObj env,
                                    MatchVar *mvec)
 {
-    /* TODO: If pat->numFollowingItems == 0, we don't need to calculate
-       length beforehand.  Some optimization opportunity. */
-    int limit = 0;
-    for (ScmObj p = form; SCM_PAIRP(p); p = SCM_CDR(p)) {
-        limit++;
-    }
-    limit -= pat->numFollowingItems;
-
     enter_subpattern(pat, mvec);
-    while (limit > 0) {
-        if (!match_synrule(SCM_CAR(form), pat->pattern, mod, env, mvec))
-            return FALSE;
-        form = SCM_CDR(form);
-        limit--;
+    if (pat->numFollowingItems == 0) {
+        /* The subpattern consumes all the elements; no need to
+           calculate the length beforehand. */
+        while (SCM_PAIRP(form)) {
+            if (!match_synrule(SCM_CAR(form), pat->pattern, mod, env, mvec))
+                return FALSE;
+            form = SCM_CDR(form);
+        }
+    } else {
+        int limit = 0;
+        for (ScmObj p = form; SCM_PAIRP(p); p = SCM_CDR(p)) {
+            limit++;
+        }
+        limit -= pat->numFollowingItems;
+
+        while (limit > 0) {
+            if (!match_synrule(SCM_CAR(form), pat->pattern, mod, env, mvec))
+                return FALSE;
+            form = SCM_CDR(form);
+            limit--;
+        }
     }
     exit_subpattern(pat, mvec);
     return match_synrule(form, rest, mod, env, mvec);
@@ -875,13 +946,35 @@ static int match_synrule(ScmObj form, ScmObj pattern, ScmObj mod, ScmObj env,
  * pattern language transformer
  */
 
+/* Renaming of template variables.  A free variable in the template
+   is renamed at most once per expansion; IDS keeps the renamed
+   identifiers indexed by tvref, SCM_UNBOUND if not renamed yet. */
+static inline ScmObj rename_tvar(ScmObj tvref,
+                                 ScmSyntaxRules *sr,
+                                 ScmSyntaxRuleBranch *branch,
+                                 ScmObj *ids)
+{
+    int index = TVREF_INDEX(tvref);
+    if (SCM_UNBOUNDP(ids[index])) {
+        ScmObj var = SCM_VECTOR_ELEMENT(branch->tvars, index);
+        if (SCM_SYMBOLP(var)) {
+            ids[index] = Scm_MakeIdentifier(var, sr->mod, sr->env);
+        } else {
+            SCM_ASSERT(SCM_IDENTIFIERP(var));
+            ids[index] = Scm_WrapIdentifier(SCM_IDENTIFIER(var));
+        }
+    }
+    return ids[index];
+}
+
 /* If a pattern variable is exhausted, SCM_UNDEFINED is returned. */
 static ScmObj realize_template_rec(ScmSyntaxRules *sr,
+                                   ScmSyntaxRuleBranch *branch,
                                    ScmObj template,
                                    MatchVar *mvec,
                                    int level,
                                    int *indices,
-                                   ScmObj *idlist,
+                                   ScmObj *ids,
                                    int *exlev)
 {
     if (SCM_PAIRP(template)) {
@@ -889,18 +982,18 @@ static ScmObj realize_template_rec(ScmSyntaxRules *sr,
         while (SCM_PAIRP(template)) {
             ScmObj e = SCM_CAR(template);
             if (SCM_SYNTAX_PATTERN_P(e)) {
-                ScmObj r = realize_template_rec(sr, e, mvec, level, indices, idlist, exlev);
+                ScmObj r = realize_template_rec(sr, branch, e, mvec, level, indices, ids, exlev);
                 if (SCM_UNBOUNDP(r)) return r;
                 SCM_APPEND(h, t, r);
             } else {
-                ScmObj r = realize_template_rec(sr, e, mvec, level, indices, idlist, exlev);
+                ScmObj r = realize_template_rec(sr, branch, e, mvec, level, indices, ids, exlev);
                 if (SCM_UNBOUNDP(r)) return r;
                 SCM_APPEND1(h, t, r);
             }
             template = SCM_CDR(template);
         }
         if (!SCM_NULLP(template)) {
-            ScmObj r = realize_template_rec(sr, template, mvec, level, indices, idlist, exlev);
+            ScmObj r = realize_template_rec(sr, branch, template, mvec, level, indices, ids, exlev);
             if (SCM_UNBOUNDP(r)) return r;
             if (SCM_NULLP(h)) return r; /* (a ... . b) and a ... is empty */
             SCM_APPEND(h, t, r);
@@ -910,12 +1003,15 @@ static ScmObj realize_template_rec(ScmSyntaxRules *sr,
     if (PVREF_P(template)) {
         return get_pvref_value(template, mvec, indices, exlev);
     }
+    if (TVREF_P(template)) {
+        return rename_tvar(template, sr, branch, ids);
+    }
     if (SCM_SYNTAX_PATTERN_P(template)) {
         ScmSyntaxPattern *pat = SCM_SYNTAX_PATTERN(template);
         ScmObj h = SCM_NIL, t = SCM_NIL;
         indices[level+1] = 0;
         for (;;) {
-            ScmObj r = realize_template_rec(sr, pat->pattern, mvec, level+1, indices, idlist, exlev);
+            ScmObj r = realize_template_rec(sr, branch, pat->pattern, mvec, level+1, indices, ids, exlev);
             if (SCM_UNBOUNDP(r)) return (*exlev < pat->level)? r : h;
             if (SCM_SYNTAX_PATTERN_P(pat->pattern)) {
                 SCM_APPEND(h, t, r);
@@ -932,43 +1028,51 @@ static ScmObj realize_template_rec(ScmSyntaxRules *sr,
 
         for (int i=0; i<len; i++, pe++) {
             if (SCM_SYNTAX_PATTERN_P(*pe)) {
-                ScmObj r = realize_template_rec(sr, *pe, mvec, level, indices, idlist, exlev);
+                ScmObj r = realize_template_rec(sr, branch, *pe, mvec, level, indices, ids, exlev);
                 if (SCM_UNBOUNDP(r)) return r;
                 SCM_APPEND(h, t, r);
             } else {
-                ScmObj r = realize_template_rec(sr, *pe, mvec, level, indices, idlist, exlev);
+                ScmObj r = realize_template_rec(sr, branch, *pe, mvec, level, indices, ids, exlev);
                 if (SCM_UNBOUNDP(r)) return r;
                 SCM_APPEND1(h, t, r);
             }
         }
         return Scm_ListToVector(h, 0, -1);
     }
-    if (SCM_SYMBOLP(template) || SCM_IDENTIFIERP(template)) {
-        return rename_variable(template, idlist, sr->mod, sr->env);
-    }
     return template;
 }
 
 #define DEFAULT_MAX_LEVEL  10
+#define DEFAULT_NUM_TVARS  32
 
 static ScmObj realize_template(ScmSyntaxRules *sr,
                                ScmSyntaxRuleBranch *branch,
                                MatchVar *mvec)
 {
     int index[DEFAULT_MAX_LEVEL], *indices = index;
+    ScmObj id[DEFAULT_NUM_TVARS], *ids = id;
+    int numTvars = SCM_VECTOR_SIZE(branch->tvars);
     int exlev = 0;
-    ScmObj idlist = SCM_NIL;
 
-    if (branch->maxLevel > DEFAULT_MAX_LEVEL)
+    if (branch->maxLevel >= DEFAULT_MAX_LEVEL)
         indices = SCM_NEW_ATOMIC2(int*, (branch->maxLevel+1) * sizeof(int));
     for (int i=0; i<=branch->maxLevel; i++) indices[i] = 0;
-    return realize_template_rec(sr, branch->template, mvec, 0,
-                                indices, &idlist, &exlev);
+    if (numTvars > DEFAULT_NUM_TVARS)
+        ids = SCM_NEW_ARRAY(ScmObj, numTvars);
+    for (int i=0; i<numTvars; i++) ids[i] = SCM_UNBOUND;
+    return realize_template_rec(sr, branch, branch->template, mvec, 0,
+                                indices, ids, &exlev);
 }
 
 static ScmObj synrule_expand(ScmObj form, ScmObj mod, ScmObj env, ScmSyntaxRules *sr)
 {
-    MatchVar *mvec = alloc_matchvec(sr->maxNumPvars);
+    MatchVar mv[DEFAULT_NUM_PVARS], *mvec = mv;
+    /* # of elements of the macro call, or -1 if it's not a proper list */
+    int len = Scm_Length(SCM_CDR(form));
+
+    if (sr->maxNumPvars > DEFAULT_NUM_PVARS) {
+        mvec = alloc_matchvec(sr->maxNumPvars);
+    }
 
 #ifdef DEBUG_SYNRULE
     Scm_Printf(SCM_CUROUT, "**** synrule_transform: %S\n", form);
@@ -977,6 +1081,11 @@ static ScmObj synrule_expand(ScmObj form, ScmObj mod, ScmObj env, ScmSyntaxRules
 #ifdef DEBUG_SYNRULE
         Scm_Printf(SCM_CUROUT, "pattern #%d: %S\n", i, sr->rules[i].pattern);
 #endif
+        if (len >= 0) {
+            if (len < sr->rules[i].minLength) continue;
+            if (sr->rules[i].maxLength >= 0
+                && len > sr->rules[i].maxLength) continue;
+        }
         init_matchvec(mvec, sr->rules[i].numPvars);
         if (match_synrule(SCM_CDR(form), sr->rules[i].pattern, mod, env, mvec)) {
 #ifdef DEBUG_SYNRULE
@@ -171,6 +171,17 @@ void usage(void)
             "      standard ports with character conversion ports that matches the\n"
             "      the console's codepage by default.  Setting this variable suppresses it.\n"
 #endif /*defined(GAUCHE_WINDOWS)*/
+            "  GC_MARKERS\n"
+            "      Number of threads used by GC's mark phase, if GC is built with\n"
+            "      parallel marking.  By default, it is the number of processors.\n"
+            "      Setting it to 1 makes marking sequential.\n"
+            "  GC_INITIAL_HEAP_SIZE, GC_MAXIMUM_HEAP_SIZE\n"
+            "      Initial and maximum heap size, in bytes.  A suffix k, M or G can\n"
+            "      be used.\n"
+            "  GC_FREE_SPACE_DIVISOR\n"
+            "      Controls heap growth.  GC expands the heap rather than collecting\n"
+            "      if the heap has less than 1/N of free space.  Smaller N makes the\n"
+            "      heap grow faster, with fewer collections.  The default is 3.\n"
             );
     exit(1);
 }
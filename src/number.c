@@ -3938,6 +3938,9 @@ static u_long bigdig[RADIX_MAX-RADIX_MIN+1] = { 0 };
 
 static ScmObj numread_error(const char *msg, struct numread_packet *context);
 
+/* # of digits above which read_uint uses Scm_BignumFromDigits. */
+#define DIGITS_DC_THRESHOLD  1000
+
 /* Returns either small integer or bignum.
    initval may be a Scheme integer that will be 'concatenated' before
    the integer to be read; it is used to read floating-point number.
@@ -3973,6 +3976,24 @@ static ScmObj read_uint(const char **strp, int *lenp,
         digread = TRUE;
     }
 
+    /* Long run of plain digits is converted by divide-and-conquer,
+       instead of accumulating digits one chunk at a time, which is
+       quadratic. */
+    if (SCM_FALSEP(initval) && !ctx->padread && len > DIGITS_DC_THRESHOLD) {
+        int n = 0;
+        for (; n < len; n++) {
+            int c = tolower((unsigned char)str[n]);
+            int v = isdigit(c)? c - '0' : (isalpha(c)? c - 'a' + 10 : radix);
+            if (v >= radix) break;
+        }
+        if (n > DIGITS_DC_THRESHOLD
+            && (n == len || (str[n] != '#' && str[n] != '_'))) {
+            *strp = str + n;
+            *lenp = len - n;
+            return Scm_BignumFromDigits(str, n, radix);
+        }
+    }
+
     while (len--) {
         int digval = -1;
         char c = tolower(*str++);
@@ -398,6 +398,63 @@ int Scm_FdReady(int fd, int dir)
 #endif /*!HAVE_SELECT && !GAUCHE_WINDOWS */
 }
 
+/*===============================================================
+ * Direct access to the input buffer
+ *   Used by the reader to scan runs of bytes without fetching them
+ *   one character at a time.  The caller must hold the port lock.
+ */
+
+/* If PORT's pending input is available as a contiguous byte sequence,
+   set *START and *END to its range and returns TRUE.  Returns FALSE
+   if the port doesn't keep a buffer, or there's ungotten character or
+   partial character, which must be read through Getc first.  The range
+   may be empty. */
+int Scm__PortInputBuffer(ScmPort *port, const char **start, const char **end)
+{
+    if (port->scrcnt > 0 || port->ungotten != SCM_CHAR_INVALID
+        || SCM_PORT_CLOSED_P(port)) {
+        return FALSE;
+    }
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        *start = port->src.buf.current;
+        *end = port->src.buf.end;
+        return TRUE;
+    case SCM_PORT_ISTR:
+        *start = port->src.istr.current;
+        *end = port->src.istr.end;
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* Mark NBYTES bytes of the range obtained by Scm__PortInputBuffer as
+   read.  NLINES is the number of newlines in them.  NBYTES can be 0
+   with any type of port, to count the newlines read by Scm_Getb, which
+   doesn't count lines. */
+void Scm__PortInputConsumed(ScmPort *port, size_t nbytes, u_long nlines)
+{
+    if (nbytes == 0) {
+        port->line += nlines;
+        return;
+    }
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        SCM_ASSERT(port->src.buf.current + nbytes <= port->src.buf.end);
+        port->src.buf.current += nbytes;
+        break;
+    case SCM_PORT_ISTR:
+        SCM_ASSERT(port->src.istr.current + nbytes <= port->src.istr.end);
+        port->src.istr.current += nbytes;
+        break;
+    default:
+        Scm_Panic("Scm__PortInputConsumed: bad port type");
+    }
+    port->bytes += nbytes;
+    port->line += nlines;
+}
+
 /*===============================================================
  * buffered Port
  *  - mainly used for buffered file I/O, but can also be used
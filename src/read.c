@@ -403,6 +403,39 @@ inline static int char_word_case_fold(int c)
     return (c >= 0 && c < 128 && (ctypes[(unsigned char)c]&2));
 }
 
+/* Fast path of scanning.
+   We hold the port lock while reading, so we can look into the port's
+   input buffer directly and take a run of ASCII bytes at once, instead
+   of fetching one character at a time.  These returns the number of
+   bytes scanned from START; the scan stops at END or at the first byte
+   that needs attention (non-ASCII bytes are left to Scm_GetcUnsafe).
+*/
+static size_t scan_word_run(const char *start, const char *end,
+                            int include_hash_sign)
+{
+    const char *p = start;
+    for (; p < end; p++) {
+        unsigned char b = (unsigned char)*p;
+        if (b >= 0x80) break;
+        if (!(ctypes[b]&1) && !(b == '#' && include_hash_sign)) break;
+    }
+    return (size_t)(p - start);
+}
+
+static size_t scan_string_run(const char *start, const char *end,
+                              u_long *nlines)
+{
+    const char *p = start;
+    u_long nl = 0;
+    for (; p < end; p++) {
+        unsigned char b = (unsigned char)*p;
+        if (b >= 0x80 || b == '"' || b == '\\') break;
+        if (b == '\n') nl++;
+    }
+    *nlines = nl;
+    return (size_t)(p - start);
+}
+
 /* R7RS 7.1.1 <delimiter> */
 static int char_is_delimiter(ScmChar ch)
 {
@@ -464,6 +497,15 @@ static void read_comment(ScmPort *port) /* leading semicolon is already read */
 static int skipws(ScmPort *port, ScmReadContext *ctx)
 {
     for (;;) {
+        const char *start, *end;
+        if (Scm__PortInputBuffer(port, &start, &end)) {
+            const char *p = start;
+            u_long nlines = 0;
+            for (; p < end && (unsigned char)*p < 0x80 && isspace(*p); p++) {
+                if (*p == '\n') nlines++;
+            }
+            if (p > start) Scm__PortInputConsumed(port, p - start, nlines);
+        }
         int c = Scm_GetcUnsafe(port);
         if (c == EOF) return c;
         if (c <= 127) {
@@ -1053,6 +1095,15 @@ static ScmObj read_string(ScmPort *port, int incompletep,
     ((var)==' ' || (var)=='\t' || SCM_CHAR_EXTRA_WHITESPACE_INTRALINE(var))
 
     for (;;) {
+        const char *start, *end;
+        if (Scm__PortInputBuffer(port, &start, &end)) {
+            u_long nlines;
+            size_t n = scan_string_run(start, end, &nlines);
+            if (n > 0) {
+                Scm_DStringPutz(&ds, start, (int)n);
+                Scm__PortInputConsumed(port, n, nlines);
+            }
+        }
         FETCH(c);
         switch (c) {
         case EOF: goto eof_exit;
@@ -1273,6 +1324,26 @@ static ScmObj read_word(ScmPort *port, ScmChar initial, ScmReadContext *ctx,
     }
 
     for (;;) {
+        const char *start, *end;
+        if (Scm__PortInputBuffer(port, &start, &end)) {
+            size_t n = scan_word_run(start, end, include_hash_sign);
+            if (n > 0) {
+                if (case_fold) {
+                    for (size_t i=0; i<n; i++) {
+                        int b = (unsigned char)start[i];
+                        SCM_DSTRING_PUTC(&ds, char_word_case_fold(b)? tolower(b):b);
+                    }
+                } else {
+                    Scm_DStringPutz(&ds, start, (int)n);
+                }
+                Scm__PortInputConsumed(port, n, 0);
+            }
+            /* If the run ends with an ASCII delimiter in the buffer,
+               we don't need to fetch and unget it. */
+            if (start + n < end && (unsigned char)start[n] < 0x80) {
+                return Scm_DStringGet(&ds, 0);
+            }
+        }
         int c = Scm_GetcUnsafe(port);
         if (c == EOF || !char_word_constituent(c, include_hash_sign)) {
             Scm_UngetcUnsafe(c, port);
@@ -1,5 +1,5 @@
 /*
- * serial.c - serializer 
+ * serial.c - binary serializer
  *
  *   Copyright (c) 2000-2017  Shiro Kawai  <shiro@acm.org>
  * 
@@ -31,8 +31,1029 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+
+#define LIBGAUCHE_BODY
 #include "gauche.h"
+#include "gauche/class.h"
+#include "gauche/bignum.h"
+#include "gauche/priv/portP.h"
+
+/*
+ * Format
+ *
+ *   A serialized datum consists of a 4-byte header followed by an
+ *   encoded object.
+ *
+ *     header : 0xd5 'G' 'S' <version>
+ *
+ *   Every object begins with a one-byte tag (see below).  Integers
+ *   embedded in the encoding (lengths, indices, fixnum values) are
+ *   unsigned LEB128 ("varint"); signed values are zigzag-encoded first.
+ *   Raw multibyte data (flonums and uvector elements) is little-endian.
+ *   Strings and symbol names are in the native character encoding.
+ *
+ *   Objects with identity---pairs, strings, symbols, keywords, vectors,
+ *   uvectors, hash tables, instances, and classes of instances---are
+ *   numbered in the order they appear.  When the same object appears
+ *   again it is written as TAG_REF with its number, so shared and
+ *   circular structure is preserved.  The decoder numbers the objects
+ *   in the same order.
+ *
+ *   A list is written as TAG_LIST, the elements, TAG_LIST_END and the
+ *   tail.  Each spine pair gets its number just before its car is
+ *   written.  The spine stops at a pair that has already been numbered,
+ *   which then becomes the tail, written as a reference.
+ *
+ *   An instance of a Scheme-defined class is written as TAG_INSTANCE,
+ *   the class descriptor and the values of the instance slots.  The class
+ *   descriptor (TAG_CLASS) has the class name, the name of the module
+ *   that defines the class, and the slot names.  The decoder looks up the
+ *   class by name and matches the slots by name, so the data survives
+ *   reordering or addition of slots.
+ */
+
+#define SERIAL_MAGIC  0xd5
+
+enum {
+    TAG_NIL        = 0x00,
+    TAG_FALSE      = 0x01,
+    TAG_TRUE       = 0x02,
+    TAG_UNDEF      = 0x03,
+    TAG_EOF        = 0x04,
+    TAG_UNBOUND    = 0x05,      /* only as a slot value */
+    TAG_REF        = 0x06,      /* varint index */
+
+    TAG_FIXNUM     = 0x10,      /* zigzag varint */
+    TAG_BIGNUM_POS = 0x11,      /* varint nbytes, magnitude (LE) */
+    TAG_BIGNUM_NEG = 0x12,
+    TAG_FLONUM     = 0x13,      /* 8 bytes */
+    TAG_RATNUM     = 0x14,      /* numerator, denominator */
+    TAG_COMPNUM    = 0x15,      /* 8 bytes real, 8 bytes imag */
+    TAG_CHAR       = 0x16,      /* varint char code */
+
+    TAG_STRING     = 0x20,      /* flags, varint size, varint len, bytes */
+    TAG_SYMBOL     = 0x21,      /* varint size, varint len, bytes */
+    TAG_USYMBOL    = 0x22,      /* uninterned symbol; same as above */
+    TAG_KEYWORD    = 0x23,      /* same as above */
+
+    TAG_LIST       = 0x30,      /* elements, TAG_LIST_END, tail */
+    TAG_LIST_END   = 0x31,
+    TAG_VECTOR     = 0x32,      /* varint length, elements */
+    TAG_UVECTOR    = 0x33,      /* type, varint length, raw elements */
+    TAG_HASH_TABLE = 0x34,      /* type, varint count, keys and values */
+    TAG_INSTANCE   = 0x35,      /* class descriptor, slot values */
+    TAG_CLASS      = 0x36,      /* name, module name, varint nslots, names */
+
+    TAG_SMALLINT   = 0x80       /* 0x80-0xff: fixnum 0-127 */
+};
+
+/* flags after TAG_STRING */
+#define STRING_FLAG_IMMUTABLE   1
+#define STRING_FLAG_INCOMPLETE  2
+
+#define SERIAL_BUFSIZ  8192
+
+/* Limit of nesting of compound objects, so that deeply nested (or
+   corrupted) data raises an error instead of overflowing the C stack.
+   Both the encoder and the decoder recurse on nested data. */
+#define SERIAL_MAX_DEPTH  10000
+
+static ScmClass *uvector_class(int type);
+
+/*============================================================
+ * Encoder
+ */
+
+typedef struct SerialOutRec {
+    ScmPort *port;              /* NULL if we accumulate the output in buf */
+    char *buf;
+    size_t len;
+    size_t cap;
+    ScmHashCore table;          /* object -> index+1 */
+    u_long count;               /* number of indexed objects */
+    int depth;                  /* nesting level */
+} SerialOut;
+
+static void serial_out_init(SerialOut *o, ScmPort *port)
+{
+    o->port = port;
+    o->buf = SCM_NEW_ATOMIC2(char*, SERIAL_BUFSIZ);
+    o->len = 0;
+    o->cap = SERIAL_BUFSIZ;
+    Scm_HashCoreInitSimple(&o->table, SCM_HASH_EQ, 0, NULL);
+    o->count = 0;
+    o->depth = 0;
+}
+
+static void out_flush(SerialOut *o)
+{
+    if (o->port && o->len > 0) {
+        Scm_PutzUnsafe(o->buf, (int)o->len, o->port);
+        o->len = 0;
+    }
+}
+
+/* Make sure we have room for N bytes in buf.  If we write to a port,
+   N must not exceed SERIAL_BUFSIZ. */
+static void out_room(SerialOut *o, size_t n)
+{
+    if (o->len + n <= o->cap) return;
+    if (o->port) {
+        out_flush(o);
+    } else {
+        size_t newcap = o->cap * 2;
+        while (newcap < o->len + n) newcap *= 2;
+        char *newbuf = SCM_NEW_ATOMIC2(char*, newcap);
+        memcpy(newbuf, o->buf, o->len);
+        o->buf = newbuf;
+        o->cap = newcap;
+    }
+}
+
+static inline void out_byte(SerialOut *o, u_char b)
+{
+    if (o->len >= o->cap) out_room(o, 1);
+    o->buf[o->len++] = (char)b;
+}
+
+static void out_bytes(SerialOut *o, const char *p, size_t n)
+{
+    if (o->port && n > SERIAL_BUFSIZ) {
+        out_flush(o);
+        while (n > 0) {
+            int chunk = (n > INT_MAX)? INT_MAX : (int)n;
+            Scm_PutzUnsafe(p, chunk, o->port);
+            p += chunk;
+            n -= chunk;
+        }
+        return;
+    }
+    out_room(o, n);
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+}
+
+static inline void out_uint(SerialOut *o, uint64_t v)
+{
+    out_room(o, 10);
+    while (v >= 0x80) {
+        o->buf[o->len++] = (char)((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    o->buf[o->len++] = (char)v;
+}
+
+static inline void out_int(SerialOut *o, int64_t v)
+{
+    out_uint(o, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void out_double(SerialOut *o, double d)
+{
+    union { double d; uint64_t u; } v;
+    v.d = d;
+    out_room(o, 8);
+    for (int i=0; i<8; i++) {
+        o->buf[o->len++] = (char)(v.u & 0xff);
+        v.u >>= 8;
+    }
+}
+
+/* If OBJ has already been written, write a reference to it and
+   returns TRUE.  Otherwise, give OBJ the next index and returns FALSE. */
+static int out_ref(SerialOut *o, ScmObj obj)
+{
+    ScmDictEntry *e = Scm_HashCoreSearch(&o->table, (intptr_t)obj,
+                                         SCM_DICT_CREATE);
+    if (e->value) {
+        out_byte(o, TAG_REF);
+        out_uint(o, (uint64_t)(e->value - 1));
+        return TRUE;
+    }
+    e->value = (intptr_t)++o->count;
+    return FALSE;
+}
+
+static void out_string_body(SerialOut *o, ScmString *s)
+{
+    u_int size, len;
+    const char *p = Scm_GetStringContent(s, &size, &len, NULL);
+    out_uint(o, size);
+    out_uint(o, len);
+    out_bytes(o, p, size);
+}
+
+static void out_bignum(SerialOut *o, ScmBignum *b)
+{
+    u_int words = SCM_BIGNUM_SIZE(b);
+    size_t nbytes = (size_t)words * SIZEOF_LONG;
+    /* strip leading zero bytes of the magnitude */
+    while (nbytes > 0) {
+        u_long w = b->values[(nbytes-1)/SIZEOF_LONG];
+        if ((w >> (((nbytes-1)%SIZEOF_LONG)*8)) & 0xff) break;
+        nbytes--;
+    }
+    out_byte(o, (SCM_BIGNUM_SIGN(b) < 0)? TAG_BIGNUM_NEG : TAG_BIGNUM_POS);
+    out_uint(o, nbytes);
+    for (size_t i=0; i<nbytes; i++) {
+        u_long w = b->values[i/SIZEOF_LONG];
+        out_byte(o, (u_char)(w >> ((i%SIZEOF_LONG)*8)));
+    }
+}
+
+static void out_uvector(SerialOut *o, ScmUVector *v)
+{
+    ScmClass *k = Scm_ClassOf(SCM_OBJ(v));
+    ScmSmallInt size = SCM_UVECTOR_SIZE(v);
+    int esize = Scm_UVectorElementSize(k);
+    out_byte(o, TAG_UVECTOR);
+    out_byte(o, (u_char)Scm_UVectorType(k));
+    out_uint(o, size);
+#if WORDS_BIGENDIAN
+    if (esize > 1) {
+        const u_char *p = (const u_char*)SCM_UVECTOR_ELEMENTS(v);
+        for (ScmSmallInt i=0; i<size; i++, p+=esize) {
+            for (int j=esize-1; j>=0; j--) out_byte(o, p[j]);
+        }
+        return;
+    }
+#endif /*WORDS_BIGENDIAN*/
+    out_bytes(o, (const char*)SCM_UVECTOR_ELEMENTS(v), (size_t)size*esize);
+}
+
+static void serial_write(ScmObj obj, SerialOut *o);
+
+static void out_list(SerialOut *o, ScmObj obj)
+{
+    out_byte(o, TAG_LIST);
+    for (;;) {
+        serial_write(SCM_CAR(obj), o);
+        obj = SCM_CDR(obj);
+        if (!SCM_PAIRP(obj)) break;
+        ScmDictEntry *e = Scm_HashCoreSearch(&o->table, (intptr_t)obj,
+                                             SCM_DICT_CREATE);
+        if (e->value) break;    /* shared tail; written as a reference */
+        e->value = (intptr_t)++o->count;
+    }
+    out_byte(o, TAG_LIST_END);
+    serial_write(obj, o);
+}
+
+static void out_hash_table(SerialOut *o, ScmHashTable *h)
+{
+    int type;
+    switch (Scm_HashTableType(h)) {
+    case SCM_HASH_EQ:     type = SCM_HASH_EQ; break;
+    case SCM_HASH_EQV:    type = SCM_HASH_EQV; break;
+    case SCM_HASH_EQUAL:  type = SCM_HASH_EQUAL; break;
+    case SCM_HASH_STRING: type = SCM_HASH_STRING; break;
+    default:
+        Scm_Error("can't serialize a hash table with a custom comparator: %S",
+                  SCM_OBJ(h));
+        return;                 /* dummy */
+    }
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(h);
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    out_byte(o, TAG_HASH_TABLE);
+    out_byte(o, (u_char)type);
+    out_uint(o, Scm_HashCoreNumEntries(core));
+    Scm_HashIterInit(&iter, core);
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        serial_write(SCM_DICT_KEY(e), o);
+        serial_write(SCM_DICT_VALUE(e), o);
+    }
+}
+
+static void out_class(SerialOut *o, ScmClass *k)
+{
+    if (out_ref(o, SCM_OBJ(k))) return;
+
+    ScmObj modname = SCM_FALSE, cp;
+    u_long nslots = 0;
+    if (SCM_PAIRP(k->modules) && SCM_MODULEP(SCM_CAR(k->modules))) {
+        modname = SCM_MODULE(SCM_CAR(k->modules))->name;
+    }
+    SCM_FOR_EACH(cp, k->accessors) {
+        if (SCM_SLOT_ACCESSOR(SCM_CDAR(cp))->slotNumber >= 0) nslots++;
+    }
+    out_byte(o, TAG_CLASS);
+    serial_write(k->name, o);
+    serial_write(modname, o);
+    out_uint(o, nslots);
+    SCM_FOR_EACH(cp, k->accessors) {
+        if (SCM_SLOT_ACCESSOR(SCM_CDAR(cp))->slotNumber >= 0) {
+            serial_write(SCM_CAAR(cp), o);
+        }
+    }
+}
+
+static void out_instance(SerialOut *o, ScmObj obj, ScmClass *k)
+{
+    ScmObj cp;
+    out_byte(o, TAG_INSTANCE);
+    out_class(o, k);
+    SCM_FOR_EACH(cp, k->accessors) {
+        int n = SCM_SLOT_ACCESSOR(SCM_CDAR(cp))->slotNumber;
+        if (n < 0) continue;
+        ScmObj v = Scm_InstanceSlotRef(obj, n);
+        if (SCM_UNBOUNDP(v)) out_byte(o, TAG_UNBOUND);
+        else serial_write(v, o);
+    }
+}
+
+static void serial_write_1(ScmObj obj, SerialOut *o);
 
-/* NOT IMPLEMENTED YET */
+static void serial_write(ScmObj obj, SerialOut *o)
+{
+    if (++o->depth > SERIAL_MAX_DEPTH) {
+        Scm_Error("object nested too deeply to serialize");
+    }
+    serial_write_1(obj, o);
+    o->depth--;
+}
 
+static void serial_write_1(ScmObj obj, SerialOut *o)
+{
+    if (SCM_INTP(obj)) {
+        ScmSmallInt v = SCM_INT_VALUE(obj);
+        if (v >= 0 && v < 0x80) {
+            out_byte(o, (u_char)(TAG_SMALLINT|v));
+        } else {
+            out_byte(o, TAG_FIXNUM);
+            out_int(o, v);
+        }
+        return;
+    }
+    if (SCM_NULLP(obj))      { out_byte(o, TAG_NIL); return; }
+    if (SCM_FALSEP(obj))     { out_byte(o, TAG_FALSE); return; }
+    if (SCM_TRUEP(obj))      { out_byte(o, TAG_TRUE); return; }
+    if (SCM_UNDEFINEDP(obj)) { out_byte(o, TAG_UNDEF); return; }
+    if (SCM_EOFP(obj))       { out_byte(o, TAG_EOF); return; }
+    if (SCM_CHARP(obj)) {
+        out_byte(o, TAG_CHAR);
+        out_uint(o, (uint64_t)SCM_CHAR_VALUE(obj));
+        return;
+    }
+    if (SCM_FLONUMP(obj)) {
+        out_byte(o, TAG_FLONUM);
+        out_double(o, SCM_FLONUM_VALUE(obj));
+        return;
+    }
+    if (!SCM_PTRP(obj)) goto unserializable;
+    if (SCM_BIGNUMP(obj)) {
+        out_bignum(o, SCM_BIGNUM(obj));
+        return;
+    }
+    if (SCM_RATNUMP(obj)) {
+        out_byte(o, TAG_RATNUM);
+        serial_write(SCM_RATNUM_NUMER(obj), o);
+        serial_write(SCM_RATNUM_DENOM(obj), o);
+        return;
+    }
+    if (SCM_COMPNUMP(obj)) {
+        out_byte(o, TAG_COMPNUM);
+        out_double(o, SCM_COMPNUM_REAL(obj));
+        out_double(o, SCM_COMPNUM_IMAG(obj));
+        return;
+    }
+
+    /* The rest are objects with identity. */
+    if (SCM_PAIRP(obj)) {
+        if (!out_ref(o, obj)) out_list(o, obj);
+        return;
+    }
+    if (SCM_STRINGP(obj)) {
+        if (out_ref(o, obj)) return;
+        u_char flags = 0;
+        if (SCM_STRING_IMMUTABLE_P(obj))  flags |= STRING_FLAG_IMMUTABLE;
+        if (SCM_STRING_INCOMPLETE_P(obj)) flags |= STRING_FLAG_INCOMPLETE;
+        out_byte(o, TAG_STRING);
+        out_byte(o, flags);
+        out_string_body(o, SCM_STRING(obj));
+        return;
+    }
+    if (SCM_KEYWORDP(obj)) {
+        if (out_ref(o, obj)) return;
+        out_byte(o, TAG_KEYWORD);
+        out_string_body(o, SCM_STRING(Scm_KeywordToString(SCM_KEYWORD(obj))));
+        return;
+    }
+    if (SCM_SYMBOLP(obj)) {
+        if (out_ref(o, obj)) return;
+        out_byte(o, SCM_SYMBOL_INTERNED(obj)? TAG_SYMBOL : TAG_USYMBOL);
+        out_string_body(o, SCM_SYMBOL_NAME(obj));
+        return;
+    }
+    if (SCM_VECTORP(obj)) {
+        if (out_ref(o, obj)) return;
+        ScmSmallInt size = SCM_VECTOR_SIZE(obj);
+        out_byte(o, TAG_VECTOR);
+        out_uint(o, size);
+        for (ScmSmallInt i=0; i<size; i++) {
+            serial_write(SCM_VECTOR_ELEMENT(obj, i), o);
+        }
+        return;
+    }
+    if (SCM_UVECTORP(obj)) {
+        if (!out_ref(o, obj)) out_uvector(o, SCM_UVECTOR(obj));
+        return;
+    }
+    if (SCM_HASH_TABLE_P(obj)) {
+        if (!out_ref(o, obj)) out_hash_table(o, SCM_HASH_TABLE(obj));
+        return;
+    }
+    ScmClass *k = Scm_ClassOf(obj);
+    if (SCM_CLASS_CATEGORY(k) == SCM_CLASS_SCHEME && !SCM_CLASSP(obj)) {
+        if (!out_ref(o, obj)) out_instance(o, obj, k);
+        return;
+    }
+  unserializable:
+    Scm_Error("unserializable object: %S", obj);
+}
+
+static void serial_write_datum(ScmObj obj, SerialOut *o)
+{
+    out_byte(o, SERIAL_MAGIC);
+    out_byte(o, 'G');
+    out_byte(o, 'S');
+    out_byte(o, SCM_SERIAL_VERSION);
+    serial_write(obj, o);
+}
+
+/* Write a serialized datum of OBJ to an output PORT. */
+void Scm_Serialize(ScmObj obj, ScmObj port)
+{
+    ScmVM *vm = Scm_VM();
+    SerialOut out;
+
+    if (!SCM_OPORTP(port)) {
+        Scm_Error("output port required, but got %S", port);
+    }
+    serial_out_init(&out, SCM_PORT(port));
+    PORT_LOCK(SCM_PORT(port), vm);
+    PORT_SAFE_CALL(SCM_PORT(port),
+                   (serial_write_datum(obj, &out), out_flush(&out)),
+                   /*no cleanup*/);
+    PORT_UNLOCK(SCM_PORT(port));
+}
+
+/* Returns a serialized datum of OBJ as an u8vector. */
+ScmObj Scm_SerializeToUVector(ScmObj obj)
+{
+    SerialOut out;
+    serial_out_init(&out, NULL);
+    serial_write_datum(obj, &out);
+    return Scm_MakeUVectorFull(SCM_CLASS_U8VECTOR, (ScmSmallInt)out.len,
+                               out.buf, FALSE, NULL);
+}
+
+/*============================================================
+ * Decoder
+ */
+
+typedef struct SerialInRec {
+    ScmPort *port;              /* NULL if we read from a memory */
+    const char *start;          /* beginning of the unsynced range */
+    const char *cur;
+    const char *end;
+    int detached;               /* TRUE if [start, end) is our own copy
+                                   of the bytes taken from the port */
+    int depth;                  /* nesting level */
+    ScmObj *objs;               /* indexed objects */
+    u_long nobjs;
+    u_long capobjs;
+} SerialIn;
+
+static void serial_in_init(SerialIn *in, ScmPort *port,
+                           const char *buf, ScmSmallInt size)
+{
+    in->port = port;
+    in->start = in->cur = buf;
+    in->end = buf + size;
+    in->detached = FALSE;
+    in->depth = 0;
+    in->capobjs = 32;
+    in->objs = SCM_NEW_ARRAY(ScmObj, in->capobjs);
+    in->nobjs = 0;
+}
+
+/* Tell the port how many bytes we've taken from its buffer. */
+static void in_sync(SerialIn *in)
+{
+    if (in->port && !in->detached && in->cur > in->start) {
+        Scm__PortInputConsumed(in->port, in->cur - in->start, 0);
+    }
+    in->start = in->cur;
+}
+
+/* Called when we run out the directly accessible bytes.  Returns the
+   next byte or EOF. */
+static int in_fill(SerialIn *in)
+{
+    if (in->port == NULL) return EOF;
+    in_sync(in);
+    in->detached = FALSE;
+    const char *start, *end;
+    if (Scm__PortInputBuffer(in->port, &start, &end) && start < end) {
+        in->start = start;
+        in->cur = start + 1;
+        in->end = end;
+        return (u_char)*start;
+    }
+    in->start = in->cur = in->end = NULL;
+    /* This may fill the port's buffer, so that the next in_fill can
+       take the fast path. */
+    return Scm_GetbUnsafe(in->port);
+}
+
+static inline int in_byte(SerialIn *in)
+{
+    if (in->cur < in->end) return (u_char)*in->cur++;
+    return in_fill(in);
+}
+
+static void in_eof(SerialIn *in)
+{
+    if (in->port) {
+        Scm_Error("unexpected EOF in serialized data from %S",
+                  SCM_OBJ(in->port));
+    } else {
+        Scm_Error("unexpected EOF in serialized data");
+    }
+}
+
+static inline u_char in_byte_x(SerialIn *in)
+{
+    int b = in_byte(in);
+    if (b == EOF) in_eof(in);
+    return (u_char)b;
+}
+
+static void in_bytes(SerialIn *in, char *buf, size_t n)
+{
+    size_t avail = in->end - in->cur;
+    if (in->cur && avail > 0) {
+        if (avail > n) avail = n;
+        memcpy(buf, in->cur, avail);
+        in->cur += avail;
+        buf += avail;
+        n -= avail;
+    }
+    if (n == 0) return;
+    if (in->port == NULL) in_eof(in);
+    in_sync(in);
+    in->detached = FALSE;
+    in->start = in->cur = in->end = NULL;
+    while (n > 0) {
+        int chunk = (n > INT_MAX)? INT_MAX : (int)n;
+        int r = Scm_GetzUnsafe(buf, chunk, in->port);
+        if (r <= 0) in_eof(in);
+        buf += r;
+        n -= r;
+    }
+}
+
+/* Makes sure the input has at least N more bytes, before we allocate
+   something of the size read from the data; a corrupted size field
+   must not make us allocate a huge object.  From a port, we don't know
+   how many bytes are left, so we read ahead N bytes into our own
+   buffer, which grows only as the bytes actually arrive. */
+static void in_require(SerialIn *in, size_t n)
+{
+    size_t avail = in->cur? (size_t)(in->end - in->cur) : 0;
+    if (avail >= n) return;
+    if (in->port == NULL) {
+        Scm_Error("malformed serialized data: size exceeds the input");
+    }
+
+    size_t cap = SERIAL_BUFSIZ, len = avail;
+    while (cap < avail) cap *= 2;
+    char *buf = SCM_NEW_ATOMIC2(char*, cap);
+    if (avail > 0) memcpy(buf, in->cur, avail);
+    in->cur += avail;
+    in_sync(in);
+    while (len < n) {
+        if (len == cap) {
+            char *nbuf = SCM_NEW_ATOMIC2(char*, cap*2);
+            memcpy(nbuf, buf, len);
+            buf = nbuf;
+            cap *= 2;
+        }
+        size_t chunk = cap - len;
+        if (chunk > n - len) chunk = n - len;
+        if (chunk > INT_MAX) chunk = INT_MAX;
+        int r = Scm_GetzUnsafe(buf + len, (int)chunk, in->port);
+        if (r <= 0) {
+            Scm_Error("malformed serialized data: size exceeds the input");
+        }
+        len += r;
+    }
+    in->start = in->cur = buf;
+    in->end = buf + len;
+    in->detached = TRUE;
+}
+
+static uint64_t in_uint(SerialIn *in)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        u_char b = in_byte_x(in);
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    Scm_Error("malformed serialized data: varint too long");
+    return 0;                   /* dummy */
+}
+
+static inline int64_t in_int(SerialIn *in)
+{
+    uint64_t v = in_uint(in);
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* Reads a length that must fit in ScmSmallInt. */
+static ScmSmallInt in_size(SerialIn *in)
+{
+    uint64_t v = in_uint(in);
+    if (v > (uint64_t)SCM_SMALL_INT_MAX) {
+        Scm_Error("malformed serialized data: size too large");
+    }
+    return (ScmSmallInt)v;
+}
+
+static double in_double(SerialIn *in)
+{
+    union { double d; uint64_t u; } v;
+    v.u = 0;
+    for (int i=0; i<8; i++) {
+        v.u |= (uint64_t)in_byte_x(in) << (i*8);
+    }
+    return v.d;
+}
+
+/* Gives the next index to OBJ.  OBJ may be a placeholder, to be
+   replaced later by in_set_ref. */
+static u_long in_register(SerialIn *in, ScmObj obj)
+{
+    if (in->nobjs >= in->capobjs) {
+        u_long newcap = in->capobjs * 2;
+        ScmObj *newobjs = SCM_NEW_ARRAY(ScmObj, newcap);
+        memcpy(newobjs, in->objs, sizeof(ScmObj) * in->nobjs);
+        in->objs = newobjs;
+        in->capobjs = newcap;
+    }
+    in->objs[in->nobjs] = obj;
+    return in->nobjs++;
+}
+
+static ScmObj in_string_body(SerialIn *in, u_int flags)
+{
+    ScmSmallInt size = in_size(in);
+    ScmSmallInt len = in_size(in);
+    in_require(in, size);
+    char *buf = SCM_NEW_ATOMIC2(char*, size+1);
+    in_bytes(in, buf, size);
+    buf[size] = '\0';
+    if (flags & SCM_STRING_INCOMPLETE) {
+        return Scm_MakeString(buf, size, size, flags);
+    }
+    /* Scm_MakeString trusts the given length, but we can't trust the
+       data.  Let it count the characters, and check it's consistent. */
+    ScmObj s = Scm_MakeString(buf, size, -1, flags);
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    if (SCM_STRING_BODY_INCOMPLETE_P(b) || SCM_STRING_BODY_LENGTH(b) != len) {
+        Scm_Error("malformed serialized data: bad string");
+    }
+    return s;
+}
+
+static ScmObj in_bignum(SerialIn *in, int sign)
+{
+    ScmSmallInt nbytes = in_size(in);
+    in_require(in, nbytes);
+    ScmSmallInt words = (nbytes + SIZEOF_LONG - 1) / SIZEOF_LONG;
+    if (words == 0) return SCM_MAKE_INT(0);
+    u_long *values = SCM_NEW_ATOMIC_ARRAY(u_long, words);
+    memset(values, 0, sizeof(u_long) * words);
+    for (ScmSmallInt i=0; i<nbytes; i++) {
+        values[i/SIZEOF_LONG] |= (u_long)in_byte_x(in) << ((i%SIZEOF_LONG)*8);
+    }
+    return Scm_NormalizeBignum(SCM_BIGNUM(Scm_MakeBignumFromUIArray(sign,
+                                                                   values,
+                                                                   words)));
+}
+
+static ScmObj in_uvector(SerialIn *in)
+{
+    int type = in_byte_x(in);
+    ScmClass *k = uvector_class(type);
+    if (k == NULL) {
+        Scm_Error("malformed serialized data: bad uvector type %d", type);
+    }
+    ScmSmallInt size = in_size(in);
+    int esize = Scm_UVectorElementSize(k);
+    if (size > SCM_SMALL_INT_MAX/esize) {
+        Scm_Error("malformed serialized data: size too large");
+    }
+    in_require(in, (size_t)size*esize);
+    ScmObj v = Scm_MakeUVector(k, size, NULL);
+    in_register(in, v);
+    in_bytes(in, (char*)SCM_UVECTOR_ELEMENTS(v), (size_t)size*esize);
+#if WORDS_BIGENDIAN
+    if (esize > 1) {
+        u_char *p = (u_char*)SCM_UVECTOR_ELEMENTS(v);
+        for (ScmSmallInt i=0; i<size; i++, p+=esize) {
+            for (int j=0; j<esize/2; j++) {
+                u_char t = p[j]; p[j] = p[esize-1-j]; p[esize-1-j] = t;
+            }
+        }
+    }
+#endif /*WORDS_BIGENDIAN*/
+    return v;
+}
+
+static ScmObj serial_read(SerialIn *in);
+static ScmObj serial_read_tagged(SerialIn *in, int tag);
+
+static ScmObj in_list(SerialIn *in)
+{
+    ScmObj head = Scm_Cons(SCM_NIL, SCM_NIL), tail = head;
+    in_register(in, head);
+    SCM_SET_CAR(head, serial_read(in));
+    for (;;) {
+        int tag = in_byte_x(in);
+        if (tag == TAG_LIST_END) break;
+        ScmObj p = Scm_Cons(SCM_NIL, SCM_NIL);
+        in_register(in, p);
+        SCM_SET_CDR(tail, p);
+        tail = p;
+        SCM_SET_CAR(p, serial_read_tagged(in, tag));
+    }
+    SCM_SET_CDR(tail, serial_read(in));
+    return head;
+}
+
+static ScmObj in_hash_table(SerialIn *in)
+{
+    int type = in_byte_x(in);
+    if (type != SCM_HASH_EQ && type != SCM_HASH_EQV
+        && type != SCM_HASH_EQUAL && type != SCM_HASH_STRING) {
+        Scm_Error("malformed serialized data: bad hash table type %d", type);
+    }
+    ScmSmallInt count = in_size(in);
+    in_require(in, (size_t)count*2); /* at least a byte per key and value */
+    ScmObj h = Scm_MakeHashTableSimple((ScmHashType)type,
+                                       (count > INT_MAX)? 0 : (int)count);
+    in_register(in, h);
+    for (ScmSmallInt i=0; i<count; i++) {
+        ScmObj key = serial_read(in);
+        ScmObj val = serial_read(in);
+        Scm_HashTableSet(SCM_HASH_TABLE(h), key, val, 0);
+    }
+    return h;
+}
+
+/* A class descriptor is decoded into (<class> . #(slot-number ...)),
+   where each slot number is of the corresponding serialized slot in
+   the current class, or -1 if the class no longer has the slot. */
+static ScmObj in_class(SerialIn *in)
+{
+    u_long index = in_register(in, SCM_UNDEFINED);
+    ScmObj name = serial_read(in);
+    ScmObj modname = serial_read(in);
+    ScmSmallInt nslots = in_size(in);
+    in_require(in, nslots);     /* at least a byte per slot name */
+    ScmObj slotmap = Scm_MakeVector(nslots, SCM_MAKE_INT(-1));
+    ScmModule *mod = NULL;
+    ScmObj klass = SCM_UNBOUND;
+
+    if (SCM_SYMBOLP(modname)) {
+        mod = Scm_FindModule(SCM_SYMBOL(modname), SCM_FIND_MODULE_QUIET);
+    } else if (SCM_FALSEP(modname)) {
+        mod = Scm_UserModule();
+    }
+    if (mod && SCM_SYMBOLP(name)) {
+        klass = Scm_GlobalVariableRef(mod, SCM_SYMBOL(name), 0);
+    }
+    if (!SCM_CLASSP(klass)) {
+        Scm_Error("can't find class %S in module %S for deserialization",
+                  name, modname);
+    }
+    /* Only the instances of Scheme-defined classes are serialized as
+       slots; others can't be allocated that way. */
+    if (SCM_CLASS_CATEGORY(klass) != SCM_CLASS_SCHEME) {
+        Scm_Error("class %S can't be deserialized as an instance", klass);
+    }
+    for (ScmSmallInt i=0; i<nslots; i++) {
+        ScmObj sname = serial_read(in);
+        ScmObj p = Scm_Assq(sname, SCM_CLASS(klass)->accessors);
+        if (SCM_PAIRP(p)) {
+            int n = SCM_SLOT_ACCESSOR(SCM_CDR(p))->slotNumber;
+            if (n >= 0) SCM_VECTOR_ELEMENT(slotmap, i) = SCM_MAKE_INT(n);
+        }
+    }
+    ScmObj cinfo = Scm_Cons(klass, slotmap);
+    in->objs[index] = cinfo;
+    return cinfo;
+}
+
+static ScmObj in_instance(SerialIn *in)
+{
+    u_long index = in_register(in, SCM_UNDEFINED);
+    int tag = in_byte_x(in);
+    ScmObj cinfo;
+    if (tag == TAG_CLASS) {
+        cinfo = in_class(in);
+    } else if (tag == TAG_REF) {
+        cinfo = serial_read_tagged(in, tag);
+    } else {
+        cinfo = SCM_FALSE;
+    }
+    if (!SCM_PAIRP(cinfo) || !SCM_CLASSP(SCM_CAR(cinfo))
+        || SCM_CLASS_CATEGORY(SCM_CAR(cinfo)) != SCM_CLASS_SCHEME
+        || !SCM_VECTORP(SCM_CDR(cinfo))) {
+        Scm_Error("malformed serialized data: bad class descriptor");
+    }
+    ScmObj obj = Scm_Allocate(SCM_CLASS(SCM_CAR(cinfo)), SCM_NIL);
+    ScmObj slotmap = SCM_CDR(cinfo);
+    in->objs[index] = obj;
+    for (ScmSmallInt i=0; i<SCM_VECTOR_SIZE(slotmap); i++) {
+        int n = SCM_INT_VALUE(SCM_VECTOR_ELEMENT(slotmap, i));
+        int t = in_byte_x(in);
+        if (t == TAG_UNBOUND) continue;
+        ScmObj v = serial_read_tagged(in, t);
+        if (n >= 0) Scm_InstanceSlotSet(obj, n, v);
+    }
+    return obj;
+}
+
+static ScmObj serial_read_tagged_1(SerialIn *in, int tag);
+
+static ScmObj serial_read_tagged(SerialIn *in, int tag)
+{
+    if (++in->depth > SERIAL_MAX_DEPTH) {
+        Scm_Error("malformed serialized data: nested too deeply");
+    }
+    ScmObj r = serial_read_tagged_1(in, tag);
+    in->depth--;
+    return r;
+}
+
+static ScmObj serial_read_tagged_1(SerialIn *in, int tag)
+{
+    if (tag >= TAG_SMALLINT) return SCM_MAKE_INT(tag - TAG_SMALLINT);
+
+    switch (tag) {
+    case TAG_NIL:   return SCM_NIL;
+    case TAG_FALSE: return SCM_FALSE;
+    case TAG_TRUE:  return SCM_TRUE;
+    case TAG_UNDEF: return SCM_UNDEFINED;
+    case TAG_EOF:   return SCM_EOF;
+    case TAG_REF: {
+        uint64_t index = in_uint(in);
+        if (index >= in->nobjs) {
+            Scm_Error("malformed serialized data: bad reference %lu",
+                      (u_long)index);
+        }
+        return in->objs[index];
+    }
+    case TAG_FIXNUM:     return Scm_MakeInteger64(in_int(in));
+    case TAG_BIGNUM_POS: return in_bignum(in, 1);
+    case TAG_BIGNUM_NEG: return in_bignum(in, -1);
+    case TAG_FLONUM:     return Scm_MakeFlonum(in_double(in));
+    case TAG_RATNUM: {
+        ScmObj numer = serial_read(in);
+        ScmObj denom = serial_read(in);
+        if (!SCM_INTEGERP(numer) || !SCM_INTEGERP(denom)) {
+            Scm_Error("malformed serialized data: bad ratnum");
+        }
+        return Scm_MakeRational(numer, denom);
+    }
+    case TAG_COMPNUM: {
+        double r = in_double(in);
+        double i = in_double(in);
+        return Scm_MakeComplex(r, i);
+    }
+    case TAG_CHAR: {
+        uint64_t c = in_uint(in);
+        if (c > SCM_CHAR_MAX) {
+            Scm_Error("malformed serialized data: bad character %lu",
+                      (u_long)c);
+        }
+        return SCM_MAKE_CHAR((ScmChar)c);
+    }
+    case TAG_STRING: {
+        int f = in_byte_x(in);
+        u_int flags = 0;
+        if (f & STRING_FLAG_IMMUTABLE)  flags |= SCM_STRING_IMMUTABLE;
+        if (f & STRING_FLAG_INCOMPLETE) flags |= SCM_STRING_INCOMPLETE;
+        u_long index = in_register(in, SCM_UNDEFINED);
+        return (in->objs[index] = in_string_body(in, flags));
+    }
+    case TAG_SYMBOL:
+    case TAG_USYMBOL:
+    case TAG_KEYWORD: {
+        u_long index = in_register(in, SCM_UNDEFINED);
+        ScmObj name = in_string_body(in, SCM_STRING_IMMUTABLE);
+        ScmObj r;
+        if (tag == TAG_KEYWORD) {
+            r = Scm_MakeKeyword(SCM_STRING(name));
+        } else {
+            r = Scm_MakeSymbol(SCM_STRING(name), tag == TAG_SYMBOL);
+        }
+        return (in->objs[index] = r);
+    }
+    case TAG_LIST:
+        return in_list(in);
+    case TAG_VECTOR: {
+        ScmSmallInt size = in_size(in);
+        in_require(in, size);   /* at least a byte per element */
+        ScmObj v = Scm_MakeVector(size, SCM_UNDEFINED);
+        in_register(in, v);
+        for (ScmSmallInt i=0; i<size; i++) {
+            SCM_VECTOR_ELEMENT(v, i) = serial_read(in);
+        }
+        return v;
+    }
+    case TAG_UVECTOR:    return in_uvector(in);
+    case TAG_HASH_TABLE: return in_hash_table(in);
+    case TAG_INSTANCE:   return in_instance(in);
+    default:
+        Scm_Error("malformed serialized data: unknown tag 0x%02x", tag);
+        return SCM_UNDEFINED;   /* dummy */
+    }
+}
+
+static ScmObj serial_read(SerialIn *in)
+{
+    return serial_read_tagged(in, in_byte_x(in));
+}
+
+/* Returns EOF object if the input is exhausted before the header. */
+static ScmObj serial_read_datum(SerialIn *in)
+{
+    int b = in_byte(in);
+    if (b == EOF) return SCM_EOF;
+    if (b != SERIAL_MAGIC || in_byte_x(in) != 'G' || in_byte_x(in) != 'S') {
+        Scm_Error("input is not a serialized datum");
+    }
+    int version = in_byte_x(in);
+    if (version != SCM_SERIAL_VERSION) {
+        Scm_Error("unsupported serialized data version: %d", version);
+    }
+    return serial_read(in);
+}
+
+/* Read a serialized datum from an input PORT. */
+ScmObj Scm_Deserialize(ScmObj port)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj r = SCM_UNDEFINED;
+    SerialIn in;
+
+    if (!SCM_IPORTP(port)) {
+        Scm_Error("input port required, but got %S", port);
+    }
+    serial_in_init(&in, SCM_PORT(port), NULL, 0);
+    PORT_LOCK(SCM_PORT(port), vm);
+    PORT_SAFE_CALL(SCM_PORT(port),
+                   r = serial_read_datum(&in),
+                   in_sync(&in));
+    PORT_UNLOCK(SCM_PORT(port));
+    return r;
+}
+
+/* Read a serialized datum from the byte sequence BUF of SIZE bytes.
+   If CONSUMED isn't NULL, the number of bytes used is stored in it. */
+ScmObj Scm_DeserializeFromBytes(const char *buf, ScmSmallInt size,
+                                ScmSmallInt *consumed)
+{
+    SerialIn in;
+    serial_in_init(&in, NULL, buf, size);
+    ScmObj r = serial_read_datum(&in);
+    if (consumed) *consumed = in.cur - buf;
+    return r;
+}
+
+/*============================================================
+ * Utility
+ */
 
+static ScmClass *uvector_class(int type)
+{
+    switch (type) {
+    case SCM_UVECTOR_S8:  return SCM_CLASS_S8VECTOR;
+    case SCM_UVECTOR_U8:  return SCM_CLASS_U8VECTOR;
+    case SCM_UVECTOR_S16: return SCM_CLASS_S16VECTOR;
+    case SCM_UVECTOR_U16: return SCM_CLASS_U16VECTOR;
+    case SCM_UVECTOR_S32: return SCM_CLASS_S32VECTOR;
+    case SCM_UVECTOR_U32: return SCM_CLASS_U32VECTOR;
+    case SCM_UVECTOR_S64: return SCM_CLASS_S64VECTOR;
+    case SCM_UVECTOR_U64: return SCM_CLASS_U64VECTOR;
+    case SCM_UVECTOR_F16: return SCM_CLASS_F16VECTOR;
+    case SCM_UVECTOR_F32: return SCM_CLASS_F32VECTOR;
+    case SCM_UVECTOR_F64: return SCM_CLASS_F64VECTOR;
+    default: return NULL;
+    }
+}
@@ -36,6 +36,7 @@
 #include "gauche/class.h"
 #include "gauche/bignum.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gauche/priv/systemP.h"
 
 #include <locale.h>
 #include <errno.h>
@@ -195,9 +196,48 @@ int Scm_GetPortFd(ScmObj port_or_fd, int needfd)
  *   reads entire directory.
  */
 
+/* File type from the directory entry, in the same symbol as the type
+   slot of <sys-stat>.  Returns #f if the entry doesn't tell, in which
+   case the caller has to stat the file.  Symlinks are reported as
+   symlink, not the type of what they point to. */
+#if !defined(GAUCHE_WINDOWS)
+static ScmObj dirent_type(struct dirent *dire)
+{
+#if defined(DT_UNKNOWN)
+    switch (dire->d_type) {
+    case DT_DIR:  return SCM_SYM_DIRECTORY;
+    case DT_REG:  return SCM_SYM_REGULAR;
+    case DT_LNK:  return SCM_SYM_SYMLINK;
+    case DT_CHR:  return SCM_SYM_CHARACTER;
+    case DT_BLK:  return SCM_SYM_BLOCK;
+    case DT_FIFO: return SCM_SYM_FIFO;
+    case DT_SOCK: return SCM_SYM_SOCKET;
+    default:      return SCM_FALSE;
+    }
+#else  /*!DT_UNKNOWN*/
+    return SCM_FALSE;
+#endif /*!DT_UNKNOWN*/
+}
+#else  /*GAUCHE_WINDOWS*/
+static ScmObj find_data_type(WIN32_FIND_DATA *fdata)
+{
+    /* A reparse point may be a symlink or a junction; let stat decide. */
+    if (fdata->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        return SCM_FALSE;
+    }
+    if (fdata->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        return SCM_SYM_DIRECTORY;
+    }
+    return SCM_SYM_REGULAR;
+}
+#endif /*GAUCHE_WINDOWS*/
+
 /* Returns a list of directory entries.  If pathname is not a directory,
-   or can't be opened by some reason, an error is signalled. */
-ScmObj Scm_ReadDirectory(ScmString *pathname)
+   or can't be opened by some reason, an error is signalled.
+   If with_types is TRUE, each element is (name . type) instead of
+   name, where type is what dirent_type() returns.  It saves a stat
+   call per entry when walking a directory tree. */
+static ScmObj read_directory(ScmString *pathname, int with_types)
 {
     ScmObj head = SCM_NIL, tail = SCM_NIL;
 #if !defined(GAUCHE_WINDOWS)
@@ -211,6 +251,7 @@ ScmObj Scm_ReadDirectory(ScmString *pathname)
     }
     while ((dire = readdir(dirp)) != NULL) {
         ScmObj ent = SCM_MAKE_STR_COPYING(dire->d_name);
+        if (with_types) ent = Scm_Cons(ent, dirent_type(dire));
         SCM_APPEND1(head, tail, ent);
     }
     SCM_SIGCHECK(vm);
@@ -238,12 +279,12 @@ ScmObj Scm_ReadDirectory(ScmString *pathname)
         if ((winerrno = GetLastError()) != ERROR_FILE_NOT_FOUND) goto err;
         return head;
     }
-    const char *tpath = SCM_WCS2MBS(fdata.cFileName);
-    SCM_APPEND1(head, tail, SCM_MAKE_STR_COPYING(tpath));
-    while (FindNextFile(dirp, &fdata) != 0) {
-        tpath = SCM_WCS2MBS(fdata.cFileName);
-        SCM_APPEND1(head, tail, SCM_MAKE_STR_COPYING(tpath));
-    }
+    do {
+        const char *tpath = SCM_WCS2MBS(fdata.cFileName);
+        ScmObj ent = SCM_MAKE_STR_COPYING(tpath);
+        if (with_types) ent = Scm_Cons(ent, find_data_type(&fdata));
+        SCM_APPEND1(head, tail, ent);
+    } while (FindNextFile(dirp, &fdata) != 0);
     winerrno = GetLastError();
     FindClose(dirp);
     if (winerrno != ERROR_NO_MORE_FILES) goto err;
@@ -255,6 +296,16 @@ ScmObj Scm_ReadDirectory(ScmString *pathname)
 #endif
 }
 
+ScmObj Scm_ReadDirectory(ScmString *pathname)
+{
+    return read_directory(pathname, FALSE);
+}
+
+ScmObj Scm_ReadDirectoryWithTypes(ScmString *pathname)
+{
+    return read_directory(pathname, TRUE);
+}
+
 /* getcwd compatibility layer.
    Some implementations of getcwd accepts NULL as buffer to allocate
    enough buffer memory in it, but that's not standardized and we avoid
@@ -1654,7 +1705,167 @@ char *win_create_command_line(ScmObj args)
 }
 #endif /*GAUCHE_WINDOWS*/
 
-/* Scm_SysExec
+/* When we give an explicit environment to the child, we use execve()
+ * instead of execvp(), so we search PATH for the program beforehand.
+ * Like execvp(), we search our PATH, not the one in the new environment.
+ * Relative entries of PATH (including empty ones) are relative to the
+ * directory where the program is executed, so we skip them if the child
+ * is going to change the directory (CDIR is not NULL).
+ * Returns NULL if the program isn't found.
+ */
+#if !defined(GAUCHE_WINDOWS)
+static const char *find_program(const char *program, const char *cdir)
+{
+    if (strchr(program, '/') != NULL) return program;
+    const char *path = Scm_GetEnv("PATH");
+    if (path == NULL) path = "/bin:/usr/bin";
+
+    for (;;) {
+        const char *end = strchr(path, ':');
+        size_t len = (end != NULL)? (size_t)(end - path) : strlen(path);
+        if (cdir == NULL || (len > 0 && path[0] == '/')) {
+            ScmDString ds;
+            Scm_DStringInit(&ds);
+            if (len == 0) Scm_DStringPutc(&ds, SCM_CHAR('.'));
+            else          Scm_DStringPutz(&ds, path, len);
+            Scm_DStringPutc(&ds, SCM_CHAR('/'));
+            Scm_DStringPutz(&ds, program, -1);
+            const char *cand = Scm_DStringGetz(&ds);
+
+            struct stat st;
+            if (stat(cand, &st) == 0 && S_ISREG(st.st_mode)
+                && access(cand, X_OK) == 0) {
+                return cand;
+            }
+        }
+        if (end == NULL) break;
+        path = end + 1;
+    }
+    return NULL;
+}
+#endif /*!GAUCHE_WINDOWS*/
+
+/* Environment block for CreateProcess (Windows only)
+ *   A sequence of NUL-terminated "NAME=VALUE" strings, terminated
+ *   by an extra NUL.
+ */
+#if defined(GAUCHE_WINDOWS)
+static LPVOID win_create_env_block(char **envp)
+{
+    int n = 0;
+    while (envp[n] != NULL) n++;
+    const TCHAR **ws = SCM_NEW_ARRAY(const TCHAR*, n);
+    size_t total = 1;
+    for (int i=0; i<n; i++) {
+        ws[i] = SCM_MBS2WCS(envp[i]);
+        total += _tcslen(ws[i]) + 1;
+    }
+    if (n == 0) total = 2;      /* empty block still needs two NULs */
+    TCHAR *block = SCM_NEW_ATOMIC_ARRAY(TCHAR, total);
+    TCHAR *p = block;
+    for (int i=0; i<n; i++) {
+        size_t len = _tcslen(ws[i]) + 1;
+        memcpy(p, ws[i], len * sizeof(TCHAR));
+        p += len;
+    }
+    *p++ = 0;
+    if (n == 0) *p = 0;
+    return block;
+}
+#endif /*GAUCHE_WINDOWS*/
+
+#if !defined(GAUCHE_WINDOWS) && defined(HAVE_VFORK)
+static int swap_fds(int *fds, int maxfd, const char **failed);
+static int sys_max_fd(void);
+
+#if defined(GAUCHE_USE_PTHREADS)
+#define SPAWN_SIGPROCMASK pthread_sigmask
+#else
+#define SPAWN_SIGPROCMASK sigprocmask
+#endif
+
+/* Report an error from the vfork()-ed child and exit, without touching
+   stdio or the heap.  MSGS is NULL-terminated; errno's description
+   follows them. */
+static void spawn_child_fail(const char **msgs)
+{
+    const char *e = strerror(errno);
+    for (; *msgs; msgs++) {
+        SCM_IGNORE_RESULT(write(2, *msgs, strlen(*msgs)));
+    }
+    SCM_IGNORE_RESULT(write(2, e, strlen(e)));
+    SCM_IGNORE_RESULT(write(2, "\n", 1));
+    _exit(1);
+}
+
+/* Fork and exec with vfork().
+ *   fork() has to copy the page table of the parent, so its cost grows
+ *   with the size of the heap; with a heap of several gigabytes each
+ *   run-process can stall for a noticeable time.  With vfork() the child
+ *   borrows the parent's memory until it execs, so the cost is constant.
+ *   Scm_SysExec doesn't run any Scheme code in the child, so we can use
+ *   it whenever we don't need to detach the child (which requires
+ *   the second fork).
+ *
+ *   The child shares the memory with the parent, so it must not allocate,
+ *   take locks, or touch stdio; it only makes system calls on the data
+ *   prepared by the parent.  All signals are blocked around vfork(), and
+ *   the child resets the handlers installed by the parent before
+ *   restoring the mask, so that no handler runs on the parent's memory.
+ *   The parent is suspended until the child execs or exits.
+ *   Returns the child's pid, or -1 with errno set if vfork() fails.
+ */
+static pid_t spawn_vfork(const char *program, char **argv, char **envp,
+                         int *fds, sigset_t *mask, const char *cdir)
+{
+    int maxfd = (fds != NULL)? sys_max_fd() : 0;
+    sigset_t all, omask;
+    sigfillset(&all);
+    SPAWN_SIGPROCMASK(SIG_SETMASK, &all, &omask);
+
+    pid_t pid = vfork();
+    if (pid == 0) {
+        for (int sig = 1; sig < NSIG; sig++) {
+            struct sigaction act;
+            if (sigaction(sig, NULL, &act) == 0
+                && act.sa_handler != SIG_DFL && act.sa_handler != SIG_IGN) {
+                act.sa_handler = SIG_DFL;
+                act.sa_flags = 0;
+                sigemptyset(&act.sa_mask);
+                sigaction(sig, &act, NULL);
+            }
+        }
+        if (cdir != NULL && chdir(cdir) < 0) {
+            const char *msgs[] = { "chdir to ", cdir,
+                                   " failed before executing ", program,
+                                   ": ", NULL };
+            spawn_child_fail(msgs);
+        }
+        const char *failed;
+        if (fds != NULL && swap_fds(fds, maxfd, &failed) < 0) {
+            const char *msgs[] = { failed, " failed: ", NULL };
+            spawn_child_fail(msgs);
+        }
+        if (mask) Scm_ResetSignalHandlers(mask);
+        SPAWN_SIGPROCMASK(SIG_SETMASK, (mask? mask : &omask), NULL);
+
+        if (envp != NULL) {
+            execve(program, (char *const*)argv, (char *const*)envp);
+        } else {
+            execvp(program, (char *const*)argv);
+        }
+        const char *msgs[] = { "exec failed: ", program, ": ", NULL };
+        spawn_child_fail(msgs);
+    }
+
+    int e = errno;
+    SPAWN_SIGPROCMASK(SIG_SETMASK, &omask, NULL);
+    errno = e;
+    return pid;
+}
+#endif /*!GAUCHE_WINDOWS && HAVE_VFORK*/
+
+/* Scm_SysExec, Scm_SysExecWithEnv
  *   execvp(), with optionally setting stdios correctly.
  *
  *   iomap argument, when provided, specifies how the open file descriptors
@@ -1665,11 +1876,19 @@ char *win_create_command_line(ScmObj args)
  *   or a port.   If a list is passed to iomap, any file descriptors other
  *   than specified in the list will be closed before exec().
  *
+ *   Scm_SysExecWithEnv takes an extra env argument, which is either #f,
+ *   in which case the executed process inherits the current environment,
+ *   or a list of strings of "NAME=VALUE" form, which becomes the entire
+ *   environment of the executed process.  The program is searched in
+ *   our PATH as execvp() does; if it can't be found, a system error
+ *   with ENOENT is raised before forking.
+ *
  *   If forkp arg is TRUE, this function forks before swapping file
  *   descriptors.  It is more reliable way to fork&exec in multi-threaded
  *   program.  In such a case, this function returns Scheme integer to
  *   show the children's pid.   If fork arg is FALSE, this procedure
- *   of course never returns.
+ *   of course never returns.  Unless we detach the child, we use vfork()
+ *   if available; see spawn_vfork() below.
  *
  *   On Windows port, this returns a process handle obejct instead of
  *   pid of the child process in fork mode.  We need to keep handle, or
@@ -1677,6 +1896,13 @@ char *win_create_command_line(ScmObj args)
  */
 ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
                    ScmSysSigset *mask, ScmString *dir, int flags)
+{
+    return Scm_SysExecWithEnv(file, args, iomap, mask, dir, SCM_FALSE, flags);
+}
+
+ScmObj Scm_SysExecWithEnv(ScmString *file, ScmObj args, ScmObj iomap,
+                          ScmSysSigset *mask, ScmString *dir, ScmObj env,
+                          int flags)
 {
     int argc = Scm_Length(args);
     pid_t pid = 0;
@@ -1694,6 +1920,15 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
     /* setting up iomap table */
     int *fds = Scm_SysPrepareFdMap(iomap);
 
+    /* environment of the new process */
+    char **envp = NULL;
+    if (!SCM_FALSEP(env)) {
+        if (Scm_Length(env) < 0) {
+            Scm_Error("list of strings or #f required for environment, but got %S", env);
+        }
+        envp = Scm_ListToCStringArray(env, TRUE, NULL);
+    }
+
     /*
      * From now on, we have totally different code for Unix and Windows.
      */
@@ -1703,10 +1938,27 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
      */
     const char *cdir = NULL;
     if (dir != NULL) cdir = Scm_GetStringConst(dir);
+    if (envp != NULL) {
+        const char *found = find_program(program, cdir);
+        if (found == NULL) {
+            errno = ENOENT;
+            Scm_SysError("exec failed: %s", program);
+        }
+        program = found;
+    }
+
+#if defined(HAVE_VFORK)
+    if (forkp && !detachp) {
+        pid = spawn_vfork(program, argv, envp, fds,
+                          (mask? &mask->set : NULL), cdir);
+        if (pid < 0) Scm_SysError("vfork failed");
+        return Scm_MakeInteger(pid);
+    }
+#endif /*HAVE_VFORK*/
 
     /* When requested, call fork() here. */
     if (forkp) {
-        SCM_SYSCALL(pid, fork());
+        SCM_SYSCALL(pid, Scm__ForkWith(NULL, NULL));
         if (pid < 0) Scm_SysError("fork failed");
     }
 
@@ -1715,7 +1967,7 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
         /* If we're running the daemon, we fork again to detach the parent,
            and also reset the session id. */
         if (detachp) {
-            SCM_SYSCALL(pid, fork());
+            SCM_SYSCALL(pid, Scm__ForkWith(NULL, NULL));
             if (pid < 0) Scm_SysError("fork failed");
             if (pid > 0) exit(0);   /* not Scm_Exit(), for we don't want to
                                        run the cleanup stuff. */
@@ -1735,7 +1987,11 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
             Scm_SysSigmask(SIG_SETMASK, mask);
         }
 
-        execvp(program, (char *const*)argv);
+        if (envp != NULL) {
+            execve(program, (char *const*)argv, (char *const*)envp);
+        } else {
+            execvp(program, (char *const*)argv);
+        }
         /* here, we failed */
         Scm_Panic("exec failed: %s: %s", program, strerror(errno));
     }
@@ -1790,6 +2046,14 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
         LPCTSTR curdir = NULL;
         if (cdir != NULL) curdir = SCM_MBS2WCS(cdir);
 
+        LPVOID envblock = NULL;
+        if (envp != NULL) {
+            envblock = win_create_env_block(envp);
+#if defined(UNICODE)
+            creation_flags |= CREATE_UNICODE_ENVIRONMENT;
+#endif /*UNICODE*/
+        }
+
         if (detachp) {
             creation_flags |= CREATE_NEW_PROCESS_GROUP;
         }
@@ -1800,7 +2064,7 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
                                NULL, /* thread addr */
                                TRUE, /* inherit handles */
                                creation_flags, /* creation flags */
-                               NULL, /* nenvironment */
+                               envblock, /* environment */
                                curdir, /* current dir */
                                &si,  /* startup info */
                                &pi); /* process info */
@@ -1827,9 +2091,18 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
         /* TODO: We should probably use Windows API to handle various
            options consistently with fork-and-exec case above. */
 #if defined(__MINGW64_VERSION_MAJOR)
-        execvp(program, (char *const*)argv);
+        if (envp != NULL) {
+            execvpe(program, (char *const*)argv, (char *const*)envp);
+        } else {
+            execvp(program, (char *const*)argv);
+        }
 #else  /* !defined(__MINGW64_VERSION_MAJOR) */
-        execvp(program, (const char *const*)argv);
+        if (envp != NULL) {
+            execvpe(program, (const char *const*)argv,
+                    (const char *const*)envp);
+        } else {
+            execvp(program, (const char *const*)argv);
+        }
 #endif /* !defined(__MINGW64_VERSION_MAJOR) */
         Scm_Panic("exec failed: %s: %s", program, strerror(errno));
     }
@@ -1907,23 +2180,29 @@ int *Scm_SysPrepareFdMap(ScmObj iomap)
     return fds;
 }
 
-void Scm_SysSwapFds(int *fds)
+static int sys_max_fd(void)
 {
-    if (fds == NULL) return;
-
-    int maxfd;
-    int nfds = fds[0];
-    int *tofd   = fds + 1;
-    int *fromfd = fds + 1 + nfds;
-
     /* TODO: use getdtablehi if available */
 #if !defined(GAUCHE_WINDOWS)
-    if ((maxfd = sysconf(_SC_OPEN_MAX)) < 0) {
+    int maxfd = sysconf(_SC_OPEN_MAX);
+    if (maxfd < 0) {
         Scm_Panic("failed to get OPEN_MAX value from sysconf");
     }
+    return maxfd;
 #else  /*GAUCHE_WINDOWS*/
-    maxfd = 256;        /* guess it and cross your finger */
+    return 256;         /* guess it and cross your finger */
 #endif /*GAUCHE_WINDOWS*/
+}
+
+/* The body of Scm_SysSwapFds.  It is also called in the vfork()-ed child
+   (see spawn_vfork()), so it only makes system calls.  Returns 0 on
+   success.  On failure, returns -1 with errno set, and the name of the
+   failed call in *failed. */
+static int swap_fds(int *fds, int maxfd, const char **failed)
+{
+    int nfds = fds[0];
+    int *tofd   = fds + 1;
+    int *fromfd = fds + 1 + nfds;
 
     /* Dup fromfd to the corresponding tofd.  We need to be careful
        not to override the destination fd if it will be used. */
@@ -1932,12 +2211,11 @@ void Scm_SysSwapFds(int *fds)
         for (int j=i+1; j<nfds; j++) {
             if (tofd[i] == fromfd[j]) {
                 int tmp = dup(tofd[i]);
-                if (tmp < 0) Scm_Panic("dup failed: %s", strerror(errno));
+                if (tmp < 0) { *failed = "dup"; return -1; }
                 fromfd[j] = tmp;
             }
         }
-        if (dup2(fromfd[i], tofd[i]) < 0)
-            Scm_Panic("dup2 failed: %s", strerror(errno));
+        if (dup2(fromfd[i], tofd[i]) < 0) { *failed = "dup2"; return -1; }
     }
 
     /* Close unused fds */
@@ -1946,6 +2224,17 @@ void Scm_SysSwapFds(int *fds)
         for (j=0; j<nfds; j++) if (fd == tofd[j]) break;
         if (j == nfds) close(fd);
     }
+    return 0;
+}
+
+void Scm_SysSwapFds(int *fds)
+{
+    if (fds == NULL) return;
+
+    const char *failed;
+    if (swap_fds(fds, sys_max_fd(), &failed) < 0) {
+        Scm_Panic("%s failed: %s", failed, strerror(errno));
+    }
 }
 
 #if defined(GAUCHE_WINDOWS)
@@ -2571,6 +2860,116 @@ int Scm_AvailableProcessors()
 #endif /*defined(GAUCHE_WINDOWS)*/
 }
 
+/*===============================================================
+ * Fork
+ *
+ *  With parallel marking, the GC marker threads don't exist in the
+ *  child, so the child's first collection would wait for them forever
+ *  unless GC knows about the fork.  We don't let GC install atfork
+ *  handlers, since they must not run in the children of vfork().
+ *  So every fork-family call, fork() or forkpty() etc., has to go
+ *  through this.  FORKFN does the fork and returns what fork() does;
+ *  if it is NULL, fork() is called.
+ */
+#if !defined(GAUCHE_WINDOWS)
+pid_t Scm__ForkWith(pid_t (*forkfn)(void*), void *data)
+{
+#if defined(GAUCHE_GC_PARALLEL_MARK)
+    GC_atfork_prepare();
+#endif
+    pid_t pid = forkfn? forkfn(data) : fork();
+#if defined(GAUCHE_GC_PARALLEL_MARK)
+    if (pid == 0) GC_atfork_child();
+    else GC_atfork_parent();
+#endif
+    return pid;
+}
+#endif /*!defined(GAUCHE_WINDOWS)*/
+
+/*===============================================================
+ * Parallel jobs
+ *
+ *  A simple fork-join used by the built-in operations that split
+ *  large data among threads (sort, bulk digest, parallel gzip).
+ *  The jobs run plain C code; they must not touch the VM.  The worker
+ *  threads are created through GC's pthread_create wrapper so that
+ *  the collector can stop them and scan their stacks.
+ */
+
+/* Returns the number of threads worth running, up to MAX.  Always 1
+   if we don't have threads. */
+int Scm__ParallelJobCount(int max)
+{
+#if defined(GAUCHE_USE_PTHREADS)
+    int nproc = Scm_AvailableProcessors();
+    if (nproc > max) nproc = max;
+    return (nproc < 1)? 1 : nproc;
+#else  /*!GAUCHE_USE_PTHREADS*/
+    return 1;
+#endif /*!GAUCHE_USE_PTHREADS*/
+}
+
+#if defined(GAUCHE_USE_PTHREADS)
+typedef struct parallel_job_rec {
+    void (*fn)(void*);
+    void *data;
+} parallel_job;
+
+static void *parallel_job_worker(void *data)
+{
+    parallel_job *j = (parallel_job*)data;
+    j->fn(j->data);
+    return NULL;
+}
+#endif /*GAUCHE_USE_PTHREADS*/
+
+#define PARALLEL_JOBS_STATIC 16
+
+/* Calls FN on each of NJOBS jobs, which is an array of elements of
+   STRIDE bytes, and returns when all of them are done.  The first job
+   is run in the calling thread; if we can't create a thread for
+   another job, it is run in the calling thread as well. */
+void Scm__RunParallelJobs(void (*fn)(void*), void *jobs, size_t stride,
+                          int njobs)
+{
+    char *p = (char*)jobs;
+#if defined(GAUCHE_USE_PTHREADS)
+    pthread_t thbuf[PARALLEL_JOBS_STATIC], *th = thbuf;
+    parallel_job jbuf[PARALLEL_JOBS_STATIC], *js = jbuf;
+    int cbuf[PARALLEL_JOBS_STATIC], *created = cbuf;
+    sigset_t set, oset;
+
+    if (njobs <= 1) {
+        if (njobs == 1) fn(p);
+        return;
+    }
+    if (njobs > PARALLEL_JOBS_STATIC) {
+        th = SCM_NEW_ATOMIC2(pthread_t*, sizeof(pthread_t)*njobs);
+        js = SCM_NEW_ATOMIC2(parallel_job*, sizeof(parallel_job)*njobs);
+        created = SCM_NEW_ATOMIC2(int*, sizeof(int)*njobs);
+    }
+
+    /* Signals should be handled by Scheme threads. */
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &oset);
+    for (int i=1; i<njobs; i++) {
+        js[i].fn = fn;
+        js[i].data = p + stride*i;
+        created[i] =
+            (pthread_create(&th[i], NULL, parallel_job_worker, &js[i]) == 0);
+    }
+    pthread_sigmask(SIG_SETMASK, &oset, NULL);
+
+    fn(p);
+    for (int i=1; i<njobs; i++) {
+        if (created[i]) pthread_join(th[i], NULL);
+        else fn(p + stride*i);
+    }
+#else  /*!GAUCHE_USE_PTHREADS*/
+    for (int i=0; i<njobs; i++) fn(p + stride*i);
+#endif /*!GAUCHE_USE_PTHREADS*/
+}
+
 /*===============================================================
  * Emulation layer for Windows
  */
@@ -44,6 +44,7 @@
 #include <ctype.h>
 
 static void write_walk(ScmObj obj, ScmPort *port);
+static void walk_table_clear(struct ScmWriteWalkTableRec *t);
 static void write_ss(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
 static void write_rec(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
 static void write_object(ScmObj obj, ScmPort *out, ScmWriteContext *ctx);
@@ -159,6 +160,7 @@ ScmWriteState *Scm_MakeWriteState(ScmWriteState *proto)
     z->sharedCounter = 0;
     z->currentLevel = 0;
     z->controls = NULL;
+    z->walkTable = NULL;
     return z;
 }
 
@@ -185,6 +187,10 @@ static void cleanup_port_write_state(ScmPort *port)
         if (s && s->sharedTable) {
             Scm_HashCoreClear(SCM_HASH_TABLE_CORE(s->sharedTable));
         }
+        if (s && s->walkTable) {
+            walk_table_clear(s->walkTable);
+            s->walkTable = NULL;
+        }
     }
 }
 
@@ -471,6 +477,13 @@ ScmObj Scm__WritePrimitive(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
         Scm_PutzUnsafe(buf, -1, port);
         return SCM_MAKE_INT(k);
     }
+    else if (SCM_TVREF_P(obj)) {
+        char buf[SPBUFSIZ];
+        int k = snprintf(buf, SPBUFSIZ, "#<tvar %" PRIdPTR ">",
+                         SCM_TVREF_INDEX(obj));
+        Scm_PutzUnsafe(buf, -1, port);
+        return SCM_MAKE_INT(k);
+    }
     return SCM_FALSE;
 }
 
@@ -497,10 +510,12 @@ ScmObj Scm__WritePrimitive(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
    NB: R7RS write-shared doesn't require datum labels on strings,
    but srfi-38 does.  We follow srfi-38.
 
-   NB: The walk pass is now written in Scheme (libio.scm: write-walk),
-   but the emit pass is in C (write_rec).  Using naive recursion in write_rec
-   can bust the C stack when deep structure is passed, even if it is
-   not circular.
+   The walk pass counts visits in its own table (see WalkTable below),
+   and only registers objects seen more than once to the hashtable,
+   which is what the emit pass (and pretty printer) looks at.
+
+   Using naive recursion in write_walk and write_rec can bust the C stack
+   when deep structure is passed, even if it is not circular.
    Thus we avoided recursion by managing traversal stack by our own
    ('stack' local variable).    It made the code ugly.  Oh well.
 
@@ -523,15 +538,227 @@ ScmObj Scm__WritePrimitive(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
  */
 
 /* pass 1 */
-/* Implemented in Scheme */
+
+/* WalkTable
+   An open-addressing table keyed by the address of objects, to record
+   how many times we've seen each object during the walk pass.  It is
+   kept in the write state, since the walk can be reentered through
+   write-object methods.
+
+   In write/ss mode, every visit to an already seen object counts.
+   Otherwise we only look for circular structure, so we count it only
+   if the object is still being walked (WALK_ACTIVE); once we've finished
+   walking an object (WALK_DONE) it can't be a part of a cycle found
+   later.
+*/
+typedef struct {
+    ScmObj key;                 /* NULL for empty entry */
+    int count;                  /* # of times we've seen the object */
+    int state;                  /* WALK_ACTIVE or WALK_DONE */
+} WalkEntry;
+
+enum {
+    WALK_ACTIVE,
+    WALK_DONE
+};
+
+typedef struct ScmWriteWalkTableRec {
+    WalkEntry *entries;
+    u_long size;                /* # of entries; power of 2 */
+    u_long numEntries;          /* # of used entries */
+} WalkTable;
+
+#define WALK_TABLE_INITIAL_SIZE  64
+
+#define WALK_HASH(obj, mask) \
+    (((u_long)(SCM_WORD(obj) >> 3) * 2654435761UL) & (mask))
+
+static WalkTable *make_walk_table(void)
+{
+    WalkTable *t = SCM_NEW(WalkTable);
+    t->size = WALK_TABLE_INITIAL_SIZE;
+    t->numEntries = 0;
+    t->entries = SCM_NEW_ARRAY(WalkEntry, t->size);
+    return t;
+}
+
+/* Like the shared table, we clear the entries when we're done, so that
+   a big table mistakenly retained by a false pointer won't keep the
+   objects alive. */
+static void walk_table_clear(WalkTable *t)
+{
+    memset(t->entries, 0, t->size * sizeof(WalkEntry));
+    t->numEntries = 0;
+}
+
+static void walk_table_grow(WalkTable *t)
+{
+    u_long newsize = t->size * 2, mask = newsize - 1;
+    WalkEntry *newentries = SCM_NEW_ARRAY(WalkEntry, newsize);
+    for (u_long i = 0; i < t->size; i++) {
+        ScmObj key = t->entries[i].key;
+        if (key == NULL) continue;
+        u_long j = WALK_HASH(key, mask);
+        while (newentries[j].key != NULL) j = (j+1) & mask;
+        newentries[j] = t->entries[i];
+    }
+    memset(t->entries, 0, t->size * sizeof(WalkEntry));
+    t->entries = newentries;
+    t->size = newsize;
+}
+
+/* Returns the entry of OBJ.  If OBJ isn't in the table, adds an entry
+   with zero count and sets *CREATED to TRUE.  The returned pointer is
+   valid until the next call of this function. */
+static WalkEntry *walk_table_search(WalkTable *t, ScmObj obj, int *created)
+{
+    if (t->numEntries * 2 >= t->size) walk_table_grow(t);
+    u_long mask = t->size - 1;
+    for (u_long i = WALK_HASH(obj, mask);; i = (i+1) & mask) {
+        WalkEntry *e = &t->entries[i];
+        if (e->key == NULL) {
+            e->key = obj;
+            e->count = 0;
+            e->state = WALK_ACTIVE;
+            t->numEntries++;
+            *created = TRUE;
+            return e;
+        }
+        if (SCM_EQ(e->key, obj)) {
+            *created = FALSE;
+            return e;
+        }
+    }
+}
+
+static void walk_table_finish(WalkTable *t, ScmObj obj)
+{
+    int created;
+    WalkEntry *e = walk_table_search(t, obj, &created);
+    SCM_ASSERT(!created);
+    e->state = WALK_DONE;
+}
+
+/* Returns FALSE if OBJ never gets a label. */
+static inline int walk_need_recurse(ScmObj obj)
+{
+    return !(!SCM_PTRP(obj)
+             || SCM_NUMBERP(obj)
+             || SCM_KEYWORDP(obj)
+             || (SCM_SYMBOLP(obj) && SCM_SYMBOL_INTERNED(obj))
+             || (SCM_STRINGP(obj) && SCM_STRING_SIZE(obj) == 0)
+             || (SCM_VECTORP(obj) && SCM_VECTOR_SIZE(obj) == 0));
+}
+
+/* Quick check to skip the walk pass.
+   If OBJ is a list/vector structure of limited depth and size without
+   circular cdr, and its leaves are objects that don't contain other
+   objects, it can't be circular.  In write/ss mode, we also have to
+   know no substructure appears twice, so we only accept a flat list
+   or vector of objects that never get a label.  BUDGET limits the number
+   of objects we look at; we give up and do the real walk when it
+   runs out. */
+#define WALK_SKIP_DEPTH   16
+#define WALK_SKIP_BUDGET  4096
+
+static int walk_unnecessary_p(ScmObj obj, int sharedp, int depth, int *budget)
+{
+    if (!walk_need_recurse(obj)) return TRUE;
+    if (--*budget < 0) return FALSE;
+    if (!sharedp && (SCM_SYMBOLP(obj) || SCM_STRINGP(obj))) return TRUE;
+    if (depth <= 0) return FALSE;
+    if (SCM_PAIRP(obj)) {
+        for (; SCM_PAIRP(obj); obj = SCM_CDR(obj)) {
+            if (--*budget < 0) return FALSE;
+            if (!walk_unnecessary_p(SCM_CAR(obj), sharedp, depth-1, budget))
+                return FALSE;
+        }
+        return walk_unnecessary_p(obj, sharedp, depth-1, budget);
+    }
+    if (SCM_VECTORP(obj)) {
+        ScmSmallInt len = SCM_VECTOR_SIZE(obj);
+        for (ScmSmallInt i = 0; i < len; i++) {
+            if (!walk_unnecessary_p(SCM_VECTOR_ELEMENT(obj, i),
+                                    sharedp, depth-1, budget))
+                return FALSE;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Walk pass main body.  Pairs and vectors are traversed with our own
+   stack; other objects are walked by write-object, which may call
+   back write_walk via Scm_Write. */
+typedef struct {
+    ScmObj obj;                 /* pair or vector */
+    ScmSmallInt index;          /* next element to visit */
+} WalkFrame;
+
+#define WALK_STACK_INITIAL_SIZE  64
+
 static void write_walk(ScmObj obj, ScmPort *port)
 {
-    static ScmObj proc = SCM_UNDEFINED;
-    SCM_ASSERT(port->writeState);
-    ScmHashTable *ht = port->writeState->sharedTable;
+    ScmWriteState *s = port->writeState;
+    SCM_ASSERT(s);
+    ScmHashTable *ht = s->sharedTable;
     SCM_ASSERT(ht != NULL);
-    SCM_BIND_PROC(proc, "%write-walk-rec", Scm_GaucheInternalModule());
-    Scm_ApplyRec3(proc, obj, SCM_OBJ(port), SCM_OBJ(ht));
+    if (s->walkTable == NULL) s->walkTable = make_walk_table();
+    WalkTable *t = s->walkTable;
+    int sharedp = (port->flags & SCM_PORT_WRITESS);
+
+    WalkFrame stack0[WALK_STACK_INITIAL_SIZE], *stack = stack0;
+    ScmSmallInt sp = 0, stack_size = WALK_STACK_INITIAL_SIZE;
+
+    for (;;) {
+        if (walk_need_recurse(obj)) {
+            int created;
+            WalkEntry *e = walk_table_search(t, obj, &created);
+            if (!created) {
+                if (sharedp || e->state == WALK_ACTIVE) {
+                    if (++e->count == 2) {
+                        Scm_HashTableSet(ht, obj, SCM_MAKE_INT(2), 0);
+                    }
+                }
+            } else {
+                e->count = 1;
+                if (SCM_PAIRP(obj) || SCM_VECTORP(obj)) {
+                    if (sp == stack_size) {
+                        WalkFrame *newstack = SCM_NEW_ARRAY(WalkFrame,
+                                                            stack_size*2);
+                        memcpy(newstack, stack, sp * sizeof(WalkFrame));
+                        stack = newstack;
+                        stack_size *= 2;
+                    }
+                    stack[sp].obj = obj;
+                    stack[sp].index = 0;
+                    sp++;
+                } else if (SCM_SYMBOLP(obj) || SCM_STRINGP(obj)) {
+                    e->state = WALK_DONE; /* uninterned symbol or string */
+                } else {
+                    write_object(obj, port, NULL);
+                    if (!sharedp) walk_table_finish(t, obj);
+                }
+            }
+        }
+
+        /* pick the next object to visit */
+        for (;;) {
+            if (sp == 0) return;
+            WalkFrame *f = &stack[sp-1];
+            if (SCM_PAIRP(f->obj)) {
+                if (f->index < 2) {
+                    obj = (f->index++ == 0)? SCM_CAR(f->obj) : SCM_CDR(f->obj);
+                    break;
+                }
+            } else if (f->index < SCM_VECTOR_SIZE(f->obj)) {
+                obj = SCM_VECTOR_ELEMENT(f->obj, f->index++);
+                break;
+            }
+            if (!sharedp) walk_table_finish(t, f->obj);
+            sp--;
+        }
+    }
 }
 
 /* pass 2 */
@@ -780,7 +1007,12 @@ static void write_ss(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
     s->controls = ctx->controls;
     port->writeState = s;
 
-    write_walk(obj, port);
+    int sharedp = (SCM_WRITE_MODE(ctx)==SCM_WRITE_SHARED);
+    int budget = WALK_SKIP_BUDGET;
+    if (!walk_unnecessary_p(obj, sharedp, sharedp? 1 : WALK_SKIP_DEPTH,
+                            &budget)) {
+        write_walk(obj, port);
+    }
     port->flags &= ~(SCM_PORT_WALKING|SCM_PORT_WRITESS);
 
     /* pass 2 */
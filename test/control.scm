@@ -67,6 +67,39 @@
   ]
  [else])
 
+;;--------------------------------------------------------------------
+;; control.future
+;;
+
+(cond-expand
+ [gauche.sys.threads
+  (test-section "control.future")
+  (use control.future)
+  (test-module 'control.future)
+
+  (test* "future" '(1 2)
+         (let1 f (future (values 1 2))
+           (receive vals (future-get f) vals)))
+  (test* "future-get twice" '(3 3)
+         (let1 f (make-future (^[] (+ 1 2)))
+           (list (future-get f) (future-get f))))
+  (test* "future-get timeout" 'none
+         (let* ([gate (make-mtqueue :max-length 0)]
+                [f (future (dequeue/wait! gate))])
+           (begin0 (future-get f 0.01 'none)
+                   (enqueue/wait! gate #t))))
+  (test* "future-done?" '(#f #t)
+         (let* ([gate (make-mtqueue :max-length 0)]
+                [f (future (dequeue/wait! gate))]
+                [d0 (future-done? f)])
+           (enqueue/wait! gate #t)
+           (future-get f)
+           (list d0 (future-done? f))))
+  (test* "future error" (test-error <error> "bang")
+         (future-get (future (error "bang"))))
+  ]
+ [else])
+
 ;;--------------------------------------------------------------------
 ;; control.thread-pool
 ;;
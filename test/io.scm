@@ -809,6 +809,36 @@
 ;; regression check for format/ss
 (test* "format/ss" "z  " (format/ss "~v,a" 3 'z))
 
+;; format with literal format string is expanded at compile time;
+;; make sure it agrees with the runtime version.
+(let ([fmt "a~a b~s c~d ~b ~o ~x ~X~%"]
+      [args '(1 "x" 10 5 8 255 255)])
+  (test* "format (inlined)" (apply format fmt args)
+         (format "a~a b~s c~d ~b ~o ~x ~X~%" 1 "x" 10 5 8 255 255))
+  (test* "format (inlined)" (apply format fmt args)
+         (format #f "a~a b~s c~d ~b ~o ~x ~X~%" 1 "x" 10 5 8 255 255))
+  (test* "format (inlined)" (apply format fmt args)
+         (with-output-to-string
+           (^[] (format #t "a~a b~s c~d ~b ~o ~x ~X~%"
+                        1 "x" 10 5 8 255 255)))))
+(test* "format (inlined, non-exact ~d)" "1.5 abc"
+       (format "~d ~d" 1.5 'abc))
+(test* "format (inlined, argument evaluation)" "x[1]"
+       (with-output-to-string
+         (^[] (format #t "[~a]" (begin (display "x") 1)))))
+(test* "format (inlined, too few args)" (test-error)
+       (format "~a ~a" 1))
+(test* "format (inlined, too many args)" (test-error)
+       (format "~a" 1 2))
+(test* "format (inlined, invalid directive)" (test-error)
+       (format "~q" 1))
+
+(test* "format (cache, mutable string)" '("1" "\"x\"")
+       (let* ([s (string-copy "~a")]
+              [r (format s 1)])
+         (string-set! s 1 #\s)
+         (list r (format s "x"))))
+
 ;;-------------------------------------------------------------------
 (test-section "some corner cases in list reader")
 
@@ -823,6 +853,47 @@
 (dot-reader-tester "((). .)"  (test-error <read-error>))
 
 
+;;-------------------------------------------------------------------
+(test-section "reading tokens across buffer boundary")
+
+;; The reader scans the port buffer directly; make sure tokens that
+;; straddle buffer refills, and line counts, come out right.
+(let1 data (list-tabulate 5000
+                          (^i (list (string->symbol (format "sym-~a" i))
+                                    (* i 12345678901)
+                                    (format "str\\~a\n\"~a\"" i (make-string (modulo i 37) #\x))
+                                    (/ i 7)
+                                    'a.b:c)))
+  (with-output-to-file "tmp1.o"
+    (^[] (for-each (^x (write x) (newline)) data)))
+  (test* "read data file" data
+         (call-with-input-file "tmp1.o"
+           (^p (let loop ([r '()])
+                 (let1 x (read p)
+                   (if (eof-object? x) (reverse r) (loop (cons x r))))))))
+  (test* "read data file (line count)" (+ (length data) 1)
+         (call-with-input-file "tmp1.o"
+           (^p (let loop ()
+                 (if (eof-object? (read p))
+                   (port-current-line p)
+                   (loop))))))
+  (test* "read data file (token at eof)" '(foo "bar" 123 baz)
+         (begin
+           (with-output-to-file "tmp1.o"
+             (^[] (display (make-string 10000 #\space))
+                  (display "foo \"bar\" 123 baz")))
+           (call-with-input-file "tmp1.o" port->sexp-list)))
+  (sys-unlink "tmp1.o"))
+
+(test* "read word and delimiter" '(abc "d\ne" (f . g) h)
+       (read-from-string "(abc\"d\\ne\"(f . g)h)"))
+(test* "read word with fold-case" '(abc |X| def)
+       (read-from-string "#!fold-case (ABC |X| dEf)"))
+(test* "read line count" 4
+       (let1 p (open-input-string "(a\n\"b\nc\"\n d)  ")
+         (read p)
+         (port-current-line p)))
+
 ;;-------------------------------------------------------------------
 (test-section "nested multi-line comments")
 
@@ -156,6 +156,22 @@
 
 (test* "circular list involving abbrev syntax" "#0=((quote . #0#))"
        (write-to-string (cdr #0='#0#) write/ss))
+(test* "abbrev syntax without sharing" "(1 'a #0=(b) #0#)"
+       (let1 x (list 'b)
+         (write-to-string (list 1 ''a x x) write/ss)))
+
+(test* "large shared structure"
+       (string-append "#(#0=(a . #0#)"
+                      (string-join (make-list 9999 "#0#") " " 'prefix)
+                      ")")
+       (let* ([x (list 'a)]
+              [v (make-vector 10000 x)])
+         (set-cdr! x x)
+         (write-to-string v write/ss)))
+(test* "large shared structure (circular only)"
+       (string-append "(" (string-join (make-list 10000 "(a b)") " ") ")")
+       (let1 x (list 'a 'b)
+         (write-to-string (make-list 10000 x))))
 
 (define-class <foo> ()
   ((a :init-keyword :a)
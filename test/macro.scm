@@ -510,6 +510,50 @@
 (test "qq1" '()  (lambda () (qq1 '())))
 (test "qq2" '#() (lambda () (qq2 '())))
 
+;; rules are selected by the number of elements, but a dotted or
+;; circular call must still go through the matcher.
+(define-syntax nargs (syntax-rules ()
+                       ((_) 0)
+                       ((_ a) 1)
+                       ((_ a b c ... d e) (+ 4 (length '(c ...))))
+                       ((_ a . b) dotted)))
+(test-macro "nargs" 0 (nargs))
+(test-macro "nargs" 1 (nargs x))
+(test-macro "nargs" dotted (nargs x y))
+(test-macro "nargs" (+ 4 (length '())) (nargs w x y z))
+(test-macro "nargs" (+ 4 (length '(1 2))) (nargs w x 1 2 y z))
+(test-macro "nargs" dotted (nargs x . y))
+(test-macro "nargs" dotted (nargs w x y z . 0))
+
+;; the same free identifier in a template is renamed to the same
+;; identifier within one expansion, and the expander must cope with
+;; more pattern variables and template identifiers than fit in its
+;; preallocated buffers.
+(define-syntax hygiene2 (syntax-rules ()
+                          ((_ e) (let ((tmp e)) (let ((tmp (* tmp 2))) tmp)))))
+(test "hygiene2" 6 (lambda () (let ((tmp 100)) (hygiene2 3))))
+(test "hygiene2" 200 (lambda () (let ((tmp 100)) (hygiene2 tmp))))
+
+(define-syntax many-vars
+  (syntax-rules ()
+    ((_ a0 a1 a2 a3 a4 a5 a6 a7 a8 a9 b0 b1 b2 b3 b4 b5 b6 b7 b8 b9
+        c0 c1 c2 c3 c4 c5 c6 c7 c8 c9 d0 d1 d2 d3 d4 d5 d6 d7 d8 d9)
+     (let* ((x0 a0) (x1 a1) (x2 a2) (x3 a3) (x4 a4)
+            (x5 a5) (x6 a6) (x7 a7) (x8 a8) (x9 a9)
+            (y0 b0) (y1 b1) (y2 b2) (y3 b3) (y4 b4)
+            (y5 b5) (y6 b6) (y7 b7) (y8 b8) (y9 b9)
+            (z0 c0) (z1 c1) (z2 c2) (z3 c3) (z4 c4)
+            (z5 c5) (z6 c6) (z7 c7) (z8 c8) (z9 c9)
+            (w0 d0) (w1 d1) (w2 d2) (w3 d3) (w4 d4)
+            (w5 d5) (w6 d6) (w7 d7) (w8 d8) (w9 d9))
+       (list x0 x9 y0 y9 z0 z9 w0 w9)))))
+(test "many-vars" '(0 9 10 19 20 29 a 39)
+      (lambda ()
+        (let ((x0 'a) (w9 'b))
+          (many-vars 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19
+                     20 21 22 23 24 25 26 27 28 29
+                     x0 31 32 33 34 35 36 37 38 (+ 30 9)))))
+
 ;; R7RS style alternative ellipsis
 (test-section "alternative ellipsis")
 
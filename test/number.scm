@@ -491,6 +491,18 @@
         "-340282366920938463463374607431768211457")
       (i-tester2 (exp2 127)))
 
+;; Large numbers are converted by divide-and-conquer.
+(test* "10^5000" (string-append "1" (make-string 5000 #\0))
+       (number->string (expt 10 5000)))
+(test* "-(10^5000-1)" (string-append "-" (make-string 5000 #\9))
+       (number->string (- 1 (expt 10 5000))))
+(test* "read 10^5000-1" (- (expt 10 5000) 1)
+       (string->number (make-string 5000 #\9)))
+(let1 n (+ (expt 3 30000) (expt 10 7000))
+  (dolist [radix '(2 7 10 16 36)]
+    (test* (format "round trip (radix ~a)" radix) n
+           (string->number (number->string n radix) radix))))
+
 ;;------------------------------------------------------------------
 (test-section "number->string customization")
 
@@ -1328,6 +1340,21 @@
            173462447179147555430258970864309778377421844723664084649347019061363579192879108857591038330408837177983810868451546421940712978306134189864280826014542758708589243873685563973118948869399158545506611147420216132557017260564139394366945793220968665108959685482705388072645828554151936401912464931182546092879815733057795573358504982279280090942872567591518912118622751714319229788100979251036035496917279912663527358783236647193154777091427745377038294584918917590325110939381322486044298573971650711059244462177542540706913047034664643603491382441723306598834177
            ))
 
+;; Large operands to go through Karatsuba and Toom-3.  The expected
+;; values are computed by shifts and additions.
+(let ()
+  (define (m1 n) (- (ash 1 n) 1))
+  (define (p1 n) (+ (ash 1 n) 1))
+  (dolist [n '(3000 10000 100000 300000)]
+    (test* (format "(2^~a-1)(2^~a+1)" n n) (m1 (* n 2))
+           (* (m1 n) (p1 n)))
+    (test* (format "(2^~a-1)(2^~a-1)" n n)
+           (+ (- (ash 1 (* n 2)) (ash 1 (+ n 1))) 1)
+           (* (m1 n) (m1 n)))
+    (test* (format "(2^~a-1)(2^~a+1) unbalanced" (* n 3) n)
+           (- (+ (ash 1 (* n 4)) (ash 1 (* n 3))) (ash 1 n) 1)
+           (* (m1 (* n 3)) (p1 n)))))
+
 ;;------------------------------------------------------------------
 (test-section "multiplication short cuts")
 
@@ -1665,6 +1692,21 @@
   (do-exactness 7 9)
   )
 
+;; Large operands to go through Burnikel-Ziegler division.
+(let ()
+  (define a (- (expt 7 40000) (expt 3 20000)))
+  (define b (+ (expt 5 30000) 12345))
+  (define r (- b (expt 11 1000)))
+  (test* "quotient&remainder (large)" (list a r)
+         (receive (q r) (quotient&remainder (+ (* a b) r) b) (list q r)))
+  (test* "quotient&remainder (large, negative)" (list (- a) (- r))
+         (receive (q r) (quotient&remainder (- (+ (* a b) r)) b) (list q r)))
+  (test* "quotient&remainder (2^2n-1)/(2^n-1)" (list (+ (ash 1 100000) 1) 0)
+         (receive (q r) (quotient&remainder (- (ash 1 200000) 1)
+                                            (- (ash 1 100000) 1))
+           (list q r)))
+  )
+
 ;;------------------------------------------------------------------
 (test-section "div and mod")
 
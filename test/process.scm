@@ -546,6 +546,28 @@
 
 (rmrf "test2.o")
 
+(test* "process-output->string (environment)" "hello"
+       (process-output->string
+        '("./gosh" "-ftest" "-e(display (sys-getenv \"GAUCHE_ENV_TEST\"))"
+          "-Eexit")
+        :environment (cons "GAUCHE_ENV_TEST=hello"
+                           (remove #/^GAUCHE_ENV_TEST=/ (sys-environ)))))
+
+(cond-expand
+ [gauche.os.windows]
+ [else
+  (test* "run-process nonexistent command" 1
+         (let1 p (run-process '("./no-such-command.o") :error *nulldev*
+                              :wait #t)
+           (sys-wait-exit-status (process-exit-status p))))
+  (test* "run-process nonexistent command (environment)"
+         (test-error <system-error>)
+         (run-process '("no-such-command.o") :environment (sys-environ)))
+  (test* "run-process many times" #t
+         (every (^_ (let1 p (run-process '("true") :wait #t)
+                      (zero? (process-exit-status p))))
+                (iota 50)))])
+
 (rmrf "testc.o")
 
 (let ()
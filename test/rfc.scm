@@ -5,6 +5,7 @@
 (use gauche.test)
 (use gauche.sequence)
 (use gauche.process)
+(use gauche.uvector)
 (use util.match)
 (use srfi-19)
 (test-start "rfc")
@@ -80,6 +81,53 @@
 (test* "url-safe encode" "YTA-YTA_" (base64-encode-string "a0>a0?" :url-safe #t))
 (test* "url-safe decode" "a0>a0?" (base64-decode-string "YTA-YTA_" :url-safe #t))
 
+(test* "encode bytevector" "AAECAw==" (base64-encode-bytevector '#u8(0 1 2 3)))
+(test* "encode bytevector" "+/8=" (base64-encode-bytevector '#u8(251 255)))
+(test* "encode bytevector" "-_8=" (base64-encode-bytevector '#u8(251 255)
+                                                           :url-safe #t))
+(test* "decode bytevector" '#u8(0 1 2 3) (base64-decode-bytevector "AAECAw=="))
+(test* "decode bytevector" '#u8(251 255) (base64-decode-bytevector "+/8="))
+(test* "decode bytevector" '#u8(251 255)
+       (base64-decode-bytevector "-_8=" :url-safe #t))
+(when (eq? (gauche-character-encoding) 'utf-8)
+  (test* "decode (incomplete result)" #t
+         (string-incomplete? (base64-decode-string "+/8="))))
+
+;; Exercise chunk boundaries of the native codec
+(let* ([data (with-output-to-string
+               (^[] (dotimes [i 20000] (write-byte (modulo (* i 7) 256)))))]
+       [enc (base64-encode-string data)]
+       [enc-nobreak (base64-encode-string data :line-width #f)])
+  (test* "encode long (line width)" #t
+         (every (^l (<= (string-length l) 76))
+                (string-split enc #\newline)))
+  (test* "encode long (port)" enc
+         (with-input-from-string data
+           (cut with-output-to-string base64-encode)))
+  (test* "decode long" data (base64-decode-string enc)
+         (^[a b] (equal? (string->u8vector a) (string->u8vector b))))
+  (test* "decode long (port)" data
+         (with-input-from-string enc-nobreak
+           (cut with-output-to-string base64-decode))
+         (^[a b] (equal? (string->u8vector a) (string->u8vector b))))
+  (test* "decode long (stops at termination)" "a"
+         (base64-decode-string (string-append "YQ==" enc)))
+  (test* "decode long (port, leaves the rest)" (list data "rest")
+         (with-input-from-string (string-append enc "rest")
+           (^[] (let1 r (with-output-to-string base64-decode)
+                  (list r (read-line)))))
+         (^[a b] (and (equal? (string->u8vector (car a))
+                              (string->u8vector (car b)))
+                      (equal? (cadr a) (cadr b))))))
+
+(test* "decode (port, leaves the rest)" '("a" "rest" "a0" "rest")
+       (with-input-from-string "YQ==rest\nYTA=rest"
+         (^[] (let* ([a (with-output-to-string base64-decode)]
+                     [b (read-line)]
+                     [c (with-output-to-string base64-decode)]
+                     [d (read-line)])
+                (list a b c d)))))
+
 ;;--------------------------------------------------------------------
 (test-section "rfc.quoted-printable")
 (use rfc.quoted-printable)
@@ -128,6 +176,27 @@
 (test* "decode (robustness)"
        "foo=1qr =  j\r\n"
        (quoted-printable-decode-string "foo=1qr =  j\r\n="))
+(test* "decode (lowercase hex)" '#u8(97 255 98)
+       (string->u8vector (quoted-printable-decode-string "a=ffb")))
+(test* "encode (port)" "abc=3D\r\ndef"
+       (with-input-from-string "abc=\ndef"
+         (cut with-output-to-string quoted-printable-encode)))
+(test* "decode (port)" "abc=\r\ndef"
+       (with-input-from-string "abc=3D\r\nd=\r\nef"
+         (cut with-output-to-string quoted-printable-decode)))
+
+;; Escape sequences and CRLF across the chunk boundaries of the port codec
+(dolist [n '(4093 4094 4095 4096)]
+  (let ([enc (string-append (make-string n #\a) "=3D=\r\nb= \r\nc")]
+        [dec (string-append (make-string n #\a) "\r\nb=")])
+    (test* #"decode (port, ~n)" (quoted-printable-decode-string enc)
+           (with-input-from-string enc
+             (cut with-output-to-string quoted-printable-decode)))
+    (test* #"encode (port, ~n)"
+           (quoted-printable-encode-string dec :line-width #f)
+           (with-input-from-string dec
+             (cut with-output-to-string
+               (cut quoted-printable-encode :line-width #f))))))
 
 
 ;;--------------------------------------------------------------------
@@ -241,8 +310,8 @@
                     0))
 
 ;;--------------------------------------------------------------------
-;; NB: rfc.json test is moved to under ext/peg, since it totally
-;; depends on parser.peg.
+;; NB: rfc.json test is moved to under ext/rfc, since it is
+;; precompiled.
 
 ;;--------------------------------------------------------------------
 ;; NB: rfc.mime test is in ext/mime
@@ -770,4 +839,220 @@
 
 (sys-waitpid -1)
 
+;;-------------------------------------------------------------------
+(test-section "rfc.http-server")
+(use rfc.http-server)
+(test-module 'rfc.http-server)
+(use rfc.http-parser)
+(use gauche.net)
+(use srfi-13)
+(use control.future)
+
+(define *httpd*
+  '(
+    (use rfc.http-server)
+    (use gauche.uvector)
+
+    (define (handler req)
+      (let1 path (http-request-path req)
+        (cond
+         [(equal? path "/echo")
+          (values 200 '(("content-type" "text/plain"))
+                  (write-to-string
+                   (list (http-request-method req)
+                         (http-request-target req)
+                         (http-request-version req)
+                         (http-request-query req)
+                         (http-request-header-ref req "x-test")
+                         (and-let* ([b (http-request-body req)])
+                           (u8vector->string b)))))]
+         [(equal? path "/stream")
+          (values 200 '() (^[out] (dotimes [i 3] (display "abc" out))))]
+         [(equal? path "/error") (error "boom")]
+         [(equal? path "/stop")
+          (http-server-stop! *server*)
+          (values 200 '() "bye")]
+         [else (values 404 '() "not found")])))
+
+    (define *server* #f)
+
+    (define (main args)
+      (let1 s (make-http-server handler
+                                :port 0 :model (string->symbol (cadr args))
+                                :max-line-size 1024
+                                :error-handler (^e #f))
+        (set! *server* s)
+        (print (http-server-port s)) (flush) ; handshake
+        (http-server-run! s)
+        0))
+    ))
+
+(with-output-to-file "testhttpd.o" (^[] (for-each write *httpd*)))
+
+(define (read-http-response in)
+  (receive (version status reason headers) (http-read-response-head in)
+    (define (read-bytes n)
+      (u8vector->string (read-uvector <u8vector> n in)))
+    (let1 body (cond
+                [(rfc822-header-ref headers "content-length")
+                 => (^n (read-bytes (string->number n)))]
+                [(rfc822-header-ref headers "transfer-encoding")
+                 (let loop ([chunks '()])
+                   (let1 n (string->number (read-line in) 16)
+                     (if (zero? n)
+                       (begin (read-line in)
+                              (string-concatenate-reverse chunks))
+                       (let1 c (read-bytes n)
+                         (read-line in)
+                         (loop (cons c chunks))))))]
+                [else (port->string in)])
+      (list status (rfc822-header-ref headers "connection") body))))
+
+(define (http-exchange port-num . requests)
+  (call-with-client-socket (make-client-socket 'inet "localhost" port-num)
+    (^[in out]
+      (for-each (cut display <> out) requests)
+      (flush out)
+      (map (^_ (read-http-response in)) requests))))
+
+(define (run-httpd-tests model)
+  (let* ([p (run-process `("./gosh" "-ftest" "./testhttpd.o" ,model)
+                         :output :pipe)]
+         [port-num (string->number (read-line (process-output p)))])
+    (define (echo . args) (write-to-string args))
+
+    (test* #"keep-alive and pipelining (~model)"
+           `((200 #f ,(echo "GET" "/echo?a=b" "HTTP/1.1" "a=b" "1" #f))
+             (200 #f ,(echo "POST" "/echo" "HTTP/1.1" #f #f "hello"))
+             (200 "close" ,(echo "GET" "/echo" "HTTP/1.1" #f "3" #f)))
+           (http-exchange port-num
+                          "GET /echo?a=b HTTP/1.1\r\nHost: x\r\nX-Test: 1\r\n\r\n"
+                          "POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+                          "GET /echo HTTP/1.1\r\nX-Test: 3\r\nConnection: close\r\n\r\n"))
+
+    (test* #"chunked request (~model)"
+           `((200 #f ,(echo "POST" "/echo" "HTTP/1.1" #f #f "hello, world")))
+           (http-exchange port-num
+                          "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n\
+                           5\r\nhello\r\n7;x=y\r\n, world\r\n0\r\n\r\n"))
+
+    (test* #"chunked request, too long lines (~model)"
+           '((400 "close" "") (431 "close" ""))
+           (list (car (http-exchange
+                       port-num
+                       #"POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n\
+                         5;~(make-string 2000 #\x)\r\nhello\r\n0\r\n\r\n"))
+                 (car (http-exchange
+                       port-num
+                       #"POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n\
+                         5\r\nhello\r\n0\r\nX: ~(make-string 2000 #\x)\r\n\r\n"))))
+
+    (test* #"chunked response (~model)"
+           '((200 #f "abcabcabc") (404 #f "not found"))
+           (http-exchange port-num
+                          "GET /stream HTTP/1.1\r\n\r\n"
+                          "GET /nothing HTTP/1.1\r\n\r\n"))
+
+    (test* #"HTTP/1.0 (~model)"
+           `((200 "keep-alive" ,(echo "GET" "/echo" "HTTP/1.0" #f #f #f))
+             (200 "close" "abcabcabc"))
+           (http-exchange port-num
+                          "GET /echo HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"
+                          "GET /stream HTTP/1.0\r\n\r\n"))
+
+    (test* #"errors (~model)"
+           '((500 #f "") (400 "close" ""))
+           (http-exchange port-num
+                          "GET /error HTTP/1.1\r\n\r\n"
+                          "GET /bad request HTTP/1.1\r\n\r\n"))
+
+    (test* #"http-request client (~model)" "200"
+           (values-ref (http-request 'GET #"localhost:~port-num" "/echo") 0))
+
+    (let1 pool (make-http-connection-pool)
+      (define (idle-sockets)
+        (map car (append-map cdr (hash-table->alist (~ pool'table)))))
+      (parameterize ([http-connection-pool pool])
+        (test* #"connection pool (~model)" '("200" 1 "200" #t)
+               (let* ([c1 (values-ref (http-get #"localhost:~port-num" "/echo")
+                                      0)]
+                      [s1 (idle-sockets)]
+                      [c2 (values-ref (http-get #"localhost:~port-num" "/echo")
+                                      0)])
+                 (list c1 (length s1) c2 (equal? s1 (idle-sockets)))))
+        (test* #"connection pool, closed by server (~model)"
+               (list "200" '())
+               (list (values-ref (http-get #"localhost:~port-num" "/echo"
+                                           :connection "close")
+                                 0)
+                     (idle-sockets)))
+        (cond-expand
+         [gauche.sys.threads
+          (test* #"http-request-async (~model)"
+                 '(("200" "abcabcabc") ("404" "not found") ("200" "abcabcabc"))
+                 (map (^f (receive (code hdrs body) (future-get f)
+                            (list code body)))
+                      (map (^p (http-request-async 'GET #"localhost:~port-num" p))
+                           '("/stream" "/nothing" "/stream"))))]
+         [else]))
+      (http-connection-pool-clear! pool)
+      (test* #"connection pool cleared (~model)" '() (idle-sockets)))
+
+    (test* #"stop (~model)" '(200 "close" "bye")
+           (car (http-exchange port-num "GET /stop HTTP/1.1\r\n\r\n")))
+
+    (test* #"server exits (~model)" 0
+           (begin (process-wait p) (process-exit-status p)))))
+
+(cond-expand
+ [gauche.sys.threads
+  (run-httpd-tests "thread")
+  (run-httpd-tests "pool")]
+ [else])
+(run-httpd-tests "event-loop")
+
+;; A server that reads the second request on each connection and closes
+;; it without replying, as if it had timed out the idle connection just
+;; then.  The client should retry a GET, but not a POST.
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (let* ([ss (make-server-socket 'inet 0 :reuse-addr? #t)]
+         [port-num (sockaddr-port (socket-address ss))]
+         [received 0])
+    (define (read-request in)
+      (let loop ([len 0])
+        (let1 line (read-line in)
+          (cond [(eof-object? line)]
+                [(equal? line "") (read-block len in) (inc! received)]
+                [(#/^content-length:\s*(\d+)/i line)
+                 => (^m (loop (x->integer (m 1))))]
+                [else (loop len)]))))
+    (define (serve)
+      (let1 s (socket-accept ss)
+        (let ([in (socket-input-port s)]
+              [out (socket-output-port s)])
+          (read-request in)
+          (display "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok" out)
+          (flush out)
+          (read-request in)
+          (socket-close s)))
+      (serve))
+    (let ([th (thread-start! (make-thread serve))]
+          [pool (make-http-connection-pool)])
+      (parameterize ([http-connection-pool pool])
+        (test* "retry GET on a stale connection" '("200" "200" 3)
+               (let* ([c1 (values-ref (http-get #"localhost:~port-num" "/") 0)]
+                      [c2 (values-ref (http-get #"localhost:~port-num" "/") 0)])
+                 (list c1 c2 received)))
+        (test* "don't retry POST on a stale connection" '(#t 4)
+               (list (guard (e [(<error> e) #t])
+                       (http-post #"localhost:~port-num" "/" "data")
+                       #f)
+                     received)))
+      (http-connection-pool-clear! pool)
+      (thread-terminate! th)
+      (socket-close ss)))]
+ [else])
+
 (test-end)
@@ -4,6 +4,9 @@
 
 (use gauche.serializer)
 (use gauche.serializer.aserializer)
+(use gauche.serializer.bserializer)
+(use gauche.record)
+(use gauche.uvector)
 (use gauche.test)
 
 (test-start "serializer")
@@ -173,6 +176,143 @@
          (lambda () (sys-remove "test.s"))
          )))
 
+;;----------------------------------------------------------------------
+(test-section "bserializer")
+
+(define *binary-primitives*
+  `(1 -1 0 127 128 -129 ,(greatest-fixnum) ,(least-fixnum)
+    12345678901234567890123 -98765432109876543210   ; bignum
+    3.14178 -0.0 5.0e33 +inf.0 1/3 -7/22 1.5+2.5i    ; other numbers
+    #f #t () #\null #\A #\x3bb
+    "string" "" "\u03bb\u03bc" x |odd sym| :key-word
+    (1 2 . 3) #(a b c) #() #u8(0 255) #s32(-1 2) #f64(1.5 -2.25)))
+
+(define (binary-round-trip obj)
+  (receive (r pos) (deserialize (serialize obj))
+    r))
+
+(test* "primitives" *binary-primitives*
+       (binary-round-trip *binary-primitives*))
+
+(test* "primitives (port)" *binary-primitives*
+       (read-from-string-with-serializer
+        <bserializer>
+        (write-to-string-with-serializer <bserializer> *binary-primitives*)))
+
+(test* "shared/circular component" #t
+       (topological-equal? *shared-substructure*
+                           (binary-round-trip *shared-substructure*)))
+
+(test* "sharing is preserved" '(#t #t #f)
+       (let* ([s (string-copy "abc")]
+              [r (binary-round-trip (list s s (string-copy "abc")))])
+         (list (eq? (car r) (cadr r))
+               (equal? (car r) (caddr r))
+               (eq? (car r) (caddr r)))))
+
+(test* "circular vector" #t
+       (let1 v (vector 1 #f)
+         (vector-set! v 1 v)
+         (let1 r (binary-round-trip v)
+           (eq? r (vector-ref r 1)))))
+
+(test* "uninterned symbol" '(#f #t)
+       (let* ([g (gensym)]
+              [r (binary-round-trip (list g g))])
+         (list (eq? (car r) g) (eq? (car r) (cadr r)))))
+
+(test* "hash table" '(equal? 1 (a b) #t)
+       (let1 h (make-hash-table 'equal?)
+         (hash-table-put! h "one" 1)
+         (hash-table-put! h '(k) '(a b))
+         (hash-table-put! h 'self h)
+         (let1 r (binary-round-trip h)
+           (list (hash-table-type r)
+                 (hash-table-get r "one")
+                 (hash-table-get r '(k))
+                 (eq? r (hash-table-get r 'self))))))
+
+(test* "objects" #t
+       (topological-equal? *object-instances*
+                           (binary-round-trip *object-instances*)))
+
+(define-record-type bpoint (make-bpoint x y) bpoint?
+  (x bpoint-x)
+  (y bpoint-y))
+
+(test* "records" '(#t 1 (2 3))
+       (let1 r (binary-round-trip (make-bpoint 1 '(2 3)))
+         (list (bpoint? r) (bpoint-x r) (bpoint-y r))))
+
+(test* "stream of data (u8vector)" '((a 1) "b" #(c) end)
+       (let1 v (apply u8vector-append (map serialize '((a 1) "b" #(c))))
+         (let loop ([pos 0] [r '()])
+           (if (= pos (u8vector-length v))
+             (reverse (cons 'end r))
+             (receive (obj next) (deserialize v pos)
+               (loop next (cons obj r)))))))
+
+(test* "stream of data (port)" '((a 1) "b" #(c) #t)
+       (let1 s (call-with-output-string
+                 (^p (for-each (cut write-serialized <> p) '((a 1) "b" #(c)))))
+         (call-with-input-string s
+           (^p (let* ([a (read-serialized p)]
+                      [b (read-serialized p)]
+                      [c (read-serialized p)])
+                 (list a b c (eof-object? (read-serialized p))))))))
+
+(test* "large data" #t
+       (let1 data (list (iota 100000)
+                        (make-vector 10000 "shared")
+                        (make-u8vector 100000 7))
+         (equal? data (binary-round-trip data))))
+
+(test* "file i/o" #t
+       (unwind-protect
+           (let ([data (list *primitive-types*
+                             *shared-substructure*
+                             *object-instances*)])
+             (write-to-file-with-serializer <bserializer> data "test.s")
+             (topological-equal? data
+                                 (read-from-file-with-serializer <bserializer>
+                                                                 "test.s")))
+         (sys-unlink "test.s")))
+
+(test* "unserializable" (test-error)
+       (serialize (list (current-output-port))))
+(test* "malformed" (test-error)
+       (deserialize (u8vector 1 2 3 4)))
+(test* "truncated" (test-error)
+       (let1 v (serialize '(a b c))
+         (deserialize v 0 (- (u8vector-length v) 1))))
+
+;; Corrupted data must not make the decoder allocate a huge object
+;; or overflow the stack.
+(let ([header (u8vector-copy (serialize '()) 0 4)])
+  (define (bad bytes)
+    (u8vector-append header (list->u8vector bytes)))
+  (test* "malformed vector size" (test-error)
+         (deserialize (bad '(#x32 #xff #xff #xff #xff #x0f 0))))
+  (test* "malformed vector size (port)" (test-error)
+         (call-with-input-string (u8vector->string
+                                  (bad '(#x32 #xff #xff #xff #xff #x0f 0)))
+           read-serialized))
+  (test* "malformed uvector size" (test-error)
+         (deserialize (bad '(#x33 #x0a #xff #xff #xff #xff #x0f 0))))
+  (test* "malformed string length" (test-error)
+         (deserialize (bad `(#x20 0 1 5 ,(char->integer #\a)))))
+  (test* "nested too deeply" (test-error)
+         (deserialize (bad (fold (^[_ bytes] (list* #x32 1 bytes))
+                                 '(0) (iota 20000)))))
+  ;; An instance of a builtin class, which can't be allocated from slots
+  (test* "instance of builtin class" (test-error)
+         (deserialize (bad `(#x35 #x36 #x21 6 6
+                             ,@(map char->integer (string->list "<pair>"))
+                             #x01 0))))
+  )
+(test* "serialize nested too deeply" (test-error)
+       (serialize (fold (^[_ x] (list x)) '() (iota 20000))))
+
 ;(test "dserializer"
 ;      (lambda ()
 ;        (let* ((data *primitive-types*)
@@ -0,0 +1,36 @@
+;;
+;; Measuring sort performance on various input patterns
+;;
+
+(use gauche.time)
+(use data.random)
+
+(define-constant *size* 1000000)
+
+(define %sort-parallel-threshold
+  (with-module gauche.internal %sort-parallel-threshold))
+
+(define (inputs)
+  (let1 rnd (list->vector (generator->list (integers$ *size*) *size*))
+    `((random   . ,rnd)
+      (sorted   . ,(list->vector (iota *size*)))
+      (reversed . ,(list->vector (reverse (iota *size*))))
+      (few-keys . ,(vector-map (cut modulo <> 16) rnd))
+      (appended . ,(vector-append (list->vector (iota (quotient *size* 2)))
+                                  (vector-copy rnd 0 (quotient *size* 2))))
+      (flonums  . ,(vector-map (cut / <> 3.0) rnd))
+      (strings  . ,(vector-map number->string rnd)))))
+
+(define (sequentially thunk)
+  (^[] (let1 thr (%sort-parallel-threshold 0)
+         (unwind-protect (thunk) (%sort-parallel-threshold thr)))))
+
+(define (main args)
+  (dolist [p (inputs)]
+    (let1 v (cdr p)
+      (print (car p) ":")
+      ($ time-these/report '(cpu 3)
+         `((sequential . ,(sequentially (^[] (sort v))))
+           (parallel   . ,(^[] (sort v)))
+           (sort-by    . ,(sequentially (^[] (sort-by v (^x x)))))
+           (scheme-cmp . ,(^[] (sort v (^[a b] (< (compare a b) 0))))))))))
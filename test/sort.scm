@@ -169,4 +169,72 @@
  boolean<?
  '((1 3 1 2 4 2) (1 3 1 2 4 2)))
 
+(test-section "internal sort")
+
+;; Compare the internal sort with the merge sort in Scheme, which is
+;; used when an explicit comparison procedure is given.
+(define (lcg-list n seed mod)
+  (let loop ([i 0] [x seed] [r '()])
+    (if (= i n)
+      (reverse r)
+      (let1 x (modulo (+ (* x 1103515245) 12345) 2147483648)
+        (loop (+ i 1) x (cons (modulo (ash x -8) mod) r))))))
+
+(define (check-internal-sort name lis)
+  (let1 exp (stable-sort lis (^[a b] (< (compare a b) 0)))
+    (test* #"sort ~name (list)" exp (sort lis))
+    (test* #"sort ~name (vector)" (list->vector exp)
+           (sort (list->vector lis)))
+    (test* #"sort! ~name (vector)" (list->vector exp)
+           (rlet1 v (list->vector lis) (sort! v)))
+    (test* #"sort! ~name (list)" exp (sort! (list-copy lis)))))
+
+(let ([rnd (lcg-list 5000 1 100000)]
+      [dup (lcg-list 5000 2 10)])
+  (check-internal-sort "fixnums" rnd)
+  (check-internal-sort "fixnums with duplicates" dup)
+  (check-internal-sort "sorted" (iota 5000))
+  (check-internal-sort "reversed" (reverse (iota 5000)))
+  (check-internal-sort "sawtooth" (map (cut modulo <> 700) (iota 5000)))
+  (check-internal-sort "appended" (append (iota 3000) (iota 2000 -500)))
+  (check-internal-sort "flonums" (map (cut / <> 7.0) rnd))
+  (check-internal-sort "strings" (map number->string rnd))
+  (check-internal-sort "mixed numbers"
+                       (map (^[x] (case (modulo x 3)
+                                    [(0) x] [(1) (/ x 3)] [else (* x 0.5)]))
+                            rnd))
+  (check-internal-sort "mixed types"
+                       (map (^[x] (case (modulo x 3)
+                                    [(0) x] [(1) (number->string x)]
+                                    [else (integer->char (+ 65 (modulo x 26)))]))
+                            rnd)))
+
+(let ([thr ((with-module gauche.internal %sort-parallel-threshold) 100)])
+  (unwind-protect
+      (let ([rnd (lcg-list 20000 3 1000000)])
+        (check-internal-sort "parallel fixnums" rnd)
+        (check-internal-sort "parallel flonums" (map (cut * <> 0.25) rnd))
+        (check-internal-sort "parallel strings" (map number->string rnd))
+        (test* "sort-by parallel (stability)"
+               (stable-sort (map cons (lcg-list 20000 4 50) (iota 20000))
+                            (^[a b] (< (car a) (car b))))
+               (sort-by (list->vector (map cons (lcg-list 20000 4 50)
+                                           (iota 20000)))
+                        car)
+               (^[exp vec] (equal? exp (vector->list vec)))))
+    ((with-module gauche.internal %sort-parallel-threshold) thr)))
+
+(test* "sort-by stability (nocmp)"
+       '((0 . b) (0 . d) (1 . a) (1 . c) (2 . e))
+       (sort-by '((1 . a) (0 . b) (1 . c) (0 . d) (2 . e)) car))
+(test* "sort-by! stability (nocmp)"
+       '#((0 . b) (0 . d) (1 . a) (1 . c) (2 . e))
+       (sort-by! (vector '(1 . a) '(0 . b) '(1 . c) '(0 . d) '(2 . e)) car))
+(test* "sort-by computes keys once" 5
+       (let1 n 0
+         (sort-by '(3 1 4 1 5) (^x (inc! n) (- x)))
+         n))
+(test* "stable-sort (nocmp) stability" '(1 1.0 2 2.0 3)
+       (stable-sort '(2 1 2.0 1.0 3)))
+
 (test-end)
@@ -968,5 +968,37 @@
   ] 
  [else]) ; gauche.os.windows
 
+;;-------------------------------------------------------------------
+(test-section "gc")
+
+(test* "gc-stat" '(:total-heap-size :free-bytes :bytes-since-gc :total-bytes
+                   :gc-count :free-space-divisor :markers :thread-local-alloc)
+       (map car (gc-stat)))
+
+(test* "gc-stat :markers" #t
+       (let1 n (cadr (assq :markers (gc-stat)))
+         (and (exact-integer? n) (>= n 1))))
+
+(let ()
+  (define (events kind) (filter (^e (eq? (car e) kind)) (gc-event-log)))
+  (gc-event-log-start! 4)
+  (gc)
+  (test* "gc-event-log (collection)" '(#t #t #t)
+         (let1 e (last (events 'collection))
+           (list (eq? (get-keyword :thread (cdr e)) (current-thread))
+                 (>= (get-keyword :duration (cdr e)) 0)
+                 (exact-integer? (get-keyword :reclaimed (cdr e))))))
+  (dotimes [i 10] (gc))
+  (test* "gc-event-log (ring buffer)" '(4 #t)
+         (list (length (gc-event-log))
+               (>= (gc-event-count) 11)))
+  (test* "gc-event-log (clear)" '(4 ())
+         (let* ([a (gc-event-log #t)]
+                [b (gc-event-log)])
+           (list (length a) b)))
+  (gc-event-log-stop!)
+  (gc)
+  (test* "gc-event-log (stopped)" '() (gc-event-log)))
+
 (test-end)
 
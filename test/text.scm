@@ -50,6 +50,52 @@
        (eof-object?
         (call-with-input-string "" (make-csv-reader #\,))))
 
+(test* "csv-reader (crlf)" '(("a\r\nb" "c") ("d" "e"))
+       (call-with-input-string "\"a\r\nb\",c\r\nd,e\r\n"
+         (^p (let1 r (make-csv-reader #\,)
+               (let* ([a (r p)] [b (r p)])
+                 (and (eof-object? (r p)) (list a b)))))))
+
+(test* "csv-reader (tab)" '("a" "" "b c")
+       (call-with-input-string "a\t\t b c \n"
+         (make-csv-reader #\tab)))
+
+(test* "csv-reader (vector)" '(#("a" "b") #("" "c d"))
+       (call-with-input-string "a,b\n,\"c d\"\n"
+         (^p (let1 r (make-csv-reader #\, #\" 'vector)
+               (let* ([a (r p)] [b (r p)])
+                 (and (eof-object? (r p)) (list a b)))))))
+
+(test* "csv-reader (multibyte)" '("あい" "う\"" "λ")
+       (call-with-input-string "あい,\"う\"\"\", λ \n"
+         (make-csv-reader #\,)))
+
+(test* "csv-column-reader"
+       '#(#("a" "b" "c") #f64(1.5 -2.0e10 0.25) #s32(-3 2147483647 7)
+          #f #(12 #f 1/2))
+       (call-with-input-string "a,1.5,-3,x,12\nb,-2e10,2147483647,y,z\nc,.25,7,,1/2\n"
+         (make-csv-column-reader #\, '(string f64 s32 #f number))))
+
+(test* "csv-column-reader (max-rows)"
+       '(#(#u8(1 2) #f32(0.5 -4.0)) #(#u8(3) #f32(1.0)) #t)
+       (let1 r (make-csv-column-reader #\, '(u8 f32))
+         (call-with-input-string "1,0.5\n2,-4\n3,1\n"
+           (^p (let* ([a (r p 2)] [b (r p 2)] [c (r p 2)])
+                 (list a b (eof-object? c)))))))
+
+(test* "csv-column-reader (missing flonum)" #t
+       (let1 v (call-with-input-string "1\n"
+                 (make-csv-column-reader #\, '(s8 f64)))
+         (nan? (uvector-ref (vector-ref v 1) 0))))
+
+(test* "csv-column-reader (out of range)" (test-error)
+       (call-with-input-string "256\n"
+         (make-csv-column-reader #\, '(u8))))
+
+(test* "csv-column-reader (empty integer)" (test-error)
+       (call-with-input-string "1\n\n"
+         (make-csv-column-reader #\, '(s16))))
+
 (test* "csv-writer"
        "abc,def,123,\"what's up?\",\"he said, \"\"nothing new.\"\"\"\n"
        (call-with-output-string
@@ -0,0 +1,84 @@
+;;
+;; Benchmark of bignum algorithms
+;;
+;;  gosh tools/bench-bignum.scm [mul|div|str|all]
+;;
+;;  For each operation, compares the time with the faster algorithm
+;;  disabled (threshold set beyond the operand size) and enabled with
+;;  the default threshold, over a range of operand sizes (in words).
+;;  The crossover point is where the ratio goes below 1.0.  Use the
+;;  result to tune the default thresholds in src/bignum.c.
+;;
+
+(use gauche.time)
+(use srfi-27)
+(use util.match)
+
+(define %threshold (with-module gauche.internal %bignum-algorithm-threshold))
+
+(define *word-bits* (if (> (fixnum-width) 32) 64 32))
+
+(define *sizes* '(10 20 30 40 60 80 120 160 240 320 480 640 1000 1500 2000 4000))
+
+(define (random-bignum words)
+  (+ (ash 1 (- (* words *word-bits*) 1))
+     (random-integer (ash 1 (- (* words *word-bits*) 1)))))
+
+;; Returns average microseconds per call of THUNK.
+(define (measure thunk)
+  (let1 counter (make <real-time-counter>)
+    (let loop ([n 1])
+      (with-time-counter counter (dotimes [i n] (thunk)))
+      (if (< (time-counter-value counter) 0.2)
+        (begin (time-counter-reset! counter) (loop (* n 2)))
+        (* 1e6 (/ (time-counter-value counter) n))))))
+
+;; Runs THUNK with threshold NAME temporarily set to VALUE.
+(define (with-threshold name value thunk)
+  (let1 prev (%threshold name value)
+    (unwind-protect (thunk) (%threshold name prev))))
+
+(define (compare title name make-thunk)
+  (print title " (threshold " name " = " (%threshold name) " words)")
+  (print (format "~8a ~14a ~14a ~8a" "words" "disabled(us)" "enabled(us)" "ratio"))
+  (dolist [n *sizes*]
+    (let* ([thunk (make-thunk n)]
+           [t0 (with-threshold name *disabled* (cut measure thunk))]
+           [t1 (measure thunk)])
+      (print (format "~8d ~14,2f ~14,2f ~8,3f" n t0 t1 (/ t1 t0)))))
+  (newline))
+
+;; A threshold large enough to disable the algorithm; must fit in C int.
+(define *disabled* (- (expt 2 30) 1))
+
+(define (bench-mul)
+  (compare "Karatsuba vs schoolbook multiplication" 'karatsuba
+           (^n (let ([x (random-bignum n)] [y (random-bignum n)])
+                 (^[] (* x y)))))
+  (compare "Toom-3 vs Karatsuba multiplication" 'toom3
+           (^n (let ([x (random-bignum n)] [y (random-bignum n)])
+                 (^[] (* x y))))))
+
+(define (bench-div)
+  ;; Burnikel-Ziegler is used only for divisors several times larger than
+  ;; its base case; we move the base case here.
+  (compare "Burnikel-Ziegler vs Knuth division (2n/n words)" 'bz
+           (^n (let ([x (random-bignum (* n 2))] [y (random-bignum n)])
+                 (^[] (quotient&remainder x y))))))
+
+(define (bench-str)
+  (compare "Divide-and-conquer vs simple number->string" 'dc-conv
+           (^n (let1 x (random-bignum n)
+                 (^[] (number->string x)))))
+  (compare "Divide-and-conquer vs simple string->number" 'dc-conv
+           (^n (let1 s (number->string (random-bignum n))
+                 (^[] (string->number s))))))
+
+(define (main args)
+  (match (cdr args)
+    [("mul") (bench-mul)]
+    [("div") (bench-div)]
+    [("str") (bench-str)]
+    [(or () ("all")) (bench-mul) (bench-div) (bench-str)]
+    [_ (exit 1 "Usage: gosh bench-bignum.scm [mul|div|str|all]")])
+  0)